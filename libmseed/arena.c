@@ -0,0 +1,550 @@
+/***************************************************************************
+ * arena.c:
+ *
+ * Arena allocation for records, blockettes and traces.
+ *
+ * Memory is allocated sequentially from large blocks and released in
+ * bulk when the arena is reset or freed, avoiding many small
+ * allocations and frees when working through a trace group or a
+ * conversion job.  Individual allocations cannot be released, freeing
+ * an object allocated from an arena is a no-op until the arena is
+ * reset.  An arena is not safe for use by multiple threads.
+ *
+ * Blocks are aligned to and sized in multiples of a 64 KiB span, the
+ * spans of all blocks are registered with their arena in a private
+ * table.  The owner of any pointer is found by looking up its span,
+ * so ownership is not recorded in the public structures and heap
+ * memory attached to an arena allocated structure is still freed.
+ *
+ * modified: 2026.291
+ ***************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed.h"
+#include "packdata.h"
+
+/* The registry is shared by all arenas, e.g. the per-thread arenas
+ * of the parallel reader, and is locked when threads are available */
+#if !defined(LMP_WIN) && !defined(LMP_NOTHREADS)
+  #define LMP_THREADS 1
+  #include <pthread.h>
+static pthread_mutex_t registrylock = PTHREAD_MUTEX_INITIALIZER;
+  #define REGISTRY_LOCK() pthread_mutex_lock (&registrylock)
+  #define REGISTRY_UNLOCK() pthread_mutex_unlock (&registrylock)
+#else
+  #define REGISTRY_LOCK()
+  #define REGISTRY_UNLOCK()
+#endif
+
+/* Span alignment and size granularity of blocks */
+#define ARENA_SPANSHIFT 16
+#define ARENA_SPAN ((size_t)1 << ARENA_SPANSHIFT)
+
+/* Span aligned allocation of blocks */
+#if defined(LMP_WIN)
+  #include <malloc.h>
+  #define ALLOC_SPANS(P, SIZE) (((P) = _aligned_malloc ((SIZE), ARENA_SPAN)) != NULL)
+  #define FREE_SPANS(P) _aligned_free (P)
+#else
+  #define ALLOC_SPANS(P, SIZE) (posix_memalign (&(P), ARENA_SPAN, (SIZE)) == 0)
+  #define FREE_SPANS(P) free (P)
+#endif
+
+/* Alignment of allocations, suitable for any object */
+#define ARENA_ALIGN 16
+
+/* Size of block header, rounded to alignment */
+#define ARENA_HEADER ((sizeof (MSArenaBlock) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+/* Default allocation space of arena blocks, a block is one span */
+#define ARENA_BLOCKSIZE (ARENA_SPAN - ARENA_HEADER)
+
+/* Table of keys, span numbers or object addresses, to their arena.
+ * Open addressing with linear probing, a key of 0 is an empty slot */
+typedef struct ArenaEntry_s
+{
+  uintptr_t key;
+  MSArena *arena;
+} ArenaEntry;
+
+typedef struct ArenaTable_s
+{
+  ArenaEntry *entries;
+  int bits;      /* Table size is 2^bits */
+  size_t count;  /* Number of keys in table */
+} ArenaTable;
+
+/* Spans of all blocks and arenas bound to trace groups */
+static ArenaTable spantable   = {NULL, 0, 0};
+static ArenaTable objecttable = {NULL, 0, 0};
+
+static size_t table_slot (ArenaTable *table, uintptr_t key);
+static MSArena *table_get (ArenaTable *table, uintptr_t key);
+static int table_put (ArenaTable *table, uintptr_t key, MSArena *arena);
+static void table_del (ArenaTable *table, uintptr_t key);
+static MSArenaBlock *block_alloc (MSArena *arena, size_t size);
+static void block_free (MSArenaBlock *block);
+
+/***************************************************************************
+ * ms_arena_init:
+ *
+ * Initialize and return an MSArena struct, allocating memory if
+ * needed.  If the arena already contains blocks all allocations are
+ * released, the most recently allocated block of the default size is
+ * retained for reuse.  A blocksize of 0 selects the default block
+ * size of 64 KiB including the block header, blocks are rounded up to
+ * a multiple of 64 KiB.
+ *
+ * Returns a pointer to a MSArena struct on success or NULL on error.
+ ***************************************************************************/
+MSArena *
+ms_arena_init (MSArena *arena, size_t blocksize)
+{
+  MSArenaBlock *block;
+  MSArenaBlock *keep = NULL;
+  size_t keepsize;
+
+  if (!arena)
+  {
+    arena = (MSArena *)malloc (sizeof (MSArena));
+
+    if (arena == NULL)
+    {
+      ms_log (2, "ms_arena_init(): Cannot allocate memory\n");
+      return NULL;
+    }
+
+    arena->blocks = NULL;
+  }
+
+  if (blocksize == 0)
+    blocksize = ARENA_BLOCKSIZE;
+
+  keepsize = ((ARENA_HEADER + blocksize + ARENA_SPAN - 1) & ~(ARENA_SPAN - 1)) - ARENA_HEADER;
+
+  /* Release all blocks except one of the block size */
+  while (arena->blocks)
+  {
+    block         = arena->blocks;
+    arena->blocks = block->next;
+
+    if (!keep && block->size == keepsize)
+      keep = block;
+    else
+      block_free (block);
+  }
+
+  if (keep)
+  {
+    keep->next = NULL;
+    keep->used = 0;
+  }
+
+  arena->blocks    = keep;
+  arena->blocksize = blocksize;
+
+  return arena;
+} /* End of ms_arena_init() */
+
+/***************************************************************************
+ * ms_arena_alloc:
+ *
+ * Allocate memory from an arena, aligned for any object type.  A new
+ * block is added when the current block is full, allocations larger
+ * than the arena block size are given a block of their own.  If the
+ * arena is NULL the memory is allocated with malloc().
+ *
+ * Returns a pointer to the memory on success or NULL on error.
+ ***************************************************************************/
+void *
+ms_arena_alloc (MSArena *arena, size_t size)
+{
+  MSArenaBlock *block;
+  size_t blocksize;
+  void *ptr;
+
+  if (!arena)
+    return malloc (size);
+
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+  if (size == 0)
+    size = ARENA_ALIGN;
+
+  block = arena->blocks;
+
+  if (!block || (block->size - block->used) < size)
+  {
+    blocksize = (size > arena->blocksize) ? size : arena->blocksize;
+
+    if (!(block = block_alloc (arena, blocksize)))
+    {
+      ms_log (2, "ms_arena_alloc(): Cannot allocate memory\n");
+      return NULL;
+    }
+
+    /* Keep a partially used current block ahead of a dedicated block */
+    if (arena->blocks && blocksize > arena->blocksize)
+    {
+      block->next         = arena->blocks->next;
+      arena->blocks->next = block;
+    }
+    else
+    {
+      block->next   = arena->blocks;
+      arena->blocks = block;
+    }
+  }
+
+  ptr = (char *)block + ARENA_HEADER + block->used;
+  block->used += size;
+
+  return ptr;
+} /* End of ms_arena_alloc() */
+
+/***************************************************************************
+ * ms_arena_owner:
+ *
+ * Determine the arena that memory was allocated from by looking up the
+ * span of the pointer in the registry of arena blocks.
+ *
+ * Returns the owning arena or NULL if the memory is not part of an
+ * arena, e.g. heap memory.
+ ***************************************************************************/
+MSArena *
+ms_arena_owner (const void *ptr)
+{
+  MSArena *arena;
+
+  if (!ptr)
+    return NULL;
+
+  REGISTRY_LOCK ();
+  arena = table_get (&spantable, (uintptr_t)ptr >> ARENA_SPANSHIFT);
+  REGISTRY_UNLOCK ();
+
+  return arena;
+} /* End of ms_arena_owner() */
+
+/***************************************************************************
+ * ms_arena_owns:
+ *
+ * Determine if memory was allocated from an arena.
+ *
+ * Returns 1 if the memory is part of the arena and 0 otherwise.
+ ***************************************************************************/
+int
+ms_arena_owns (MSArena *arena, const void *ptr)
+{
+  if (!arena || !ptr)
+    return 0;
+
+  return (ms_arena_owner (ptr) == arena) ? 1 : 0;
+} /* End of ms_arena_owns() */
+
+/***************************************************************************
+ * ms_arena_release:
+ *
+ * Release memory allocated with ms_arena_alloc() or malloc().  Memory
+ * allocated from an arena is released when the arena is reset or
+ * freed, heap memory is released with free().
+ ***************************************************************************/
+void
+ms_arena_release (void *ptr)
+{
+  if (!ptr || ms_arena_owner (ptr))
+    return;
+
+  free (ptr);
+} /* End of ms_arena_release() */
+
+/***************************************************************************
+ * ms_arena_bind:
+ *
+ * Bind an arena to an object, e.g. a MSTraceGroup, so that memory for
+ * the object can be allocated from the arena without storing it in
+ * the object.  An arena of NULL removes the binding.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ms_arena_bind (const void *object, MSArena *arena)
+{
+  int retval = 0;
+
+  if (!object)
+    return -1;
+
+  REGISTRY_LOCK ();
+  if (arena)
+    retval = table_put (&objecttable, (uintptr_t)object, arena);
+  else
+    table_del (&objecttable, (uintptr_t)object);
+  REGISTRY_UNLOCK ();
+
+  if (retval)
+    ms_log (2, "ms_arena_bind(): Cannot allocate memory\n");
+
+  return retval;
+} /* End of ms_arena_bind() */
+
+/***************************************************************************
+ * ms_arena_bound:
+ *
+ * Returns the arena bound to an object or NULL if none.
+ ***************************************************************************/
+MSArena *
+ms_arena_bound (const void *object)
+{
+  MSArena *arena;
+
+  if (!object)
+    return NULL;
+
+  REGISTRY_LOCK ();
+  arena = table_get (&objecttable, (uintptr_t)object);
+  REGISTRY_UNLOCK ();
+
+  return arena;
+} /* End of ms_arena_bound() */
+
+/***************************************************************************
+ * ms_arena_free:
+ *
+ * Free all memory associated with an arena, remove any bindings of
+ * the arena to objects and set the pointer to NULL.
+ ***************************************************************************/
+void
+ms_arena_free (MSArena **pparena)
+{
+  MSArenaBlock *block;
+  size_t idx;
+
+  if (!pparena || !*pparena)
+    return;
+
+  while ((*pparena)->blocks)
+  {
+    block              = (*pparena)->blocks;
+    (*pparena)->blocks = block->next;
+    block_free (block);
+  }
+
+  /* Deleting shifts later entries back, the slot is checked again */
+  REGISTRY_LOCK ();
+  for (idx = 0; objecttable.count && idx < ((size_t)1 << objecttable.bits);)
+  {
+    if (objecttable.entries[idx].key && objecttable.entries[idx].arena == *pparena)
+      table_del (&objecttable, objecttable.entries[idx].key);
+    else
+      idx++;
+  }
+  REGISTRY_UNLOCK ();
+
+  free (*pparena);
+  *pparena = NULL;
+} /* End of ms_arena_free() */
+
+/***************************************************************************
+ * block_alloc:
+ *
+ * Allocate a span aligned block with at least size bytes of
+ * allocation space and register its spans to the arena.
+ *
+ * Returns a pointer to the block on success or NULL on error.
+ ***************************************************************************/
+static MSArenaBlock *
+block_alloc (MSArena *arena, size_t size)
+{
+  MSArenaBlock *block;
+  uintptr_t span;
+  size_t total;
+  size_t idx;
+  void *ptr;
+
+  total = (ARENA_HEADER + size + ARENA_SPAN - 1) & ~(ARENA_SPAN - 1);
+
+  if (total < size || !ALLOC_SPANS (ptr, total))
+    return NULL;
+
+  span = (uintptr_t)ptr >> ARENA_SPANSHIFT;
+
+  REGISTRY_LOCK ();
+  for (idx = 0; idx < (total >> ARENA_SPANSHIFT); idx++)
+  {
+    if (table_put (&spantable, span + idx, arena))
+    {
+      while (idx-- > 0)
+        table_del (&spantable, span + idx);
+
+      REGISTRY_UNLOCK ();
+      FREE_SPANS (ptr);
+      return NULL;
+    }
+  }
+  REGISTRY_UNLOCK ();
+
+  block       = (MSArenaBlock *)ptr;
+  block->next = NULL;
+  block->size = total - ARENA_HEADER;
+  block->used = 0;
+
+  return block;
+} /* End of block_alloc() */
+
+/***************************************************************************
+ * block_free:
+ *
+ * Remove the spans of a block from the registry and free it.
+ ***************************************************************************/
+static void
+block_free (MSArenaBlock *block)
+{
+  uintptr_t span = (uintptr_t)block >> ARENA_SPANSHIFT;
+  size_t idx;
+
+  REGISTRY_LOCK ();
+  for (idx = 0; idx < ((ARENA_HEADER + block->size) >> ARENA_SPANSHIFT); idx++)
+    table_del (&spantable, span + idx);
+  REGISTRY_UNLOCK ();
+
+  FREE_SPANS (block);
+} /* End of block_free() */
+
+/***************************************************************************
+ * table_slot:
+ *
+ * Returns the home slot of a key, a Fibonacci hash of the key.
+ ***************************************************************************/
+static size_t
+table_slot (ArenaTable *table, uintptr_t key)
+{
+  return (size_t) (((uint64_t)key * UINT64_C (0x9E3779B97F4A7C15)) >> (64 - table->bits));
+} /* End of table_slot() */
+
+/***************************************************************************
+ * table_get:
+ *
+ * Returns the arena of a key or NULL if the key is not in the table.
+ ***************************************************************************/
+static MSArena *
+table_get (ArenaTable *table, uintptr_t key)
+{
+  size_t mask;
+  size_t idx;
+
+  if (!table->count)
+    return NULL;
+
+  mask = ((size_t)1 << table->bits) - 1;
+
+  for (idx = table_slot (table, key); table->entries[idx].key; idx = (idx + 1) & mask)
+  {
+    if (table->entries[idx].key == key)
+      return table->entries[idx].arena;
+  }
+
+  return NULL;
+} /* End of table_get() */
+
+/***************************************************************************
+ * table_put:
+ *
+ * Add or replace the arena of a key, the table is doubled in size
+ * when more than half full.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+table_put (ArenaTable *table, uintptr_t key, MSArena *arena)
+{
+  ArenaTable grown;
+  size_t mask;
+  size_t idx;
+
+  if (!table->entries || (table->count + 1) * 2 > ((size_t)1 << table->bits))
+  {
+    grown.bits  = (table->bits) ? table->bits + 1 : 6;
+    grown.count = 0;
+
+    if (!(grown.entries = (ArenaEntry *)calloc ((size_t)1 << grown.bits, sizeof (ArenaEntry))))
+      return -1;
+
+    if (table->entries)
+    {
+      for (idx = 0; idx < ((size_t)1 << table->bits); idx++)
+      {
+        if (table->entries[idx].key)
+          table_put (&grown, table->entries[idx].key, table->entries[idx].arena);
+      }
+
+      free (table->entries);
+    }
+
+    *table = grown;
+  }
+
+  mask = ((size_t)1 << table->bits) - 1;
+
+  for (idx = table_slot (table, key); table->entries[idx].key; idx = (idx + 1) & mask)
+  {
+    if (table->entries[idx].key == key)
+    {
+      table->entries[idx].arena = arena;
+      return 0;
+    }
+  }
+
+  table->entries[idx].key   = key;
+  table->entries[idx].arena = arena;
+  table->count++;
+
+  return 0;
+} /* End of table_put() */
+
+/***************************************************************************
+ * table_del:
+ *
+ * Remove a key from the table, following entries of the probe
+ * sequence are shifted back so that no tombstones are needed.
+ ***************************************************************************/
+static void
+table_del (ArenaTable *table, uintptr_t key)
+{
+  size_t mask;
+  size_t hole;
+  size_t home;
+  size_t idx;
+
+  if (!table->count)
+    return;
+
+  mask = ((size_t)1 << table->bits) - 1;
+
+  for (hole = table_slot (table, key); table->entries[hole].key != key; hole = (hole + 1) & mask)
+  {
+    if (!table->entries[hole].key)
+      return;
+  }
+
+  for (idx = (hole + 1) & mask; table->entries[idx].key; idx = (idx + 1) & mask)
+  {
+    home = table_slot (table, table->entries[idx].key);
+
+    /* Move the entry into the hole unless its home lies cyclically
+     * after the hole and at or before the entry */
+    if ((idx > hole) ? (home <= hole || home > idx) : (home <= hole && home > idx))
+    {
+      table->entries[hole] = table->entries[idx];
+      hole                 = idx;
+    }
+  }
+
+  table->entries[hole].key   = 0;
+  table->entries[hole].arena = NULL;
+  table->count--;
+} /* End of table_del() */
@@ -7,9 +7,14 @@
  * opionally re-packs the data records and saves them to a specified
  * output file.
  *
+ * With the -P option the records are repacked by multiple threads,
+ * each channel is assigned to a single thread that repacks its records
+ * in input order.  Packed records are collected in a reorder buffer and
+ * written in the order they would be written by a single thread.
+ *
  * Written by Chad Trabant, IRIS Data Management Center
  *
- * modified 2012.105
+ * modified 2026.291
  ***************************************************************************/
 
 #include <stdio.h>
@@ -20,6 +25,7 @@
 
 #ifndef WIN32
   #include <signal.h>
+  #include <pthread.h>
   static void term_handler (int sig);
 #endif
 
@@ -39,8 +45,12 @@ static int   packencoding  = -1;
 static int   byteorder     = -1;
 static char *inputfile     = 0;
 static FILE *outfile       = 0;
+static int   workers       = 0;
 
 static int convertsamples (MSRecord *msr, int packencoding);
+#ifndef WIN32
+static int repack_parallel (void);
+#endif
 static int parameter_proc (int argcount, char **argvec);
 static void record_handler (char *record, int reclen, void *ptr);
 static void usage (void);
@@ -94,6 +104,18 @@ main (int argc, char **argv)
       MS_UNPACKENCODINGFORMAT (inputencoding);
     }
   
+#ifndef WIN32
+  /* Repack with multiple threads if requested */
+  if ( workers > 0 )
+    {
+      retcode = repack_parallel ();
+      
+      fclose (outfile);
+      
+      return retcode;
+    }
+#endif
+  
   /* Init MSTraceGroup */
   mstg = mst_initgroup (mstg);
   
@@ -421,6 +443,921 @@ convertsamples (MSRecord *msr, int packencoding)
 }  /* End of convertsamples() */
 
 
+#ifndef WIN32
+/* Number of input records held in the reorder buffer */
+#define REORDER_WINDOW 4096
+
+/* Input record of parallel repacking */
+typedef struct RepackRecord_s {
+  off_t   offset;                 /* Offset of record in input file */
+  int     reclen;                 /* Length of record */
+  int     worker;                 /* Worker repacking the record */
+} RepackRecord;
+
+/* Packed records of an input record or flushed trace */
+typedef struct RepackOutput_s {
+  char    *buffer;                /* Packed records */
+  size_t   length;                /* Length of packed records */
+  size_t   size;                  /* Size of buffer */
+  int      records;               /* Number of packed records */
+  int      packed;                /* Return value of packing, -1 on error */
+  int64_t  order;                 /* Input record creating a flushed trace */
+  flag     status;                /* 0: pending, 1: done, -1: error */
+  flag     logpacked;             /* Log packed records: 1 = now, 2 = after flush */
+  flag     renumber;              /* Renumber packed records in output order */
+  char     timecorrect[50];       /* Source name if time correction flag set */
+  char     message[100];          /* Error message */
+} RepackOutput;
+
+/* Worker state, traces of the channels assigned to the worker */
+typedef struct RepackWorker_s {
+  int            id;
+  int64_t        first;           /* First input record to repack */
+  int64_t        load;            /* Number of assigned records */
+  FILE          *fp;
+  char          *recbuf;
+  MSRecord      *msr;
+  MSTraceGroup  *mstg;
+  int64_t       *created;         /* Input record creating each trace */
+  RepackOutput  *flush;           /* Flushed records of each trace */
+  pthread_t      thread;
+} RepackWorker;
+
+/* Channel of input records */
+typedef struct RepackChannel_s {
+  char     srcname[50];           /* Source name after network replacement */
+  uint32_t hash;                  /* Hash of source name */
+  int64_t  records;               /* Number of records */
+  int      worker;                /* Assigned worker */
+} RepackChannel;
+
+static RepackRecord *records     = 0;
+static int64_t       recordcount = 0;
+static RepackOutput  reorder[REORDER_WINDOW];
+static int64_t       written     = 0;
+static flag          stopping    = 0;
+static pthread_mutex_t reorderlock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  reorderdone  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  reorderspace = PTHREAD_COND_INITIALIZER;
+
+static int64_t scanrecords (RepackWorker *workerlist, int *lastflag, int *readcode);
+static int findchannel (RepackChannel **channels, int *channelcount, int **table,
+			int *tablesize, MSRecord *msr);
+static int repackrecord (RepackWorker *worker, int64_t recidx, RepackOutput *output);
+static int flushtraces (RepackWorker *worker);
+static void *repackworker (void *arg);
+static void output_handler (char *record, int reclen, void *ptr);
+static void writeoutput (RepackOutput *output, int *iseqnum);
+static void printrecord (FILE *fp, char *recbuf, int64_t recidx);
+static int cmp_output (const void *a, const void *b);
+static void primepacking (void);
+static void discard_handler (char *record, int reclen, void *ptr);
+
+
+/***************************************************************************
+ * repack_parallel:
+ *
+ * Repack the input file with multiple threads.  The input records are
+ * scanned and each channel is assigned to the worker with the fewest
+ * records, workers repack the records of their channels in input
+ * order.  Repacked records are written in input record order through
+ * a reorder buffer of REORDER_WINDOW input records, when packing
+ * individual records sequence numbers are assigned in output order.
+ * Trace flushes are written in trace creation order at the end.  The
+ * output is identical to repacking with a single thread.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+repack_parallel (void)
+{
+  RepackWorker *workerlist;
+  RepackOutput **flushlist = 0;
+  RepackOutput *output;
+  FILE *printfp = 0;
+  char *printbuf = 0;
+  int64_t flushcount = 0;
+  int64_t recidx;
+  int64_t idx;
+  int lastflag = 0;
+  int readcode = MS_NOERROR;
+  int packedrecords = 0;
+  int iseqnum = 1;
+  int started;
+  int widx;
+  flag lastpacked = 0;
+  flag failed = 0;
+  
+  if ( ! (workerlist = (RepackWorker *) calloc (workers, sizeof(RepackWorker))) )
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return -1;
+    }
+  
+  /* Open input for each worker and for printing record details */
+  for (widx = 0; widx < workers; widx++)
+    {
+      workerlist[widx].id = widx;
+      
+      if ( ! (workerlist[widx].fp = fopen (inputfile, "rb")) ||
+	   ! (workerlist[widx].recbuf = (char *) malloc (MAXRECLEN)) ||
+	   ! (workerlist[widx].mstg = mst_initgroup (NULL)) )
+	{
+	  ms_log (2, "Cannot open input file %s: %s\n", inputfile, strerror(errno));
+	  failed = 1;
+	  break;
+	}
+    }
+  
+  if ( ! failed && (! (printfp = fopen (inputfile, "rb")) ||
+		    ! (printbuf = (char *) malloc (MAXRECLEN))) )
+    {
+      ms_log (2, "Cannot open input file %s: %s\n", inputfile, strerror(errno));
+      failed = 1;
+    }
+  
+  if ( ! failed && scanrecords (workerlist, &lastflag, &readcode) < 0 )
+    failed = 1;
+  
+  started = 0;
+  
+  if ( ! failed && recordcount > 0 )
+    {
+      /* Repack the first record before starting workers, library
+       * settings from the environment are initialized by the first
+       * unpacking and packing */
+      primepacking ();
+      
+      widx = records[0].worker;
+      repackrecord (&workerlist[widx], 0, &reorder[0]);
+      reorder[0].status = (reorder[0].status) ? reorder[0].status : 1;
+      workerlist[widx].first = 1;
+      
+      for (started = 0; started < workers; started++)
+	if ( pthread_create (&workerlist[started].thread, NULL, repackworker,
+			     &workerlist[started]) )
+	  {
+	    ms_log (2, "Cannot create repacking thread\n");
+	    break;
+	  }
+      
+      /* Stop repacking if not all workers were started */
+      if ( started < workers )
+	{
+	  pthread_mutex_lock (&reorderlock);
+	  stopping = 1;
+	  pthread_cond_broadcast (&reorderspace);
+	  pthread_mutex_unlock (&reorderlock);
+	  failed = 1;
+	}
+    }
+  
+  /* Write repacked records in input order */
+  for (recidx = 0; ! failed && recidx < recordcount; recidx++)
+    {
+      output = &reorder[recidx % REORDER_WINDOW];
+      
+      pthread_mutex_lock (&reorderlock);
+      while ( ! output->status )
+	pthread_cond_wait (&reorderdone, &reorderlock);
+      pthread_mutex_unlock (&reorderlock);
+      
+      printrecord (printfp, printbuf, recidx);
+      
+      if ( output->status < 0 )
+	{
+	  ms_log (2, "%s", output->message);
+	  failed = 1;
+	}
+      else
+	{
+	  if ( output->timecorrect[0] )
+	    ms_log (1, "Setting time correction applied flag for %s\n", output->timecorrect);
+	  
+	  writeoutput (output, &iseqnum);
+	  
+	  if ( output->logpacked == 1 )
+	    {
+	      if ( output->packed == -1 )
+		ms_log (2, "Cannot pack records\n");
+	      else
+		ms_log (1, "Packed %d records\n", output->packed);
+	    }
+	  
+	  lastpacked = (output->logpacked == 2);
+	}
+      
+      /* Release the reorder buffer slot for the next window */
+      pthread_mutex_lock (&reorderlock);
+      output->length = 0;
+      output->status = 0;
+      output->timecorrect[0] = '\0';
+      written = recidx + 1;
+      stopping = failed;
+      pthread_cond_broadcast (&reorderspace);
+      pthread_mutex_unlock (&reorderlock);
+    }
+  
+  for (widx = 0; widx < started; widx++)
+    pthread_join (workerlist[widx].thread, NULL);
+  
+  /* Write flushed traces in order of creation */
+  if ( ! failed && tracepack && recordcount > 0 )
+    {
+      for (widx = 0; widx < workers; widx++)
+	flushcount += workerlist[widx].mstg->numtraces;
+      
+      if ( flushcount > 0 &&
+	   ! (flushlist = (RepackOutput **) malloc (flushcount * sizeof(RepackOutput *))) )
+	{
+	  ms_log (2, "Cannot allocate memory\n");
+	  failed = 1;
+	}
+      
+      for (idx = 0, widx = 0; ! failed && widx < workers; widx++)
+	for (recidx = 0; recidx < workerlist[widx].mstg->numtraces; recidx++)
+	  flushlist[idx++] = &workerlist[widx].flush[recidx];
+      
+      if ( ! failed )
+	{
+	  qsort (flushlist, flushcount, sizeof(RepackOutput *), cmp_output);
+	  
+	  for (idx = 0; idx < flushcount; idx++)
+	    {
+	      writeoutput (flushlist[idx], &iseqnum);
+	      packedrecords += flushlist[idx]->packed;
+	    }
+	  
+	  /* Traces are flushed after the last record when packing traces
+	   * after reading all data, otherwise at the end */
+	  if ( packedrecords || (lastflag && lastpacked) )
+	    ms_log (1, "Packed %d records\n", packedrecords);
+	}
+      
+      if ( flushlist )
+	free (flushlist);
+    }
+  
+  if ( readcode != MS_ENDOFFILE )
+    ms_log (2, "Error reading %s: %s\n", inputfile, ms_errorstr(readcode));
+  
+  /* Make sure everything is cleaned up */
+  for (widx = 0; widx < workers; widx++)
+    {
+      if ( workerlist[widx].fp )
+	fclose (workerlist[widx].fp);
+      if ( workerlist[widx].recbuf )
+	free (workerlist[widx].recbuf);
+      if ( workerlist[widx].flush )
+	{
+	  for (idx = 0; idx < workerlist[widx].mstg->numtraces; idx++)
+	    free (workerlist[widx].flush[idx].buffer);
+	  free (workerlist[widx].flush);
+	}
+      if ( workerlist[widx].created )
+	free (workerlist[widx].created);
+      
+      msr_free (&workerlist[widx].msr);
+      
+      /* Free record templates */
+      if ( workerlist[widx].mstg )
+	{
+	  MSTrace *mst;
+	  
+	  for (mst = workerlist[widx].mstg->traces; mst; mst = mst->next)
+	    if ( mst->prvtptr )
+	      {
+		MSRecord *tmsr = (MSRecord *) mst->prvtptr;
+		msr_free (&tmsr);
+		mst->prvtptr = 0;
+	      }
+	  
+	  mst_freegroup (&workerlist[widx].mstg);
+	}
+    }
+  
+  for (idx = 0; idx < REORDER_WINDOW; idx++)
+    if ( reorder[idx].buffer )
+      free (reorder[idx].buffer);
+  
+  if ( printfp )
+    {
+      printrecord (NULL, NULL, 0);
+      fclose (printfp);
+    }
+  if ( printbuf )
+    free (printbuf);
+  if ( records )
+    free (records);
+  free (workerlist);
+  
+  return (failed) ? -1 : 0;
+}  /* End of repack_parallel() */
+
+
+/***************************************************************************
+ * scanrecords:
+ *
+ * Read the headers of all input records, recording the offset and
+ * length of each, and assign the channels of the records to workers.
+ * Channels are identified by source name without quality after
+ * replacing the network code, as records are matched to traces.
+ * Channels are assigned in order of decreasing record count to the
+ * worker with the fewest records.
+ *
+ * Returns the number of records on success, and -1 on failure
+ ***************************************************************************/
+static int64_t
+scanrecords (RepackWorker *workerlist, int *lastflag, int *readcode)
+{
+  MSRecord *msr = 0;
+  RepackChannel *channels = 0;
+  RepackRecord *newrecords;
+  int *table = 0;
+  int *order = 0;
+  int64_t recordsize = 0;
+  int64_t recidx;
+  off_t fpos;
+  int channelcount = 0;
+  int tablesize = 0;
+  int last = 0;
+  int channel;
+  int cidx;
+  int widx;
+  int minidx;
+  
+  while ( (*readcode = ms_readmsr (&msr, inputfile, reclen, &fpos, &last,
+				   1, 0, verbose)) == MS_NOERROR )
+    {
+      *lastflag = last;
+      
+      /* Packing parameters not specified are taken from the first record */
+      if ( recordcount == 0 )
+	{
+	  if ( packreclen < 0 )
+	    packreclen = msr->reclen;
+	  if ( packencoding < 0 )
+	    packencoding = msr->encoding;
+	  if ( byteorder < 0 )
+	    byteorder = msr->byteorder;
+	}
+      
+      if ( recordcount >= recordsize )
+	{
+	  recordsize = (recordsize) ? recordsize * 2 : 1024;
+	  
+	  if ( ! (newrecords = (RepackRecord *) realloc (records, recordsize * sizeof(RepackRecord))) )
+	    {
+	      ms_log (2, "Cannot allocate memory\n");
+	      break;
+	    }
+	  
+	  records = newrecords;
+	}
+      
+      /* Replace network code before identifying the channel */
+      if ( netcode )
+	strncpy (msr->network, netcode, sizeof(msr->network));
+      
+      if ( (channel = findchannel (&channels, &channelcount, &table, &tablesize, msr)) < 0 )
+	break;
+      
+      channels[channel].records++;
+      
+      records[recordcount].offset = fpos;
+      records[recordcount].reclen = msr->reclen;
+      records[recordcount].worker = channel;
+      recordcount++;
+    }
+  
+  ms_readmsr (&msr, NULL, 0, NULL, NULL, 0, 0, 0);
+  
+  if ( table )
+    free (table);
+  
+  if ( *readcode == MS_NOERROR ||
+       (channelcount > 0 && ! (order = (int *) malloc (channelcount * sizeof(int)))) )
+    {
+      if ( channels )
+	free (channels);
+      return -1;
+    }
+  
+  /* Assign channels to workers in order of decreasing record count */
+  for (cidx = 0; cidx < channelcount; cidx++)
+    order[cidx] = cidx;
+  
+  for (cidx = 1; cidx < channelcount; cidx++)
+    {
+      channel = order[cidx];
+      
+      for (widx = cidx; widx > 0 && channels[order[widx - 1]].records < channels[channel].records; widx--)
+	order[widx] = order[widx - 1];
+      
+      order[widx] = channel;
+    }
+  
+  for (cidx = 0; cidx < channelcount; cidx++)
+    {
+      for (minidx = 0, widx = 1; widx < workers; widx++)
+	if ( workerlist[widx].load < workerlist[minidx].load )
+	  minidx = widx;
+      
+      workerlist[minidx].load += channels[order[cidx]].records;
+      channels[order[cidx]].worker = minidx;
+    }
+  
+  for (recidx = 0; recidx < recordcount; recidx++)
+    records[recidx].worker = channels[records[recidx].worker].worker;
+  
+  if ( verbose )
+    ms_log (1, "Repacking %lld records of %d channels with %d threads\n",
+	    (long long int) recordcount, channelcount, workers);
+  
+  if ( order )
+    free (order);
+  if ( channels )
+    free (channels);
+  
+  return recordcount;
+}  /* End of scanrecords() */
+
+
+/***************************************************************************
+ * findchannel:
+ *
+ * Find the channel of a record in a hash table of channels, adding a
+ * new channel if not found.  The table is kept no more than half full.
+ *
+ * Returns the index of the channel on success, and -1 on failure
+ ***************************************************************************/
+static int
+findchannel (RepackChannel **channels, int *channelcount, int **table,
+	     int *tablesize, MSRecord *msr)
+{
+  RepackChannel *newchannels;
+  char srcname[50];
+  uint32_t hash = 2166136261u;
+  int *newtable;
+  int slot;
+  int idx;
+  char *cp;
+  
+  msr_srcname (msr, srcname, 0);
+  
+  for (cp = srcname; *cp; cp++)
+    {
+      hash ^= (uint8_t) *cp;
+      hash *= 16777619u;
+    }
+  
+  for (slot = (*tablesize) ? hash & (*tablesize - 1) : 0;
+       *tablesize && (*table)[slot] >= 0; slot = (slot + 1) & (*tablesize - 1))
+    {
+      idx = (*table)[slot];
+      
+      if ( (*channels)[idx].hash == hash && ! strcmp ((*channels)[idx].srcname, srcname) )
+	return idx;
+    }
+  
+  /* Grow channel list and table as needed, re-inserting channels */
+  if ( (*channelcount + 1) * 2 > *tablesize )
+    {
+      int newsize = (*tablesize) ? *tablesize * 2 : 64;
+      
+      if ( ! (newchannels = (RepackChannel *) realloc (*channels, newsize / 2 * sizeof(RepackChannel))) ||
+	   ! (newtable = (int *) malloc (newsize * sizeof(int))) )
+	{
+	  if ( newchannels )
+	    *channels = newchannels;
+	  ms_log (2, "Cannot allocate memory\n");
+	  return -1;
+	}
+      
+      *channels = newchannels;
+      memset (newtable, -1, newsize * sizeof(int));
+      
+      for (idx = 0; idx < *channelcount; idx++)
+	{
+	  for (slot = (*channels)[idx].hash & (newsize - 1); newtable[slot] >= 0;
+	       slot = (slot + 1) & (newsize - 1));
+	  
+	  newtable[slot] = idx;
+	}
+      
+      if ( *table )
+	free (*table);
+      
+      *table = newtable;
+      *tablesize = newsize;
+      
+      for (slot = hash & (newsize - 1); newtable[slot] >= 0; slot = (slot + 1) & (newsize - 1));
+    }
+  
+  idx = (*channelcount)++;
+  
+  strcpy ((*channels)[idx].srcname, srcname);
+  (*channels)[idx].hash = hash;
+  (*channels)[idx].records = 0;
+  (*channels)[idx].worker = 0;
+  (*table)[slot] = idx;
+  
+  return idx;
+}  /* End of findchannel() */
+
+
+/***************************************************************************
+ * repackrecord:
+ *
+ * Read, unpack and repack an input record with the traces of a worker
+ * following the same steps as repacking with a single thread.  The
+ * packed records and the messages to log are stored in the output
+ * entry to be written in input order.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+repackrecord (RepackWorker *worker, int64_t recidx, RepackOutput *output)
+{
+  RepackRecord *record = &records[recidx];
+  MSRecord *msr;
+  MSTrace *mst;
+  int64_t packedsamples;
+  int64_t *newcreated;
+  int retcode;
+  
+  output->records = 0;
+  output->packed = 0;
+  output->logpacked = 0;
+  output->renumber = 0;
+  
+  if ( lmp_fseeko (worker->fp, record->offset, SEEK_SET) ||
+       fread (worker->recbuf, record->reclen, 1, worker->fp) != 1 )
+    {
+      snprintf (output->message, sizeof(output->message),
+		"Error reading %s: %s\n", inputfile, strerror(errno));
+      output->status = -1;
+      return -1;
+    }
+  
+  if ( (retcode = msr_unpack (worker->recbuf, record->reclen, &worker->msr, 1, verbose)) != MS_NOERROR )
+    {
+      snprintf (output->message, sizeof(output->message),
+		"Error reading %s: %s\n", inputfile, ms_errorstr(retcode));
+      output->status = -1;
+      return -1;
+    }
+  
+  msr = worker->msr;
+  
+  /* Convert sample type as needed for packencoding */
+  if ( packencoding != msr->encoding )
+    {
+      if ( convertsamples (msr, packencoding) )
+	{
+	  snprintf (output->message, sizeof(output->message),
+		    "Error converting samples for encoding %d\n", packencoding);
+	  output->status = -1;
+	  return -1;
+	}
+    }
+  
+  msr->reclen = packreclen;
+  msr->encoding = packencoding;
+  msr->byteorder = byteorder;
+  
+  /* Set the time correction applied flag as done by main() */
+  if ( msr->fsdh->time_correct && ! (msr->fsdh->act_flags & 0x02) )
+    {
+      snprintf (output->timecorrect, sizeof(output->timecorrect), "%s_%s_%s_%s",
+		msr->network, msr->station, msr->location, msr->channel);
+      msr->fsdh->act_flags |= 0x02;
+    }
+  
+  /* Replace network code */
+  if ( netcode )
+    strncpy (msr->network, netcode, sizeof(msr->network));
+  
+  /* If no samples in the record just pack the header */
+  if ( msr->numsamples == 0 )
+    {
+      msr_pack_header (msr, 1, verbose);
+      output_handler (msr->record, msr->reclen, output);
+    }
+  
+  /* Pack each record individually, sequence numbers are assigned when written */
+  else if ( ! tracepack )
+    {
+      msr->sequence_number = 1;
+      
+      output->packed = msr_pack (msr, &output_handler, output, &packedsamples, 1, verbose);
+      output->logpacked = 1;
+      output->renumber = 1;
+    }
+  
+  /* Pack records from the traces of the worker */
+  else
+    {
+      mst = mst_addmsrtogroup (worker->mstg, msr, 0, -1.0, -1.0);
+      
+      if ( ! mst )
+	{
+	  snprintf (output->message, sizeof(output->message), "Error adding MSRecord to MStrace!\n");
+	  output->status = -1;
+	  return -1;
+	}
+      
+      /* Reset sequence number and free previous template */
+      if ( mst->prvtptr )
+	{
+	  MSRecord *tmsr = (MSRecord *) mst->prvtptr;
+	  
+	  /* Retain sequence number from previous template */
+	  msr->sequence_number = tmsr->sequence_number;
+	  
+	  msr_free (&tmsr);
+	}
+      else
+	{
+	  msr->sequence_number = 1;
+	  
+	  /* Track the input record creating the trace, new traces are
+	   * added to the end of the group */
+	  if ( ! (newcreated = (int64_t *) realloc (worker->created, worker->mstg->numtraces * sizeof(int64_t))) )
+	    {
+	      snprintf (output->message, sizeof(output->message), "Cannot allocate memory\n");
+	      output->status = -1;
+	      return -1;
+	    }
+	  
+	  worker->created = newcreated;
+	  worker->created[worker->mstg->numtraces - 1] = recidx;
+	}
+      
+      /* Copy MSRecord and store as template */
+      mst->prvtptr = msr_duplicate (msr, 0);
+      
+      if ( ! mst->prvtptr )
+	{
+	  snprintf (output->message, sizeof(output->message), "Error duplicating MSRecord for template!\n");
+	  output->status = -1;
+	  return -1;
+	}
+      
+      /* Pack full records, traces are flushed after all records */
+      if ( tracepack == 1 )
+	{
+	  for (mst = worker->mstg->traces; mst; mst = mst->next)
+	    output->packed += mst_pack (mst, &output_handler, output, packreclen,
+					packencoding, byteorder, &packedsamples,
+					0, verbose, (MSRecord *)mst->prvtptr);
+	  
+	  output->logpacked = 1;
+	}
+      else if ( tracepack == 2 && recidx == recordcount - 1 )
+	{
+	  output->logpacked = 2;
+	}
+    }
+  
+  return 0;
+}  /* End of repackrecord() */
+
+
+/***************************************************************************
+ * flushtraces:
+ *
+ * Flush the traces of a worker after all records were repacked, the
+ * packed records of each trace are stored for writing in order of
+ * trace creation.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+flushtraces (RepackWorker *worker)
+{
+  MSTrace *mst;
+  int64_t packedsamples;
+  int idx;
+  
+  if ( ! worker->mstg->numtraces )
+    return 0;
+  
+  if ( ! (worker->flush = (RepackOutput *) calloc (worker->mstg->numtraces, sizeof(RepackOutput))) )
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return -1;
+    }
+  
+  for (idx = 0, mst = worker->mstg->traces; mst; idx++, mst = mst->next)
+    {
+      worker->flush[idx].order = worker->created[idx];
+      worker->flush[idx].packed = mst_pack (mst, &output_handler, &worker->flush[idx], packreclen,
+					    packencoding, byteorder, &packedsamples,
+					    1, verbose, (MSRecord *)mst->prvtptr);
+    }
+  
+  return 0;
+}  /* End of flushtraces() */
+
+
+/***************************************************************************
+ * repackworker:
+ *
+ * Thread routine to repack the input records assigned to a worker in
+ * input order.  A record is repacked when it is within the reorder
+ * buffer window of the next record to write, the record to write is
+ * always within the window so the writer cannot be blocked by a
+ * worker waiting for space.  After all records the traces are flushed.
+ ***************************************************************************/
+static void *
+repackworker (void *arg)
+{
+  RepackWorker *worker = (RepackWorker *) arg;
+  RepackOutput *output;
+  int64_t recidx;
+  flag stop = 0;
+  
+  for (recidx = worker->first; recidx < recordcount && ! stop; recidx++)
+    {
+      if ( records[recidx].worker != worker->id )
+	continue;
+      
+      pthread_mutex_lock (&reorderlock);
+      while ( recidx >= written + REORDER_WINDOW && ! stopping )
+	pthread_cond_wait (&reorderspace, &reorderlock);
+      stop = stopping;
+      pthread_mutex_unlock (&reorderlock);
+      
+      if ( stop )
+	break;
+      
+      output = &reorder[recidx % REORDER_WINDOW];
+      
+      stop = (repackrecord (worker, recidx, output) != 0);
+      
+      pthread_mutex_lock (&reorderlock);
+      if ( ! output->status )
+	output->status = 1;
+      pthread_cond_signal (&reorderdone);
+      pthread_mutex_unlock (&reorderlock);
+    }
+  
+  if ( ! stop && tracepack )
+    flushtraces (worker);
+  
+  return NULL;
+}  /* End of repackworker() */
+
+
+/***************************************************************************
+ * output_handler:
+ * Append packed records to an output entry.
+ ***************************************************************************/
+static void
+output_handler (char *record, int reclen, void *ptr)
+{
+  RepackOutput *output = (RepackOutput *) ptr;
+  char *newbuffer;
+  
+  if ( output->length + reclen > output->size )
+    {
+      size_t newsize = (output->size) ? output->size * 2 : reclen * 4;
+      
+      while ( newsize < output->length + reclen )
+	newsize *= 2;
+      
+      if ( ! (newbuffer = (char *) realloc (output->buffer, newsize)) )
+	{
+	  ms_log (2, "Cannot allocate memory for packed records\n");
+	  return;
+	}
+      
+      output->buffer = newbuffer;
+      output->size = newsize;
+    }
+  
+  memcpy (output->buffer + output->length, record, reclen);
+  output->length += reclen;
+  output->records++;
+}  /* End of output_handler() */
+
+
+/***************************************************************************
+ * writeoutput:
+ *
+ * Write the packed records of an output entry, assigning sequence
+ * numbers in output order to individually packed records.
+ ***************************************************************************/
+static void
+writeoutput (RepackOutput *output, int *iseqnum)
+{
+  char seqnum[7];
+  size_t offset;
+  size_t reclength;
+  
+  if ( ! output->length )
+    return;
+  
+  if ( output->renumber && output->records > 0 )
+    {
+      reclength = output->length / output->records;
+      
+      for (offset = 0; offset < output->length; offset += reclength)
+	{
+	  snprintf (seqnum, sizeof(seqnum), "%06d", *iseqnum);
+	  memcpy (output->buffer + offset, seqnum, 6);
+	  
+	  *iseqnum = (*iseqnum >= 999999) ? 1 : *iseqnum + 1;
+	}
+    }
+  
+  record_handler (output->buffer, (int) output->length, NULL);
+}  /* End of writeoutput() */
+
+
+/***************************************************************************
+ * printrecord:
+ * Print the header details of an input record as done by main().
+ ***************************************************************************/
+static void
+printrecord (FILE *fp, char *recbuf, int64_t recidx)
+{
+  static MSRecord *msr = 0;
+  
+  if ( ! fp )
+    {
+      msr_free (&msr);
+      return;
+    }
+  
+  if ( lmp_fseeko (fp, records[recidx].offset, SEEK_SET) ||
+       fread (recbuf, records[recidx].reclen, 1, fp) != 1 )
+    return;
+  
+  if ( msr_unpack (recbuf, records[recidx].reclen, &msr, 0, 0) == MS_NOERROR )
+    msr_print (msr, ppackets);
+}  /* End of printrecord() */
+
+
+/***************************************************************************
+ * cmp_output:
+ * Compare flushed trace output entries by input record creating the trace.
+ ***************************************************************************/
+static int
+cmp_output (const void *a, const void *b)
+{
+  const RepackOutput *oa = *(const RepackOutput **) a;
+  const RepackOutput *ob = *(const RepackOutput **) b;
+  
+  return (oa->order > ob->order) - (oa->order < ob->order);
+}  /* End of cmp_output() */
+
+
+/***************************************************************************
+ * primepacking:
+ *
+ * Pack a single sample record that is discarded.  The first packing
+ * initializes the byte order settings of the library from the
+ * environment, which must not happen concurrently in the workers when
+ * the first record is not packed before they are started.
+ ***************************************************************************/
+static void
+primepacking (void)
+{
+  MSRecord *msr;
+  int32_t sample = 0;
+  
+  if ( ! (msr = msr_init (NULL)) )
+    return;
+  
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "PRIME");
+  msr->reclen = 256;
+  msr->encoding = DE_INT32;
+  msr->samprate = 1.0;
+  msr->datasamples = &sample;
+  msr->numsamples = 1;
+  msr->sampletype = 'i';
+  
+  msr_pack (msr, &discard_handler, NULL, NULL, 1, 0);
+  
+  msr->datasamples = NULL;
+  msr_free (&msr);
+}  /* End of primepacking() */
+
+
+/***************************************************************************
+ * discard_handler:
+ * Discard a packed record.
+ ***************************************************************************/
+static void
+discard_handler (char *record, int reclen, void *ptr)
+{
+}  /* End of discard_handler() */
+#endif
+
+
 /***************************************************************************
  * parameter_proc:
  *
@@ -491,6 +1428,12 @@ parameter_proc (int argcount, char **argvec)
 	{
 	  netcode = argvec[++optind];
 	}
+#ifndef WIN32
+      else if (strcmp (argvec[optind], "-P") == 0)
+	{
+	  workers = strtol (argvec[++optind], NULL, 10);
+	}
+#endif
       else if (strcmp (argvec[optind], "-o") == 0)
 	{
 	  outputfile = argvec[++optind];
@@ -521,6 +1464,13 @@ parameter_proc (int argcount, char **argvec)
       exit (1);
     }
   
+  /* Parallel repacking reads records from a file by offset */
+  if ( workers && ! strcmp (inputfile, "-") )
+    {
+      ms_log (2, "Cannot repack from standard input with multiple threads\n");
+      exit (1);
+    }
+  
   /* Make sure an outputfile was specified */
   if ( ! outputfile )
     {
@@ -590,6 +1540,7 @@ usage (void)
 	   " -E encoding    Specify encoding format for packing\n"
 	   " -b byteorder   Specify byte order for packing, MSBF: 1, LSBF: 0\n"
 	   " -N netcode     Specify network code for output data\n"
+	   " -P threads     Repack channels in parallel with the specified threads\n"
 	   "\n"
 	   " -o outfile     Specify the output file, required\n"
 	   "\n"
@@ -605,7 +1556,11 @@ usage (void)
 	   "length is changed.\n"
 	   "\n"
 	   "Unless each input record is being packed individually, option -i, it is\n"
-	   "not recommended to pack files containing records for different data streams.\n");
+	   "not recommended to pack files containing records for different data streams.\n"
+	   "\n"
+	   "With option -P the output is identical to repacking with a single thread,\n"
+	   "the records of each channel are repacked by a single thread in input order.\n"
+	   "Repacking stops at the first record that cannot be repacked.\n");
 }  /* End of usage() */
 
 
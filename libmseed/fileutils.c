@@ -5,7 +5,7 @@
  * Written by Chad Trabant
  *   IRIS Data Management Center
  *
- * modified: 2015.108
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <errno.h>
@@ -18,7 +18,43 @@
 
 #include "libmseed.h"
 
+/* Regular files may be read through a memory mapping when supported,
+ * this can be disabled with -DLMP_NOMMAP */
+#if !defined(LMP_WIN) && !defined(LMP_NOMMAP)
+  #define LMP_MMAP 1
+  #include <sys/mman.h>
+#endif
+
+/* Records are decoded in parallel when thread support is available,
+ * this can be disabled with -DLMP_NOTHREADS */
+#if defined(LMP_MMAP) && !defined(LMP_NOTHREADS)
+  #define LMP_THREADS 1
+  #include <pthread.h>
+#endif
+
+/* File reading parameters of ms_readmsr_map(), the mapping is kept
+ * out of the public MSFileParam */
+typedef struct MSFileMap_s
+{
+  MSFileParam msfp;      /* Must be first, returned to the caller */
+  char *mapping;         /* File mapping, NULL if not mapped */
+} MSFileMap;
+
+static int ms_readmsr_int (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
+                           int reclen, off_t *fpos, int *last, flag skipnotdata,
+                           flag dataflag, Selections *selections, flag mapfile,
+                           flag verbose);
 static int ms_fread (char *buf, int size, int num, FILE *stream);
+static int ms_mapfile (MSFileMap *map, flag verbose);
+static void ms_unmapfile (MSFileMap *map);
+static int ms_readtracelist_int (MSTraceList *mstl, MSFileParam **ppmsfp,
+                                 const char *msfile, int reclen, off_t offset,
+                                 double timetol, double sampratetol,
+                                 Selections *selections, flag dataquality,
+                                 flag skipnotdata, flag dataflag, flag verbose);
+static void ms_addtracelist (MSTraceList *mstl, MSRecord *msr,
+                             double timetol, double sampratetol,
+                             Selections *selections, flag dataquality);
 
 /* Pack type parameters for the 8 defined types:
  * [type] : [hdrlen] [sizelen] [chksumlen]
@@ -133,9 +169,13 @@ ms_readmsr_r (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
  * file reading buffer for a MSFP.  The buffer length, reading offset
  * and file position indicators are all updated as necessary.
  *
+ * If the file is memory mapped (mapping is not NULL) the buffer is a
+ * window of the mapping and the start of the window is advanced
+ * instead.
+ *
  *********************************************************************/
 static void
-ms_shift_msfp (MSFileParam *msfp, int shift)
+ms_shift_msfp (MSFileParam *msfp, int shift, char *mapping)
 {
   if (!msfp)
     return;
@@ -147,7 +187,11 @@ ms_shift_msfp (MSFileParam *msfp, int shift)
     return;
   }
 
-  memmove (msfp->rawrec, msfp->rawrec + shift, msfp->readlen - shift);
+  if (mapping)
+    msfp->rawrec += shift;
+  else
+    memmove (msfp->rawrec, msfp->rawrec + shift, msfp->readlen - shift);
+
   msfp->readlen -= shift;
 
   if (shift < msfp->readoffset)
@@ -169,6 +213,12 @@ ms_shift_msfp (MSFileParam *msfp, int shift)
 /* Macro to return current reading position */
 #define MSFPREADPTR(MSFP) (MSFP->rawrec + MSFP->readoffset)
 
+/* Macro to test for end of file, for a mapped file when the buffer
+ * window reaches the end of the mapping */
+#define MSFPEOF(MSFP, MAPPING) ((MAPPING) ? \
+                                ((MSFP->rawrec - (MAPPING)) + MSFP->readlen >= MSFP->filesize) : \
+                                feof (MSFP->fp))
+
 /**********************************************************************
  * ms_readmsr_main:
  *
@@ -219,8 +269,59 @@ int
 ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
                  int reclen, off_t *fpos, int *last, flag skipnotdata,
                  flag dataflag, Selections *selections, flag verbose)
+{
+  return ms_readmsr_int (ppmsfp, ppmsr, msfile, reclen, fpos, last,
+                         skipnotdata, dataflag, selections, 0, verbose);
+} /* End of ms_readmsr_main() */
+
+/**********************************************************************
+ * ms_readmsr_map:
+ *
+ * This routine performs the same function as ms_readmsr_r() but reads
+ * regular files through a memory mapping when supported.  Records are
+ * parsed directly from the mapping without copying and returned
+ * MSRecords reference the read-only mapping until the file is closed.
+ * The kernel is advised that the file will be read sequentially.
+ *
+ * A mapped file is read up to its size when opened.  If the file is
+ * truncated while it is mapped, access to the mapping beyond the new
+ * end of the file raises SIGBUS, files that may be truncated while
+ * being read must be read with ms_readmsr_r().  Files that cannot be
+ * mapped and stdin are read into a buffer.
+ *
+ * The MSFileParam is allocated with private mapping state, *ppmsfp
+ * must be NULL on the first call and the parameters must only be used
+ * with this routine, including the final call with msfile set to NULL.
+ *
+ * See the comments with ms_readmsr_main() for return values and
+ * further description of arguments.
+ *********************************************************************/
+int
+ms_readmsr_map (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
+                int reclen, off_t *fpos, int *last, flag skipnotdata,
+                flag dataflag, flag verbose)
+{
+  return ms_readmsr_int (ppmsfp, ppmsr, msfile, reclen, fpos, last,
+                         skipnotdata, dataflag, NULL, 1, verbose);
+} /* End of ms_readmsr_map() */
+
+/**********************************************************************
+ * ms_readmsr_int:
+ *
+ * Implementation of ms_readmsr_main() and ms_readmsr_map().  If
+ * mapfile is true the file reading parameters are a MSFileMap and
+ * regular files are memory mapped, the read buffer is then a window of
+ * the mapping.
+ *********************************************************************/
+static int
+ms_readmsr_int (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
+                int reclen, off_t *fpos, int *last, flag skipnotdata,
+                flag dataflag, Selections *selections, flag mapfile,
+                flag verbose)
 {
   MSFileParam *msfp;
+  MSFileMap *map = NULL;
+  char *mapping  = NULL;
   off_t packdatasize = 0;
   int packskipsize;
   int parseval  = 0;
@@ -239,7 +340,17 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
   /* Initialize the file read parameters if needed */
   if (!msfp)
   {
-    msfp = (MSFileParam *)malloc (sizeof (MSFileParam));
+    if (mapfile)
+    {
+      if ((map = (MSFileMap *)malloc (sizeof (MSFileMap))))
+        map->mapping = NULL;
+
+      msfp = (MSFileParam *)map;
+    }
+    else
+    {
+      msfp = (MSFileParam *)malloc (sizeof (MSFileParam));
+    }
 
     if (msfp == NULL)
     {
@@ -262,11 +373,21 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
     msfp->recordcount   = 0;
   }
 
+  /* The mapping state follows the parameters of ms_readmsr_map() */
+  if (mapfile)
+  {
+    map     = (MSFileMap *)msfp;
+    mapping = map->mapping;
+  }
+
   /* When cleanup is requested */
   if (msfile == NULL)
   {
     msr_free (ppmsr);
 
+    if (mapping)
+      ms_unmapfile (map);
+
     if (msfp->fp != NULL)
       fclose (msfp->fp);
 
@@ -297,22 +418,18 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
     return MS_NOERROR;
   }
 
-  /* Allocate reading buffer */
-  if (msfp->rawrec == NULL)
-  {
-    if (!(msfp->rawrec = (char *)malloc (MAXRECLEN)))
-    {
-      ms_log (2, "ms_readmsr_main(): Cannot allocate memory for read buffer\n");
-      return MS_GENERROR;
-    }
-  }
-
   /* Sanity check: track if we are reading the same file */
   if (msfp->fp && strncmp (msfile, msfp->filename, sizeof (msfp->filename)))
   {
     ms_log (2, "ms_readmsr_main() called with a different file name without being reset\n");
 
     /* Close previous file and reset needed variables */
+    if (mapping)
+    {
+      ms_unmapfile (map);
+      mapping = NULL;
+    }
+
     if (msfp->fp != NULL)
       fclose (msfp->fp);
 
@@ -360,15 +477,39 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
         }
 
         msfp->filesize = sbuf.st_size;
+
+        /* Map regular files if requested, otherwise read into the buffer */
+        if (map && S_ISREG (sbuf.st_mode) && msfp->filesize > 0 &&
+            ms_mapfile (map, verbose) == 0)
+          mapping = map->mapping;
       }
     }
   }
 
+  /* Allocate reading buffer if the file is not mapped */
+  if (msfp->rawrec == NULL)
+  {
+    if (!(msfp->rawrec = (char *)malloc (MAXRECLEN)))
+    {
+      ms_log (2, "ms_readmsr_main(): Cannot allocate memory for read buffer\n");
+      return MS_GENERROR;
+    }
+  }
+
   /* Seek to a specified offset if requested */
   if (fpos != NULL && *fpos < 0)
   {
     /* Only try to seek in real files, not stdin */
-    if (msfp->fp != stdin)
+    /* For a mapped file an offset beyond the end results in no data as
+     * when seeking beyond the end of a file */
+    if (mapping)
+    {
+      msfp->filepos    = *fpos * -1;
+      msfp->rawrec     = mapping + ((msfp->filepos < msfp->filesize) ? msfp->filepos : msfp->filesize);
+      msfp->readlen    = 0;
+      msfp->readoffset = 0;
+    }
+    else if (msfp->fp != stdin)
     {
       if (lmp_fseeko (msfp->fp, *fpos * -1, SEEK_SET))
       {
@@ -390,9 +531,21 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
   /* Read data and search for records */
   for (;;)
   {
+    /* For a mapped file move the buffer window to the reading position
+     * under the same conditions that more data would be read, the window
+     * is limited to MAXRECLEN bytes like the read buffer. */
+    if (mapping)
+    {
+      if (!MSFPEOF (msfp, mapping) && (MSFPBUFLEN (msfp) < MINRECLEN || parseval > 0))
+      {
+        msfp->rawrec     = mapping + msfp->filepos;
+        msfp->readoffset = 0;
+        msfp->readlen    = ((msfp->filesize - msfp->filepos) < MAXRECLEN) ? (int)(msfp->filesize - msfp->filepos) : MAXRECLEN;
+      }
+    }
     /* Read more data into buffer if not at EOF and buffer has less than MINRECLEN
        * or more data is needed for the current record detected in buffer. */
-    if (!feof (msfp->fp) && (MSFPBUFLEN (msfp) < MINRECLEN || parseval > 0))
+    else if (!feof (msfp->fp) && (MSFPBUFLEN (msfp) < MINRECLEN || parseval > 0))
     {
       /* Reset offsets if no unprocessed data in buffer */
       if (MSFPBUFLEN (msfp) <= 0)
@@ -403,7 +556,7 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
       /* Otherwise shift existing data to beginning of buffer */
       else if (msfp->readoffset > 0)
       {
-        ms_shift_msfp (msfp, msfp->readoffset);
+        ms_shift_msfp (msfp, msfp->readoffset, mapping);
       }
 
       /* Determine read size */
@@ -482,7 +635,7 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
                 msfp->packhdroffset);
 
       /* Shift buffer to new reading offset (aligns records in buffer) */
-      ms_shift_msfp (msfp, msfp->readoffset + (packskipsize + packtypes[msfp->packtype][0]));
+      ms_shift_msfp (msfp, msfp->readoffset + (packskipsize + packtypes[msfp->packtype][0]), mapping);
     } /* End of packed header processing */
 
     /* Check for match if selections are supplied and pack header was read, */
@@ -518,7 +671,11 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
                     srcname, (msfp->packhdroffset - msfp->filepos), msfp->filepos);
           }
 
-          if (lmp_fseeko (msfp->fp, msfp->packhdroffset, SEEK_SET))
+          if (mapping)
+          {
+            msfp->rawrec = mapping + msfp->packhdroffset;
+          }
+          else if (lmp_fseeko (msfp->fp, msfp->packhdroffset, SEEK_SET))
           {
             ms_log (2, "Cannot seek in file: %s (%s)\n", msfile, strerror (errno));
 
@@ -648,7 +805,7 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
         }
 
         /* End of file check */
-        else if (impreclen <= 0 && feof (msfp->fp))
+        else if (impreclen <= 0 && MSFPEOF (msfp, mapping))
         {
           impreclen = msfp->filesize - msfp->filepos;
 
@@ -705,7 +862,7 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
   }
 
   return retcode;
-} /* End of ms_readmsr_main() */
+} /* End of ms_readmsr_int() */
 
 /*********************************************************************
  * ms_readtraces:
@@ -905,9 +1062,7 @@ ms_readtracelist_selection (MSTraceList **ppmstl, const char *msfile,
                             Selections *selections, flag dataquality,
                             flag skipnotdata, flag dataflag, flag verbose)
 {
-  MSRecord *msr     = 0;
   MSFileParam *msfp = 0;
-  int retcode;
 
   if (!ppmstl)
     return MS_GENERROR;
@@ -921,37 +1076,548 @@ ms_readtracelist_selection (MSTraceList **ppmstl, const char *msfile,
       return MS_GENERROR;
   }
 
-  /* Loop over the input file */
-  while ((retcode = ms_readmsr_main (&msfp, &msr, msfile, reclen, NULL, NULL,
-                                     skipnotdata, dataflag, NULL, verbose)) == MS_NOERROR)
+  return ms_readtracelist_int (*ppmstl, &msfp, msfile, reclen, 0,
+                               timetol, sampratetol, selections,
+                               dataquality, skipnotdata, dataflag, verbose);
+} /* End of ms_readtracelist_selection() */
+
+#if defined(LMP_THREADS)
+/* Parameters for decoding a range of records on worker threads */
+struct decodework
+{
+  char *mapping;         /* File mapping */
+  int64_t *offsets;      /* Offsets of records in mapping */
+  int *reclens;          /* Lengths of records */
+  MSRecord **msrs;       /* Decoded records */
+  int count;             /* Number of records to decode */
+  int next;              /* Index of next record to decode */
+  int failed;            /* Lowest index of a record that failed to decode */
+  flag dataflag;
+  flag verbose;
+  pthread_mutex_t lock;
+};
+
+/* Decoding thread, records are allocated from its own arena */
+struct decodeworker
+{
+  struct decodework *work;
+  MSArena *arena;
+  pthread_t thread;
+};
+
+/* Number of records claimed by a worker at a time */
+#define DECODEBATCH 64
+
+/* Number of records decoded by each worker before merging */
+#define DECODEWINDOW 1024
+
+/*********************************************************************
+ * ms_decoderecords:
+ *
+ * Worker thread routine to decode records, batches of records are
+ * claimed until all records are decoded.  A record that cannot be
+ * unpacked is noted as failed, batches following it are not decoded
+ * and records already decoded after it will be ignored.  Records and
+ * their blockettes are allocated from the arena of the worker.
+ *********************************************************************/
+static void *
+ms_decoderecords (void *arg)
+{
+  struct decodeworker *worker = (struct decodeworker *)arg;
+  struct decodework *work     = worker->work;
+  int idx;
+  int end;
+
+  for (;;)
   {
-    /* Test against selections if supplied */
-    if (selections)
+    pthread_mutex_lock (&work->lock);
+    idx = work->next;
+    work->next += DECODEBATCH;
+    end = work->failed;
+    pthread_mutex_unlock (&work->lock);
+
+    /* Done when all records are claimed or following a failed record */
+    if (idx >= work->count || idx > end)
+      break;
+
+    end = (idx + DECODEBATCH < work->count) ? idx + DECODEBATCH : work->count;
+
+    for (; idx < end; idx++)
     {
-      char srcname[50];
-      hptime_t endtime;
+      work->msrs[idx] = msr_init_arena (worker->arena);
 
-      msr_srcname (msr, srcname, 1);
-      endtime = msr_endtime (msr);
+      if (!work->msrs[idx] ||
+          msr_unpack (work->mapping + work->offsets[idx], work->reclens[idx],
+                      &work->msrs[idx], work->dataflag, work->verbose) != MS_NOERROR)
+      {
+        msr_free (&work->msrs[idx]);
 
-      if (ms_matchselect (selections, srcname, msr->starttime, endtime, NULL) == NULL)
+        pthread_mutex_lock (&work->lock);
+        if (idx < work->failed)
+          work->failed = idx;
+        pthread_mutex_unlock (&work->lock);
+      }
+    }
+  }
+
+  return NULL;
+} /* End of ms_decoderecords() */
+#endif
+
+/*********************************************************************
+ * ms_readtracelist_parallel:
+ *
+ * Read all Mini-SEED records in specified file and populate a trace
+ * list using multiple threads to decode records.  The result is the
+ * same as from ms_readtracelist_selection().  This routine is thread
+ * safe.
+ *
+ * The memory mapped file is first scanned for record boundaries
+ * using the record length from the Blockette 1000 of each record, or
+ * the specified record length if reclen > 0.  Records are then
+ * unpacked by up to workers threads and added to the trace list in
+ * file order.  From the first position where a record cannot be
+ * identified in this way, e.g. no Blockette 1000, non-data or a
+ * truncated record, or a record cannot be unpacked, the remainder of
+ * the file is read with ms_readmsr_main() like the serial reader.
+ *
+ * If workers <= 1, the file cannot be mapped or thread support is not
+ * available the file is read with ms_readtracelist_selection().
+ *
+ * Returns MS_NOERROR and populates an MSTraceList struct at *ppmstl
+ * on successful read, otherwise returns a libmseed error code (listed
+ * in libmseed.h).
+ *********************************************************************/
+int
+ms_readtracelist_parallel (MSTraceList **ppmstl, const char *msfile,
+                           int reclen, double timetol, double sampratetol,
+                           Selections *selections, flag dataquality,
+                           flag skipnotdata, flag dataflag, int workers,
+                           flag verbose)
+{
+#if defined(LMP_THREADS)
+  MSFileMap mapfp;
+  MSFileParam *msfp = 0;
+  struct decodework work;
+  struct decodeworker *workerlist = NULL;
+  struct stat sbuf;
+  int64_t *offsets   = NULL;
+  int *reclens       = NULL;
+  MSRecord **msrs    = NULL;
+  int64_t offset     = 0;
+  int recordcount    = 0;
+  int recordmax      = 0;
+  int started        = 0;
+  int window;
+  int detlen;
+  int idx;
+  int tidx;
+  int retcode = MS_NOERROR;
+
+  if (!ppmstl || !msfile)
+    return MS_GENERROR;
+
+  if (workers <= 1 || !strcmp (msfile, "-"))
+    return ms_readtracelist_selection (ppmstl, msfile, reclen, timetol, sampratetol,
+                                       selections, dataquality, skipnotdata,
+                                       dataflag, verbose);
+
+  /* Map the file, otherwise read it serially */
+  memset (&mapfp, 0, sizeof (MSFileMap));
+  strncpy (mapfp.msfp.filename, msfile, sizeof (mapfp.msfp.filename) - 1);
+
+  if ((mapfp.msfp.fp = fopen (msfile, "rb")) == NULL ||
+      fstat (fileno (mapfp.msfp.fp), &sbuf) || !S_ISREG (sbuf.st_mode) ||
+      (mapfp.msfp.filesize = sbuf.st_size) <= 0 ||
+      ms_mapfile (&mapfp, verbose))
+  {
+    if (mapfp.msfp.fp)
+      fclose (mapfp.msfp.fp);
+
+    return ms_readtracelist_selection (ppmstl, msfile, reclen, timetol, sampratetol,
+                                       selections, dataquality, skipnotdata,
+                                       dataflag, verbose);
+  }
+
+  /* Initialize MSTraceList if needed */
+  if (!*ppmstl)
+  {
+    *ppmstl = mstl_init (*ppmstl);
+
+    if (!*ppmstl)
+    {
+      retcode = MS_GENERROR;
+      goto cleanup;
+    }
+  }
+
+  /* Scan record boundaries until the end of the file or a position
+   * where the record length cannot be determined from the header */
+  while ((mapfp.msfp.filesize - offset) >= MINRECLEN)
+  {
+    detlen = ms_detect (mapfp.mapping + offset, MINRECLEN);
+
+    /* A specified record length applies to records without Blockette
+     * 1000, records of other lengths are left to be read serially */
+    if (reclen > 0 && detlen == 0 && (reclen & (reclen - 1)) == 0)
+      detlen = reclen;
+    else if (reclen > 0 && detlen != reclen)
+      break;
+
+    if (detlen < MINRECLEN || detlen > MAXRECLEN ||
+        detlen > (mapfp.msfp.filesize - offset))
+      break;
+
+    if (recordcount == recordmax)
+    {
+      recordmax = (recordmax) ? recordmax * 2 : 1024;
+
+      if (!(offsets = (int64_t *)realloc (offsets, sizeof (int64_t) * recordmax)) ||
+          !(reclens = (int *)realloc (reclens, sizeof (int) * recordmax)))
       {
-        continue;
+        ms_log (2, "ms_readtracelist_parallel(): Cannot allocate memory\n");
+        retcode = MS_GENERROR;
+        goto cleanup;
+      }
+    }
+
+    offsets[recordcount] = offset;
+    reclens[recordcount] = detlen;
+    recordcount++;
+
+    offset += detlen;
+  }
+
+  if (verbose > 1)
+    ms_log (1, "Scanned %d records in %" PRId64 " bytes of %s\n",
+            recordcount, offset, msfile);
+
+  window = workers * DECODEWINDOW;
+
+  if (recordcount > 0 &&
+      (!(msrs = (MSRecord **)calloc ((recordcount < window) ? recordcount : window, sizeof (MSRecord *))) ||
+       !(workerlist = (struct decodeworker *)calloc (workers, sizeof (struct decodeworker)))))
+  {
+    ms_log (2, "ms_readtracelist_parallel(): Cannot allocate memory\n");
+    retcode = MS_GENERROR;
+    goto cleanup;
+  }
+
+  memset (&work, 0, sizeof (work));
+
+  for (tidx = 0; recordcount > 0 && tidx < workers; tidx++)
+  {
+    workerlist[tidx].work = &work;
+
+    if (!(workerlist[tidx].arena = ms_arena_init (NULL, 0)))
+    {
+      retcode = MS_GENERROR;
+      goto cleanup;
+    }
+  }
+
+  work.mapping  = mapfp.mapping;
+  work.dataflag = dataflag;
+  work.verbose  = verbose;
+  pthread_mutex_init (&work.lock, NULL);
+
+  /* Decode records in windows, merging each window in file order */
+  for (idx = 0; idx < recordcount; idx += work.count)
+  {
+    work.offsets = offsets + idx;
+    work.reclens = reclens + idx;
+    work.msrs    = msrs;
+    work.count   = (recordcount - idx < window) ? recordcount - idx : window;
+    work.next    = 0;
+    work.failed  = work.count;
+
+    /* Decode the first record before starting workers, settings from
+     * the environment are initialized by the first unpacking */
+    if (idx == 0)
+    {
+      msrs[0] = msr_init_arena (workerlist[0].arena);
+
+      if (!msrs[0] ||
+          msr_unpack (mapfp.mapping + offsets[0], reclens[0], &msrs[0],
+                      dataflag, verbose) != MS_NOERROR)
+      {
+        msr_free (&msrs[0]);
+        work.failed = 0;
       }
+
+      work.next = 1;
+    }
+
+    for (started = 1; started < workers; started++)
+      if (pthread_create (&workerlist[started].thread, NULL, ms_decoderecords,
+                          &workerlist[started]))
+        break;
+
+    ms_decoderecords (&workerlist[0]);
+
+    for (tidx = 1; tidx < started; tidx++)
+      pthread_join (workerlist[tidx].thread, NULL);
+
+    for (tidx = 0; tidx < work.count; tidx++)
+    {
+      if (tidx < work.failed)
+        ms_addtracelist (*ppmstl, msrs[tidx], timetol, sampratetol,
+                         selections, dataquality);
+
+      msr_free (&msrs[tidx]);
     }
 
-    /* Add to trace list */
-    mstl_addmsr (*ppmstl, msr, dataquality, 1, timetol, sampratetol);
+    /* Release the records of the window in bulk */
+    for (tidx = 0; tidx < workers; tidx++)
+      ms_arena_init (workerlist[tidx].arena, 0);
+
+    /* Continue reading serially from a record that failed to decode */
+    if (work.failed < work.count)
+    {
+      offset      = offsets[idx + work.failed];
+      recordcount = idx + work.failed;
+      break;
+    }
+  }
+
+  pthread_mutex_destroy (&work.lock);
+
+  /* Read the remainder of the file serially, the record count is
+   * carried over so that the end of file is handled the same */
+  if ((mapfp.msfp.filesize - offset) >= MINRECLEN)
+  {
+    if (verbose > 1)
+      ms_log (1, "Reading %s from offset %" PRId64 "\n", msfile, offset);
+
+    if (!(msfp = (MSFileParam *)calloc (1, sizeof (MSFileParam))))
+    {
+      ms_log (2, "ms_readtracelist_parallel(): Cannot allocate memory\n");
+      retcode = MS_GENERROR;
+      goto cleanup;
+    }
+
+    msfp->recordcount = recordcount;
+
+    retcode = ms_readtracelist_int (*ppmstl, &msfp, msfile, reclen, (off_t)offset,
+                                    timetol, sampratetol, selections,
+                                    dataquality, skipnotdata, dataflag, verbose);
+  }
+
+cleanup:
+  ms_unmapfile (&mapfp);
+  fclose (mapfp.msfp.fp);
+
+  if (offsets)
+    free (offsets);
+  if (reclens)
+    free (reclens);
+  if (msrs)
+    free (msrs);
+  if (workerlist)
+  {
+    for (tidx = 0; tidx < workers; tidx++)
+      ms_arena_free (&workerlist[tidx].arena);
+
+    free (workerlist);
+  }
+
+  return retcode;
+#else
+  return ms_readtracelist_selection (ppmstl, msfile, reclen, timetol, sampratetol,
+                                     selections, dataquality, skipnotdata,
+                                     dataflag, verbose);
+#endif
+} /* End of ms_readtracelist_parallel() */
+
+/*********************************************************************
+ * ms_scantracelist:
+ *
+ * Scan all Mini-SEED records in specified file and populate a trace
+ * list with the time coverage of the records, no data samples are
+ * unpacked.  The trace list is the same as from
+ * ms_readtracelist_selection() without data samples.  This routine is
+ * thread safe.
+ *
+ * Records of a memory mapped file are delimited by the record length
+ * in Blockette 1000, or the specified record length if reclen > 0,
+ * and their headers are unpacked in place with msr_unpack_header()
+ * without allocating a MSRecord for each record or blockette links.
+ * From the first position where a record cannot be identified in this
+ * way, or if the file cannot be mapped, the remainder of the file is
+ * read with ms_readmsr_main().
+ *
+ * Returns MS_NOERROR and populates an MSTraceList struct at *ppmstl
+ * on successful read, otherwise returns a libmseed error code (listed
+ * in libmseed.h).
+ *********************************************************************/
+int
+ms_scantracelist (MSTraceList **ppmstl, const char *msfile, int reclen,
+                  double timetol, double sampratetol, Selections *selections,
+                  flag dataquality, flag skipnotdata, flag verbose)
+{
+  MSFileMap mapfp;
+  MSFileParam *msfp = 0;
+  MSRecord msr;
+  struct fsdh_s fsdh;
+  struct stat sbuf;
+  int64_t offset  = 0;
+  int recordcount = 0;
+  int detlen;
+  int retcode = MS_NOERROR;
+
+  if (!ppmstl || !msfile)
+    return MS_GENERROR;
+
+  /* Initialize MSTraceList if needed */
+  if (!*ppmstl)
+  {
+    *ppmstl = mstl_init (*ppmstl);
+
+    if (!*ppmstl)
+      return MS_GENERROR;
+  }
+
+  /* Map the file, otherwise read it with ms_readmsr_main() */
+  memset (&mapfp, 0, sizeof (MSFileMap));
+  strncpy (mapfp.msfp.filename, msfile, sizeof (mapfp.msfp.filename) - 1);
+
+  if (!strcmp (msfile, "-") ||
+      (mapfp.msfp.fp = fopen (msfile, "rb")) == NULL ||
+      fstat (fileno (mapfp.msfp.fp), &sbuf) || !S_ISREG (sbuf.st_mode) ||
+      (mapfp.msfp.filesize = sbuf.st_size) <= 0 ||
+      ms_mapfile (&mapfp, verbose))
+  {
+    if (mapfp.msfp.fp)
+      fclose (mapfp.msfp.fp);
+
+    return ms_readtracelist_int (*ppmstl, &msfp, msfile, reclen, 0,
+                                 timetol, sampratetol, selections,
+                                 dataquality, skipnotdata, 0, verbose);
+  }
+
+  memset (&msr, 0, sizeof (MSRecord));
+  msr.fsdh = &fsdh;
+
+  /* Unpack headers until the end of the file or a position where the
+   * record length cannot be determined from the header */
+  while ((mapfp.msfp.filesize - offset) >= MINRECLEN)
+  {
+    detlen = ms_detect (mapfp.mapping + offset, MINRECLEN);
+
+    /* A specified record length applies to records without Blockette
+     * 1000, records of other lengths are left to be read serially */
+    if (reclen > 0 && detlen == 0 && (reclen & (reclen - 1)) == 0)
+      detlen = reclen;
+    else if (reclen > 0 && detlen != reclen)
+      break;
+
+    if (detlen < MINRECLEN || detlen > MAXRECLEN ||
+        detlen > (mapfp.msfp.filesize - offset) ||
+        msr_unpack_header (mapfp.mapping + offset, detlen, &msr, verbose) != MS_NOERROR)
+      break;
+
+    ms_addtracelist (*ppmstl, &msr, timetol, sampratetol, selections, dataquality);
+
+    recordcount++;
+    offset += detlen;
+  }
+
+  if (verbose > 1)
+    ms_log (1, "Scanned %d record headers in %" PRId64 " bytes of %s\n",
+            recordcount, offset, msfile);
+
+  /* Read the remainder of the file, the record count is carried over
+   * so that the end of file is handled the same */
+  if ((mapfp.msfp.filesize - offset) >= MINRECLEN)
+  {
+    if (verbose > 1)
+      ms_log (1, "Reading %s from offset %" PRId64 "\n", msfile, offset);
+
+    if (!(msfp = (MSFileParam *)calloc (1, sizeof (MSFileParam))))
+    {
+      ms_log (2, "ms_scantracelist(): Cannot allocate memory\n");
+      retcode = MS_GENERROR;
+    }
+    else
+    {
+      msfp->recordcount = recordcount;
+
+      retcode = ms_readtracelist_int (*ppmstl, &msfp, msfile, reclen, (off_t)offset,
+                                      timetol, sampratetol, selections,
+                                      dataquality, skipnotdata, 0, verbose);
+    }
+  }
+
+  ms_unmapfile (&mapfp);
+  fclose (mapfp.msfp.fp);
+
+  return retcode;
+} /* End of ms_scantracelist() */
+
+/*********************************************************************
+ * ms_readtracelist_int:
+ *
+ * Read Mini-SEED records from a file with ms_readmsr_main(), starting
+ * at the specified offset, and add them to a trace list.  The file
+ * reading parameters are released when done.
+ *
+ * Returns MS_NOERROR on successful read, otherwise returns a libmseed
+ * error code (listed in libmseed.h).
+ *********************************************************************/
+static int
+ms_readtracelist_int (MSTraceList *mstl, MSFileParam **ppmsfp,
+                      const char *msfile, int reclen, off_t offset,
+                      double timetol, double sampratetol,
+                      Selections *selections, flag dataquality,
+                      flag skipnotdata, flag dataflag, flag verbose)
+{
+  MSRecord *msr = 0;
+  off_t fpos    = -offset;
+  int retcode;
+
+  /* Loop over the input file */
+  while ((retcode = ms_readmsr_main (ppmsfp, &msr, msfile, reclen, (offset) ? &fpos : NULL, NULL,
+                                     skipnotdata, dataflag, NULL, verbose)) == MS_NOERROR)
+  {
+    ms_addtracelist (mstl, msr, timetol, sampratetol, selections, dataquality);
   }
 
   /* Reset return code to MS_NOERROR on successful read by ms_readmsr() */
   if (retcode == MS_ENDOFFILE)
     retcode = MS_NOERROR;
 
-  ms_readmsr_main (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, NULL, 0);
+  ms_readmsr_main (ppmsfp, &msr, NULL, 0, NULL, NULL, 0, 0, NULL, 0);
 
   return retcode;
-} /* End of ms_readtracelist_selection() */
+} /* End of ms_readtracelist_int() */
+
+/*********************************************************************
+ * ms_addtracelist:
+ *
+ * Add a record to a trace list if it matches the selections, if
+ * supplied.
+ *********************************************************************/
+static void
+ms_addtracelist (MSTraceList *mstl, MSRecord *msr,
+                 double timetol, double sampratetol,
+                 Selections *selections, flag dataquality)
+{
+  /* Test against selections if supplied */
+  if (selections)
+  {
+    char srcname[50];
+    hptime_t endtime;
+
+    msr_srcname (msr, srcname, 1);
+    endtime = msr_endtime (msr);
+
+    if (ms_matchselect (selections, srcname, msr->starttime, endtime, NULL) == NULL)
+      return;
+  }
+
+  /* Add to trace list */
+  mstl_addmsr (mstl, msr, dataquality, 1, timetol, sampratetol);
+} /* End of ms_addtracelist() */
 
 /*********************************************************************
  * ms_fread:
@@ -979,6 +1645,86 @@ ms_fread (char *buf, int size, int num, FILE *stream)
   return read;
 } /* End of ms_fread() */
 
+/*********************************************************************
+ * ms_mapfile:
+ *
+ * Map the open file of a MSFileMap into memory, the buffer of the MSFP
+ * becomes a window of the mapping.  The mapping is read-only, header
+ * fields, blockettes and data frames are copied before they are byte
+ * swapped when unpacking.  The kernel is advised that the file will be
+ * read sequentially and that all of it will be needed.
+ *
+ * The file is mapped up to its size when opened, data appended to a
+ * growing file later is not read.  If the file is truncated while it
+ * is mapped, access to the mapping beyond the new end of the file
+ * raises SIGBUS, files that may be truncated while being read must not
+ * be mapped.
+ *
+ * Returns 0 on success and -1 if the file was not mapped, in which
+ * case the file will be read with stdio.
+ *********************************************************************/
+static int
+ms_mapfile (MSFileMap *map, flag verbose)
+{
+#if defined(LMP_MMAP)
+  MSFileParam *msfp = (map) ? &map->msfp : NULL;
+  void *mapping;
+
+  if (!msfp || !msfp->fp || msfp->filesize <= 0 ||
+      (uint64_t)msfp->filesize > (uint64_t)((size_t)-1))
+    return -1;
+
+  mapping = mmap (NULL, (size_t)msfp->filesize, PROT_READ,
+                  MAP_PRIVATE, fileno (msfp->fp), 0);
+
+  if (mapping == MAP_FAILED)
+  {
+    if (verbose > 1)
+      ms_log (1, "Cannot map file, reading instead: %s (%s)\n",
+              msfp->filename, strerror (errno));
+    return -1;
+  }
+
+#if defined(MADV_SEQUENTIAL) && defined(MADV_WILLNEED)
+  madvise (mapping, (size_t)msfp->filesize, MADV_SEQUENTIAL);
+  madvise (mapping, (size_t)msfp->filesize, MADV_WILLNEED);
+#endif
+
+  /* Release a read buffer from a previous file */
+  if (msfp->rawrec)
+    free (msfp->rawrec);
+
+  map->mapping     = (char *)mapping;
+  msfp->rawrec     = map->mapping;
+  msfp->readlen    = 0;
+  msfp->readoffset = 0;
+
+  return 0;
+#else
+  return -1;
+#endif
+} /* End of ms_mapfile() */
+
+/*********************************************************************
+ * ms_unmapfile:
+ *
+ * Release the file mapping of a MSFileMap, the buffer of the MSFP is
+ * reset and will be allocated if needed.
+ *********************************************************************/
+static void
+ms_unmapfile (MSFileMap *map)
+{
+#if defined(LMP_MMAP)
+  if (!map || !map->mapping)
+    return;
+
+  munmap (map->mapping, (size_t)map->msfp.filesize);
+
+  map->mapping     = NULL;
+  map->msfp.rawrec = NULL;
+#endif
+} /* End of ms_unmapfile() */
+
 /***************************************************************************
  * ms_record_handler_int:
  *
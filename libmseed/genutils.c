@@ -7,7 +7,7 @@
  * ORFEUS/EC-Project MEREDIAN
  * IRIS Data Management Center
  *
- * modified: 2017.053
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <errno.h>
@@ -22,6 +22,7 @@ static hptime_t ms_time2hptime_int (int year, int day, int hour,
                                     int min, int sec, int usec);
 
 static struct tm *ms_gmtime_r (int64_t *timep, struct tm *result);
+static int ms_buildleapsecondtable (void);
 
 /* A constant number of seconds between the NTP and Posix/Unix time epoch */
 #define NTPPOSIXEPOCHDELTA 2208988800LL
@@ -29,6 +30,11 @@ static struct tm *ms_gmtime_r (int64_t *timep, struct tm *result);
 /* Global variable to hold a leap second list */
 LeapSecond *leapsecondlist = NULL;
 
+/* Sorted table of leap second times built from the leap second list */
+static hptime_t *leapsecondtable = NULL;
+static int leapsecondcount = 0;
+static LeapSecond *leapsecondtablelist = NULL;
+
 /***************************************************************************
  * ms_recsrcname:
  *
@@ -1159,6 +1165,142 @@ ms_readleapseconds (char *envvarname)
   return -2;
 } /* End of ms_readleapseconds() */
 
+/***************************************************************************
+ * ms_loadleapseconds:
+ *
+ * Load leap seconds once, reading them from a file indicated by the
+ * specified environment variable unless a leap second list is already
+ * present, and prepare the sorted leap second table used by
+ * ms_leapsecondinspan().  Subsequent calls return the loaded count.
+ *
+ * This should be called before reading data, in particular before
+ * using multiple threads, when leap seconds are to be used.
+ *
+ * Returns positive number of leap seconds loaded, -1 on file read
+ * error, and -2 when the environment variable is not set.
+ ***************************************************************************/
+int
+ms_loadleapseconds (char *envvarname)
+{
+  int rv;
+
+  if (leapsecondlist && leapsecondtablelist == leapsecondlist)
+    return leapsecondcount;
+
+  if (!leapsecondlist && (rv = ms_readleapseconds (envvarname)) < 0)
+    return rv;
+
+  return ms_buildleapsecondtable ();
+} /* End of ms_loadleapseconds() */
+
+/***************************************************************************
+ * ms_leapsecondinspan:
+ *
+ * Determine if a leap second from the leap second list occurs within
+ * the specified time span, exclusive of the start and end times.  The
+ * sorted leap second table is searched with a range check followed by
+ * a binary search, if the table is not current for the leap second
+ * list the list is searched.
+ *
+ * Returns 1 if a leap second occurs within the span, 0 if not and -1
+ * if no leap second list is loaded.
+ ***************************************************************************/
+int
+ms_leapsecondinspan (hptime_t starttime, hptime_t endtime)
+{
+  LeapSecond *lslist = leapsecondlist;
+  int low;
+  int high;
+  int mid;
+
+  if (!lslist)
+    return -1;
+
+  if (leapsecondtable && leapsecondtablelist == lslist)
+  {
+    /* Fast check that the span is not within the leap second range */
+    if (leapsecondcount == 0 ||
+        endtime <= leapsecondtable[0] ||
+        starttime >= leapsecondtable[leapsecondcount - 1])
+      return 0;
+
+    /* Find first leap second after the start time */
+    low  = 0;
+    high = leapsecondcount;
+    while (low < high)
+    {
+      mid = low + (high - low) / 2;
+
+      if (leapsecondtable[mid] <= starttime)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    return (low < leapsecondcount && leapsecondtable[low] < endtime) ? 1 : 0;
+  }
+
+  while (lslist)
+  {
+    if (lslist->leapsecond > starttime && lslist->leapsecond < endtime)
+      return 1;
+
+    lslist = lslist->next;
+  }
+
+  return 0;
+} /* End of ms_leapsecondinspan() */
+
+/***************************************************************************
+ * ms_buildleapsecondtable:
+ *
+ * Build the sorted table of leap second times from the leap second
+ * list.
+ *
+ * Returns the number of leap seconds in the table on success and -1
+ * on error.
+ ***************************************************************************/
+static int
+ms_buildleapsecondtable (void)
+{
+  LeapSecond *ls;
+  hptime_t *table;
+  hptime_t time;
+  int count = 0;
+  int idx;
+
+  for (ls = leapsecondlist; ls; ls = ls->next)
+    count++;
+
+  if ((table = (hptime_t *)malloc (sizeof (hptime_t) * ((count) ? count : 1))) == NULL)
+  {
+    ms_log (2, "Cannot allocate leap second table, out of memory?\n");
+    return -1;
+  }
+
+  /* Insertion sort, the list is normally in time order */
+  count = 0;
+  for (ls = leapsecondlist; ls; ls = ls->next)
+  {
+    time = ls->leapsecond;
+
+    for (idx = count; idx > 0 && table[idx - 1] > time; idx--)
+      table[idx] = table[idx - 1];
+
+    table[idx] = time;
+    count++;
+  }
+
+  if (leapsecondtable)
+    free (leapsecondtable);
+
+  leapsecondtable     = table;
+  leapsecondcount     = count;
+  leapsecondtablelist = leapsecondlist;
+
+  return count;
+} /* End of ms_buildleapsecondtable() */
+
 /***************************************************************************
  * ms_readleapsecondfile:
  *
@@ -1256,9 +1398,15 @@ ms_readleapsecondfile (char *filename)
       }
       else
       {
+        if (!lastls)
+          for (lastls = leapsecondlist; lastls->next; lastls = lastls->next)
+            ;
+
         lastls->next = ls;
         lastls       = ls;
       }
+
+      count++;
     }
     else
     {
@@ -1273,6 +1421,10 @@ ms_readleapsecondfile (char *filename)
 
   fclose (fp);
 
+  /* Update the sorted leap second table */
+  if (ms_buildleapsecondtable () < 0)
+    return -1;
+
   return count;
 } /* End of ms_readleapsecondfile() */
 
@@ -1581,6 +1733,120 @@ ms_rsqrt64 (double val)
   return y;
 } /* End of ms_rsqrt64() */
 
+/***************************************************************************
+ * ms_samplecapacity:
+ *
+ * Determine the capacity in bytes of a sample buffer holding size
+ * bytes.  Sizes are rounded up to a granule of an eighth to a quarter
+ * of the size, so the capacity grows geometrically and is derived
+ * from the size alone without any state kept with the buffer.
+ *
+ * Returns the capacity in bytes.
+ ***************************************************************************/
+static size_t
+ms_samplecapacity (size_t size)
+{
+  size_t granule = 256;
+
+  while (granule <= size / 8)
+    granule <<= 1;
+
+  return (size + granule - 1) & ~(granule - 1);
+} /* End of ms_samplecapacity() */
+
+/***************************************************************************
+ * ms_growsamples:
+ *
+ * Make room for addsamples samples of samplesize bytes in a trace or
+ * segment sample buffer holding numsamples samples.
+ *
+ * The buffer is reallocated to the capacity for the total samples,
+ * which grows geometrically with the number of samples.  As long as
+ * the capacity does not change the reallocation keeps the buffer in
+ * place without copying, so repeated additions are amortized.  No
+ * capacity is stored, datasamples is always the start of an
+ * allocation and may be replaced, freed or reallocated by the caller.
+ *
+ * If whence is 1 room is made at the end of the samples.  If whence
+ * is 2 room is made at the beginning of the samples by moving the
+ * existing samples within the buffer.
+ *
+ * The caller is expected to copy the added samples to the returned
+ * location and increase the sample count.
+ *
+ * Returns a pointer to the location of the added samples on success
+ * and NULL on error.
+ ***************************************************************************/
+void *
+ms_growsamples (void **datasamples, int64_t numsamples, int64_t addsamples,
+                int samplesize, flag whence)
+{
+  char *buffer;
+  size_t used;
+  size_t add;
+
+  if (!datasamples || numsamples < 0 || addsamples <= 0 || samplesize <= 0 ||
+      (whence != 1 && whence != 2))
+    return NULL;
+
+  used = (*datasamples) ? (size_t)numsamples * samplesize : 0;
+  add  = (size_t)addsamples * samplesize;
+
+  if (!(buffer = (char *)realloc (*datasamples, ms_samplecapacity (used + add))))
+    return NULL;
+
+  *datasamples = buffer;
+
+  /* Add room at the end */
+  if (whence == 1)
+    return buffer + used;
+
+  /* Add room at the beginning */
+  if (used)
+    memmove (buffer + add, buffer, used);
+
+  return buffer;
+} /* End of ms_growsamples() */
+
+/***************************************************************************
+ * ms_shrinksamples:
+ *
+ * Shrink a trace or segment sample buffer grown by ms_growsamples() to
+ * exactly numsamples samples of samplesize bytes, a buffer without
+ * samples is freed.
+ *
+ * Returns 0 on success and -1 on error, in which case the buffer is
+ * unchanged.
+ ***************************************************************************/
+int
+ms_shrinksamples (void **datasamples, int64_t numsamples, int samplesize)
+{
+  char *buffer;
+  size_t used;
+
+  if (!datasamples || numsamples < 0 || samplesize <= 0)
+    return -1;
+
+  if (!*datasamples)
+    return 0;
+
+  used = (size_t)numsamples * samplesize;
+
+  if (used == 0)
+  {
+    free (*datasamples);
+    *datasamples = NULL;
+    return 0;
+  }
+
+  if (!(buffer = (char *)realloc (*datasamples, used)))
+    return -1;
+
+  *datasamples = buffer;
+
+  return 0;
+} /* End of ms_shrinksamples() */
+
 /***************************************************************************
  * ms_gmtime_r:
  *
@@ -28,8 +28,8 @@
 extern "C" {
 #endif
 
-#define LIBMSEED_VERSION "2.19.3"
-#define LIBMSEED_RELEASE "2017.075"
+#define LIBMSEED_VERSION "2.20.0"
+#define LIBMSEED_RELEASE "2026.291"
 
 /* C99 standard headers */
 #include <stdlib.h>
@@ -455,6 +455,23 @@ typedef struct blkt_link_s
 }
 BlktLink;
 
+/* Block of memory in an arena, allocations follow the header */
+typedef struct MSArenaBlock_s
+{
+  struct MSArenaBlock_s *next;       /* Next (previously allocated) block */
+  size_t    size;                    /* Size of allocation space in bytes */
+  size_t    used;                    /* Bytes allocated from block */
+}
+MSArenaBlock;
+
+/* Arena for allocation of records, blockettes and traces released in bulk */
+typedef struct MSArena_s
+{
+  MSArenaBlock *blocks;              /* Chain of blocks, most recent first */
+  size_t    blocksize;               /* Allocation space of new blocks in bytes */
+}
+MSArena;
+
 typedef struct StreamState_s
 {
   int64_t   packedrecords;           /* Count of packed records */
@@ -604,6 +621,13 @@ extern int unpackencodingfallback;
 #define MS_UNPACKENCODINGFORMAT(X) (unpackencodingformat = X);
 #define MS_UNPACKENCODINGFALLBACK(X) (unpackencodingfallback = X);
 
+/* Arena allocation related functions */
+extern MSArena*      ms_arena_init (MSArena *arena, size_t blocksize);
+extern void*         ms_arena_alloc (MSArena *arena, size_t size);
+extern void          ms_arena_release (void *ptr);
+extern int           ms_arena_owns (MSArena *arena, const void *ptr);
+extern void          ms_arena_free (MSArena **pparena);
+
 /* Mini-SEED record related functions */
 extern int           msr_parse (char *record, int recbuflen, MSRecord **ppmsr, int reclen,
 				flag dataflag, flag verbose);
@@ -614,15 +638,31 @@ extern int           msr_parse_selection ( char *recbuf, int recbuflen, int64_t
 
 extern int           msr_unpack (char *record, int reclen, MSRecord **ppmsr,
 				 flag dataflag, flag verbose);
+extern int           msr_unpack_header (char *record, int reclen, MSRecord *msr, flag verbose);
+extern int           msr_unpack_buffer (char *record, int reclen, MSRecord **ppmsr,
+					void *buffer, size_t buffersize, flag verbose);
 
 extern int           msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
 		 	       void *handlerdata, int64_t *packedsamples, flag flush, flag verbose );
 
+extern int           msr_pack_rawsamples (MSRecord *msr, void (*record_handler) (char *, int, void *),
+					  void *handlerdata, int64_t *packedsamples, flag flush,
+					  int rawsamplesize, flag rawswapflag, flag verbose);
+
+extern int           msr_pack_parallel (MSRecord *msr, void (*record_handler) (char *, int, void *),
+					void *handlerdata, int64_t *packedsamples, flag flush,
+					int workers, flag verbose);
+
+extern int           msr_pack_reclens (MSRecord *msr, void (*record_handler) (char *, int, void *),
+				       void *handlerdata, int64_t *packedsamples, flag flush,
+				       const int *reclens, int reclencount, int workers, flag verbose);
+
 extern int           msr_pack_header (MSRecord *msr, flag normalize, flag verbose);
 
 extern int           msr_unpack_data (MSRecord *msr, int swapflag, flag verbose);
 
 extern MSRecord*     msr_init (MSRecord *msr);
+extern MSRecord*     msr_init_arena (MSArena *arena);
 extern void          msr_free (MSRecord **ppmsr);
 extern void          msr_free_blktchain (MSRecord *msr);
 extern BlktLink*     msr_addblockette (MSRecord *msr, char *blktdata, int length,
@@ -644,8 +684,10 @@ extern int           ms_parse_raw (char *record, int maxreclen, flag details, fl
 
 /* MSTrace related functions */
 extern MSTrace*      mst_init (MSTrace *mst);
+extern MSTrace*      mst_init_arena (MSArena *arena);
 extern void          mst_free (MSTrace **ppmst);
 extern MSTraceGroup* mst_initgroup (MSTraceGroup *mstg);
+extern MSTraceGroup* mst_initgroup_arena (MSTraceGroup *mstg, MSArena *arena);
 extern void          mst_freegroup (MSTraceGroup **ppmstg);
 extern MSTrace*      mst_findmatch (MSTrace *startmst, char dataquality,
 				    char *network, char *station, char *location, char *channel);
@@ -659,10 +701,13 @@ extern int           mst_addspan (MSTrace *mst, hptime_t starttime,  hptime_t en
 				  char sampletype, flag whence);
 extern MSTrace*      mst_addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
 					double timetol, double sampratetol);
+extern MSTrace*      mst_adoptsamples (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
+				       double timetol, double sampratetol);
 extern MSTrace*      mst_addtracetogroup (MSTraceGroup *mstg, MSTrace *mst);
 extern int           mst_groupheal (MSTraceGroup *mstg, double timetol, double sampratetol);
 extern int           mst_groupsort (MSTraceGroup *mstg, flag quality);
 extern int           mst_convertsamples (MSTrace *mst, char type, flag truncate);
+extern int           mst_shrinksamples (MSTrace *mst);
 extern char *        mst_srcname (MSTrace *mst, char *srcname, flag quality);
 extern void          mst_printtracelist (MSTraceGroup *mstg, flag timeformat,
 					 flag details, flag gaps);
@@ -673,6 +718,14 @@ extern int           mst_pack (MSTrace *mst, void (*record_handler) (char *, int
 			       void *handlerdata, int reclen, flag encoding, flag byteorder,
 			       int64_t *packedsamples, flag flush, flag verbose,
 			       MSRecord *mstemplate);
+extern int           mst_pack_parallel (MSTrace *mst, void (*record_handler) (char *, int, void *),
+					void *handlerdata, int reclen, flag encoding, flag byteorder,
+					int64_t *packedsamples, flag flush, int workers, flag verbose,
+					MSRecord *mstemplate);
+extern int           mst_pack_reclens (MSTrace *mst, void (*record_handler) (char *, int, void *),
+				       void *handlerdata, const int *reclens, int reclencount,
+				       flag encoding, flag byteorder, int64_t *packedsamples,
+				       flag flush, int workers, flag verbose, MSRecord *mstemplate);
 extern int           mst_packgroup (MSTraceGroup *mstg, void (*record_handler) (char *, int, void *),
 				    void *handlerdata, int reclen, flag encoding, flag byteorder,
 				    int64_t *packedsamples, flag flush, flag verbose,
@@ -683,7 +736,10 @@ extern MSTraceList * mstl_init ( MSTraceList *mstl );
 extern void          mstl_free ( MSTraceList **ppmstl, flag freeprvtptr );
 extern MSTraceSeg *  mstl_addmsr ( MSTraceList *mstl, MSRecord *msr, flag dataquality,
 				   flag autoheal, double timetol, double sampratetol );
+extern MSTraceSeg *  mstl_adoptsamples ( MSTraceList *mstl, MSRecord *msr, flag dataquality,
+					 flag autoheal, double timetol, double sampratetol );
 extern int           mstl_convertsamples ( MSTraceSeg *seg, char type, flag truncate );
+extern int           mstl_shrinksamples ( MSTraceList *mstl );
 extern void          mstl_printtracelist ( MSTraceList *mstl, flag timeformat,
 					   flag details, flag gaps );
 extern void          mstl_printsynclist ( MSTraceList *mstl, char *dccid, flag subsecond );
@@ -711,6 +767,8 @@ extern int      ms_readmsr_r (MSFileParam **ppmsfp, MSRecord **ppmsr, const char
 			      off_t *fpos, int *last, flag skipnotdata, flag dataflag, flag verbose);
 extern int      ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile, int reclen,
 				 off_t *fpos, int *last, flag skipnotdata, flag dataflag, Selections *selections, flag verbose);
+extern int      ms_readmsr_map (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile, int reclen,
+				off_t *fpos, int *last, flag skipnotdata, flag dataflag, flag verbose);
 extern int      ms_readtraces (MSTraceGroup **ppmstg, const char *msfile, int reclen, double timetol, double sampratetol,
 			       flag dataquality, flag skipnotdata, flag dataflag, flag verbose);
 extern int      ms_readtraces_timewin (MSTraceGroup **ppmstg, const char *msfile, int reclen, double timetol, double sampratetol,
@@ -723,6 +781,11 @@ extern int      ms_readtracelist_timewin (MSTraceList **ppmstl, const char *msfi
 					  hptime_t starttime, hptime_t endtime, flag dataquality, flag skipnotdata, flag dataflag, flag verbose);
 extern int      ms_readtracelist_selection (MSTraceList **ppmstl, const char *msfile, int reclen, double timetol, double sampratetol,
 					    Selections *selections, flag dataquality, flag skipnotdata, flag dataflag, flag verbose);
+extern int      ms_readtracelist_parallel (MSTraceList **ppmstl, const char *msfile, int reclen, double timetol, double sampratetol,
+					   Selections *selections, flag dataquality, flag skipnotdata, flag dataflag,
+					   int workers, flag verbose);
+extern int      ms_scantracelist (MSTraceList **ppmstl, const char *msfile, int reclen, double timetol, double sampratetol,
+				  Selections *selections, flag dataquality, flag skipnotdata, flag verbose);
 
 extern int      msr_writemseed ( MSRecord *msr, const char *msfile, flag overwrite, int reclen,
 				 flag encoding, flag byteorder, flag verbose );
@@ -757,17 +820,21 @@ extern int      ms_ratapprox (double real, int *num, int *den, int maxval, doubl
 extern int      ms_bigendianhost (void);
 extern double   ms_dabs (double val);
 extern double   ms_rsqrt64 (double val);
+extern void*    ms_growsamples (void **datasamples, int64_t numsamples, int64_t addsamples,
+				int samplesize, flag whence);
+extern int      ms_shrinksamples (void **datasamples, int64_t numsamples, int samplesize);
 
 
 /* Lookup functions */
 extern uint8_t  ms_samplesize (const char sampletype);
+extern char     ms_encodingsampletype (const char encoding);
 extern char*    ms_encodingstr (const char encoding);
 extern char*    ms_blktdesc (uint16_t blkttype);
 extern uint16_t ms_blktlen (uint16_t blkttype, const char *blktdata, flag swapflag);
 extern char *   ms_errorstr (int errorcode);
 
 /* Logging facility */
-#define MAX_LOG_MSG_LENGTH  200      /* Maximum length of log messages */
+#define MAX_LOG_MSG_LENGTH  200      /* Length of log message buffers, longer are allocated */
 
 /* Logging parameters */
 typedef struct MSLogParam_s
@@ -785,6 +852,7 @@ extern void   ms_loginit (void (*log_print)(char*), const char *logprefix,
 extern MSLogParam *ms_loginit_l (MSLogParam *logp,
 			         void (*log_print)(char*), const char *logprefix,
 			         void (*diag_print)(char*), const char *errprefix);
+extern int    ms_loglevel (int minlevel);
 
 /* Selection functions */
 extern Selections *ms_matchselect (Selections *selections, char *srcname,
@@ -797,6 +865,7 @@ extern int      ms_addselect_comp (Selections **ppselections, char *net, char* s
 extern int      ms_readselectionsfile (Selections **ppselections, char *filename);
 extern void     ms_freeselections (Selections *selections);
 extern void     ms_printselections (Selections *selections);
+extern int      ms_compileselections (Selections *selections);
 
 /* Leap second declarations, implementation in gentutils.c */
 typedef struct LeapSecond_s
@@ -809,6 +878,8 @@ typedef struct LeapSecond_s
 extern LeapSecond *leapsecondlist;
 extern int ms_readleapseconds (char *envvarname);
 extern int ms_readleapsecondfile (char *filename);
+extern int ms_loadleapseconds (char *envvarname);
+extern int ms_leapsecondinspan (hptime_t starttime, hptime_t endtime);
 
 /* Generic byte swapping routines */
 extern void     ms_gswap2 ( void *data2 );
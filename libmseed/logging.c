@@ -6,7 +6,7 @@
  * Chad Trabant
  * IRIS Data Management Center
  *
- * modified: 2014.197
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <stdarg.h>
@@ -25,6 +25,9 @@ int ms_log_main (MSLogParam *logp, int level, va_list *varlist);
 /* Initialize the global logging parameters */
 MSLogParam gMSLogParam = {NULL, NULL, NULL, NULL};
 
+/* Minimum level of messages formatted and printed */
+static int minloglevel = 0;
+
 /***************************************************************************
  * ms_loginit:
  *
@@ -146,6 +149,27 @@ ms_loginit_main (MSLogParam *logp,
   return;
 } /* End of ms_loginit_main() */
 
+/***************************************************************************
+ * ms_loglevel:
+ *
+ * Set the minimum level of messages printed by ms_log() and
+ * ms_log_l(), messages of lower levels are discarded before they are
+ * formatted.  The default of 0 prints all messages, e.g. 2 prints only
+ * error messages.  The level should be set before logging from
+ * multiple threads.
+ *
+ * Returns the previous minimum level.
+ ***************************************************************************/
+int
+ms_loglevel (int minlevel)
+{
+  int previous = minloglevel;
+
+  minloglevel = minlevel;
+
+  return previous;
+} /* End of ms_loglevel() */
+
 /***************************************************************************
  * ms_log:
  *
@@ -214,6 +238,9 @@ ms_log_l (MSLogParam *logp, int level, ...)
  * 1  : Diagnostic messages, printed using diag_print with logprefix
  * 2+ : Error messagess, printed using diag_print with errprefix
  *
+ * Messages below the minimum level set with ms_loglevel() are
+ * discarded before they are formatted.
+ *
  * This function builds the log/error message and passes to it as a
  * string (char *) to the functions defined with ms_loginit() or
  * ms_loginit_l().  If the log/error printing functions have not been
@@ -223,8 +250,11 @@ ms_log_l (MSLogParam *logp, int level, ...)
  * If the log/error prefix's have been set with ms_loginit() or
  * ms_loginit_l() they will be pre-pended to the message.
  *
- * All messages will be truncated to the MAX_LOG_MSG_LENGTH, this includes
- * any set prefix.
+ * Messages are formatted in a buffer of MAX_LOG_MSG_LENGTH local to
+ * the call, longer messages are formatted in an allocated buffer and
+ * only truncated if it cannot be allocated.  The function may be used
+ * from multiple threads if the log/error printing functions are
+ * thread-safe.
  *
  * Returns the number of characters formatted on success, and a
  * a negative value on error.
@@ -232,10 +262,15 @@ ms_log_l (MSLogParam *logp, int level, ...)
 int
 ms_log_main (MSLogParam *logp, int level, va_list *varlist)
 {
-  static char message[MAX_LOG_MSG_LENGTH];
+  char message[MAX_LOG_MSG_LENGTH];
+  char *longmessage = NULL;
+  char *output      = message;
+  const char *prefix;
+  const char *format;
+  void (*print) (char *);
+  va_list formatlist;
   int retvalue = 0;
   int presize;
-  const char *format;
 
   if (!logp)
   {
@@ -243,86 +278,65 @@ ms_log_main (MSLogParam *logp, int level, va_list *varlist)
     return -1;
   }
 
-  message[0] = '\0';
-
-  format = va_arg (*varlist, const char *);
+  /* Discard messages below the minimum level before formatting */
+  if (level < 0 || level < minloglevel)
+    return 0;
 
   if (level >= 2) /* Error message */
   {
-    if (logp->errprefix != NULL)
-    {
-      strncpy (message, logp->errprefix, MAX_LOG_MSG_LENGTH);
-      message[MAX_LOG_MSG_LENGTH - 1] = '\0';
-    }
-    else
-    {
-      strncpy (message, "Error: ", MAX_LOG_MSG_LENGTH);
-    }
-
-    presize  = strlen (message);
-    retvalue = vsnprintf (&message[presize],
-                          MAX_LOG_MSG_LENGTH - presize,
-                          format, *varlist);
-
-    message[MAX_LOG_MSG_LENGTH - 1] = '\0';
-
-    if (logp->diag_print != NULL)
-    {
-      logp->diag_print (message);
-    }
-    else
-    {
-      fprintf (stderr, "%s", message);
-    }
+    prefix = (logp->errprefix != NULL) ? logp->errprefix : "Error: ";
+    print  = logp->diag_print;
   }
   else if (level == 1) /* Diagnostic message */
   {
-    if (logp->logprefix != NULL)
-    {
-      strncpy (message, logp->logprefix, MAX_LOG_MSG_LENGTH);
-      message[MAX_LOG_MSG_LENGTH - 1] = '\0';
-    }
+    prefix = logp->logprefix;
+    print  = logp->diag_print;
+  }
+  else /* Normal log message */
+  {
+    prefix = logp->logprefix;
+    print  = logp->log_print;
+  }
 
-    presize  = strlen (message);
-    retvalue = vsnprintf (&message[presize],
-                          MAX_LOG_MSG_LENGTH - presize,
-                          format, *varlist);
+  message[0] = '\0';
 
+  if (prefix != NULL)
+  {
+    strncpy (message, prefix, MAX_LOG_MSG_LENGTH);
     message[MAX_LOG_MSG_LENGTH - 1] = '\0';
-
-    if (logp->diag_print != NULL)
-    {
-      logp->diag_print (message);
-    }
-    else
-    {
-      fprintf (stderr, "%s", message);
-    }
   }
-  else if (level == 0) /* Normal log message */
-  {
-    if (logp->logprefix != NULL)
-    {
-      strncpy (message, logp->logprefix, MAX_LOG_MSG_LENGTH);
-      message[MAX_LOG_MSG_LENGTH - 1] = '\0';
-    }
 
-    presize  = strlen (message);
-    retvalue = vsnprintf (&message[presize],
-                          MAX_LOG_MSG_LENGTH - presize,
-                          format, *varlist);
+  format = va_arg (*varlist, const char *);
 
-    message[MAX_LOG_MSG_LENGTH - 1] = '\0';
+  presize = strlen (message);
+  va_copy (formatlist, *varlist);
+  retvalue = vsnprintf (&message[presize],
+                        MAX_LOG_MSG_LENGTH - presize,
+                        format, formatlist);
+  va_end (formatlist);
 
-    if (logp->log_print != NULL)
-    {
-      logp->log_print (message);
-    }
-    else
-    {
-      fprintf (stdout, "%s", message);
-    }
+  message[MAX_LOG_MSG_LENGTH - 1] = '\0';
+
+  /* Format a message longer than the buffer in an allocated buffer */
+  if (retvalue >= MAX_LOG_MSG_LENGTH - presize &&
+      (longmessage = (char *)malloc (presize + retvalue + 1)) != NULL)
+  {
+    memcpy (longmessage, message, presize);
+    vsnprintf (longmessage + presize, retvalue + 1, format, *varlist);
+    output = longmessage;
   }
 
+  if (print != NULL)
+  {
+    print (output);
+  }
+  else
+  {
+    fprintf ((level >= 1) ? stderr : stdout, "%s", output);
+  }
+
+  if (longmessage)
+    free (longmessage);
+
   return retvalue;
 } /* End of ms_log_main() */
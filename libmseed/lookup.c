@@ -5,7 +5,7 @@
  *
  * Written by Chad Trabant, ORFEUS/EC-Project MEREDIAN
  *
- * modified: 2006.346
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <string.h>
@@ -35,6 +35,40 @@ ms_samplesize (const char sampletype)
 
 } /* End of ms_samplesize() */
 
+/***************************************************************************
+ * ms_encodingsampletype():
+ *
+ * Returns the type code of the samples decoded from a data encoding
+ * format or 0 for unknown or unsupported encodings.
+ ***************************************************************************/
+char
+ms_encodingsampletype (const char encoding)
+{
+  switch (encoding)
+  {
+  case DE_ASCII:
+    return 'a';
+  case DE_INT16:
+  case DE_INT32:
+  case DE_STEIM1:
+  case DE_STEIM2:
+  case DE_CDSN:
+  case DE_SRO:
+  case DE_DWWSSN:
+    return 'i';
+  case DE_FLOAT32:
+  case DE_GEOSCOPE24:
+  case DE_GEOSCOPE163:
+  case DE_GEOSCOPE164:
+    return 'f';
+  case DE_FLOAT64:
+    return 'd';
+  default:
+    return 0;
+  } /* end switch */
+
+} /* End of ms_encodingsampletype() */
+
 /***************************************************************************
  * ms_encodingstr():
  *
@@ -0,0 +1,647 @@
+/***************************************************************************
+ * mexMsReadTracesParallel.c
+ *
+ * This file is part of the library libmseed.
+ *
+ *     libmseed is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     libmseed is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Foobar; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Mex function reading Mini-SEED traces with multiple threads.
+ *
+ * mexMsReadTracesParallel takes the following arguments:
+ *  filename
+ *  [timetolerance]
+ *  [sampratetolerance]
+ *  [workers]
+ *  [verbosity]
+ *
+ * The return value is a Matlab structure similiar to the libmseed
+ * structure MSTrace_s containing the trace header and data, the same
+ * as returned by mexMsReadTraces except that the data samples are of
+ * the native sample type: int32 for integer encodings, single for
+ * 32-bit floats, double for 64-bit floats and uint8 for text.
+ *
+ * The record headers are scanned first to assemble the traces in the
+ * same way as ms_readtraces() without unpacking data samples.  The
+ * Matlab arrays for the data are then created with the sample counts
+ * from the headers and the records are decoded directly into their
+ * position in the arrays by worker threads, no intermediate trace
+ * buffers or sample conversions are needed.
+ *
+ * modified: 2026.291
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mex.h"
+#include "../libmseed.h"
+
+/* Records are decoded with worker threads where available */
+#if !defined(LMP_WIN) && !defined(LMP_NOTHREADS)
+  #define MEX_THREADS 1
+  #include <pthread.h>
+#endif
+
+/* Default and maximum number of worker threads */
+#define DEFAULT_WORKERS 4
+#define MAX_WORKERS 64
+
+/* Number of records claimed by a worker at a time */
+#define RECORD_BATCH 64
+
+/* Record of the input file and its position in a trace */
+typedef struct ScanRecord_s {
+  off_t    offset;                /* Offset of record in file */
+  int      reclen;                /* Record length */
+  int      trace;                 /* Index of trace, -1 if not in a trace */
+  int64_t  position;              /* First sample position in trace */
+  int64_t  samplecnt;             /* Sample count from header */
+} ScanRecord;
+
+/* Sample range of a trace during scanning and the decoding target */
+typedef struct ScanTrace_s {
+  int      index;                 /* Index of trace */
+  int64_t  head;                  /* Position of first sample */
+  int64_t  tail;                  /* Position after last sample */
+  char     sampletype;            /* Sample type of the trace */
+  char    *data;                  /* Data of Matlab array */
+  int64_t  decoded;               /* Number of samples decoded */
+} ScanTrace;
+
+/* Shared state of the decoding workers */
+typedef struct DecodeWork_s {
+  const char  *filename;
+  ScanRecord  *records;
+  ScanTrace  **traces;
+  int64_t      recordcount;
+  int64_t      nextrecord;
+  int64_t      errors;
+  flag         verbose;
+#if defined(MEX_THREADS)
+  pthread_mutex_t lock;
+#endif
+} DecodeWork;
+
+static int scanrecords (const char *filename, MSTraceGroup *mstg, ScanRecord **records,
+			int64_t *recordcount, ScanTrace ***traces, double timetol,
+			double sampratetol, flag verbose);
+static int addtotrace (MSTraceGroup *mstg, MSRecord *msr, ScanRecord *record,
+		       ScanTrace ***traces, double timetol, double sampratetol);
+static void *decoderecords (void *arg);
+static void logmessage (char *message);
+static void logflush (void);
+
+/* Log messages collected while workers are running */
+static char   *logbuffer = NULL;
+static size_t  loglength = 0;
+static size_t  logsize = 0;
+#if defined(MEX_THREADS)
+static pthread_mutex_t loglock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void
+mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  MSTraceGroup *mstg = NULL;
+  MSTrace *mst = NULL;
+  ScanRecord *records = NULL;
+  ScanTrace **traces = NULL;
+  DecodeWork work;
+  const char **my_fnames = NULL;
+  char *filename;
+  int buflen;
+  double timetol = -1.0;
+  double sampratetol = -1.0;
+  int workers = DEFAULT_WORKERS;
+  flag verbose = 0;
+  int64_t recordcount = 0;
+  int i, nfields;
+  mxClassID classid;
+  mxArray *tmp_val;
+#if defined(MEX_THREADS)
+  pthread_t threads[MAX_WORKERS];
+  int started;
+#endif
+
+  /* Sanity check input and output */
+  if ( nrhs < 1 )
+    {
+      mexPrintf ("mexMsReadTracesParallel - Read Mini-SEED data into Matlab with multiple threads\n\n");
+      mexPrintf ("Usage: mexMsReadTracesParallel (filename, [timetol], [sampratetol], [workers], [verbosity])\n");
+      mexPrintf ("  filename    - Name of file to read Mini-SEED data from\n");
+      mexPrintf ("  timetol     - Time tolerance, default is 1/2 sample period (-1)\n");
+      mexPrintf ("  sampratetol - Sample rate tolerance, default is rate depdendent (-1)\n");
+      mexPrintf ("  workers     - Number of decoding threads, default %d\n", DEFAULT_WORKERS);
+      mexPrintf ("  verbosity   - Level of diagnostic messages, default 0\n\n");
+      mexErrMsgTxt ("At lease one 1 argument required.");
+    }
+  else if ( nlhs > 1 )
+    {
+      mexErrMsgTxt ("Too many output arguments.");
+    }
+
+  /* Redirect libmseed logging messages to Matlab functions */
+  ms_loginit ((void *)&mexPrintf, NULL, (void *)&mexWarnMsgTxt, NULL);
+
+  /* Get the length of the input string */
+  buflen = (mxGetM (prhs[0]) * mxGetN (prhs[0])) + 1;
+
+  /* Allocate memory for input string */
+  filename = mxCalloc (buflen, sizeof (char));
+
+  /* Assign the input arguments to variables */
+  if ( mxGetString (prhs[0], filename, buflen) )
+    mexErrMsgTxt ("Not enough space. Filename string is truncated.");
+  if ( nrhs >= 2 )
+    timetol = mxGetScalar(prhs[1]);
+  if ( nrhs >= 3 )
+    sampratetol = mxGetScalar(prhs[2]);
+  if ( nrhs >= 4 )
+    workers = (int) mxGetScalar(prhs[3]);
+  if ( nrhs >= 5 )
+    verbose = (flag) mxGetScalar(prhs[4]);
+
+  if ( workers < 1 )
+    workers = 1;
+  if ( workers > MAX_WORKERS )
+    workers = MAX_WORKERS;
+
+  /* Scan the record headers and assemble the traces */
+  mstg = mst_initgroup (NULL);
+
+  if ( ! mstg || scanrecords (filename, mstg, &records, &recordcount, &traces,
+			      timetol, sampratetol, verbose) )
+    {
+      mst_freegroup (&mstg);
+      free (records);
+      free (traces);
+      mexErrMsgTxt ("Error reading files");
+    }
+
+  /* Print some information to the Matlab command prompt */
+  mst_printtracelist (mstg, 0, verbose, 1);
+
+  nfields = 13;
+  my_fnames = mxCalloc (nfields, sizeof (*my_fnames));
+  my_fnames[0] = "network";
+  my_fnames[1] = "station";
+  my_fnames[2] = "location";
+  my_fnames[3] = "channel";
+  my_fnames[4] = "dataquality";
+  my_fnames[5] = "type";
+  my_fnames[6] = "startTime";
+  my_fnames[7] = "endTime";
+  my_fnames[8] = "sampleRate";
+  my_fnames[9] = "sampleCount";
+  my_fnames[10] = "numberOfSamples";
+  my_fnames[11] = "sampleType";
+  my_fnames[12] = "data";
+  plhs[0] = mxCreateStructMatrix(mstg->numtraces, 1, nfields, my_fnames);
+  mxFree(my_fnames);
+
+  /* Create the data arrays from the header sample counts, the data
+   * pointers are the targets for decoding */
+  mst = mstg->traces;
+  for (i=0; i < mstg->numtraces; i++)
+    {
+      if ( mst->sampletype == 'i' )
+	classid = mxINT32_CLASS;
+      else if ( mst->sampletype == 'f' )
+	classid = mxSINGLE_CLASS;
+      else if ( mst->sampletype == 'a' )
+	classid = mxUINT8_CLASS;
+      else
+	classid = mxDOUBLE_CLASS;
+
+      tmp_val = mxCreateNumericMatrix ((mwSize) mst->samplecnt, 1, classid, mxREAL);
+      traces[i]->data = (char *) mxGetData (tmp_val);
+
+      mxSetFieldByNumber(plhs[0], i, 12, tmp_val);
+
+      mst = mst->next;
+    }
+
+  /* Decode the records into the data arrays, messages are collected
+   * and printed after decoding as Matlab functions may only be called
+   * from the main thread */
+  memset (&work, 0, sizeof (DecodeWork));
+  work.filename = filename;
+  work.records = records;
+  work.traces = traces;
+  work.recordcount = recordcount;
+  work.verbose = verbose;
+
+  ms_loginit (logmessage, NULL, logmessage, NULL);
+
+#if defined(MEX_THREADS)
+  pthread_mutex_init (&work.lock, NULL);
+
+  if ( workers > recordcount / RECORD_BATCH + 1 )
+    workers = (int) (recordcount / RECORD_BATCH + 1);
+
+  for (started = 0; started < workers - 1; started++)
+    if ( pthread_create (&threads[started], NULL, decoderecords, &work) )
+      break;
+
+  /* The calling thread is also a worker */
+  decoderecords (&work);
+
+  while ( started > 0 )
+    pthread_join (threads[--started], NULL);
+
+  pthread_mutex_destroy (&work.lock);
+#else
+  decoderecords (&work);
+#endif
+
+  ms_loginit ((void *)&mexPrintf, NULL, (void *)&mexWarnMsgTxt, NULL);
+  logflush ();
+
+  if ( work.errors )
+    ms_log (2, "Error decoding %lld records\n", (long long int) work.errors);
+
+  /* Copy the trace headers to the matlab output structure. */
+  mst = mstg->traces;
+  for (i=0; i < mstg->numtraces; i++)
+    {
+      mxSetFieldByNumber(plhs[0], i, 0, mxCreateString(mst->network));
+      mxSetFieldByNumber(plhs[0], i, 1, mxCreateString(mst->station));
+      mxSetFieldByNumber(plhs[0], i, 2, mxCreateString(mst->location));
+      mxSetFieldByNumber(plhs[0], i, 3, mxCreateString(mst->channel));
+      mxSetFieldByNumber(plhs[0], i, 4, mxCreateDoubleScalar((int)mst->dataquality));
+      mxSetFieldByNumber(plhs[0], i, 5, mxCreateDoubleScalar((int)mst->type));
+      mxSetFieldByNumber(plhs[0], i, 6, mxCreateDoubleScalar(mst->starttime));
+      mxSetFieldByNumber(plhs[0], i, 7, mxCreateDoubleScalar(mst->endtime));
+      mxSetFieldByNumber(plhs[0], i, 8, mxCreateDoubleScalar(mst->samprate));
+      mxSetFieldByNumber(plhs[0], i, 9, mxCreateDoubleScalar(mst->samplecnt));
+      mxSetFieldByNumber(plhs[0], i, 10, mxCreateDoubleScalar(traces[i]->decoded));
+      mxSetFieldByNumber(plhs[0], i, 11, mxCreateDoubleScalar((int)mst->sampletype));
+
+      mst = mst->next;
+    }
+
+  mst_freegroup (&mstg);
+  free (records);
+  free (traces);
+}
+
+
+/***************************************************************************
+ * scanrecords:
+ *
+ * Read the record headers of a file without unpacking data samples
+ * and add them to the traces of a MSTraceGroup, keeping the offset of
+ * each record and the position of its samples in the trace.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+scanrecords (const char *filename, MSTraceGroup *mstg, ScanRecord **records,
+	     int64_t *recordcount, ScanTrace ***traces, double timetol,
+	     double sampratetol, flag verbose)
+{
+  MSFileParam *msfp = NULL;
+  MSRecord *msr = NULL;
+  ScanRecord *newrecords;
+  int64_t maxrecords = 0;
+  int64_t idx;
+  off_t fpos;
+  int retcode;
+
+  while ( (retcode = ms_readmsr_r (&msfp, &msr, filename, -1, &fpos, NULL,
+				   1, 0, verbose)) == MS_NOERROR )
+    {
+      if ( *recordcount >= maxrecords )
+	{
+	  maxrecords = (maxrecords) ? maxrecords * 2 : 1024;
+
+	  if ( ! (newrecords = (ScanRecord *) realloc (*records, maxrecords * sizeof(ScanRecord))) )
+	    {
+	      ms_log (2, "Cannot allocate memory for records\n");
+	      retcode = MS_GENERROR;
+	      break;
+	    }
+
+	  *records = newrecords;
+	}
+
+      (*records)[*recordcount].offset = fpos;
+      (*records)[*recordcount].reclen = msr->reclen;
+      (*records)[*recordcount].samplecnt = msr->samplecnt;
+
+      if ( addtotrace (mstg, msr, &(*records)[*recordcount], traces,
+		       timetol, sampratetol) )
+	{
+	  retcode = MS_GENERROR;
+	  break;
+	}
+
+      (*recordcount)++;
+    }
+
+  ms_readmsr_r (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, 0);
+
+  if ( retcode != MS_ENDOFFILE )
+    {
+      ms_log (2, "Cannot read %s: %s\n", filename, ms_errorstr(retcode));
+      return -1;
+    }
+
+  /* Make sample positions relative to the first sample of each trace */
+  for (idx = 0; idx < *recordcount; idx++)
+    if ( (*records)[idx].trace >= 0 )
+      (*records)[idx].position -= (*traces)[(*records)[idx].trace]->head;
+
+  return 0;
+}  /* End of scanrecords() */
+
+
+/***************************************************************************
+ * addtotrace:
+ *
+ * Add a record to a time adjacent trace of a MSTraceGroup or to a new
+ * trace in the same way as mst_addmsrtogroup(), determining the
+ * position of the record samples from the trace sample range.
+ * Records of a different sample type than the trace are not added,
+ * as mst_addmsr() would not add their samples.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addtotrace (MSTraceGroup *mstg, MSRecord *msr, ScanRecord *record,
+	    ScanTrace ***traces, double timetol, double sampratetol)
+{
+  MSTrace *mst;
+  MSTrace *lasttrace;
+  ScanTrace *trace;
+  ScanTrace **newtraces;
+  hptime_t endtime;
+  flag whence;
+  char sampletype;
+
+  record->trace = -1;
+  record->position = 0;
+
+  if ( (endtime = msr_endtime (msr)) == HPTERROR )
+    {
+      ms_log (2, "Error calculating record end time\n");
+      return 0;
+    }
+
+  sampletype = ms_encodingsampletype (msr->encoding);
+
+  if ( msr->samplecnt > 0 && ! sampletype )
+    {
+      ms_log (2, "Unsupported encoding format %d (%s)\n",
+	      msr->encoding, (char *) ms_encodingstr (msr->encoding));
+      return 0;
+    }
+
+  mst = mst_findadjacent (mstg, &whence, msr->dataquality,
+			  msr->network, msr->station, msr->location, msr->channel,
+			  msr->samprate, sampratetol,
+			  msr->starttime, endtime, timetol);
+
+  if ( mst )
+    {
+      /* Records with no time coverage do not contribute to a trace */
+      if ( msr->samplecnt <= 0 || msr->samprate <= 0.0 )
+	return 0;
+
+      if ( sampletype != mst->sampletype )
+	{
+	  ms_log (2, "mst_addmsr(): Mismatched sample type, '%c' and '%c'\n",
+		  sampletype, mst->sampletype);
+	  return 0;
+	}
+
+      trace = (ScanTrace *) mst->prvtptr;
+
+      if ( whence == 1 )
+	{
+	  record->position = trace->tail;
+	  trace->tail += msr->samplecnt;
+	}
+      else
+	{
+	  trace->head -= msr->samplecnt;
+	  record->position = trace->head;
+	}
+    }
+  else
+    {
+      if ( ! (mst = mst_init (NULL)) )
+	return -1;
+
+      if ( ! (trace = (ScanTrace *) calloc (1, sizeof(ScanTrace))) ||
+	   ! (newtraces = (ScanTrace **) realloc (*traces, (mstg->numtraces + 1) * sizeof(ScanTrace *))) )
+	{
+	  ms_log (2, "Cannot allocate memory for traces\n");
+	  free (trace);
+	  mst_free (&mst);
+	  return -1;
+	}
+
+      *traces = newtraces;
+      (*traces)[mstg->numtraces] = trace;
+
+      trace->index = mstg->numtraces;
+      trace->tail = msr->samplecnt;
+      trace->sampletype = (msr->samplecnt > 0) ? sampletype : 0;
+
+      mst->dataquality = msr->dataquality;
+      strncpy (mst->network, msr->network, sizeof (mst->network));
+      strncpy (mst->station, msr->station, sizeof (mst->station));
+      strncpy (mst->location, msr->location, sizeof (mst->location));
+      strncpy (mst->channel, msr->channel, sizeof (mst->channel));
+
+      mst->starttime = msr->starttime;
+      mst->samprate = msr->samprate;
+      mst->sampletype = trace->sampletype;
+      mst->prvtptr = trace;
+
+      whence = 1;
+
+      /* Link new MSTrace into the end of the chain */
+      if ( ! mstg->traces )
+	{
+	  mstg->traces = mst;
+	}
+      else
+	{
+	  for (lasttrace = mstg->traces; lasttrace->next; lasttrace = lasttrace->next);
+
+	  lasttrace->next = mst;
+	}
+
+      mstg->numtraces++;
+    }
+
+  record->trace = ((ScanTrace *) mst->prvtptr)->index;
+
+  /* Update the trace time range and sample count, no samples are added */
+  return mst_addmsr (mst, msr, whence);
+}  /* End of addtotrace() */
+
+
+/***************************************************************************
+ * decoderecords:
+ *
+ * Decode records into their positions in the trace data arrays,
+ * claiming batches of records until all records are decoded.  Each
+ * worker reads the file with its own stream.  No Matlab functions may
+ * be called from this routine.
+ ***************************************************************************/
+static void *
+decoderecords (void *arg)
+{
+  DecodeWork *work = (DecodeWork *) arg;
+  MSRecord *msr = NULL;
+  ScanRecord *record;
+  ScanTrace *trace;
+  FILE *fp;
+  char *recbuf = NULL;
+  int64_t first;
+  int64_t idx;
+  int64_t errors = 0;
+  int samplesize;
+
+  if ( ! (fp = fopen (work->filename, "rb")) ||
+       ! (recbuf = (char *) malloc (MAXRECLEN)) )
+    {
+      ms_log (2, "Cannot open %s for decoding\n", work->filename);
+
+      if ( fp )
+	fclose (fp);
+
+      return NULL;
+    }
+
+  for (;;)
+    {
+#if defined(MEX_THREADS)
+      pthread_mutex_lock (&work->lock);
+#endif
+      first = work->nextrecord;
+      work->nextrecord += RECORD_BATCH;
+#if defined(MEX_THREADS)
+      pthread_mutex_unlock (&work->lock);
+#endif
+
+      if ( first >= work->recordcount )
+	break;
+
+      for (idx = first; idx < first + RECORD_BATCH && idx < work->recordcount; idx++)
+	{
+	  record = &work->records[idx];
+
+	  if ( record->trace < 0 || record->samplecnt <= 0 )
+	    continue;
+
+	  trace = work->traces[record->trace];
+	  samplesize = ms_samplesize (trace->sampletype);
+
+	  if ( lmp_fseeko (fp, record->offset, SEEK_SET) ||
+	       fread (recbuf, record->reclen, 1, fp) != 1 ||
+	       msr_unpack_buffer (recbuf, record->reclen, &msr,
+				  trace->data + record->position * samplesize,
+				  (size_t) (record->samplecnt * samplesize),
+				  work->verbose) != MS_NOERROR )
+	    {
+	      errors++;
+	      continue;
+	    }
+
+#if defined(MEX_THREADS)
+	  pthread_mutex_lock (&work->lock);
+#endif
+	  trace->decoded += msr->numsamples;
+#if defined(MEX_THREADS)
+	  pthread_mutex_unlock (&work->lock);
+#endif
+	}
+    }
+
+#if defined(MEX_THREADS)
+  pthread_mutex_lock (&work->lock);
+#endif
+  work->errors += errors;
+#if defined(MEX_THREADS)
+  pthread_mutex_unlock (&work->lock);
+#endif
+
+  msr_free (&msr);
+  free (recbuf);
+  fclose (fp);
+
+  return NULL;
+}  /* End of decoderecords() */
+
+
+/***************************************************************************
+ * logmessage:
+ * Collect a log message for printing after decoding.
+ ***************************************************************************/
+static void
+logmessage (char *message)
+{
+  size_t length = strlen (message);
+  char *newbuffer;
+
+#if defined(MEX_THREADS)
+  pthread_mutex_lock (&loglock);
+#endif
+
+  if ( loglength + length + 1 > logsize )
+    {
+      size_t newsize = (logsize) ? logsize * 2 : 4096;
+
+      while ( newsize < loglength + length + 1 )
+	newsize *= 2;
+
+      if ( (newbuffer = (char *) realloc (logbuffer, newsize)) )
+	{
+	  logbuffer = newbuffer;
+	  logsize = newsize;
+	}
+    }
+
+  if ( loglength + length + 1 <= logsize )
+    {
+      memcpy (logbuffer + loglength, message, length + 1);
+      loglength += length;
+    }
+
+#if defined(MEX_THREADS)
+  pthread_mutex_unlock (&loglock);
+#endif
+}  /* End of logmessage() */
+
+
+/***************************************************************************
+ * logflush:
+ * Print and release collected log messages.
+ ***************************************************************************/
+static void
+logflush (void)
+{
+  if ( loglength )
+    mexPrintf ("%s", logbuffer);
+
+  free (logbuffer);
+  logbuffer = NULL;
+  loglength = 0;
+  logsize = 0;
+}  /* End of logflush() */
@@ -7,7 +7,7 @@
  *   ORFEUS/EC-Project MEREDIAN
  *   IRIS Data Management Center
  *
- * modified: 2016.286
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <stdio.h>
@@ -16,6 +16,27 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "packdata.h"
+
+/* Thread-local storage for the sample rate factor cache */
+#if defined(LMP_WIN)
+  #define LMP_TLS __declspec(thread)
+#else
+  #define LMP_TLS __thread
+#endif
+
+/* Sample rate factor and multiplier generated for the last sample rate
+ * normalized by a thread, state is 1 if valid, -1 if the rate cannot be
+ * represented and 0 if nothing is cached */
+struct factmultcache
+{
+  double samprate;
+  int16_t factor;
+  int16_t multiplier;
+  flag state;
+};
+
+static LMP_TLS struct factmultcache lastfactmult = {0.0, 0, 0, 0};
 
 /***************************************************************************
  * msr_init:
@@ -23,7 +44,8 @@
  * Initialize and return an MSRecord struct, allocating memory if
  * needed.  If memory for the fsdh and datasamples fields has been
  * allocated the pointers will be retained for reuse.  If a blockette
- * chain is present all associated memory will be released.
+ * chain is present all associated memory will be released.  A record
+ * allocated from an arena remains owned by the arena.
  *
  * Returns a pointer to a MSRecord struct on success or NULL on error.
  ***************************************************************************/
@@ -68,6 +90,36 @@ msr_init (MSRecord *msr)
   return msr;
 } /* End of msr_init() */
 
+/***************************************************************************
+ * msr_init_arena:
+ *
+ * Allocate and initialize an MSRecord struct from an arena.  The fixed
+ * section data header and blockettes subsequently added to the record
+ * are also allocated from the arena, data samples and stream state are
+ * always allocated on the heap.  The memory allocated from the arena
+ * is released in bulk when the arena is reset or freed, msr_free()
+ * only releases the heap allocated parts.  The owner of memory is
+ * determined from its address, see ms_arena_owner().  If the arena is NULL this
+ * is equivalent to msr_init(NULL).
+ *
+ * Returns a pointer to a MSRecord struct on success or NULL on error.
+ ***************************************************************************/
+MSRecord *
+msr_init_arena (MSArena *arena)
+{
+  MSRecord *msr;
+
+  if (!(msr = (MSRecord *)ms_arena_alloc (arena, sizeof (MSRecord))))
+  {
+    ms_log (2, "msr_init_arena(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  memset (msr, 0, sizeof (MSRecord));
+
+  return msr_init (msr);
+} /* End of msr_init_arena() */
+
 /***************************************************************************
  * msr_free:
  *
@@ -80,7 +132,7 @@ msr_free (MSRecord **ppmsr)
   {
     /* Free fixed section header if populated */
     if ((*ppmsr)->fsdh)
-      free ((*ppmsr)->fsdh);
+      ms_arena_release ((*ppmsr)->fsdh);
 
     /* Free blockette chain if populated */
     if ((*ppmsr)->blkts)
@@ -94,7 +146,7 @@ msr_free (MSRecord **ppmsr)
     if ((*ppmsr)->ststate)
       free ((*ppmsr)->ststate);
 
-    free (*ppmsr);
+    ms_arena_release (*ppmsr);
 
     *ppmsr = NULL;
   }
@@ -122,9 +174,9 @@ msr_free_blktchain (MSRecord *msr)
         nb = bc->next;
 
         if (bc->blktdata)
-          free (bc->blktdata);
+          ms_arena_release (bc->blktdata);
 
-        free (bc);
+        ms_arena_release (bc);
 
         bc = nb;
       }
@@ -147,7 +199,8 @@ msr_free_blktchain (MSRecord *msr)
  * 'chainpos' value controls which end of the chain the blockette is
  * added to.  If 'chainpos' is 0 the blockette will be added to the
  * end of the chain (last blockette), other wise it will be added to
- * the beginning of the chain (first blockette).
+ * the beginning of the chain (first blockette).  The blockette is
+ * allocated from the arena of a record allocated from an arena.
  *
  * Returns a pointer to the BlktLink added to the chain on success and
  * NULL on error.
@@ -157,17 +210,20 @@ msr_addblockette (MSRecord *msr, char *blktdata, int length, int blkttype,
                   int chainpos)
 {
   BlktLink *blkt;
+  MSArena *arena;
 
   if (!msr)
     return NULL;
 
+  arena = ms_arena_owner (msr);
+
   blkt = msr->blkts;
 
   if (blkt)
   {
     if (chainpos != 0)
     {
-      blkt = (BlktLink *)malloc (sizeof (BlktLink));
+      blkt = (BlktLink *)ms_arena_alloc (arena, sizeof (BlktLink));
 
       blkt->next = msr->blkts;
       msr->blkts = blkt;
@@ -180,7 +236,7 @@ msr_addblockette (MSRecord *msr, char *blktdata, int length, int blkttype,
         blkt = blkt->next;
       }
 
-      blkt->next = (BlktLink *)malloc (sizeof (BlktLink));
+      blkt->next = (BlktLink *)ms_arena_alloc (arena, sizeof (BlktLink));
 
       blkt       = blkt->next;
       blkt->next = 0;
@@ -194,7 +250,7 @@ msr_addblockette (MSRecord *msr, char *blktdata, int length, int blkttype,
   }
   else
   {
-    msr->blkts = (BlktLink *)malloc (sizeof (BlktLink));
+    msr->blkts = (BlktLink *)ms_arena_alloc (arena, sizeof (BlktLink));
 
     if (msr->blkts == NULL)
     {
@@ -210,7 +266,7 @@ msr_addblockette (MSRecord *msr, char *blktdata, int length, int blkttype,
   blkt->blkt_type  = blkttype;
   blkt->next_blkt  = 0;
 
-  blkt->blktdata = (char *)malloc (length);
+  blkt->blktdata = (char *)ms_arena_alloc (arena, length);
 
   if (blkt->blktdata == NULL)
   {
@@ -287,10 +343,25 @@ msr_normalize_header (MSRecord *msr, flag verbose)
     ms_strncpopen (msr->fsdh->channel, msr->channel, 3);
     ms_hptime2btime (hptimems, &(msr->fsdh->start_time));
 
-    /* Determine the factor and multipler for sample rate */
-    if (ms_genfactmult (msr->samprate,
-                        &(msr->fsdh->samprate_fact),
-                        &(msr->fsdh->samprate_mult)))
+    /* Determine the factor and multipler for sample rate, the values
+     * for the last rate are cached to avoid a rational approximation
+     * for every header packed at the same rate */
+    if (!lastfactmult.state || lastfactmult.samprate != msr->samprate)
+    {
+      lastfactmult.samprate = msr->samprate;
+      lastfactmult.state    = (ms_genfactmult (msr->samprate,
+                                               &lastfactmult.factor,
+                                               &lastfactmult.multiplier))
+                               ? -1
+                               : 1;
+    }
+
+    if (lastfactmult.state > 0)
+    {
+      msr->fsdh->samprate_fact = lastfactmult.factor;
+      msr->fsdh->samprate_mult = lastfactmult.multiplier;
+    }
+    else
     {
       if (verbose > 1)
         ms_log (1, "Sampling rate out of range, cannot generate factor & multiplier: %g\n",
@@ -577,8 +648,7 @@ msr_starttime_uc (MSRecord *msr)
 hptime_t
 msr_endtime (MSRecord *msr)
 {
-  hptime_t span      = 0;
-  LeapSecond *lslist = leapsecondlist;
+  hptime_t span = 0;
 
   if (!msr)
     return HPTERROR;
@@ -587,19 +657,10 @@ msr_endtime (MSRecord *msr)
     span = (hptime_t) (((double)(msr->samplecnt - 1) / msr->samprate * HPTMODULUS) + 0.5);
 
   /* Check if the record contains a leap second, if list is available */
-  if (lslist)
+  if (leapsecondlist)
   {
-    while (lslist)
-    {
-      if (lslist->leapsecond > msr->starttime &&
-          lslist->leapsecond < (msr->starttime + span))
-      {
-        span -= HPTMODULUS;
-        break;
-      }
-
-      lslist = lslist->next;
-    }
+    if (ms_leapsecondinspan (msr->starttime, msr->starttime + span) > 0)
+      span -= HPTMODULUS;
   }
   else
   {
@@ -7,9 +7,10 @@
  * Written by Chad Trabant,
  *   IRIS Data Management Center
  *
- * modified: 2015.273
+ * modified: 2026.291
  ***************************************************************************/
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,7 +19,27 @@
 #include "libmseed.h"
 #include "packdata.h"
 
+/* Steim records of long traces are encoded in parallel when thread
+ * support is available, this can be disabled with -DLMP_NOTHREADS */
+#if !defined(LMP_WIN) && !defined(LMP_NOTHREADS)
+  #define LMP_THREADS 1
+  #include <pthread.h>
+#endif
+
+/* A run of records of the same length planned by msr_plan_records() */
+struct packrun
+{
+  int reclen;  /* Record length */
+  int records; /* Number of records */
+};
+
 /* Function(s) internal to this file */
+static int msr_pack_samples (MSRecord *msr, void (*record_handler) (char *, int, void *),
+                             void *handlerdata, int64_t *packedsamples, flag flush,
+                             int rawsamplesize, flag rawswapflag, int workers,
+                             int maxrecords, flag verbose);
+static int msr_plan_records (MSRecord *msr, const int *reclens, int reclencount,
+                             struct packrun **pruns, char *srcname, flag verbose);
 static int msr_pack_header_raw (MSRecord *msr, char *rawrec, int maxheaderlen,
                                 flag swapflag, flag normalize,
                                 struct blkt_1001_s **blkt1001,
@@ -28,14 +49,20 @@ static int msr_update_header (MSRecord *msr, char *rawrec, flag swapflag,
                               char *srcname, flag verbose);
 static int msr_pack_data (void *dest, void *src, int maxsamples, int maxdatabytes,
                           int32_t *lastintsample, flag comphistory,
-                          char sampletype, flag encoding, flag swapflag,
+                          char sampletype, int rawsamplesize, flag rawswapflag,
+                          flag encoding, flag swapflag,
                           char *srcname, flag verbose);
+static int check_environment (int verbose);
 
 /* Header and data byte order flags controlled by environment variables */
 /* -2 = not checked, -1 = checked but not set, or 0 = LE and 1 = BE */
 flag packheaderbyteorder = -2;
 flag packdatabyteorder   = -2;
 
+/* Encode debugging controlled by environment variable */
+/* -2 = not checked, 0 = not set or 1 = set */
+flag packencodedebug = -2;
+
 /***************************************************************************
  * msr_pack:
  *
@@ -70,13 +97,867 @@ flag packdatabyteorder   = -2;
 int
 msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
           void *handlerdata, int64_t *packedsamples, flag flush, flag verbose)
+{
+  return msr_pack_samples (msr, record_handler, handlerdata, packedsamples,
+                           flush, 0, 0, 1, 0, verbose);
+} /* End of msr_pack() */
+
+/***************************************************************************
+ * msr_pack_rawsamples:
+ *
+ * Pack data into SEED data records directly from raw 16 or 32-bit
+ * integer samples, avoiding conversion to an array of 32-bit host
+ * byte order integers before encoding.
+ *
+ * The MSRecord->datasamples array contains integers of rawsamplesize
+ * bytes (2 or 4), which are byte swapped before encoding if
+ * rawswapflag is set.  The MSRecord->sampletype must be 'i' and the
+ * encoding must be Steim1 or Steim2.  Otherwise the same as msr_pack(),
+ * including the update of the record start time and StreamState.
+ *
+ * Returns the number of records created on success and -1 on error.
+ ***************************************************************************/
+int
+msr_pack_rawsamples (MSRecord *msr, void (*record_handler) (char *, int, void *),
+                     void *handlerdata, int64_t *packedsamples, flag flush,
+                     int rawsamplesize, flag rawswapflag, flag verbose)
+{
+  if (!msr)
+    return -1;
+
+  if (rawsamplesize != 2 && rawsamplesize != 4)
+  {
+    ms_log (2, "msr_pack_rawsamples(): Unsupported raw sample size: %d\n", rawsamplesize);
+    return -1;
+  }
+
+  if (msr->encoding != -1 && msr->encoding != DE_STEIM1 && msr->encoding != DE_STEIM2)
+  {
+    ms_log (2, "msr_pack_rawsamples(): Raw samples can only be packed with Steim1 or Steim2, not %d\n",
+            msr->encoding);
+    return -1;
+  }
+
+  return msr_pack_samples (msr, record_handler, handlerdata, packedsamples,
+                           flush, rawsamplesize, rawswapflag, 1, 0, verbose);
+} /* End of msr_pack_rawsamples() */
+
+/***************************************************************************
+ * msr_pack_parallel:
+ *
+ * Pack data into SEED data records like msr_pack() using up to
+ * workers threads to encode Steim1/2 records of long traces.  The
+ * records are passed to record_handler in order and are identical to
+ * those packed by msr_pack(), including the updated StreamState.
+ *
+ * Each Steim record starts with the difference from the last sample
+ * of the previous record and holds a data dependent number of
+ * samples, the record boundaries are therefore determined before
+ * encoding.  Differences are packed into words independent of the
+ * record boundaries and each record holds a fixed number of words,
+ * except at the end of the samples.  For a window of the samples the
+ * number of samples in a word starting at each sample is determined
+ * concurrently, the words are then followed from the first sample of
+ * the window to find the first sample of each record.  The records
+ * are encoded concurrently, with the first difference of each from
+ * the preceding sample, and passed to record_handler by the calling
+ * thread.
+ * If workers <= 1, the encoding is not Steim1/2 of 32-bit integers,
+ * the trace is short or thread support is not available the records
+ * are packed by msr_pack().
+ *
+ * Returns the number of records created on success and -1 on error.
+ ***************************************************************************/
+int
+msr_pack_parallel (MSRecord *msr, void (*record_handler) (char *, int, void *),
+                   void *handlerdata, int64_t *packedsamples, flag flush,
+                   int workers, flag verbose)
+{
+  return msr_pack_samples (msr, record_handler, handlerdata, packedsamples,
+                           flush, 0, 0, workers, 0, verbose);
+} /* End of msr_pack_parallel() */
+
+/***************************************************************************
+ * msr_pack_reclens:
+ *
+ * Pack data into SEED data records like msr_pack_parallel() with the
+ * record lengths chosen from the reclencount lengths in reclens such
+ * that the total length of the records is minimal.
+ *
+ * Records are filled in order and only the last record is partially
+ * filled, so choosing record lengths is a matter of covering all of
+ * the samples with record capacities at the least cost.  The capacity
+ * of a Steim record is a fixed number of words and the words do not
+ * depend on where records start, see msr_steim_wordlengths(), so the
+ * number of words is determined in one pass over the samples.  For
+ * other encodings the capacity is a fixed number of samples.  The
+ * optimal lengths are then determined by dynamic programming over the
+ * last records, the records before these are of the length holding
+ * the most words or samples per byte.  Usually most records are of
+ * the length with the largest capacity followed by a few short
+ * records instead of a mostly empty one.
+ *
+ * Record lengths are only chosen when flush is set, otherwise, or if
+ * only one length is given, the records are packed with the first
+ * length in reclens.  MSRecord->reclen is set to the first length.
+ *
+ * Returns the number of records created on success and -1 on error.
+ ***************************************************************************/
+int
+msr_pack_reclens (MSRecord *msr, void (*record_handler) (char *, int, void *),
+                  void *handlerdata, int64_t *packedsamples, flag flush,
+                  const int *reclens, int reclencount, int workers, flag verbose)
+{
+  struct packrun *runs = NULL;
+  char srcname[50];
+  void *datasamples;
+  int64_t numsamples;
+  int64_t runsamples;
+  int64_t totalpackedsamples = 0;
+  hptime_t segstarttime;
+  int samplesize;
+  int recordcnt = 0;
+  int runcount;
+  int records;
+  int idx;
+
+  if (!msr)
+    return -1;
+
+  if (!reclens || reclencount < 1)
+  {
+    ms_log (2, "msr_pack_reclens(): No record lengths specified\n");
+    return -1;
+  }
+
+  msr->reclen = reclens[0];
+
+  if (reclencount == 1 || !flush || !record_handler || msr->numsamples <= 0)
+    return msr_pack_samples (msr, record_handler, handlerdata, packedsamples,
+                             flush, 0, 0, workers, 0, verbose);
+
+  if (msr_srcname (msr, srcname, 1) == NULL)
+  {
+    ms_log (2, "msr_pack_reclens(): Cannot generate srcname\n");
+    return -1;
+  }
+
+  if ((runcount = msr_plan_records (msr, reclens, reclencount, &runs, srcname, verbose)) < 0)
+    return -1;
+
+  /* Pack with the first length if records cannot be planned */
+  if (runcount == 0)
+    return msr_pack_samples (msr, record_handler, handlerdata, packedsamples,
+                             flush, 0, 0, workers, 0, verbose);
+
+  if (packedsamples)
+    *packedsamples = 0;
+
+  samplesize   = ms_samplesize (msr->sampletype);
+  datasamples  = msr->datasamples;
+  numsamples   = msr->numsamples;
+  segstarttime = msr->starttime;
+
+  /* Pack each run of records following the samples of the previous,
+   * any samples not covered by the plan are packed with the first length */
+  for (idx = 0; idx <= runcount && totalpackedsamples < numsamples; idx++)
+  {
+    msr->reclen      = (idx < runcount) ? runs[idx].reclen : reclens[0];
+    msr->datasamples = (char *)datasamples + totalpackedsamples * samplesize;
+    msr->numsamples  = numsamples - totalpackedsamples;
+
+    if (msr->samprate > 0)
+      msr->starttime = segstarttime + (hptime_t) (totalpackedsamples / msr->samprate * HPTMODULUS + 0.5);
+
+    runsamples = 0;
+    records    = msr_pack_samples (msr, record_handler, handlerdata, &runsamples, flush,
+                                   0, 0, workers, (idx < runcount) ? runs[idx].records : 0,
+                                   verbose);
+
+    if (records < 0)
+    {
+      recordcnt = -1;
+      break;
+    }
+
+    recordcnt += records;
+    totalpackedsamples += runsamples;
+    if (packedsamples)
+      *packedsamples = totalpackedsamples;
+  }
+
+  msr->reclen      = reclens[0];
+  msr->datasamples = datasamples;
+  msr->numsamples  = numsamples;
+
+  if (msr->samprate > 0)
+    msr->starttime = segstarttime + (hptime_t) (totalpackedsamples / msr->samprate * HPTMODULUS + 0.5);
+
+  free (runs);
+
+  return recordcnt;
+} /* End of msr_pack_reclens() */
+
+#if defined(LMP_THREADS)
+/* Number of samples in each chunk of word lengths determined by a worker */
+#define PACKCHUNK 262144
+
+/* Number of chunks in a window for each worker */
+#define PACKWINDOW 2
+
+/* Number of records claimed by a worker at a time */
+#define PACKBATCH 16
+
+/* Parameters for determining word lengths and encoding records of a
+ * window of samples on worker threads.  The worker threads are started
+ * once for a trace and wait for each phase of processing a window. */
+struct packwork
+{
+  int32_t *samples;       /* Samples of the trace */
+  int numsamples;         /* Number of samples */
+  int32_t diff0;          /* Difference of the first sample */
+  int32_t *lastintsample; /* Last sample of the StreamState */
+  flag encoding;
+  flag swapflag;
+  int maxdatabytes;       /* Length of encoded data of each record */
+  int recordwords;        /* Number of words in each full record */
+  char *srcname;
+  flag encode;            /* Encode records instead of word lengths */
+  int windowstart;        /* First sample of the window */
+  int windowend;          /* Sample following the window */
+  int windowsize;         /* Maximum number of samples in a window */
+  uint8_t *lengths;       /* Number of samples in a word starting at each sample */
+  int position;           /* First sample of the next word */
+  int recordword;         /* Index of the next word in its record */
+  int *starts;            /* First sample of each record of the window */
+  int *counts;            /* Number of samples in each record, -1 on error */
+  char *records;          /* Encoded data of each record */
+  int recordcount;        /* Number of records starting in the window */
+  int recordmax;          /* Allocated number of records */
+  int record;             /* Index of the next record to emit */
+  int units;              /* Number of chunks or records to process, records
+                           * completed in the window when emitting */
+  int next;               /* Next chunk or record to process */
+  int failed;             /* Processing of a chunk failed */
+  int workers;
+  pthread_t *threads;
+  int started;            /* Number of worker threads started */
+  int phase;              /* Count of phases started */
+  int active;             /* Number of worker threads processing the phase */
+  flag stop;              /* Worker threads should exit */
+  pthread_mutex_t lock;
+  pthread_cond_t start;   /* Signals a new phase or stop to worker threads */
+  pthread_cond_t done;    /* Signals the end of the phase on a worker thread */
+};
+
+/*********************************************************************
+ * msr_pack_worker:
+ *
+ * Worker thread routine to determine the word lengths of chunks of
+ * the window, or to encode records of the window.  Chunks or batches
+ * of records are claimed until all are processed.
+ *********************************************************************/
+static void *
+msr_pack_worker (void *arg)
+{
+  struct packwork *work = (struct packwork *)arg;
+  int32_t *output;
+  int32_t diff;
+  int start;
+  int end;
+  int idx;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&work->lock);
+    idx = work->next;
+    work->next += (work->encode) ? PACKBATCH : 1;
+    pthread_mutex_unlock (&work->lock);
+
+    if (idx >= work->units)
+      break;
+
+    if (!work->encode)
+    {
+      start = work->windowstart + idx * PACKCHUNK;
+      end   = (start + PACKCHUNK < work->windowend) ? start + PACKCHUNK : work->windowend;
+
+      if (msr_steim_wordlengths (work->samples, work->numsamples, work->diff0,
+                                 work->encoding, start, end,
+                                 work->lengths + (start - work->windowstart)))
+      {
+        pthread_mutex_lock (&work->lock);
+        work->failed = 1;
+        pthread_mutex_unlock (&work->lock);
+      }
+
+      continue;
+    }
+
+    end = (idx + PACKBATCH < work->units) ? idx + PACKBATCH : work->units;
+
+    for (; idx < end; idx++)
+    {
+      start  = work->starts[idx];
+      output = (int32_t *)(work->records + (size_t)idx * work->maxdatabytes);
+      diff   = (start == 0) ? work->diff0 : work->samples[start] - work->samples[start - 1];
+
+      if (work->encoding == DE_STEIM1)
+        work->counts[idx] = msr_encode_steim1 (work->samples + start, work->numsamples - start,
+                                               output, work->maxdatabytes, diff,
+                                               work->swapflag);
+      else
+        work->counts[idx] = msr_encode_steim2 (work->samples + start, work->numsamples - start,
+                                               output, work->maxdatabytes, diff,
+                                               work->srcname, work->swapflag);
+    }
+  }
+
+  return NULL;
+} /* End of msr_pack_worker() */
+
+/*********************************************************************
+ * msr_pack_thread:
+ *
+ * Worker thread routine waiting for each phase of processing and
+ * running msr_pack_worker() for it until stopped.
+ *********************************************************************/
+static void *
+msr_pack_thread (void *arg)
+{
+  struct packwork *work = (struct packwork *)arg;
+  int phase = 0;
+
+  pthread_mutex_lock (&work->lock);
+
+  for (;;)
+  {
+    while (work->phase == phase && !work->stop)
+      pthread_cond_wait (&work->start, &work->lock);
+
+    if (work->stop)
+      break;
+
+    phase = work->phase;
+    pthread_mutex_unlock (&work->lock);
+
+    msr_pack_worker (work);
+
+    pthread_mutex_lock (&work->lock);
+    if (--work->active == 0)
+      pthread_cond_signal (&work->done);
+  }
+
+  pthread_mutex_unlock (&work->lock);
+
+  return NULL;
+} /* End of msr_pack_thread() */
+
+/*********************************************************************
+ * msr_pack_run:
+ *
+ * Process the chunks or records of the window on the worker threads
+ * and the calling thread.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+msr_pack_run (struct packwork *work)
+{
+  pthread_mutex_lock (&work->lock);
+  work->next   = 0;
+  work->active = work->started;
+  work->phase++;
+  pthread_cond_broadcast (&work->start);
+  pthread_mutex_unlock (&work->lock);
+
+  msr_pack_worker (work);
+
+  pthread_mutex_lock (&work->lock);
+  while (work->active > 0)
+    pthread_cond_wait (&work->done, &work->lock);
+  pthread_mutex_unlock (&work->lock);
+
+  return (work->failed) ? -1 : 0;
+} /* End of msr_pack_run() */
+
+/*********************************************************************
+ * msr_pack_window:
+ *
+ * Encode the records starting in the next window of samples.  The
+ * word lengths of the window are determined on worker threads, the
+ * words are followed from the first word of the window to find the
+ * first sample of each record, and the records are encoded on worker
+ * threads.  A record continuing beyond the window is encoded with the
+ * next window.  Following the words stops at a word that cannot be
+ * encoded, the record including it is left to be packed serially.
+ *
+ * Returns 0 on success and -1 if no further records can be encoded.
+ *********************************************************************/
+static int
+msr_pack_window (struct packwork *work)
+{
+  uint8_t length = 1;
+
+  if (work->windowend >= work->numsamples || work->failed)
+    return -1;
+
+  /* Retain a record continuing from the previous window */
+  if (work->recordcount > work->units)
+    work->starts[0] = work->starts[work->units];
+
+  work->recordcount = work->recordcount - work->units;
+
+  work->windowstart = work->windowend;
+  work->windowend   = (work->numsamples - work->windowstart > work->windowsize) ?
+                      work->windowstart + work->windowsize : work->numsamples;
+
+  /* Determine word lengths of the window */
+  work->encode = 0;
+  work->units  = (work->windowend - work->windowstart + PACKCHUNK - 1) / PACKCHUNK;
+
+  if (msr_pack_run (work))
+    return -1;
+
+  /* Follow the words to find the records starting in the window */
+  while (work->position < work->windowend &&
+         (length = work->lengths[work->position - work->windowstart]) > 0)
+  {
+    if (work->recordword == 0)
+    {
+      if (work->recordcount == work->recordmax)
+      {
+        work->recordmax = (work->recordmax) ? work->recordmax * 2 : 1024;
+
+        if (!(work->starts = (int *)realloc (work->starts, sizeof (int) * work->recordmax)) ||
+            !(work->counts = (int *)realloc (work->counts, sizeof (int) * work->recordmax)) ||
+            !(work->records = (char *)realloc (work->records, (size_t)work->maxdatabytes * work->recordmax)))
+        {
+          work->failed = 1;
+          return -1;
+        }
+      }
+
+      work->starts[work->recordcount++] = work->position;
+    }
+
+    work->position += length;
+    work->recordword = (work->recordword + 1 < work->recordwords) ? work->recordword + 1 : 0;
+  }
+
+  /* Encode the records completed in the window */
+  work->encode = 1;
+  work->units  = work->recordcount;
+  work->record = 0;
+
+  if (work->recordword != 0 && (length == 0 || work->windowend < work->numsamples))
+    work->units--;
+
+  /* No further windows after a word that cannot be encoded */
+  if (length == 0)
+    work->windowend = work->numsamples;
+
+  return msr_pack_run (work);
+} /* End of msr_pack_window() */
+
+/*********************************************************************
+ * msr_pack_release:
+ *
+ * Stop the worker threads and free all parallel packing state.
+ *********************************************************************/
+static void
+msr_pack_release (struct packwork **ppwork)
+{
+  struct packwork *work = *ppwork;
+  int tidx;
+
+  if (!work)
+    return;
+
+  pthread_mutex_lock (&work->lock);
+  work->stop = 1;
+  pthread_cond_broadcast (&work->start);
+  pthread_mutex_unlock (&work->lock);
+
+  for (tidx = 0; tidx < work->started; tidx++)
+    pthread_join (work->threads[tidx], NULL);
+
+  pthread_cond_destroy (&work->start);
+  pthread_cond_destroy (&work->done);
+  pthread_mutex_destroy (&work->lock);
+  free (work->lengths);
+  free (work->starts);
+  free (work->counts);
+  free (work->records);
+  free (work->threads);
+  free (work);
+
+  *ppwork = NULL;
+} /* End of msr_pack_release() */
+
+/*********************************************************************
+ * msr_pack_plan:
+ *
+ * Initialize the state for encoding the records of a trace in
+ * parallel and start workers - 1 worker threads.
+ *
+ * Returns the parallel packing state on success and NULL on error.
+ *********************************************************************/
+static struct packwork *
+msr_pack_plan (MSRecord *msr, int maxdatabytes, flag swapflag, int workers,
+               char *srcname, flag verbose)
+{
+  struct packwork *work;
+
+  if (!(work = (struct packwork *)calloc (1, sizeof (struct packwork))))
+    return NULL;
+
+  pthread_mutex_init (&work->lock, NULL);
+  pthread_cond_init (&work->start, NULL);
+  pthread_cond_init (&work->done, NULL);
+
+  work->samples       = (int32_t *)msr->datasamples;
+  work->numsamples    = (int)msr->numsamples;
+  work->lastintsample = &msr->ststate->lastintsample;
+  work->encoding      = msr->encoding;
+  work->swapflag      = swapflag;
+  work->maxdatabytes  = maxdatabytes;
+  work->recordwords   = (maxdatabytes / 64) * 15 - 2;
+  work->srcname       = srcname;
+  work->workers       = workers;
+  work->windowsize    = workers * PACKWINDOW * PACKCHUNK;
+
+  /* Cold-start without compression history, as msr_pack_data() */
+  work->diff0 = (msr->ststate->comphistory) ? work->samples[0] - msr->ststate->lastintsample : 0;
+
+  if (!(work->lengths = (uint8_t *)malloc (work->windowsize)) ||
+      !(work->threads = (pthread_t *)calloc (workers, sizeof (pthread_t))))
+  {
+    msr_pack_release (&work);
+    return NULL;
+  }
+
+  for (work->started = 0; work->started < workers - 1; work->started++)
+    if (pthread_create (&work->threads[work->started], NULL, msr_pack_thread, work))
+      break;
+
+  if (verbose > 1)
+    ms_log (1, "%s: Encoding Steim%d data frames with %d workers\n",
+            srcname, (work->encoding == DE_STEIM1) ? 1 : 2, work->started + 1);
+
+  return work;
+} /* End of msr_pack_plan() */
+
+/*********************************************************************
+ * msr_pack_next:
+ *
+ * Copy the encoded data of the next record to dest, encoding the next
+ * window when needed, and update the last sample of the StreamState.
+ * The record must start at the specified sample.
+ *
+ * Returns the number of samples in the record on success and -1 if
+ * the record is not available, in which case the remaining records
+ * should be packed serially.
+ *********************************************************************/
+static int
+msr_pack_next (struct packwork *work, char *dest, int64_t position)
+{
+  int start;
+  int count;
+
+  while (work->record >= work->units)
+  {
+    if (msr_pack_window (work))
+      return -1;
+  }
+
+  start = work->starts[work->record];
+  count = work->counts[work->record];
+
+  if (start != position || count <= 0)
+    return -1;
+
+  memcpy (dest, work->records + (size_t)work->record * work->maxdatabytes,
+          work->maxdatabytes);
+
+  *work->lastintsample = work->samples[start + count - 1];
+
+  work->record++;
+
+  return count;
+} /* End of msr_pack_next() */
+#endif
+
+/* Number of samples of which word lengths are determined at a time
+ * when planning records */
+#define PLANWINDOW 1048576
+
+/* Maximum number of words or samples of the last records planned by
+ * dynamic programming */
+#define PLANMAXUNITS 4194304
+
+/***************************************************************************
+ * msr_plan_records:
+ *
+ * Plan the lengths of the records packing all samples of an MSRecord
+ * with the least total length, see msr_pack_reclens().  The plan is
+ * returned in *pruns as runs of records of the same length in packing
+ * order, the array must be freed by the caller.
+ *
+ * The capacity of a record of each length is U words (Steim) or
+ * samples, and C(k) is the least total length of records covering k
+ * words or samples: C(k) = min (reclen + C(k - U)), C(k <= 0) = 0.
+ * Replacing a set of records with a total capacity divisible by the
+ * capacity of the most efficient length with records of that length
+ * does not increase the cost, so an optimal plan has fewer than
+ * U(efficient) other records.  C() is therefore only determined for
+ * the last U(efficient) * (U(largest) + 1) words or samples, limited
+ * to PLANMAXUNITS, preceded by records of the efficient length.
+ *
+ * Returns the number of runs on success, 0 if records cannot be
+ * planned, e.g. if a difference cannot be represented in Steim2, and
+ * -1 on error.
+ ***************************************************************************/
+static int
+msr_plan_records (MSRecord *msr, const int *reclens, int reclencount,
+                  struct packrun **pruns, char *srcname, flag verbose)
+{
+  struct blkt_link_s *cur_blkt;
+  struct packrun *runs = NULL;
+  int64_t *costs       = NULL;
+  uint8_t *choices     = NULL;
+  uint8_t *lengths     = NULL;
+  int64_t units[256];
+  int64_t totalunits = 0;
+  int64_t bound;
+  int64_t tail;
+  int64_t cost;
+  int64_t efficientrecords = 0;
+  int64_t position;
+  int64_t windowend;
+  int32_t *samples;
+  int32_t diff0 = 0;
+  flag encoding;
+  int samplesize;
+  int headerlen;
+  int dataoffset;
+  int efficient = 0;
+  int largest   = 0;
+  int runcount  = 0;
+  int windowstart;
+  int idx;
+  int64_t kdx;
+
+  *pruns = NULL;
+
+  if (reclencount > 256)
+  {
+    ms_log (2, "msr_pack_reclens(%s): Too many record lengths: %d\n", srcname, reclencount);
+    return -1;
+  }
+
+  encoding   = (msr->encoding == -1) ? DE_STEIM2 : msr->encoding;
+  samplesize = ms_samplesize (msr->sampletype);
+
+  if (!samplesize || msr->numsamples > INT_MAX)
+    return 0;
+
+  /* Length of the header as packed by msr_pack_header_raw(), including
+   * a 1000 Blockette added if not present */
+  headerlen = 48;
+  for (cur_blkt = msr->blkts; cur_blkt; cur_blkt = cur_blkt->next)
+    headerlen += 4 + cur_blkt->blktdatalen;
+  if (!msr->Blkt1000)
+    headerlen += 4 + sizeof (struct blkt_1000_s);
+
+  if (encoding == DE_STEIM1 || encoding == DE_STEIM2)
+  {
+    if (msr->sampletype != 'i')
+      return 0;
+
+    dataoffset = 64;
+    while (dataoffset < headerlen)
+      dataoffset += 64;
+  }
+  else
+  {
+    dataoffset = headerlen;
+  }
+
+  /* Capacity of each record length, the most efficient and largest */
+  for (idx = 0; idx < reclencount; idx++)
+  {
+    if (reclens[idx] < MINRECLEN || reclens[idx] > MAXRECLEN)
+    {
+      ms_log (2, "msr_pack_reclens(%s): Record length is out of range: %d\n",
+              srcname, reclens[idx]);
+      return -1;
+    }
+
+    if (encoding == DE_STEIM1 || encoding == DE_STEIM2)
+      units[idx] = ((reclens[idx] - dataoffset) / 64) * 15 - 2;
+    else
+      units[idx] = (reclens[idx] - dataoffset) / samplesize;
+
+    if (units[idx] <= 0)
+    {
+      ms_log (2, "msr_pack_reclens(%s): Record length %d is too small for the header\n",
+              srcname, reclens[idx]);
+      return -1;
+    }
+
+    if ((int64_t)reclens[idx] * units[efficient] < (int64_t)reclens[efficient] * units[idx] ||
+        ((int64_t)reclens[idx] * units[efficient] == (int64_t)reclens[efficient] * units[idx] &&
+         units[idx] > units[efficient]))
+      efficient = idx;
+
+    if (units[idx] > units[largest])
+      largest = idx;
+  }
+
+  /* Count the Steim words by following the word lengths */
+  if (encoding == DE_STEIM1 || encoding == DE_STEIM2)
+  {
+    if (!(lengths = (uint8_t *)malloc (PLANWINDOW)))
+    {
+      ms_log (2, "msr_pack_reclens(%s): Cannot allocate memory\n", srcname);
+      return -1;
+    }
+
+    samples = (int32_t *)msr->datasamples;
+
+    if (msr->ststate && msr->ststate->comphistory)
+      diff0 = samples[0] - msr->ststate->lastintsample;
+
+    position = 0;
+    while (position < msr->numsamples)
+    {
+      windowstart = (int)position;
+      windowend   = (position + PLANWINDOW < msr->numsamples) ? position + PLANWINDOW : msr->numsamples;
+
+      msr_steim_wordlengths (samples, (int)msr->numsamples, diff0, encoding,
+                             windowstart, (int)windowend, lengths);
+
+      while (position < windowend)
+      {
+        if (lengths[position - windowstart] == 0)
+        {
+          free (lengths);
+          return 0;
+        }
+
+        position += lengths[position - windowstart];
+        totalunits++;
+      }
+    }
+
+    free (lengths);
+  }
+  else
+  {
+    totalunits = msr->numsamples;
+  }
+
+  /* Number of words or samples of the last records */
+  bound = units[efficient] * (units[largest] + 1);
+  if (bound > PLANMAXUNITS)
+    bound = PLANMAXUNITS;
+
+  tail = totalunits;
+  if (tail > bound)
+  {
+    efficientrecords = (tail - bound + units[efficient] - 1) / units[efficient];
+    tail -= efficientrecords * units[efficient];
+  }
+
+  if (!(costs = (int64_t *)malloc ((size_t) (tail + 1) * sizeof (int64_t))) ||
+      !(choices = (uint8_t *)malloc ((size_t) (tail + 1))) ||
+      !(runs = (struct packrun *)malloc ((size_t) (tail + 1) * sizeof (struct packrun))))
+  {
+    ms_log (2, "msr_pack_reclens(%s): Cannot allocate memory\n", srcname);
+    free (costs);
+    free (choices);
+    return -1;
+  }
+
+  /* Least total length covering each number of words or samples, the
+   * choice is the length of the first record */
+  costs[0] = 0;
+  for (kdx = 1; kdx <= tail; kdx++)
+  {
+    costs[kdx] = -1;
+
+    for (idx = 0; idx < reclencount; idx++)
+    {
+      cost = reclens[idx] + ((kdx > units[idx]) ? costs[kdx - units[idx]] : 0);
+
+      if (costs[kdx] < 0 || cost < costs[kdx])
+      {
+        costs[kdx]   = cost;
+        choices[kdx] = (uint8_t)idx;
+      }
+    }
+  }
+
+  /* Runs of records of the efficient length and of the choices */
+  if (efficientrecords > 0)
+  {
+    runs[0].reclen  = reclens[efficient];
+    runs[0].records = (int)efficientrecords;
+    runcount        = 1;
+  }
+
+  for (kdx = tail; kdx > 0; kdx -= units[choices[kdx]])
+  {
+    if (runcount > 0 && runs[runcount - 1].reclen == reclens[choices[kdx]])
+    {
+      runs[runcount - 1].records++;
+    }
+    else
+    {
+      runs[runcount].reclen  = reclens[choices[kdx]];
+      runs[runcount].records = 1;
+      runcount++;
+    }
+  }
+
+  if (verbose > 1)
+  {
+    for (idx = 0; idx < runcount; idx++)
+      ms_log (1, "%s: Planned %d records of %d bytes\n", srcname,
+              runs[idx].records, runs[idx].reclen);
+  }
+
+  free (costs);
+  free (choices);
+
+  *pruns = runs;
+
+  return runcount;
+} /* End of msr_plan_records() */
+
+/***************************************************************************
+ * msr_pack_samples:
+ *
+ * Pack data into SEED data records, see msr_pack() for details.  If
+ * rawsamplesize is not 0 the data samples are raw integers of that
+ * size, see msr_pack_rawsamples().  If workers > 1 Steim records of
+ * long traces are encoded in parallel, see msr_pack_parallel().  If
+ * maxrecords > 0 no more than that number of records are packed.
+ *
+ * Returns the number of records created on success and -1 on error.
+ ***************************************************************************/
+static int
+msr_pack_samples (MSRecord *msr, void (*record_handler) (char *, int, void *),
+                  void *handlerdata, int64_t *packedsamples, flag flush,
+                  int rawsamplesize, flag rawswapflag, int workers,
+                  int maxrecords, flag verbose)
 {
   uint16_t *HPnumsamples;
   uint16_t *HPdataoffset;
   struct blkt_1001_s *HPblkt1001 = NULL;
 
   char *rawrec;
-  char *envvariable;
   char srcname[50];
 
   flag headerswapflag = 0;
@@ -92,6 +973,10 @@ msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
   int64_t totalpackedsamples;
   hptime_t segstarttime;
 
+#if defined(LMP_THREADS)
+  struct packwork *work = NULL;
+#endif
+
   if (!msr)
     return -1;
 
@@ -123,61 +1008,12 @@ msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
   /* Track original segment start time for new start time calculation */
   segstarttime = msr->starttime;
 
-  /* Read possible environmental variables that force byteorder */
-  if (packheaderbyteorder == -2)
-  {
-    if ((envvariable = getenv ("PACK_HEADER_BYTEORDER")))
-    {
-      if (*envvariable != '0' && *envvariable != '1')
-      {
-        ms_log (2, "Environment variable PACK_HEADER_BYTEORDER must be set to '0' or '1'\n");
-        return -1;
-      }
-      else if (*envvariable == '0')
-      {
-        packheaderbyteorder = 0;
-        if (verbose > 2)
-          ms_log (1, "PACK_HEADER_BYTEORDER=0, packing little-endian header\n");
-      }
-      else
-      {
-        packheaderbyteorder = 1;
-        if (verbose > 2)
-          ms_log (1, "PACK_HEADER_BYTEORDER=1, packing big-endian header\n");
-      }
-    }
-    else
-    {
-      packheaderbyteorder = -1;
-    }
-  }
-  if (packdatabyteorder == -2)
-  {
-    if ((envvariable = getenv ("PACK_DATA_BYTEORDER")))
-    {
-      if (*envvariable != '0' && *envvariable != '1')
-      {
-        ms_log (2, "Environment variable PACK_DATA_BYTEORDER must be set to '0' or '1'\n");
-        return -1;
-      }
-      else if (*envvariable == '0')
-      {
-        packdatabyteorder = 0;
-        if (verbose > 2)
-          ms_log (1, "PACK_DATA_BYTEORDER=0, packing little-endian data samples\n");
-      }
-      else
-      {
-        packdatabyteorder = 1;
-        if (verbose > 2)
-          ms_log (1, "PACK_DATA_BYTEORDER=1, packing big-endian data samples\n");
-      }
-    }
-    else
-    {
-      packdatabyteorder = -1;
-    }
-  }
+  /* Check environment variables if necessary */
+  if (packheaderbyteorder == -2 ||
+      packdatabyteorder == -2 ||
+      packencodedebug == -2)
+    if (check_environment (verbose))
+      return -1;
 
   /* Set default indicator, record length, byte order and encoding if needed */
   if (msr->dataquality == 0)
@@ -206,7 +1042,7 @@ msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
     return -1;
   }
 
-  samplesize = ms_samplesize (msr->sampletype);
+  samplesize = (rawsamplesize) ? rawsamplesize : ms_samplesize (msr->sampletype);
 
   if (!samplesize)
   {
@@ -334,18 +1170,39 @@ msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
   if (packedsamples)
     *packedsamples = 0;
 
+#if defined(LMP_THREADS)
+  /* Encode Steim records of long traces on worker threads */
+  if (workers > 1 && !rawsamplesize && msr->sampletype == 'i' &&
+      (msr->encoding == DE_STEIM1 || msr->encoding == DE_STEIM2) &&
+      msr->numsamples >= 2 * PACKCHUNK && msr->numsamples <= INT_MAX &&
+      (msr->numsamples > maxsamples || flush) && !encodedebug)
+    work = msr_pack_plan (msr, maxdatabytes, dataswapflag, workers, srcname, verbose);
+#endif
+
   while ((msr->numsamples - totalpackedsamples) > maxsamples || flush)
   {
-    packsamples = msr_pack_data (rawrec + dataoffset,
-                                 (char *)msr->datasamples + packoffset,
-                                 (int)(msr->numsamples - totalpackedsamples), maxdatabytes,
-                                 &msr->ststate->lastintsample, msr->ststate->comphistory,
-                                 msr->sampletype, msr->encoding, dataswapflag,
-                                 srcname, verbose);
+    packsamples = -1;
+
+#if defined(LMP_THREADS)
+    /* Pack remaining records serially if a record is not available */
+    if (work && (packsamples = msr_pack_next (work, rawrec + dataoffset, totalpackedsamples)) < 0)
+      msr_pack_release (&work);
+#endif
+
+    if (packsamples < 0)
+      packsamples = msr_pack_data (rawrec + dataoffset,
+                                   (char *)msr->datasamples + packoffset,
+                                   (int)(msr->numsamples - totalpackedsamples), maxdatabytes,
+                                   &msr->ststate->lastintsample, msr->ststate->comphistory,
+                                   msr->sampletype, rawsamplesize, rawswapflag,
+                                   msr->encoding, dataswapflag, srcname, verbose);
 
     if (packsamples < 0)
     {
       ms_log (2, "msr_pack(%s): Error packing data samples\n", srcname);
+#if defined(LMP_THREADS)
+      msr_pack_release (&work);
+#endif
       free (rawrec);
       return -1;
     }
@@ -384,15 +1241,22 @@ msr_pack (MSRecord *msr, void (*record_handler) (char *, int, void *),
 
     if (totalpackedsamples >= msr->numsamples)
       break;
+
+    if (maxrecords > 0 && recordcnt >= maxrecords)
+      break;
   }
 
   if (verbose > 2)
     ms_log (1, "%s: Packed %d total samples\n", srcname, totalpackedsamples);
 
+#if defined(LMP_THREADS)
+  msr_pack_release (&work);
+#endif
+
   free (rawrec);
 
   return recordcnt;
-} /* End of msr_pack() */
+} /* End of msr_pack_samples() */
 
 /***************************************************************************
  * msr_pack_header:
@@ -526,13 +1390,15 @@ msr_pack_header_raw (MSRecord *msr, char *rawrec, int maxheaderlen,
   /* Make sure a fixed section of data header is available */
   if (!msr->fsdh)
   {
-    msr->fsdh = (struct fsdh_s *)calloc (1, sizeof (struct fsdh_s));
+    msr->fsdh = (struct fsdh_s *)ms_arena_alloc (ms_arena_owner (msr), sizeof (struct fsdh_s));
 
     if (msr->fsdh == NULL)
     {
       ms_log (2, "msr_pack_header_raw(%s): Cannot allocate memory\n", srcname);
       return -1;
     }
+
+    memset (msr->fsdh, 0, sizeof (struct fsdh_s));
   }
 
   /* Update the SEED structures associated with the MSRecord */
@@ -899,20 +1765,29 @@ msr_update_header (MSRecord *msr, char *rawrec, flag swapflag,
  *  updated with the last sample packed in order to be used with a
  *  subsequent call to this routine.
  *
+ *  If 'rawsamplesize' is not 0 the integer samples are 16 or 32-bit
+ *  integers, swapped if 'rawswapflag' is set, which can only be
+ *  encoded in Steim1/2.
+ *
  *  Return number of samples packed on success and a negative on error.
  ************************************************************************/
 static int
 msr_pack_data (void *dest, void *src, int maxsamples, int maxdatabytes,
                int32_t *lastintsample, flag comphistory, char sampletype,
+               int rawsamplesize, flag rawswapflag,
                flag encoding, flag swapflag, char *srcname, flag verbose)
 {
   int nsamples;
   int32_t *intbuff;
   int32_t d0;
+  int32_t first;
+  int32_t last;
 
-  /* Check for encode debugging environment variable */
-  if (getenv ("ENCODE_DEBUG"))
-    encodedebug = 1;
+  if (rawsamplesize && encoding != DE_STEIM1 && encoding != DE_STEIM2)
+  {
+    ms_log (2, "%s: Raw integer samples can only be packed with Steim1 or Steim2\n", srcname);
+    return -1;
+  }
 
   /* Decide if this is a format that we can encode */
   switch (encoding)
@@ -1002,17 +1877,26 @@ msr_pack_data (void *dest, void *src, int maxsamples, int maxdatabytes,
 
     intbuff = (int32_t *)src;
 
+    first = (rawsamplesize) ? msr_rawsample (src, 0, rawsamplesize, rawswapflag) : intbuff[0];
+
     /* If a previous sample is supplied use it for compression history otherwise cold-start */
-    d0 = (lastintsample && comphistory) ? (intbuff[0] - *lastintsample) : 0;
+    d0 = (lastintsample && comphistory) ? (first - *lastintsample) : 0;
 
     if (verbose > 1)
       ms_log (1, "%s: Packing Steim1 data frames\n", srcname);
 
-    nsamples = msr_encode_steim1 (src, maxsamples, dest, maxdatabytes, d0, swapflag);
+    if (rawsamplesize)
+      nsamples = msr_encode_steim1_raw (src, rawsamplesize, rawswapflag, maxsamples,
+                                        dest, maxdatabytes, d0, swapflag);
+    else
+      nsamples = msr_encode_steim1 (src, maxsamples, dest, maxdatabytes, d0, swapflag);
 
     /* If a previous sample is supplied update it with the last sample value */
     if (lastintsample && nsamples > 0)
-      *lastintsample = intbuff[nsamples - 1];
+    {
+      last = (rawsamplesize) ? msr_rawsample (src, nsamples - 1, rawsamplesize, rawswapflag) : intbuff[nsamples - 1];
+      *lastintsample = last;
+    }
 
     break;
 
@@ -1026,17 +1910,26 @@ msr_pack_data (void *dest, void *src, int maxsamples, int maxdatabytes,
 
     intbuff = (int32_t *)src;
 
+    first = (rawsamplesize) ? msr_rawsample (src, 0, rawsamplesize, rawswapflag) : intbuff[0];
+
     /* If a previous sample is supplied use it for compression history otherwise cold-start */
-    d0 = (lastintsample && comphistory) ? (intbuff[0] - *lastintsample) : 0;
+    d0 = (lastintsample && comphistory) ? (first - *lastintsample) : 0;
 
     if (verbose > 1)
       ms_log (1, "%s: Packing Steim2 data frames\n", srcname);
 
-    nsamples = msr_encode_steim2 (src, maxsamples, dest, maxdatabytes, d0, srcname, swapflag);
+    if (rawsamplesize)
+      nsamples = msr_encode_steim2_raw (src, rawsamplesize, rawswapflag, maxsamples,
+                                        dest, maxdatabytes, d0, srcname, swapflag);
+    else
+      nsamples = msr_encode_steim2 (src, maxsamples, dest, maxdatabytes, d0, srcname, swapflag);
 
     /* If a previous sample is supplied update it with the last sample value */
     if (lastintsample && nsamples > 0)
-      *lastintsample = intbuff[nsamples - 1];
+    {
+      last = (rawsamplesize) ? msr_rawsample (src, nsamples - 1, rawsamplesize, rawswapflag) : intbuff[nsamples - 1];
+      *lastintsample = last;
+    }
 
     break;
 
@@ -1048,3 +1941,84 @@ msr_pack_data (void *dest, void *src, int maxsamples, int maxdatabytes,
 
   return nsamples;
 } /* End of msr_pack_data() */
+
+/************************************************************************
+ *  check_environment:
+ *
+ *  Check environment variables and set global variables appropriately.
+ *
+ *  Return 0 on success and -1 on error.
+ ************************************************************************/
+static int
+check_environment (int verbose)
+{
+  char *envvariable;
+
+  /* Read possible environmental variables that force byteorder */
+  if (packheaderbyteorder == -2)
+  {
+    if ((envvariable = getenv ("PACK_HEADER_BYTEORDER")))
+    {
+      if (*envvariable != '0' && *envvariable != '1')
+      {
+        ms_log (2, "Environment variable PACK_HEADER_BYTEORDER must be set to '0' or '1'\n");
+        return -1;
+      }
+      else if (*envvariable == '0')
+      {
+        packheaderbyteorder = 0;
+        if (verbose > 2)
+          ms_log (1, "PACK_HEADER_BYTEORDER=0, packing little-endian header\n");
+      }
+      else
+      {
+        packheaderbyteorder = 1;
+        if (verbose > 2)
+          ms_log (1, "PACK_HEADER_BYTEORDER=1, packing big-endian header\n");
+      }
+    }
+    else
+    {
+      packheaderbyteorder = -1;
+    }
+  }
+
+  if (packdatabyteorder == -2)
+  {
+    if ((envvariable = getenv ("PACK_DATA_BYTEORDER")))
+    {
+      if (*envvariable != '0' && *envvariable != '1')
+      {
+        ms_log (2, "Environment variable PACK_DATA_BYTEORDER must be set to '0' or '1'\n");
+        return -1;
+      }
+      else if (*envvariable == '0')
+      {
+        packdatabyteorder = 0;
+        if (verbose > 2)
+          ms_log (1, "PACK_DATA_BYTEORDER=0, packing little-endian data samples\n");
+      }
+      else
+      {
+        packdatabyteorder = 1;
+        if (verbose > 2)
+          ms_log (1, "PACK_DATA_BYTEORDER=1, packing big-endian data samples\n");
+      }
+    }
+    else
+    {
+      packdatabyteorder = -1;
+    }
+  }
+
+  /* Check for encode debugging environment variable */
+  if (packencodedebug == -2)
+  {
+    packencodedebug = (getenv ("ENCODE_DEBUG")) ? 1 : 0;
+
+    if (packencodedebug)
+      encodedebug = 1;
+  }
+
+  return 0;
+} /* End of check_environment() */
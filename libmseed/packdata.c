@@ -2,7 +2,7 @@
  * Routines for packing text/ASCII, INT_16, INT_32, FLOAT_32, FLOAT_64,
  * STEIM1 and STEIM2 data records.
  *
- * modified: 2017.053
+ * modified: 2026.291
  ************************************************************************/
 
 #include <memory.h>
@@ -12,6 +12,12 @@
 #include "libmseed.h"
 #include "packdata.h"
 
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+  #include <arm_neon.h>
+#endif
+
 /* Control for printing debugging information */
 int encodedebug = 0;
 
@@ -122,11 +128,95 @@ msr_encode_int32 (int32_t *input, int samplecount, int32_t *output,
   return idx;
 } /* End of msr_encode_int32() */
 
+/************************************************************************
+ * swapcopy4:
+ *
+ * Copy 4-byte quantities from input to output reversing the byte
+ * order of each, 16 bytes at a time with SSE2 or NEON when available.
+ * The input and output must be aligned for 4-byte quantities.
+ ************************************************************************/
+static void
+swapcopy4 (const void *input, void *output, int count)
+{
+  const uint32_t *in = (const uint32_t *)input;
+  uint32_t *out      = (uint32_t *)output;
+  uint32_t value;
+  int idx = 0;
+
+#if defined(__SSE2__)
+  __m128i vec;
+
+  for (; idx + 4 <= count; idx += 4)
+  {
+    vec = _mm_loadu_si128 ((const __m128i *)(in + idx));
+    /* Swap 16-bit halves of each 32-bit value, then bytes of each half */
+    vec = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (vec, 0xB1), 0xB1);
+    vec = _mm_or_si128 (_mm_slli_epi16 (vec, 8), _mm_srli_epi16 (vec, 8));
+    _mm_storeu_si128 ((__m128i *)(out + idx), vec);
+  }
+#elif defined(__ARM_NEON)
+  for (; idx + 4 <= count; idx += 4)
+    vst1q_u8 ((uint8_t *)(out + idx), vrev32q_u8 (vld1q_u8 ((const uint8_t *)(in + idx))));
+#endif
+
+  for (; idx < count; idx++)
+  {
+    value    = in[idx];
+    out[idx] = (value << 24) | ((value << 8) & 0x00FF0000u) |
+               ((value >> 8) & 0x0000FF00u) | (value >> 24);
+  }
+} /* End of swapcopy4() */
+
+/************************************************************************
+ * swapcopy8:
+ *
+ * Copy 8-byte quantities from input to output reversing the byte
+ * order of each, 16 bytes at a time with SSE2 or NEON when available.
+ * The input and output must be aligned for 8-byte quantities.
+ ************************************************************************/
+static void
+swapcopy8 (const void *input, void *output, int count)
+{
+  const uint64_t *in = (const uint64_t *)input;
+  uint64_t *out      = (uint64_t *)output;
+  uint32_t low;
+  uint32_t high;
+  int idx = 0;
+
+#if defined(__SSE2__)
+  __m128i vec;
+
+  for (; idx + 2 <= count; idx += 2)
+  {
+    vec = _mm_loadu_si128 ((const __m128i *)(in + idx));
+    /* Reverse 16-bit quarters of each 64-bit value, then bytes of each quarter */
+    vec = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (vec, 0x1B), 0x1B);
+    vec = _mm_or_si128 (_mm_slli_epi16 (vec, 8), _mm_srli_epi16 (vec, 8));
+    _mm_storeu_si128 ((__m128i *)(out + idx), vec);
+  }
+#elif defined(__ARM_NEON)
+  for (; idx + 2 <= count; idx += 2)
+    vst1q_u8 ((uint8_t *)(out + idx), vrev64q_u8 (vld1q_u8 ((const uint8_t *)(in + idx))));
+#endif
+
+  for (; idx < count; idx++)
+  {
+    low      = (uint32_t)in[idx];
+    high     = (uint32_t)(in[idx] >> 32);
+    low      = (low << 24) | ((low << 8) & 0x00FF0000u) |
+               ((low >> 8) & 0x0000FF00u) | (low >> 24);
+    high     = (high << 24) | ((high << 8) & 0x00FF0000u) |
+               ((high >> 8) & 0x0000FF00u) | (high >> 24);
+    out[idx] = ((uint64_t)low << 32) | high;
+  }
+} /* End of swapcopy8() */
+
 /************************************************************************
  * msr_encode_float32:
  *
  * Encode 32-bit float data from an array of 32-bit floats and place
- * in supplied buffer.  Swap if requested.  Pad any space remaining in
+ * in supplied buffer.  Swap if requested, using vector byte swapping
+ * where supported.  Pad any space remaining in
  * output buffer with zeros.
  *
  * Return number of samples in output buffer on success, -1 on failure.
@@ -135,7 +225,7 @@ int
 msr_encode_float32 (float *input, int samplecount, float *output,
                     int outputlength, int swapflag)
 {
-  int idx;
+  int count;
 
   if (samplecount <= 0)
     return 0;
@@ -143,27 +233,30 @@ msr_encode_float32 (float *input, int samplecount, float *output,
   if (!input || !output || outputlength <= 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= (int)sizeof (float); idx++)
-  {
-    output[idx] = input[idx];
+  /* Determine minimum of input or output samples */
+  count = outputlength / (int)sizeof (float);
+  if (count > samplecount)
+    count = samplecount;
 
-    if (swapflag)
-      ms_gswap4a (&output[idx]);
+  if (swapflag)
+    swapcopy4 (input, output, count);
+  else
+    memcpy (output, input, count * sizeof (float));
 
-    outputlength -= sizeof (float);
-  }
+  outputlength -= count * sizeof (float);
 
   if (outputlength)
-    memset (&output[idx], 0, outputlength);
+    memset (&output[count], 0, outputlength);
 
-  return idx;
+  return count;
 } /* End of msr_encode_float32() */
 
 /************************************************************************
  * msr_encode_float64:
  *
  * Encode 64-bit float data from an array of 64-bit doubles and place
- * in supplied buffer.  Swap if requested.  Pad any space remaining in
+ * in supplied buffer.  Swap if requested, using vector byte swapping
+ * where supported.  Pad any space remaining in
  * output buffer with zeros.
  *
  * Return number of samples in output buffer on success, -1 on failure.
@@ -172,7 +265,7 @@ int
 msr_encode_float64 (double *input, int samplecount, double *output,
                     int outputlength, int swapflag)
 {
-  int idx;
+  int count;
 
   if (samplecount <= 0)
     return 0;
@@ -180,50 +273,112 @@ msr_encode_float64 (double *input, int samplecount, double *output,
   if (!input || !output || outputlength <= 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= (int)sizeof (double); idx++)
-  {
-    output[idx] = input[idx];
+  /* Determine minimum of input or output samples */
+  count = outputlength / (int)sizeof (double);
+  if (count > samplecount)
+    count = samplecount;
 
-    if (swapflag)
-      ms_gswap8a (&output[idx]);
+  if (swapflag)
+    swapcopy8 (input, output, count);
+  else
+    memcpy (output, input, count * sizeof (double));
 
-    outputlength -= sizeof (double);
-  }
+  outputlength -= count * sizeof (double);
 
   if (outputlength)
-    memset (&output[idx], 0, outputlength);
+    memset (&output[count], 0, outputlength);
 
-  return idx;
+  return count;
 } /* End of msr_encode_float64() */
 
-/* Macro to determine number of bits needed to represent VALUE in
- * the following bit widths: 4,5,6,8,10,15,16,30,32 and set RESULT. */
-#define BITWIDTH(VALUE, RESULT)                       \
-  if (VALUE >= -8 && VALUE <= 7)                      \
-    RESULT = 4;                                       \
-  else if (VALUE >= -16 && VALUE <= 15)               \
-    RESULT = 5;                                       \
-  else if (VALUE >= -32 && VALUE <= 31)               \
-    RESULT = 6;                                       \
-  else if (VALUE >= -128 && VALUE <= 127)             \
-    RESULT = 8;                                       \
-  else if (VALUE >= -512 && VALUE <= 511)             \
-    RESULT = 10;                                      \
-  else if (VALUE >= -16384 && VALUE <= 16383)         \
-    RESULT = 15;                                      \
-  else if (VALUE >= -32768 && VALUE <= 32767)         \
-    RESULT = 16;                                      \
-  else if (VALUE >= -536870912 && VALUE <= 536870911) \
-    RESULT = 30;                                      \
-  else                                                \
-    RESULT = 32;
+/* Count leading zero bits of a non-zero 32-bit value */
+#if defined(__GNUC__) || defined(__clang__)
+  #define CLZ32(X) __builtin_clz (X)
+#else
+static int
+clz32 (uint32_t x)
+{
+  int count = 0;
+
+  if (!(x & 0xFFFF0000ul)) { count += 16; x <<= 16; }
+  if (!(x & 0xFF000000ul)) { count += 8; x <<= 8; }
+  if (!(x & 0xF0000000ul)) { count += 4; x <<= 4; }
+  if (!(x & 0xC0000000ul)) { count += 2; x <<= 2; }
+  if (!(x & 0x80000000ul)) { count += 1; }
+
+  return count;
+}
+  #define CLZ32(X) clz32 (X)
+#endif
+
+/* Steim difference classes, the minimal bit width of a difference in
+ * the widths: 4,5,6,8,10,15,16,30,32 bits is classes 0 through 8 */
+#define SC_32BIT 8
+
+/* Difference class for the number of bits needed to represent a
+ * signed value (two's complement), indexed by bits: 0-32 */
+static const uint8_t steimclass[33] = {
+    0, 0, 0, 0, 0, 1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8};
+
+/* Maximum number of differences packed in a Steim1 or Steim2 word for
+ * a given difference class.  For Steim1 a capacity of 3 is not a word
+ * format and is handled as 2. */
+static const uint8_t steim1capacity[9] = {4, 4, 4, 4, 2, 2, 2, 1, 1};
+static const uint8_t steim2capacity[9] = {7, 6, 5, 4, 3, 2, 1, 1, 0};
+
+/* Maximum difference class of 2 or more differences packed in a Steim1
+ * or Steim2 word, indexed by the number of differences - 2 */
+static const uint8_t steim1fitclass[3] = {6, 3, 3};
+static const uint8_t steim2fitclass[6] = {5, 4, 3, 2, 1, 0};
+
+/* Macro to determine the Steim difference class of VALUE.  The number
+ * of bits needed is determined from the leading zero count of the
+ * value, or its complement if negative, plus a sign bit. */
+#define STEIMCLASS(VALUE) \
+  steimclass[33 - CLZ32 ((((VALUE) < 0) ? ~(uint32_t)(VALUE) : (uint32_t)(VALUE)) | 1)]
+
+/* Fetch sample IDX from the Steim encoder input */
+#define SAMPLE(IDX) msr_rawsample (input, (IDX), samplesize, sampleswap)
 
 /************************************************************************
- * msr_encode_steim1:
+ * msr_rawsample:
  *
- * Encode Steim1 data frames from an array of 32-bit integers and
- * place in supplied buffer.  Swap if requested.  Pad any space
- * remaining in output buffer with zeros.
+ * Return a sample from an array of 16 or 32-bit integers, swapping
+ * bytes if requested.
+ ************************************************************************/
+int32_t
+msr_rawsample (void *input, int idx, int samplesize, int sampleswap)
+{
+  uint32_t value;
+
+  if (samplesize == 2)
+  {
+    value = ((uint16_t *)input)[idx];
+
+    if (sampleswap)
+      value = ((value & 0xFFu) << 8) | (value >> 8);
+
+    return (int16_t)value;
+  }
+
+  value = ((uint32_t *)input)[idx];
+
+  if (sampleswap)
+    value = ((value & 0xFFu) << 24) | ((value & 0xFF00u) << 8) |
+            ((value >> 8) & 0xFF00u) | (value >> 24);
+
+  return (int32_t)value;
+} /* End of msr_rawsample() */
+
+/************************************************************************
+ * encode_steim1:
+ *
+ * Encode Steim1 data frames from an array of 16 or 32-bit integers,
+ * as specified by samplesize, and place in supplied buffer.  Input
+ * samples are swapped if sampleswap is set and output is swapped if
+ * swapflag is set.  Pad any space remaining in output buffer with
+ * zeros.
  *
  * diff0 is the first difference in the sequence and relates the first
  * sample to the sample previous to it (not available to this
@@ -231,14 +386,15 @@ msr_encode_float64 (double *input, int samplecount, double *output,
  *
  * Return number of samples in output buffer on success, -1 on failure.
  ************************************************************************/
-int
-msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
-                   int outputlength, int32_t diff0, int swapflag)
+static int
+encode_steim1 (void *input, int samplesize, int sampleswap, int samplecount,
+               int32_t *output, int outputlength, int32_t diff0, int swapflag)
 {
   int32_t *frameptr;   /* Frame pointer in output */
   int32_t *Xnp = NULL; /* Reverse integration constant, aka last sample */
   int32_t diffs[4];
-  int32_t bitwidth[4];
+  uint8_t diffclass[4];
+  uint8_t maxclass;
   int diffcount     = 0;
   int inputidx      = 0;
   int outputsamples = 0;
@@ -266,8 +422,8 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
             samplecount, maxframes, swapflag);
 
   /* Add first difference to buffers */
-  diffs[0] = diff0;
-  BITWIDTH (diffs[0], bitwidth[0]);
+  diffs[0]     = diff0;
+  diffclass[0] = STEIMCLASS (diffs[0]);
   diffcount = 1;
 
   for (frameidx = 0; frameidx < maxframes && outputsamples < samplecount; frameidx++)
@@ -281,7 +437,7 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
      * and set the starting nibble index depending on frame. */
     if (frameidx == 0)
     {
-      frameptr[1] = input[0];
+      frameptr[1] = SAMPLE (0);
 
       if (encodedebug)
         ms_log (1, "Frame %d: X0=%d\n", frameidx, frameptr[1]);
@@ -308,31 +464,41 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
         /* Shift diffs and related bit widths to beginning of buffers */
         for (idx = 0; idx < diffcount; idx++)
         {
-          diffs[idx]    = diffs[packedsamples + idx];
-          bitwidth[idx] = bitwidth[packedsamples + idx];
+          diffs[idx]     = diffs[packedsamples + idx];
+          diffclass[idx] = diffclass[packedsamples + idx];
         }
 
-        /* Add new diffs and determine bit width needed to represent */
+        /* Add new diffs and determine class needed to represent */
         for (idx = diffcount; idx < 4 && inputidx < (samplecount - 1); idx++, inputidx++)
         {
-          diffs[idx] = *(input + inputidx + 1) - *(input + inputidx);
-          BITWIDTH (diffs[idx], bitwidth[idx]);
+          diffs[idx] = SAMPLE (inputidx + 1) - SAMPLE (inputidx);
+          diffclass[idx] = STEIMCLASS (diffs[idx]);
           diffcount++;
         }
       }
 
-      /* Determine optimal packing by checking, in-order:
+      /* Determine optimal packing, the largest number of leading
+       * differences whose maximum class allows packing them in a word:
        * 4 x 8-bit differences
        * 2 x 16-bit differences
        * 1 x 32-bit difference */
+      maxclass = diffclass[0];
+      for (packedsamples = 1; packedsamples < diffcount; packedsamples++)
+      {
+        if (diffclass[packedsamples] > maxclass)
+          maxclass = diffclass[packedsamples];
+
+        if (steim1capacity[maxclass] <= packedsamples)
+          break;
+      }
 
-      word          = (union dword *)&frameptr[widx];
-      packedsamples = 0;
+      if (packedsamples == 3)
+        packedsamples = 2;
+
+      word = (union dword *)&frameptr[widx];
 
       /* 4 x 8-bit differences */
-      if (diffcount == 4 &&
-          bitwidth[0] <= 8 && bitwidth[1] <= 8 &&
-          bitwidth[2] <= 8 && bitwidth[3] <= 8)
+      if (packedsamples == 4)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 01=4x8b  %d  %d  %d  %d\n",
@@ -345,12 +511,9 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b01 (0x1) */
         frameptr[0] |= 0x1ul << (30 - 2 * widx);
-
-        packedsamples = 4;
       }
       /* 2 x 16-bit differences */
-      else if (diffcount >= 2 &&
-               bitwidth[0] <= 16 && bitwidth[1] <= 16)
+      else if (packedsamples == 2)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 2=2x16b  %d  %d\n", widx, diffs[0], diffs[1]);
@@ -366,8 +529,6 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b10 (0x2) */
         frameptr[0] |= 0x2ul << (30 - 2 * widx);
-
-        packedsamples = 2;
       }
       /* 1 x 32-bit difference */
       else
@@ -382,8 +543,6 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b11 (0x3) */
         frameptr[0] |= 0x3ul << (30 - 2 * widx);
-
-        packedsamples = 1;
       }
 
       diffcount -= packedsamples;
@@ -397,7 +556,7 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
 
   /* Set Xn (reverse integration constant) in first frame to last sample */
   if (Xnp)
-    *Xnp = *(input + outputsamples - 1);
+    *Xnp = SAMPLE (outputsamples - 1);
   if (swapflag)
     ms_gswap4a (Xnp);
 
@@ -406,12 +565,12 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
     memset (output + (frameidx * 16), 0, outputlength - (frameidx * 64));
 
   return outputsamples;
-} /* End of msr_encode_steim1() */
+} /* End of encode_steim1() */
 
 /************************************************************************
- * msr_encode_steim2:
+ * msr_encode_steim1:
  *
- * Encode Steim2 data frames from an array of 32-bit integers and
+ * Encode Steim1 data frames from an array of 32-bit integers and
  * place in supplied buffer.  Swap if requested.  Pad any space
  * remaining in output buffer with zeros.
  *
@@ -422,14 +581,63 @@ msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
  * Return number of samples in output buffer on success, -1 on failure.
  ************************************************************************/
 int
-msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
-                   int outputlength, int32_t diff0,
-                   char *srcname, int swapflag)
+msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
+                   int outputlength, int32_t diff0, int swapflag)
+{
+  return encode_steim1 (input, 4, 0, samplecount, output, outputlength,
+                        diff0, swapflag);
+} /* End of msr_encode_steim1() */
+
+/************************************************************************
+ * msr_encode_steim1_raw:
+ *
+ * Encode Steim1 data frames directly from an array of 16 or 32-bit
+ * integers in either byte order, avoiding conversion to host order
+ * 32-bit integers.  The input samples are swapped if sampleswap is
+ * set, otherwise the same as msr_encode_steim1().
+ *
+ * Return number of samples in output buffer on success, -1 on failure.
+ ************************************************************************/
+int
+msr_encode_steim1_raw (void *input, int samplesize, int sampleswap,
+                       int samplecount, int32_t *output, int outputlength,
+                       int32_t diff0, int swapflag)
+{
+  if (samplesize != 2 && samplesize != 4)
+  {
+    ms_log (2, "msr_encode_steim1_raw(): Unsupported sample size: %d\n", samplesize);
+    return -1;
+  }
+
+  return encode_steim1 (input, samplesize, sampleswap, samplecount, output,
+                        outputlength, diff0, swapflag);
+} /* End of msr_encode_steim1_raw() */
+
+/************************************************************************
+ * encode_steim2:
+ *
+ * Encode Steim2 data frames from an array of 16 or 32-bit integers,
+ * as specified by samplesize, and place in supplied buffer.  Input
+ * samples are swapped if sampleswap is set and output is swapped if
+ * swapflag is set.  Pad any space remaining in output buffer with
+ * zeros.
+ *
+ * diff0 is the first difference in the sequence and relates the first
+ * sample to the sample previous to it (not available to this
+ * function).  It should be set to 0 if this value is not known.
+ *
+ * Return number of samples in output buffer on success, -1 on failure.
+ ************************************************************************/
+static int
+encode_steim2 (void *input, int samplesize, int sampleswap, int samplecount,
+               int32_t *output, int outputlength, int32_t diff0,
+               char *srcname, int swapflag)
 {
   uint32_t *frameptr;  /* Frame pointer in output */
   int32_t *Xnp = NULL; /* Reverse integration constant, aka last sample */
   int32_t diffs[7];
-  int32_t bitwidth[7];
+  uint8_t diffclass[7];
+  uint8_t maxclass;
   int diffcount     = 0;
   int inputidx      = 0;
   int outputsamples = 0;
@@ -457,8 +665,8 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
             samplecount, maxframes, swapflag);
 
   /* Add first difference to buffers */
-  diffs[0] = diff0;
-  BITWIDTH (diffs[0], bitwidth[0]);
+  diffs[0]     = diff0;
+  diffclass[0] = STEIMCLASS (diffs[0]);
   diffcount = 1;
 
   for (frameidx = 0; frameidx < maxframes && outputsamples < samplecount; frameidx++)
@@ -472,7 +680,7 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
      * and set the starting nibble index depending on frame. */
     if (frameidx == 0)
     {
-      frameptr[1] = input[0];
+      frameptr[1] = SAMPLE (0);
 
       if (encodedebug)
         ms_log (1, "Frame %d: X0=%d\n", frameidx, frameptr[1]);
@@ -499,20 +707,21 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
         /* Shift diffs and related bit widths to beginning of buffers */
         for (idx = 0; idx < diffcount; idx++)
         {
-          diffs[idx]    = diffs[packedsamples + idx];
-          bitwidth[idx] = bitwidth[packedsamples + idx];
+          diffs[idx]     = diffs[packedsamples + idx];
+          diffclass[idx] = diffclass[packedsamples + idx];
         }
 
-        /* Add new diffs and determine bit width needed to represent */
+        /* Add new diffs and determine class needed to represent */
         for (idx = diffcount; idx < 7 && inputidx < (samplecount - 1); idx++, inputidx++)
         {
-          diffs[idx] = *(input + inputidx + 1) - *(input + inputidx);
-          BITWIDTH (diffs[idx], bitwidth[idx]);
+          diffs[idx] = SAMPLE (inputidx + 1) - SAMPLE (inputidx);
+          diffclass[idx] = STEIMCLASS (diffs[idx]);
           diffcount++;
         }
       }
 
-      /* Determine optimal packing by checking, in-order:
+      /* Determine optimal packing, the largest number of leading
+       * differences whose maximum class allows packing them in a word:
        * 7 x 4-bit differences
        * 6 x 5-bit differences
        * 5 x 6-bit differences
@@ -520,13 +729,25 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
        * 3 x 10-bit differences
        * 2 x 15-bit differences
        * 1 x 30-bit difference */
+      maxclass = diffclass[0];
+      if (maxclass == SC_32BIT)
+      {
+        ms_log (2, "msr_encode_steim2(%s): Unable to represent difference in <= 30 bits\n",
+                srcname);
+        return -1;
+      }
 
-      packedsamples = 0;
+      for (packedsamples = 1; packedsamples < diffcount; packedsamples++)
+      {
+        if (diffclass[packedsamples] > maxclass)
+          maxclass = diffclass[packedsamples];
+
+        if (steim2capacity[maxclass] <= packedsamples)
+          break;
+      }
 
       /* 7 x 4-bit differences */
-      if (diffcount == 7 && bitwidth[0] <= 4 &&
-          bitwidth[1] <= 4 && bitwidth[2] <= 4 && bitwidth[3] <= 4 &&
-          bitwidth[4] <= 4 && bitwidth[5] <= 4 && bitwidth[6] <= 4)
+      if (packedsamples == 7)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 11,10=7x4b  %d  %d  %d  %d  %d  %d  %d\n",
@@ -546,13 +767,9 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b11 (0x3) */
         frameptr[0] |= 0x3ul << (30 - 2 * widx);
-
-        packedsamples = 7;
       }
       /* 6 x 5-bit differences */
-      else if (diffcount >= 6 &&
-               bitwidth[0] <= 5 && bitwidth[1] <= 5 && bitwidth[2] <= 5 &&
-               bitwidth[3] <= 5 && bitwidth[4] <= 5 && bitwidth[5] <= 5)
+      else if (packedsamples == 6)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 11,01=6x5b  %d  %d  %d  %d  %d  %d\n",
@@ -571,13 +788,9 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b11 (0x3) */
         frameptr[0] |= 0x3ul << (30 - 2 * widx);
-
-        packedsamples = 6;
       }
       /* 5 x 6-bit differences */
-      else if (diffcount >= 5 &&
-               bitwidth[0] <= 6 && bitwidth[1] <= 6 && bitwidth[2] <= 6 &&
-               bitwidth[3] <= 6 && bitwidth[4] <= 6)
+      else if (packedsamples == 5)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 11,00=5x6b  %d  %d  %d  %d  %d\n",
@@ -594,13 +807,9 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b11 (0x3) */
         frameptr[0] |= 0x3ul << (30 - 2 * widx);
-
-        packedsamples = 5;
       }
       /* 4 x 8-bit differences */
-      else if (diffcount >= 4 &&
-               bitwidth[0] <= 8 && bitwidth[1] <= 8 &&
-               bitwidth[2] <= 8 && bitwidth[3] <= 8)
+      else if (packedsamples == 4)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 01=4x8b  %d  %d  %d  %d\n",
@@ -615,12 +824,9 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b01, only need to set 2nd bit */
         frameptr[0] |= 0x1ul << (30 - 2 * widx);
-
-        packedsamples = 4;
       }
       /* 3 x 10-bit differences */
-      else if (diffcount >= 3 &&
-               bitwidth[0] <= 10 && bitwidth[1] <= 10 && bitwidth[2] <= 10)
+      else if (packedsamples == 3)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 10,11=3x10b  %d  %d  %d\n",
@@ -636,12 +842,9 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b10 (0x2) */
         frameptr[0] |= 0x2ul << (30 - 2 * widx);
-
-        packedsamples = 3;
       }
       /* 2 x 15-bit differences */
-      else if (diffcount >= 2 &&
-               bitwidth[0] <= 15 && bitwidth[1] <= 15)
+      else if (packedsamples == 2)
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 10,10=2x15b  %d  %d\n",
@@ -656,12 +859,9 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b10 (0x2) */
         frameptr[0] |= 0x2ul << (30 - 2 * widx);
-
-        packedsamples = 2;
       }
       /* 1 x 30-bit difference */
-      else if (diffcount >= 1 &&
-               bitwidth[0] <= 30)
+      else
       {
         if (encodedebug)
           ms_log (1, "  W%02d: 10,01=1x30b  %d\n",
@@ -675,14 +875,6 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
         /* 2-bit nibble is 0b10 (0x2) */
         frameptr[0] |= 0x2ul << (30 - 2 * widx);
-
-        packedsamples = 1;
-      }
-      else
-      {
-        ms_log (2, "msr_encode_steim2(%s): Unable to represent difference in <= 30 bits\n",
-                srcname);
-        return -1;
       }
 
       /* Swap encoded word except for 4x8-bit samples */
@@ -700,7 +892,7 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
 
   /* Set Xn (reverse integration constant) in first frame to last sample */
   if (Xnp)
-    *Xnp = *(input + outputsamples - 1);
+    *Xnp = SAMPLE (outputsamples - 1);
   if (swapflag)
     ms_gswap4a (Xnp);
 
@@ -709,4 +901,194 @@ msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
     memset (output + (frameidx * 16), 0, outputlength - (frameidx * 64));
 
   return outputsamples;
+} /* End of encode_steim2() */
+
+/************************************************************************
+ * msr_encode_steim2:
+ *
+ * Encode Steim2 data frames from an array of 32-bit integers and
+ * place in supplied buffer.  Swap if requested.  Pad any space
+ * remaining in output buffer with zeros.
+ *
+ * diff0 is the first difference in the sequence and relates the first
+ * sample to the sample previous to it (not available to this
+ * function).  It should be set to 0 if this value is not known.
+ *
+ * Return number of samples in output buffer on success, -1 on failure.
+ ************************************************************************/
+int
+msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
+                   int outputlength, int32_t diff0,
+                   char *srcname, int swapflag)
+{
+  return encode_steim2 (input, 4, 0, samplecount, output, outputlength,
+                        diff0, srcname, swapflag);
 } /* End of msr_encode_steim2() */
+
+/************************************************************************
+ * msr_encode_steim2_raw:
+ *
+ * Encode Steim2 data frames directly from an array of 16 or 32-bit
+ * integers in either byte order, avoiding conversion to host order
+ * 32-bit integers.  The input samples are swapped if sampleswap is
+ * set, otherwise the same as msr_encode_steim2().
+ *
+ * Return number of samples in output buffer on success, -1 on failure.
+ ************************************************************************/
+int
+msr_encode_steim2_raw (void *input, int samplesize, int sampleswap,
+                       int samplecount, int32_t *output, int outputlength,
+                       int32_t diff0, char *srcname, int swapflag)
+{
+  if (samplesize != 2 && samplesize != 4)
+  {
+    ms_log (2, "msr_encode_steim2_raw(%s): Unsupported sample size: %d\n",
+            srcname, samplesize);
+    return -1;
+  }
+
+  return encode_steim2 (input, samplesize, sampleswap, samplecount, output,
+                        outputlength, diff0, srcname, swapflag);
+} /* End of msr_encode_steim2_raw() */
+
+/************************************************************************
+ * steim1_wordlengths:
+ *
+ * Replace the difference classes at each of count positions with the
+ * number of samples packed in a Steim1 word starting there, the same
+ * packing decision as the encoder: the largest number of leading
+ * differences that fit a word.  Fitting is monotonic in the number of
+ * differences, counting the fitting prefixes avoids data dependent
+ * branches.  The classes of the 3 following positions are used.
+ ************************************************************************/
+static void
+steim1_wordlengths (uint8_t *diffclass, int count)
+{
+  uint8_t *dc;
+  uint8_t m1, m2, m3;
+  int packedsamples;
+  int idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    dc = diffclass + idx;
+    m1 = (dc[1] > dc[0]) ? dc[1] : dc[0];
+    m2 = (dc[2] > m1) ? dc[2] : m1;
+    m3 = (dc[3] > m2) ? dc[3] : m2;
+
+    packedsamples = 1 + (m1 <= steim1fitclass[0]) + (m2 <= steim1fitclass[1]) +
+                    (m3 <= steim1fitclass[2]);
+
+    /* 3 differences are packed as 2 x 16-bit */
+    diffclass[idx] = (uint8_t)(packedsamples - (packedsamples == 3));
+  }
+} /* End of steim1_wordlengths() */
+
+/************************************************************************
+ * steim2_wordlengths:
+ *
+ * Replace the difference classes at each of count positions with the
+ * number of samples packed in a Steim2 word starting there, as for
+ * steim1_wordlengths().  The length is 0 if the first difference
+ * cannot be represented.  The classes of the 6 following positions
+ * are used.
+ ************************************************************************/
+static void
+steim2_wordlengths (uint8_t *diffclass, int count)
+{
+  uint8_t *dc;
+  uint8_t m1, m2, m3, m4, m5, m6;
+  int idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    dc = diffclass + idx;
+    m1 = (dc[1] > dc[0]) ? dc[1] : dc[0];
+    m2 = (dc[2] > m1) ? dc[2] : m1;
+    m3 = (dc[3] > m2) ? dc[3] : m2;
+    m4 = (dc[4] > m3) ? dc[4] : m3;
+    m5 = (dc[5] > m4) ? dc[5] : m4;
+    m6 = (dc[6] > m5) ? dc[6] : m5;
+
+    diffclass[idx] = (dc[0] == SC_32BIT) ? 0 :
+      (uint8_t)(1 + (m1 <= steim2fitclass[0]) + (m2 <= steim2fitclass[1]) +
+                (m3 <= steim2fitclass[2]) + (m4 <= steim2fitclass[3]) +
+                (m5 <= steim2fitclass[4]) + (m6 <= steim2fitclass[5]));
+  }
+} /* End of steim2_wordlengths() */
+
+/************************************************************************
+ * msr_steim_wordlengths:
+ *
+ * Determine the number of samples packed in a Steim1 or Steim2 word
+ * starting at each sample from start up to end of an array of 32-bit
+ * integers, without encoding.  The differences are packed the same as
+ * by msr_encode_steim1() and msr_encode_steim2(), a word depends only
+ * on the differences following its first sample and the end of the
+ * array, therefore the words of the encoders are found by following
+ * the lengths from the first sample of a record.
+ *
+ * diff0 is the first difference in the sequence as for the encoders.
+ * The length of a Steim2 word is 0 if its first difference cannot be
+ * represented.
+ *
+ * Return 0 on success, -1 on failure.
+ ************************************************************************/
+int
+msr_steim_wordlengths (int32_t *input, int samplecount, int32_t diff0,
+                       int encoding, int start, int end, uint8_t *lengths)
+{
+  uint8_t tail[16]; /* Classes of the last words */
+  int window = (encoding == DE_STEIM1) ? 4 : 7;
+  int32_t diff;
+  int count;
+  int head;
+  int idx;
+
+  if (!input || !lengths || start < 0 || start > end || end > samplecount)
+    return -1;
+
+  if ((count = end - start) == 0)
+    return 0;
+
+  head = (count > window - 1) ? count - (window - 1) : 0;
+
+  /* Classes of the differences, each class is replaced by the length
+   * of the word starting at it once the classes of the word are used */
+  idx = 0;
+  if (start == 0)
+    lengths[idx++] = STEIMCLASS (diff0);
+
+  for (; idx < count; idx++)
+  {
+    diff = input[start + idx] - input[start + idx - 1];
+    lengths[idx] = STEIMCLASS (diff);
+  }
+
+  /* Classes of the last words including differences following the
+   * range, differences beyond the end of the array fit no word */
+  for (idx = head; idx < count + window - 1; idx++)
+  {
+    if (idx < count)
+      tail[idx - head] = lengths[idx];
+    else if (start + idx < samplecount)
+      tail[idx - head] = STEIMCLASS (input[start + idx] - input[start + idx - 1]);
+    else
+      tail[idx - head] = SC_32BIT + 1;
+  }
+
+  if (encoding == DE_STEIM1)
+  {
+    steim1_wordlengths (lengths, head);
+    steim1_wordlengths (tail, count - head);
+  }
+  else
+  {
+    steim2_wordlengths (lengths, head);
+    steim2_wordlengths (tail, count - head);
+  }
+
+  memcpy (lengths + head, tail, count - head);
+
+  return 0;
+} /* End of msr_steim_wordlengths() */
@@ -4,7 +4,7 @@
  * Interface declarations for the Mini-SEED packing routines in
  * packdata.c
  *
- * modified: 2016.273
+ * modified: 2026.291
  ***************************************************************************/
 
 #ifndef PACKDATA_H
@@ -35,6 +35,21 @@ extern int msr_encode_steim1 (int32_t *input, int samplecount, int32_t *output,
 extern int msr_encode_steim2 (int32_t *input, int samplecount, int32_t *output,
                               int outputlength, int32_t diff0, char *srcname,
                               int swapflag);
+extern int32_t msr_rawsample (void *input, int idx, int samplesize, int sampleswap);
+extern int msr_encode_steim1_raw (void *input, int samplesize, int sampleswap,
+                                  int samplecount, int32_t *output, int outputlength,
+                                  int32_t diff0, int swapflag);
+extern int msr_encode_steim2_raw (void *input, int samplesize, int sampleswap,
+                                  int samplecount, int32_t *output, int outputlength,
+                                  int32_t diff0, char *srcname, int swapflag);
+extern int msr_steim_wordlengths (int32_t *input, int samplecount, int32_t diff0,
+                                  int encoding, int start, int end, uint8_t *lengths);
+
+/* Arena ownership and bindings, the owner is kept out of the public
+ * structures (defined in arena.c) */
+extern MSArena *ms_arena_owner (const void *ptr);
+extern int ms_arena_bind (const void *object, MSArena *arena);
+extern MSArena *ms_arena_bound (const void *object);
 
 #ifdef __cplusplus
 }
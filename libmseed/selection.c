@@ -6,7 +6,7 @@
  * Written by Chad Trabant unless otherwise noted
  *   IRIS Data Management Center
  *
- * modified: 2014.197
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <errno.h>
@@ -17,8 +17,109 @@
 
 #include "libmseed.h"
 
+/* Matching against a compiled list and the list of matchers are
+ * serialized when thread support is available, this can be disabled
+ * with -DLMP_NOTHREADS */
+#if !defined(LMP_WIN) && !defined(LMP_NOTHREADS)
+  #define LMP_THREADS 1
+  #include <pthread.h>
+static pthread_mutex_t matcherslock = PTHREAD_MUTEX_INITIALIZER;
+  #define MATCHERS_LOCK() pthread_mutex_lock (&matcherslock)
+  #define MATCHERS_UNLOCK() pthread_mutex_unlock (&matcherslock)
+#else
+  #define MATCHERS_LOCK()
+  #define MATCHERS_UNLOCK()
+#endif
+
 static int ms_globmatch (char *string, char *pattern);
 
+/* Open start and end times of compiled time windows */
+#define SELECT_TIMEMIN (-9223372036854775807LL - 1)
+#define SELECT_TIMEMAX 9223372036854775807LL
+
+/* Number of cached source names before the cache is cleared */
+#define SELECT_CACHEMAX 65536
+
+/* Time window of a compiled selection entry.  Windows are sorted by
+ * start time, open start and end times are the extreme values. */
+typedef struct SelectWindow_s {
+  hptime_t    starttime;     /* Window start time, SELECT_TIMEMIN if open */
+  hptime_t    endtime;       /* Window end time, SELECT_TIMEMAX if open */
+  hptime_t    maxend;        /* Latest end time of this and earlier windows */
+  int         order;         /* Position in the time window list */
+  SelectTime *selecttime;
+} SelectWindow;
+
+/* Compiled selection entry */
+typedef struct SelectEntry_s {
+  Selections   *selection;
+  SelectWindow *windows;     /* Time windows sorted by start time */
+  int           numwindows;
+  int           next;        /* Next entry of literal slot or trie node, -1 if none */
+} SelectEntry;
+
+/* Node of the prefix trie of glob patterns, children of a node are
+ * linked as siblings. */
+typedef struct SelectNode_s {
+  int  child;                /* First child node, 0 if none */
+  int  sibling;              /* Next sibling node, 0 if none */
+  int  entries;              /* First entry with a prefix ending at node, -1 if none */
+  char c;
+} SelectNode;
+
+/* Cached list of entries matching a source name */
+typedef struct SelectCache_s {
+  uint32_t hash;
+  char    *srcname;          /* Source name, NULL if slot is empty */
+  int     *entries;          /* Matching entries in list order */
+  int      count;
+} SelectCache;
+
+/* Compiled matcher of a selection list.  Entries without globbing
+ * characters are found in a hash table, the patterns of other entries
+ * are arranged in a trie by the literal prefix preceding the first
+ * globbing character such that only patterns with a prefix of the
+ * source name are tested.
+ *
+ * Matchers are kept in a private list keyed by the address of the
+ * first Selections of the list instead of in the public structure.
+ * The time windows and next entry of the first Selections are recorded
+ * when compiled, a matcher that no longer matches them is discarded. */
+typedef struct SelectMatcher_s {
+  const Selections *selections; /* First entry of the compiled list */
+  SelectTime  *timewindows;  /* Time windows of the first entry when compiled */
+  Selections  *next;         /* Next entry of the first entry when compiled */
+  struct SelectMatcher_s *nextmatcher; /* Next matcher in the list of matchers */
+  SelectEntry *entries;      /* Entries in list order */
+  int          numentries;
+  int         *literals;     /* Hash table of literal entries, -1 if empty */
+  uint32_t     literalsize;  /* Number of slots, a power of 2 */
+  SelectNode  *nodes;        /* Trie nodes, node 0 is the root */
+  int          numnodes;
+  SelectCache *cache;        /* Hash table of matching entries by source name */
+  uint32_t     cachesize;    /* Number of slots, a power of 2 */
+  uint32_t     cachecount;   /* Number of occupied slots */
+  int         *candidates;   /* Scratch list of candidate entries */
+#if defined(LMP_THREADS)
+  pthread_mutex_t lock;      /* Serializes use of the cache and candidates */
+#endif
+} SelectMatcher;
+
+static uint32_t ms_selecthash (const char *srcname);
+static int ms_compilewindows (SelectEntry *entry);
+static int ms_addtrie (SelectMatcher *matcher, int entry);
+static int *ms_matchentries (SelectMatcher *matcher, char *srcname, int *count);
+static SelectWindow *ms_matchwindow (SelectEntry *entry, hptime_t starttime, hptime_t endtime);
+static SelectMatcher *ms_getmatcher (const Selections *selections);
+static void ms_dropmatcher (const Selections *selections);
+static void ms_freecache (SelectMatcher *matcher);
+static void ms_freematcher (SelectMatcher *matcher);
+static int ms_cmpwindow (const void *a, const void *b);
+static int ms_cmpint (const void *a, const void *b);
+
+/* Compiled matchers of all lists, programs compile few lists */
+static SelectMatcher *matchers = NULL;
+
 /***************************************************************************
  * ms_matchselect:
  *
@@ -26,6 +127,11 @@ static int ms_globmatch (char *string, char *pattern);
  * srcname parameter may contain globbing characters.  The NULL value
  * (matching any times) for the start and end times is HPTERROR.
  *
+ * If the selection list was compiled with ms_compileselections() or
+ * read with ms_readselectionsfile() the compiled matcher is used,
+ * otherwise the list is searched in order.  Both return the first
+ * entry in list order with a matching time window.
+ *
  * Return Selections pointer to matching entry on successful match and
  * NULL for no match or error.
  ***************************************************************************/
@@ -33,11 +139,35 @@ Selections *
 ms_matchselect (Selections *selections, char *srcname, hptime_t starttime,
                 hptime_t endtime, SelectTime **ppselecttime)
 {
+  SelectMatcher *matcher;
+  SelectWindow *window;
   Selections *findsl  = NULL;
   SelectTime *findst  = NULL;
   SelectTime *matchst = NULL;
+  int *entries;
+  int count;
+  int idx;
 
-  if (selections)
+  if (selections && srcname && (matcher = ms_getmatcher (selections)))
+  {
+    if ((entries = ms_matchentries (matcher, srcname, &count)))
+    {
+      for (idx = 0; idx < count; idx++)
+      {
+        if ((window = ms_matchwindow (&matcher->entries[entries[idx]], starttime, endtime)))
+        {
+          findsl  = matcher->entries[entries[idx]].selection;
+          matchst = window->selecttime;
+          break;
+        }
+      }
+    }
+
+#if defined(LMP_THREADS)
+    pthread_mutex_unlock (&matcher->lock);
+#endif
+  }
+  else if (selections)
   {
     findsl = selections;
     while (findsl)
@@ -122,6 +252,10 @@ ms_addselect (Selections **ppselections, char *srcname,
   if (!ppselections || !srcname)
     return -1;
 
+  /* Release a compiled matcher, it does not include the new selection */
+  if (*ppselections)
+    ms_dropmatcher (*ppselections);
+
   /* Allocate new SelectTime and populate */
   if (!(newst = (SelectTime *)calloc (1, sizeof (SelectTime))))
   {
@@ -292,6 +426,9 @@ ms_addselect_comp (Selections **ppselections, char *net, char *sta, char *loc,
  * As a special case if the filename is "-", selection lines will be
  * read from stdin.
  *
+ * The selections list is compiled with ms_compileselections() after
+ * the selections are added.
+ *
  * Returns count of selections added on success and -1 on error.
  ***************************************************************************/
 int
@@ -463,6 +600,13 @@ ms_readselectionsfile (Selections **ppselections, char *filename)
   if (fp != stdin)
     fclose (fp);
 
+  /* Compile the list for matching */
+  if (*ppselections && ms_compileselections (*ppselections))
+  {
+    ms_log (2, "[%s] Error compiling selections\n", filename);
+    return -1;
+  }
+
   return selectcount;
 } /* End of ms_readselectionsfile() */
 
@@ -481,6 +625,8 @@ ms_freeselections (Selections *selections)
 
   if (selections)
   {
+    ms_dropmatcher (selections);
+
     select = selections;
 
     while (select)
@@ -549,6 +695,608 @@ ms_printselections (Selections *selections)
   }
 } /* End of ms_printselections() */
 
+/***************************************************************************
+ * ms_compileselections:
+ *
+ * Compile a selection list into a matcher used by ms_matchselect() for
+ * subsequent matching against the list.  Selection entries without
+ * globbing characters are found with a hash table, entries with
+ * globbing patterns are tested only if the literal prefix of the
+ * pattern is a prefix of the source name and the time windows of each
+ * entry are arranged in sorted arrays.  The entries matching each
+ * source name are cached.
+ *
+ * Lists read with ms_readselectionsfile() are compiled, lists built
+ * with ms_addselect() or ms_addselect_comp() are only compiled by
+ * calling this routine.  The matcher is kept by the library keyed by
+ * the address of the first Selections of the list.  It is released
+ * when a selection is added to the list and when the list is freed,
+ * the list must be compiled again after adding selections.  A list
+ * edited directly must also be compiled again, only changes of the
+ * time windows or next entry of the first Selections are detected.
+ * Updates of the cache are serialized when thread support is
+ * available.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ms_compileselections (Selections *selections)
+{
+  SelectMatcher *matcher;
+  SelectEntry *entry;
+  Selections *select;
+  uint32_t slot;
+  int idx;
+
+  if (!selections)
+    return -1;
+
+  ms_dropmatcher (selections);
+
+  if (!(matcher = (SelectMatcher *)calloc (1, sizeof (SelectMatcher))))
+  {
+    ms_log (2, "ms_compileselections(): Cannot allocate memory\n");
+    return -1;
+  }
+
+#if defined(LMP_THREADS)
+  pthread_mutex_init (&matcher->lock, NULL);
+#endif
+
+  for (select = selections; select; select = select->next)
+    matcher->numentries++;
+
+  /* Size the literal table to be no more than half full */
+  for (matcher->literalsize = 16; matcher->literalsize < (uint32_t)matcher->numentries * 2;)
+    matcher->literalsize *= 2;
+
+  matcher->entries    = (SelectEntry *)calloc (matcher->numentries, sizeof (SelectEntry));
+  matcher->candidates = (int *)malloc (sizeof (int) * matcher->numentries);
+  matcher->literals   = (int *)malloc (sizeof (int) * matcher->literalsize);
+  matcher->nodes      = (SelectNode *)calloc (1, sizeof (SelectNode));
+
+  if (!matcher->entries || !matcher->candidates || !matcher->literals || !matcher->nodes)
+  {
+    ms_log (2, "ms_compileselections(): Cannot allocate memory\n");
+    ms_freematcher (matcher);
+    return -1;
+  }
+
+  memset (matcher->literals, -1, sizeof (int) * matcher->literalsize);
+  matcher->nodes[0].entries = -1;
+  matcher->numnodes         = 1;
+
+  for (idx = 0, select = selections; select; idx++, select = select->next)
+  {
+    entry            = &matcher->entries[idx];
+    entry->selection = select;
+    entry->next      = -1;
+
+    if (ms_compilewindows (entry))
+    {
+      ms_freematcher (matcher);
+      return -1;
+    }
+
+    /* Add entries with globbing characters to the trie */
+    if (strpbrk (select->srcname, "*?[\\"))
+    {
+      if (ms_addtrie (matcher, idx))
+      {
+        ms_freematcher (matcher);
+        return -1;
+      }
+    }
+    /* Add literal entries to the hash table, chaining duplicates */
+    else
+    {
+      for (slot = ms_selecthash (select->srcname) & (matcher->literalsize - 1);
+           matcher->literals[slot] >= 0; slot = (slot + 1) & (matcher->literalsize - 1))
+      {
+        if (!strcmp (matcher->entries[matcher->literals[slot]].selection->srcname, select->srcname))
+          break;
+      }
+
+      if (matcher->literals[slot] >= 0)
+      {
+        int last = matcher->literals[slot];
+
+        while (matcher->entries[last].next >= 0)
+          last = matcher->entries[last].next;
+
+        matcher->entries[last].next = idx;
+      }
+      else
+      {
+        matcher->literals[slot] = idx;
+      }
+    }
+  }
+
+  matcher->selections  = selections;
+  matcher->timewindows = selections->timewindows;
+  matcher->next        = selections->next;
+
+  MATCHERS_LOCK ();
+  matcher->nextmatcher = matchers;
+  matchers             = matcher;
+  MATCHERS_UNLOCK ();
+
+  return 0;
+} /* End of ms_compileselections() */
+
+/***************************************************************************
+ * ms_getmatcher:
+ *
+ * Find the compiled matcher of a selection list and lock it for
+ * matching.  A matcher that no longer matches the first entry of the
+ * list, e.g. after the list was edited directly, is discarded.
+ *
+ * Return the locked matcher or NULL if the list is not compiled.
+ ***************************************************************************/
+static SelectMatcher *
+ms_getmatcher (const Selections *selections)
+{
+  SelectMatcher *matcher;
+
+  MATCHERS_LOCK ();
+
+  for (matcher = matchers; matcher; matcher = matcher->nextmatcher)
+  {
+    if (matcher->selections == selections)
+      break;
+  }
+
+  if (matcher && (matcher->timewindows != selections->timewindows ||
+                  matcher->next != selections->next))
+  {
+    MATCHERS_UNLOCK ();
+    ms_dropmatcher (selections);
+    return NULL;
+  }
+
+#if defined(LMP_THREADS)
+  if (matcher)
+    pthread_mutex_lock (&matcher->lock);
+#endif
+
+  MATCHERS_UNLOCK ();
+
+  return matcher;
+} /* End of ms_getmatcher() */
+
+/***************************************************************************
+ * ms_dropmatcher:
+ *
+ * Remove the compiled matcher of a selection list, if any, from the
+ * list of matchers and free it after matching in progress is done.
+ ***************************************************************************/
+static void
+ms_dropmatcher (const Selections *selections)
+{
+  SelectMatcher **pmatcher;
+  SelectMatcher *matcher = NULL;
+
+  MATCHERS_LOCK ();
+
+  for (pmatcher = &matchers; *pmatcher; pmatcher = &(*pmatcher)->nextmatcher)
+  {
+    if ((*pmatcher)->selections == selections)
+    {
+      matcher   = *pmatcher;
+      *pmatcher = matcher->nextmatcher;
+      break;
+    }
+  }
+
+  MATCHERS_UNLOCK ();
+
+  if (!matcher)
+    return;
+
+#if defined(LMP_THREADS)
+  pthread_mutex_lock (&matcher->lock);
+  pthread_mutex_unlock (&matcher->lock);
+#endif
+
+  ms_freematcher (matcher);
+} /* End of ms_dropmatcher() */
+
+/***************************************************************************
+ * ms_selecthash:
+ *
+ * Calculate the FNV-1a hash of a source name.
+ *
+ * Return the hash value.
+ ***************************************************************************/
+static uint32_t
+ms_selecthash (const char *srcname)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*srcname)
+  {
+    hash ^= (uint8_t)*srcname++;
+    hash *= 16777619u;
+  }
+
+  return hash;
+} /* End of ms_selecthash() */
+
+/***************************************************************************
+ * ms_compilewindows:
+ *
+ * Create the sorted time window array of a compiled selection entry,
+ * tracking the latest end time of each window and all earlier windows.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+ms_compilewindows (SelectEntry *entry)
+{
+  SelectTime *selecttime;
+  int idx;
+
+  for (selecttime = entry->selection->timewindows; selecttime; selecttime = selecttime->next)
+    entry->numwindows++;
+
+  if (!entry->numwindows)
+    return 0;
+
+  if (!(entry->windows = (SelectWindow *)malloc (sizeof (SelectWindow) * entry->numwindows)))
+  {
+    ms_log (2, "ms_compileselections(): Cannot allocate memory\n");
+    return -1;
+  }
+
+  for (idx = 0, selecttime = entry->selection->timewindows; selecttime;
+       idx++, selecttime = selecttime->next)
+  {
+    entry->windows[idx].starttime  = (selecttime->starttime == HPTERROR) ? SELECT_TIMEMIN : selecttime->starttime;
+    entry->windows[idx].endtime    = (selecttime->endtime == HPTERROR) ? SELECT_TIMEMAX : selecttime->endtime;
+    entry->windows[idx].order      = idx;
+    entry->windows[idx].selecttime = selecttime;
+  }
+
+  qsort (entry->windows, entry->numwindows, sizeof (SelectWindow), ms_cmpwindow);
+
+  for (idx = 0; idx < entry->numwindows; idx++)
+  {
+    entry->windows[idx].maxend = entry->windows[idx].endtime;
+
+    if (idx > 0 && entry->windows[idx - 1].maxend > entry->windows[idx].maxend)
+      entry->windows[idx].maxend = entry->windows[idx - 1].maxend;
+  }
+
+  return 0;
+} /* End of ms_compilewindows() */
+
+/***************************************************************************
+ * ms_addtrie:
+ *
+ * Add a compiled selection entry with a globbing pattern to the trie
+ * at the node for the literal prefix preceding the first globbing
+ * character.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+ms_addtrie (SelectMatcher *matcher, int entry)
+{
+  SelectNode *nodes;
+  char *cp;
+  int node = 0;
+  int child;
+  int last;
+
+  for (cp = matcher->entries[entry].selection->srcname; *cp && !strchr ("*?[\\", *cp); cp++)
+  {
+    for (child = matcher->nodes[node].child; child; child = matcher->nodes[child].sibling)
+      if (matcher->nodes[child].c == *cp)
+        break;
+
+    if (!child)
+    {
+      if (!(nodes = (SelectNode *)realloc (matcher->nodes, sizeof (SelectNode) * (matcher->numnodes + 1))))
+      {
+        ms_log (2, "ms_compileselections(): Cannot allocate memory\n");
+        return -1;
+      }
+
+      matcher->nodes = nodes;
+      child          = matcher->numnodes++;
+
+      nodes[child].child      = 0;
+      nodes[child].sibling    = nodes[node].child;
+      nodes[child].entries    = -1;
+      nodes[child].c          = *cp;
+      nodes[node].child       = child;
+    }
+
+    node = child;
+  }
+
+  /* Add entry to the end of the node list to keep list order */
+  if ((last = matcher->nodes[node].entries) < 0)
+  {
+    matcher->nodes[node].entries = entry;
+  }
+  else
+  {
+    while (matcher->entries[last].next >= 0)
+      last = matcher->entries[last].next;
+
+    matcher->entries[last].next = entry;
+  }
+
+  return 0;
+} /* End of ms_addtrie() */
+
+/***************************************************************************
+ * ms_matchentries:
+ *
+ * Determine the compiled selection entries matching a source name,
+ * independent of time.  The entries are determined once for each
+ * source name and cached.
+ *
+ * Return a list of entry indexes in list order, setting count to the
+ * number of entries, or NULL if no entries match or on error.
+ ***************************************************************************/
+static int *
+ms_matchentries (SelectMatcher *matcher, char *srcname, int *count)
+{
+  SelectCache *cache;
+  SelectCache *slotp;
+  uint32_t hash = ms_selecthash (srcname);
+  uint32_t size;
+  uint32_t slot;
+  uint32_t idx;
+  int numcandidates = 0;
+  int entry;
+  int node;
+  char *cp;
+
+  *count = 0;
+
+  if (matcher->cache)
+  {
+    for (slot = hash & (matcher->cachesize - 1); matcher->cache[slot].srcname;
+         slot = (slot + 1) & (matcher->cachesize - 1))
+    {
+      if (matcher->cache[slot].hash == hash && !strcmp (matcher->cache[slot].srcname, srcname))
+      {
+        *count = matcher->cache[slot].count;
+        return matcher->cache[slot].entries;
+      }
+    }
+  }
+
+  /* Collect literal entries */
+  for (slot = hash & (matcher->literalsize - 1); matcher->literals[slot] >= 0;
+       slot = (slot + 1) & (matcher->literalsize - 1))
+  {
+    if (!strcmp (matcher->entries[matcher->literals[slot]].selection->srcname, srcname))
+    {
+      for (entry = matcher->literals[slot]; entry >= 0; entry = matcher->entries[entry].next)
+        matcher->candidates[numcandidates++] = entry;
+      break;
+    }
+  }
+
+  /* Collect pattern entries with a prefix of the source name */
+  for (node = 0, cp = srcname;;)
+  {
+    for (entry = matcher->nodes[node].entries; entry >= 0; entry = matcher->entries[entry].next)
+      if (ms_globmatch (srcname, matcher->entries[entry].selection->srcname))
+        matcher->candidates[numcandidates++] = entry;
+
+    if (!*cp)
+      break;
+
+    for (node = matcher->nodes[node].child; node; node = matcher->nodes[node].sibling)
+      if (matcher->nodes[node].c == *cp)
+        break;
+
+    if (!node)
+      break;
+
+    cp++;
+  }
+
+  qsort (matcher->candidates, numcandidates, sizeof (int), ms_cmpint);
+
+  /* Clear the cache if it holds many source names */
+  if (matcher->cachecount >= SELECT_CACHEMAX)
+    ms_freecache (matcher);
+
+  /* Create or grow the cache to be no more than half full */
+  if (!matcher->cache || (matcher->cachecount + 1) * 2 > matcher->cachesize)
+  {
+    size = (matcher->cache) ? matcher->cachesize * 2 : 64;
+
+    if (!(cache = (SelectCache *)calloc (size, sizeof (SelectCache))))
+    {
+      ms_log (2, "ms_matchselect(): Cannot allocate memory\n");
+      return NULL;
+    }
+
+    for (idx = 0; idx < matcher->cachesize; idx++)
+    {
+      if (!matcher->cache[idx].srcname)
+        continue;
+
+      for (slot = matcher->cache[idx].hash & (size - 1); cache[slot].srcname;
+           slot = (slot + 1) & (size - 1))
+        ;
+
+      cache[slot] = matcher->cache[idx];
+    }
+
+    free (matcher->cache);
+    matcher->cache     = cache;
+    matcher->cachesize = size;
+  }
+
+  for (slot = hash & (matcher->cachesize - 1); matcher->cache[slot].srcname;
+       slot = (slot + 1) & (matcher->cachesize - 1))
+    ;
+
+  slotp = &matcher->cache[slot];
+
+  if (!(slotp->srcname = (char *)malloc (strlen (srcname) + 1)) ||
+      (numcandidates && !(slotp->entries = (int *)malloc (sizeof (int) * numcandidates))))
+  {
+    ms_log (2, "ms_matchselect(): Cannot allocate memory\n");
+    free (slotp->srcname);
+    slotp->srcname = NULL;
+    return NULL;
+  }
+
+  strcpy (slotp->srcname, srcname);
+  slotp->hash  = hash;
+  slotp->count = numcandidates;
+
+  if (numcandidates)
+    memcpy (slotp->entries, matcher->candidates, sizeof (int) * numcandidates);
+
+  matcher->cachecount++;
+
+  *count = slotp->count;
+
+  return slotp->entries;
+} /* End of ms_matchentries() */
+
+/***************************************************************************
+ * ms_matchwindow:
+ *
+ * Find the first time window, in time window list order, of a compiled
+ * selection entry that matches the specified times.  A window matches
+ * unless the times are entirely before or after it, with the same
+ * treatment of HPTERROR (unset) times as ms_matchselect().
+ *
+ * The windows starting before the latest of the times are found with
+ * a binary search and scanned backwards until no earlier window ends
+ * after the earliest of the times.
+ *
+ * Return a pointer to the matching SelectWindow or NULL for no match.
+ ***************************************************************************/
+static SelectWindow *
+ms_matchwindow (SelectEntry *entry, hptime_t starttime, hptime_t endtime)
+{
+  SelectWindow *match = NULL;
+  hptime_t latest;
+  hptime_t earliest;
+  int low  = 0;
+  int high = entry->numwindows;
+  int mid;
+  int idx;
+
+  latest   = (starttime == HPTERROR) ? SELECT_TIMEMAX : ((starttime > endtime) ? starttime : endtime);
+  earliest = (endtime == HPTERROR) ? SELECT_TIMEMIN : ((starttime < endtime) ? starttime : endtime);
+
+  while (low < high)
+  {
+    mid = low + (high - low) / 2;
+
+    if (entry->windows[mid].starttime <= latest)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  for (idx = low - 1; idx >= 0 && entry->windows[idx].maxend >= earliest; idx--)
+  {
+    if (entry->windows[idx].endtime >= earliest &&
+        (!match || entry->windows[idx].order < match->order))
+      match = &entry->windows[idx];
+  }
+
+  return match;
+} /* End of ms_matchwindow() */
+
+/***************************************************************************
+ * ms_freecache:
+ *
+ * Free the source name cache of a compiled matcher.
+ ***************************************************************************/
+static void
+ms_freecache (SelectMatcher *matcher)
+{
+  uint32_t idx;
+
+  for (idx = 0; idx < matcher->cachesize; idx++)
+  {
+    free (matcher->cache[idx].srcname);
+    free (matcher->cache[idx].entries);
+  }
+
+  free (matcher->cache);
+
+  matcher->cache      = NULL;
+  matcher->cachesize  = 0;
+  matcher->cachecount = 0;
+} /* End of ms_freecache() */
+
+/***************************************************************************
+ * ms_freematcher:
+ *
+ * Free all memory associated with a compiled matcher.
+ ***************************************************************************/
+static void
+ms_freematcher (SelectMatcher *matcher)
+{
+  int idx;
+
+  if (!matcher)
+    return;
+
+  ms_freecache (matcher);
+
+  if (matcher->entries)
+    for (idx = 0; idx < matcher->numentries; idx++)
+      free (matcher->entries[idx].windows);
+
+  free (matcher->entries);
+  free (matcher->literals);
+  free (matcher->nodes);
+  free (matcher->candidates);
+
+#if defined(LMP_THREADS)
+  pthread_mutex_destroy (&matcher->lock);
+#endif
+
+  free (matcher);
+} /* End of ms_freematcher() */
+
+/***************************************************************************
+ * ms_cmpwindow:
+ *
+ * Compare compiled time windows by start time and list order for
+ * qsort().
+ ***************************************************************************/
+static int
+ms_cmpwindow (const void *a, const void *b)
+{
+  const SelectWindow *wa = (const SelectWindow *)a;
+  const SelectWindow *wb = (const SelectWindow *)b;
+
+  if (wa->starttime != wb->starttime)
+    return (wa->starttime < wb->starttime) ? -1 : 1;
+
+  return wa->order - wb->order;
+} /* End of ms_cmpwindow() */
+
+/***************************************************************************
+ * ms_cmpint:
+ *
+ * Compare integers for qsort().
+ ***************************************************************************/
+static int
+ms_cmpint (const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+} /* End of ms_cmpint() */
+
 /***********************************************************************
  * robust glob pattern matcher
  * ozan s. yigit/dec 1994
@@ -0,0 +1,286 @@
+/***************************************************************************
+ * lmtestpackparallel.c
+ *
+ * A program for libmseed parallel Steim encoding tests.
+ *
+ * Long sample series are generated with a fixed seed and packed with
+ * msr_pack() and with msr_pack_parallel() using multiple workers.  The
+ * records, sample counts and StreamState of both are compared, a
+ * hash of the records is printed with the result of the comparison.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#define VERSION "[libmseed " LIBMSEED_VERSION " example]"
+#define PACKAGE "lmtestpackparallel"
+
+#define NUMSAMPLES 1500000
+#define WORKERS 4
+
+static uint32_t seed = 2463534242u;
+
+static int32_t samples[NUMSAMPLES];
+
+/* Records packed serially and state for record handler */
+struct packresult {
+  char *records;
+  size_t length;
+  size_t size;
+  uint32_t hash;
+  int count;
+  int differ;
+  struct packresult *serial;
+};
+
+static uint32_t xorshift (void);
+static void genseries (int series);
+static void packseries (int series, int encoding, int byteorder, int reclen,
+                        flag flush, flag history);
+static int packtrace (struct packresult *result, int encoding, int byteorder,
+                      int reclen, flag flush, flag history, int workers,
+                      int64_t *packedsamples, StreamState *ststate);
+static void record_handler (char *record, int reclen, void *handlerdata);
+static void print_stdout (char *message);
+
+int
+main (int argc, char **argv)
+{
+  int series;
+
+  /* Redirect libmseed logging facility to stdout for comparison */
+  ms_loginit (print_stdout, NULL, print_stdout, NULL);
+
+  for (series = 0; series < 4; series++)
+  {
+    genseries (series);
+
+    packseries (series, DE_STEIM1, 1, 4096, 1, 0);
+    packseries (series, DE_STEIM1, 0, 512, 1, 1);
+    packseries (series, DE_STEIM2, 1, 4096, 1, 0);
+    packseries (series, DE_STEIM2, 0, 512, 1, 0);
+    packseries (series, DE_STEIM2, 1, 4096, 0, 1);
+  }
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * xorshift:
+ *
+ * Returns the next value of a 32-bit xorshift generator.
+ ***************************************************************************/
+static uint32_t
+xorshift (void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  return seed;
+} /* End of xorshift() */
+
+/***************************************************************************
+ * genseries:
+ *
+ * Generate a series of samples: 0) a slowly varying signal of small
+ * differences, 1) differences of all Steim2 widths, 2) a signal with
+ * bursts of large differences and 3) differences of all widths with
+ * a few that cannot be represented in Steim2.
+ ***************************************************************************/
+static void
+genseries (int series)
+{
+  int32_t diff;
+  uint32_t rand;
+  int width;
+  int idx;
+
+  samples[0] = (int32_t)(xorshift () % 1000);
+
+  for (idx = 1; idx < NUMSAMPLES; idx++)
+  {
+    rand = xorshift ();
+
+    if (series == 0)
+      width = 3 + (rand & 0x1);
+    else if (series == 2)
+      width = ((idx / 5000) % 7 == 3) ? 20 : 6;
+    else if (series == 3 && (rand % 400000) == 0)
+      width = 31;
+    else
+      width = 2 + (rand >> 8) % 28;
+
+    diff = (int32_t)(xorshift () % (1u << width)) - (int32_t)(1u << (width - 1));
+
+    /* Keep the sample values well within range */
+    if ((samples[idx - 1] > 0x20000000 && diff > 0) ||
+        (samples[idx - 1] < -0x20000000 && diff < 0))
+      diff = -diff;
+
+    samples[idx] = samples[idx - 1] + diff;
+  }
+} /* End of genseries() */
+
+/***************************************************************************
+ * packseries:
+ *
+ * Pack the series serially and in parallel, compare the results and
+ * print a summary.
+ ***************************************************************************/
+static void
+packseries (int series, int encoding, int byteorder, int reclen,
+            flag flush, flag history)
+{
+  struct packresult serial;
+  struct packresult parallel;
+  StreamState serialstate;
+  StreamState parallelstate;
+  int64_t serialsamples   = 0;
+  int64_t parallelsamples = 0;
+  int serialrv;
+  int parallelrv;
+  int identical;
+
+  memset (&serial, 0, sizeof (serial));
+  memset (&parallel, 0, sizeof (parallel));
+  parallel.serial = &serial;
+
+  serialrv = packtrace (&serial, encoding, byteorder, reclen, flush, history,
+                        1, &serialsamples, &serialstate);
+  parallelrv = packtrace (&parallel, encoding, byteorder, reclen, flush, history,
+                          WORKERS, &parallelsamples, &parallelstate);
+
+  identical = (serialrv == parallelrv && serialsamples == parallelsamples &&
+               serial.count == parallel.count && !parallel.differ &&
+               serialstate.packedrecords == parallelstate.packedrecords &&
+               serialstate.packedsamples == parallelstate.packedsamples &&
+               serialstate.lastintsample == parallelstate.lastintsample &&
+               serialstate.comphistory == parallelstate.comphistory);
+
+  printf ("Series %d, %s %s %4d-byte%s%s: %d records, %lld samples, hash 0x%08x, %s\n",
+          series, (encoding == DE_STEIM1) ? "Steim1" : "Steim2",
+          (byteorder) ? "MSBF" : "LSBF", reclen,
+          (flush) ? "" : ", no flush", (history) ? ", history" : "",
+          (serialrv < 0) ? serialrv : serial.count, (long long int)serialsamples,
+          serial.hash, (identical) ? "identical" : "DIFFERENT");
+
+  free (serial.records);
+} /* End of packseries() */
+
+/***************************************************************************
+ * packtrace:
+ *
+ * Pack the series with msr_pack_parallel() using the specified number
+ * of workers, returning the StreamState in ststate.
+ *
+ * Returns the return value of msr_pack_parallel().
+ ***************************************************************************/
+static int
+packtrace (struct packresult *result, int encoding, int byteorder, int reclen,
+           flag flush, flag history, int workers, int64_t *packedsamples,
+           StreamState *ststate)
+{
+  MSRecord *msr = NULL;
+  int rv;
+
+  if (!(msr = msr_init (msr)) ||
+      !(msr->ststate = (StreamState *)calloc (1, sizeof (StreamState))))
+  {
+    fprintf (stderr, "Could not allocate MSRecord, out of memory?\n");
+    exit (1);
+  }
+
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "TEST");
+  strcpy (msr->channel, "HHZ");
+  msr->dataquality = 'D';
+  msr->starttime   = ms_timestr2hptime ("2012-01-01T00:00:00");
+  msr->samprate    = 200.0;
+  msr->reclen      = reclen;
+  msr->encoding    = encoding;
+  msr->byteorder   = byteorder;
+  msr->numsamples  = NUMSAMPLES;
+  msr->samplecnt   = NUMSAMPLES;
+  msr->datasamples = samples;
+  msr->sampletype  = 'i';
+
+  /* Continue from a previously packed sample */
+  if (history)
+  {
+    msr->ststate->comphistory   = 1;
+    msr->ststate->lastintsample = samples[0] - 12345;
+  }
+
+  result->hash = 2166136261u;
+
+  rv = msr_pack_parallel (msr, record_handler, result, packedsamples, flush,
+                          workers, 0);
+
+  memcpy (ststate, msr->ststate, sizeof (StreamState));
+
+  msr->datasamples = NULL;
+  msr_free (&msr);
+
+  return rv;
+} /* End of packtrace() */
+
+/***************************************************************************
+ * record_handler:
+ *
+ * Update the hash of packed records, retain serially packed records
+ * and compare records packed in parallel with them.
+ ***************************************************************************/
+static void
+record_handler (char *record, int reclen, void *handlerdata)
+{
+  struct packresult *result = (struct packresult *)handlerdata;
+  struct packresult *serial = result->serial;
+  int idx;
+
+  for (idx = 0; idx < reclen; idx++)
+  {
+    result->hash ^= (uint8_t)record[idx];
+    result->hash *= 16777619u;
+  }
+
+  if (serial)
+  {
+    if (result->length + reclen > serial->length ||
+        memcmp (serial->records + result->length, record, reclen))
+      result->differ = 1;
+  }
+  else
+  {
+    if (result->length + reclen > result->size)
+    {
+      result->size = (result->size) ? result->size * 2 : 1048576;
+
+      if (!(result->records = (char *)realloc (result->records, result->size)))
+      {
+        fprintf (stderr, "Could not allocate record buffer, out of memory?\n");
+        exit (1);
+      }
+    }
+
+    memcpy (result->records + result->length, record, reclen);
+  }
+
+  result->length += reclen;
+  result->count++;
+} /* End of record_handler() */
+
+/***************************************************************************
+ * print_stdout():
+ * Print messsage to stdout.
+ ***************************************************************************/
+static void
+print_stdout (char *message)
+{
+  fprintf (stdout, "%s", message);
+} /* End of print_stdout() */
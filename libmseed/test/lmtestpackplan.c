@@ -0,0 +1,344 @@
+/***************************************************************************
+ * lmtestpackplan.c
+ *
+ * A program for libmseed record length planning tests.
+ *
+ * Sample series are generated with a fixed seed and packed with
+ * msr_pack_reclens() choosing from a set of record lengths.  The
+ * records are unpacked and compared with the series, the record
+ * lengths and total length are printed with the total length of
+ * packing with each single record length in the set.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#define VERSION "[libmseed " LIBMSEED_VERSION " example]"
+#define PACKAGE "lmtestpackplan"
+
+#define MAXSAMPLES 400000
+
+static uint32_t seed = 2463534242u;
+
+static int32_t samples[MAXSAMPLES];
+
+/* Packed records and state for record handler */
+struct packresult {
+  char *records;
+  size_t length;
+  size_t size;
+  int count;
+  int lastreclen;
+  int runrecords;
+  char runs[256];
+};
+
+static uint32_t xorshift (void);
+static void genseries (int series, int numsamples);
+static void planseries (int series, int numsamples, int encoding,
+                        const int *reclens, int reclencount, flag history);
+static int packtrace (struct packresult *result, int numsamples, int encoding,
+                      const int *reclens, int reclencount, flag history);
+static int verifyrecords (struct packresult *result, int numsamples, int encoding);
+static void addrun (struct packresult *result);
+static void record_handler (char *record, int reclen, void *handlerdata);
+static void print_stdout (char *message);
+
+int
+main (int argc, char **argv)
+{
+  int steimlens[3] = {4096, 1024, 512};
+  int smalllens[2] = {512, 256};
+  int int32lens[2] = {4096, 512};
+  int numsamples[3] = {1000, 43210, 400000};
+  int series;
+  int idx;
+
+  /* Redirect libmseed logging facility to stdout for comparison */
+  ms_loginit (print_stdout, NULL, print_stdout, NULL);
+
+  for (series = 0; series < 3; series++)
+  {
+    for (idx = 0; idx < 3; idx++)
+    {
+      genseries (series, numsamples[idx]);
+
+      planseries (series, numsamples[idx], DE_STEIM1, steimlens, 3, 0);
+      planseries (series, numsamples[idx], DE_STEIM2, steimlens, 3, 1);
+      planseries (series, numsamples[idx], DE_STEIM2, smalllens, 2, 0);
+      planseries (series, numsamples[idx], DE_INT32, int32lens, 2, 0);
+    }
+  }
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * xorshift:
+ *
+ * Returns the next value of a 32-bit xorshift generator.
+ ***************************************************************************/
+static uint32_t
+xorshift (void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  return seed;
+} /* End of xorshift() */
+
+/***************************************************************************
+ * genseries:
+ *
+ * Generate a series of samples: 0) a slowly varying signal of small
+ * differences, 1) differences of all Steim2 widths and 2) a signal with
+ * bursts of large differences.
+ ***************************************************************************/
+static void
+genseries (int series, int numsamples)
+{
+  int32_t diff;
+  uint32_t rand;
+  int width;
+  int idx;
+
+  samples[0] = (int32_t)(xorshift () % 1000);
+
+  for (idx = 1; idx < numsamples; idx++)
+  {
+    rand = xorshift ();
+
+    if (series == 0)
+      width = 3 + (rand & 0x1);
+    else if (series == 2)
+      width = ((idx / 5000) % 7 == 3) ? 20 : 6;
+    else
+      width = 2 + (rand >> 8) % 28;
+
+    diff = (int32_t)(xorshift () % (1u << width)) - (int32_t)(1u << (width - 1));
+
+    /* Keep the sample values well within range */
+    if ((samples[idx - 1] > 0x20000000 && diff > 0) ||
+        (samples[idx - 1] < -0x20000000 && diff < 0))
+      diff = -diff;
+
+    samples[idx] = samples[idx - 1] + diff;
+  }
+} /* End of genseries() */
+
+/***************************************************************************
+ * planseries:
+ *
+ * Pack the series with the set of record lengths and with each single
+ * length, verify the records and print a summary.
+ ***************************************************************************/
+static void
+planseries (int series, int numsamples, int encoding,
+            const int *reclens, int reclencount, flag history)
+{
+  struct packresult planned;
+  struct packresult single;
+  char lengths[64];
+  char singles[128];
+  size_t smallest = 0;
+  int verified;
+  int rv;
+  int idx;
+
+  memset (&planned, 0, sizeof (planned));
+
+  rv       = packtrace (&planned, numsamples, encoding, reclens, reclencount, history);
+  verified = (rv == planned.count) && !verifyrecords (&planned, numsamples, encoding);
+
+  lengths[0] = singles[0] = '\0';
+  for (idx = 0; idx < reclencount; idx++)
+  {
+    memset (&single, 0, sizeof (single));
+    packtrace (&single, numsamples, encoding, reclens + idx, 1, history);
+
+    if (!smallest || single.length < smallest)
+      smallest = single.length;
+
+    snprintf (lengths + strlen (lengths), sizeof (lengths) - strlen (lengths),
+              "%s%d", (idx) ? "," : "", reclens[idx]);
+    snprintf (singles + strlen (singles), sizeof (singles) - strlen (singles),
+              "%s%d: %lu", (idx) ? ", " : "", reclens[idx], (unsigned long)single.length);
+
+    free (single.records);
+  }
+
+  printf ("Series %d, %d samples, %s %s%s: %d records (%s), %lu bytes, single %s, %s\n",
+          series, numsamples, (encoding == DE_STEIM1) ? "Steim1" :
+          (encoding == DE_STEIM2) ? "Steim2" : "Int32", lengths,
+          (history) ? ", history" : "", planned.count, planned.runs,
+          (unsigned long)planned.length, singles,
+          (!verified) ? "NOT VERIFIED" : (planned.length > smallest) ? "LARGER" : "verified");
+
+  free (planned.records);
+} /* End of planseries() */
+
+/***************************************************************************
+ * packtrace:
+ *
+ * Pack the series with msr_pack_reclens() and the set of record
+ * lengths.
+ *
+ * Returns the return value of msr_pack_reclens().
+ ***************************************************************************/
+static int
+packtrace (struct packresult *result, int numsamples, int encoding,
+           const int *reclens, int reclencount, flag history)
+{
+  MSRecord *msr = NULL;
+  int64_t packedsamples = 0;
+  int rv;
+
+  if (!(msr = msr_init (msr)) ||
+      !(msr->ststate = (StreamState *)calloc (1, sizeof (StreamState))))
+  {
+    fprintf (stderr, "Could not allocate MSRecord, out of memory?\n");
+    exit (1);
+  }
+
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "TEST");
+  strcpy (msr->channel, "HHZ");
+  msr->dataquality = 'D';
+  msr->starttime   = ms_timestr2hptime ("2012-01-01T00:00:00");
+  msr->samprate    = 100.0;
+  msr->encoding    = encoding;
+  msr->byteorder   = 1;
+  msr->numsamples  = numsamples;
+  msr->samplecnt   = numsamples;
+  msr->datasamples = samples;
+  msr->sampletype  = 'i';
+
+  /* Continue from a previously packed sample */
+  if (history)
+  {
+    msr->ststate->comphistory   = 1;
+    msr->ststate->lastintsample = samples[0] - 12345;
+  }
+
+  rv = msr_pack_reclens (msr, record_handler, result, &packedsamples, 1,
+                         reclens, reclencount, 1, 0);
+
+  if (packedsamples != numsamples)
+    rv = -1;
+
+  addrun (result);
+
+  msr->datasamples = NULL;
+  msr_free (&msr);
+
+  return rv;
+} /* End of packtrace() */
+
+/***************************************************************************
+ * verifyrecords:
+ *
+ * Unpack the records and compare the samples and start times with the
+ * series.
+ *
+ * Returns 0 if all samples and start times match and -1 otherwise.
+ ***************************************************************************/
+static int
+verifyrecords (struct packresult *result, int numsamples, int encoding)
+{
+  MSRecord *msr = NULL;
+  hptime_t starttime = ms_timestr2hptime ("2012-01-01T00:00:00");
+  size_t offset   = 0;
+  int64_t sampleidx = 0;
+  int reclen;
+  int retval = 0;
+
+  while (offset < result->length && !retval)
+  {
+    reclen = ms_detect (result->records + offset, result->length - offset);
+
+    if (reclen <= 0 ||
+        msr_unpack (result->records + offset, reclen, &msr, 1, 0) != MS_NOERROR ||
+        msr->encoding != encoding ||
+        sampleidx + msr->numsamples > numsamples ||
+        memcmp (msr->datasamples, samples + sampleidx, msr->numsamples * sizeof (int32_t)) ||
+        msr->starttime != starttime + (hptime_t) (sampleidx / 100.0 * HPTMODULUS + 0.5))
+    {
+      retval = -1;
+      break;
+    }
+
+    sampleidx += msr->numsamples;
+    offset += reclen;
+  }
+
+  if (sampleidx != numsamples)
+    retval = -1;
+
+  msr_free (&msr);
+
+  return retval;
+} /* End of verifyrecords() */
+
+/***************************************************************************
+ * addrun:
+ *
+ * Add the run of records of the same length to the summary.
+ ***************************************************************************/
+static void
+addrun (struct packresult *result)
+{
+  if (result->runrecords)
+    snprintf (result->runs + strlen (result->runs), sizeof (result->runs) - strlen (result->runs),
+              "%s%d x%d", (*result->runs) ? ", " : "", result->lastreclen, result->runrecords);
+
+  result->runrecords = 0;
+} /* End of addrun() */
+
+/***************************************************************************
+ * record_handler:
+ *
+ * Retain packed records and count runs of records of the same length.
+ ***************************************************************************/
+static void
+record_handler (char *record, int reclen, void *handlerdata)
+{
+  struct packresult *result = (struct packresult *)handlerdata;
+
+  if (reclen != result->lastreclen)
+    addrun (result);
+
+  result->lastreclen = reclen;
+  result->runrecords++;
+
+  if (result->length + reclen > result->size)
+  {
+    result->size = (result->size) ? result->size * 2 : 1048576;
+
+    if (!(result->records = (char *)realloc (result->records, result->size)))
+    {
+      fprintf (stderr, "Could not allocate record buffer, out of memory?\n");
+      exit (1);
+    }
+  }
+
+  memcpy (result->records + result->length, record, reclen);
+
+  result->length += reclen;
+  result->count++;
+} /* End of record_handler() */
+
+/***************************************************************************
+ * print_stdout():
+ * Print messsage to stdout.
+ ***************************************************************************/
+static void
+print_stdout (char *message)
+{
+  fprintf (stdout, "%s", message);
+} /* End of print_stdout() */
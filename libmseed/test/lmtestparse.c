@@ -5,7 +5,7 @@
  *
  * Written by Chad Trabant, IRIS Data Management Center
  *
- * modified 2016.275
+ * modified 2026.291
  ***************************************************************************/
 
 #include <errno.h>
@@ -26,6 +26,9 @@ static flag tracegap   = 0;
 static int printraw    = 0;
 static int printdata   = 0;
 static int reclen      = -1;
+static int workers     = 0;
+static flag scanheader = 0;
+static flag mapfile    = 0;
 static char *inputfile = 0;
 
 static double timetol     = -1.0; /* Time tolerance for continuous traces */
@@ -45,10 +48,11 @@ main (int argc, char **argv)
 {
   MSTraceList *mstl = 0;
   MSRecord *msr     = 0;
+  MSFileParam *msfp = 0;
 
   int64_t totalrecs  = 0;
   int64_t totalsamps = 0;
-  int retcode;
+  int retcode = MS_NOERROR;
 
   /* Redirect libmseed logging facility to stderr for consistency */
   ms_loginit (print_stderr, NULL, print_stderr, NULL);
@@ -60,9 +64,31 @@ main (int argc, char **argv)
   if (tracegap)
     mstl = mstl_init (NULL);
 
+  /* Scan trace list from record headers */
+  if (tracegap && scanheader)
+  {
+    retcode = ms_scantracelist (&mstl, inputfile, reclen, timetol, sampratetol,
+                                NULL, 0, 1, verbose);
+
+    if (retcode == MS_NOERROR)
+      retcode = MS_ENDOFFILE;
+  }
+  /* Read trace list with multiple threads */
+  else if (tracegap && workers > 0)
+  {
+    retcode = ms_readtracelist_parallel (&mstl, inputfile, reclen, timetol, sampratetol,
+                                         NULL, 0, 1, printdata, workers, verbose);
+
+    if (retcode == MS_NOERROR)
+      retcode = MS_ENDOFFILE;
+  }
+
   /* Loop over the input file */
-  while ((retcode = ms_readmsr (&msr, inputfile, reclen, NULL, NULL, 1,
-                                printdata, verbose)) == MS_NOERROR)
+  while (retcode == MS_NOERROR &&
+         (retcode = (mapfile) ? ms_readmsr_map (&msfp, &msr, inputfile, reclen, NULL, NULL, 1,
+                                                printdata, verbose)
+                              : ms_readmsr (&msr, inputfile, reclen, NULL, NULL, 1,
+                                            printdata, verbose)) == MS_NOERROR)
   {
     totalrecs++;
     totalsamps += msr->samplecnt;
@@ -151,7 +177,10 @@ main (int argc, char **argv)
     mstl_printtracelist (mstl, 0, 1, 1);
 
   /* Make sure everything is cleaned up */
-  ms_readmsr (&msr, NULL, 0, NULL, NULL, 0, 0, 0);
+  if (mapfile)
+    ms_readmsr_map (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, 0);
+  else
+    ms_readmsr (&msr, NULL, 0, NULL, NULL, 0, 0, 0);
 
   if (mstl)
     mstl_free (&mstl, 0);
@@ -219,6 +248,18 @@ parameter_proc (int argcount, char **argvec)
     {
       reclen = atoi (argvec[++optind]);
     }
+    else if (strcmp (argvec[optind], "-H") == 0)
+    {
+      scanheader = 1;
+    }
+    else if (strcmp (argvec[optind], "-M") == 0)
+    {
+      mapfile = 1;
+    }
+    else if (strcmp (argvec[optind], "-P") == 0)
+    {
+      workers = atoi (argvec[++optind]);
+    }
     else if (strncmp (argvec[optind], "-", 1) == 0 &&
              strlen (argvec[optind]) > 1)
     {
@@ -281,6 +322,9 @@ usage (void)
            " -d             Print first 6 sample values\n"
            " -D             Print all sample values\n"
            " -tg            Print trace listing with gap information\n"
+           " -P threads     Read trace listing using multiple threads\n"
+           " -H             Read trace listing from record headers only\n"
+           " -M             Read the file through a memory mapping\n"
            " -s             Print a basic summary after processing a file\n"
            " -r bytes       Specify record length in bytes, required if no Blockette 1000\n"
            "\n"
@@ -0,0 +1,349 @@
+/***************************************************************************
+ * lmtestselect.c
+ *
+ * A program for libmseed selection matching tests.
+ *
+ * A selection list of literal source names and globbing patterns with
+ * overlapping, open and unset time windows is matched against
+ * pseudo-random source names and time ranges.  The results of
+ * matching against the compiled list are compared to the results of
+ * searching the list in order, also when matched by concurrent
+ * threads and after an entry was linked into the list directly.  A
+ * selection file read with ms_readselectionsfile() is matched.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <libmseed.h>
+
+#define VERSION "[libmseed " LIBMSEED_VERSION " example]"
+#define PACKAGE "lmtestselect"
+
+#define MAXQUERIES 20000
+#define THREADS 4
+
+static uint32_t seed = 2463534242u;
+
+static char *networks[] = {"IU", "II", "XX", "GE"};
+static char *stations[] = {"ANMO", "COLA", "KONO", "BFO", "TEST", "S1", "S10", "S100"};
+static char *locations[] = {"", "00", "10"};
+static char *channels[] = {"BHZ", "BHN", "LHZ", "HHZ", "SHZ"};
+static char *qualities[] = {"D", "R", "Q", "M"};
+
+static char querysrc[MAXQUERIES][50];
+static hptime_t querystart[MAXQUERIES];
+static hptime_t queryend[MAXQUERIES];
+static Selections *matchsl[MAXQUERIES];
+static SelectTime *matchst[MAXQUERIES];
+
+/* Selection list and result of a matching thread */
+struct querythread {
+  pthread_t thread;
+  Selections *selections;
+  int mismatches;
+};
+
+static uint32_t xorshift (void);
+static hptime_t mkhptime (void);
+static int addselections (Selections **ppselections, int count);
+static void mkqueries (void);
+static int runqueries (Selections *selections, flag compare, int *matches);
+static void *runthread (void *arg);
+static void print_stdout (char *message);
+
+int
+main (int argc, char **argv)
+{
+  Selections *selections = NULL;
+  Selections *fileselections = NULL;
+  Selections *edit;
+  struct querythread threads[THREADS];
+  int mismatches;
+  int matches;
+  int count;
+  int idx;
+
+  /* Redirect libmseed logging facility to stdout for comparison */
+  ms_loginit (print_stdout, NULL, print_stdout, NULL);
+
+  if (addselections (&selections, 2000))
+    return 1;
+
+  mkqueries ();
+
+  /* Match against the list in order and against the compiled list */
+  runqueries (selections, 0, &matches);
+
+  if (ms_compileselections (selections))
+    return 1;
+
+  mismatches = runqueries (selections, 1, &matches);
+  printf ("Compiled selections: %d queries, %d matches, %d mismatches\n",
+          MAXQUERIES, matches, mismatches);
+
+  /* Repeat to match against cached source names */
+  mismatches = runqueries (selections, 1, &matches);
+  printf ("Cached selections: %d queries, %d matches, %d mismatches\n",
+          MAXQUERIES, matches, mismatches);
+
+  /* Adding selections releases the matcher, compile again */
+  if (addselections (&selections, 200))
+    return 1;
+
+  runqueries (selections, 0, &matches);
+
+  if (ms_compileselections (selections))
+    return 1;
+
+  mismatches = runqueries (selections, 1, &matches);
+  printf ("Recompiled selections: %d queries, %d matches, %d mismatches\n",
+          MAXQUERIES, matches, mismatches);
+
+  /* Link an entry matching everything after the first entry directly,
+   * the matcher must be discarded and the list searched in order */
+  if (!(edit = (Selections *)calloc (1, sizeof (Selections))) ||
+      !(edit->timewindows = (SelectTime *)calloc (1, sizeof (SelectTime))))
+    return 1;
+
+  strcpy (edit->srcname, "*");
+  edit->timewindows->starttime = HPTERROR;
+  edit->timewindows->endtime   = HPTERROR;
+  edit->next                   = selections->next;
+  selections->next             = edit;
+
+  runqueries (selections, 0, &matches);
+
+  if (ms_compileselections (selections))
+    return 1;
+
+  mismatches = runqueries (selections, 1, &matches);
+  printf ("Edited selections: %d queries, %d matches, %d mismatches\n",
+          MAXQUERIES, matches, mismatches);
+
+  /* Match from concurrent threads starting with an empty cache */
+  if (ms_compileselections (selections))
+    return 1;
+
+  for (idx = 0; idx < THREADS; idx++)
+  {
+    threads[idx].selections = selections;
+    if (pthread_create (&threads[idx].thread, NULL, runthread, &threads[idx]))
+      return 1;
+  }
+
+  for (mismatches = 0, idx = 0; idx < THREADS; idx++)
+  {
+    pthread_join (threads[idx].thread, NULL);
+    mismatches += threads[idx].mismatches;
+  }
+
+  printf ("Threaded selections: %d threads, %d mismatches\n", THREADS, mismatches);
+
+  ms_freeselections (selections);
+
+  /* Lists read from a file are compiled */
+  if ((count = ms_readselectionsfile (&fileselections, "data/selections.txt")) < 0)
+    return 1;
+
+  runqueries (fileselections, 0, &matches);
+  printf ("File selections: %d read, %d matches\n", count, matches);
+
+  ms_freeselections (fileselections);
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * xorshift:
+ *
+ * Returns the next value of a 32-bit xorshift generator.
+ ***************************************************************************/
+static uint32_t
+xorshift (void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  return seed;
+} /* End of xorshift() */
+
+/***************************************************************************
+ * mkhptime:
+ *
+ * Returns a time within a 10 day period or HPTERROR in 1 of 8 cases.
+ ***************************************************************************/
+static hptime_t
+mkhptime (void)
+{
+  if ((xorshift () & 0x7) == 0)
+    return HPTERROR;
+
+  return ms_timestr2hptime ("2012-01-01T00:00:00") +
+         (hptime_t) (xorshift () % 864000) * HPTMODULUS;
+} /* End of mkhptime() */
+
+/***************************************************************************
+ * addselections:
+ *
+ * Add selections with literal and globbing source names, each with one
+ * or more time windows.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addselections (Selections **ppselections, int count)
+{
+  char station[20];
+  char channel[20];
+  char *net;
+  char *loc;
+  char *qual;
+  hptime_t starttime;
+  hptime_t endtime;
+  int windows;
+  int idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    net  = networks[xorshift () % 4];
+    loc  = locations[xorshift () % 3];
+    qual = qualities[xorshift () % 4];
+
+    snprintf (station, sizeof (station), "%s", stations[xorshift () % 8]);
+    snprintf (channel, sizeof (channel), "%s", channels[xorshift () % 5]);
+
+    /* Replace parts of some source names with globbing patterns */
+    switch (xorshift () % 8)
+    {
+    case 0:
+      strcpy (station + 1, "*");
+      break;
+    case 1:
+      strcpy (channel, "?H?");
+      break;
+    case 2:
+      strcpy (channel, "[BL]HZ");
+      break;
+    case 3:
+      net = "*";
+      break;
+    case 4:
+      qual = NULL;
+      break;
+    }
+
+    for (windows = 1 + (xorshift () % 3); windows > 0; windows--)
+    {
+      starttime = mkhptime ();
+      endtime   = mkhptime ();
+
+      if (starttime != HPTERROR && endtime != HPTERROR && starttime > endtime)
+      {
+        hptime_t swap = starttime;
+        starttime     = endtime;
+        endtime       = swap;
+      }
+
+      if (ms_addselect_comp (ppselections, net, station, loc, channel, qual,
+                             starttime, endtime))
+        return -1;
+    }
+  }
+
+  return 0;
+} /* End of addselections() */
+
+/***************************************************************************
+ * mkqueries:
+ *
+ * Generate source names and time ranges to match.
+ ***************************************************************************/
+static void
+mkqueries (void)
+{
+  int idx;
+
+  for (idx = 0; idx < MAXQUERIES; idx++)
+  {
+    snprintf (querysrc[idx], sizeof (querysrc[idx]), "%s_%s_%s_%s_%s",
+              networks[xorshift () % 4], stations[xorshift () % 8],
+              locations[xorshift () % 3], channels[xorshift () % 5],
+              qualities[xorshift () % 4]);
+
+    querystart[idx] = mkhptime ();
+    queryend[idx]   = mkhptime ();
+  }
+} /* End of mkqueries() */
+
+/***************************************************************************
+ * runqueries:
+ *
+ * Match the queries against a selection list, storing the results or
+ * comparing them to the stored results if compare is true.
+ *
+ * Returns the number of results that differ from the stored results.
+ ***************************************************************************/
+static int
+runqueries (Selections *selections, flag compare, int *matches)
+{
+  Selections *sl;
+  SelectTime *st;
+  int mismatches = 0;
+  int idx;
+
+  *matches = 0;
+
+  for (idx = 0; idx < MAXQUERIES; idx++)
+  {
+    sl = ms_matchselect (selections, querysrc[idx], querystart[idx], queryend[idx], &st);
+
+    if (sl)
+      (*matches)++;
+
+    if (!compare)
+    {
+      matchsl[idx] = sl;
+      matchst[idx] = st;
+    }
+    else if (sl != matchsl[idx] || st != matchst[idx])
+    {
+      mismatches++;
+    }
+  }
+
+  return mismatches;
+} /* End of runqueries() */
+
+/***************************************************************************
+ * runthread:
+ *
+ * Thread start routine comparing the matches of the queries against
+ * the stored results.
+ ***************************************************************************/
+static void *
+runthread (void *arg)
+{
+  struct querythread *qt = (struct querythread *)arg;
+  int matches;
+
+  qt->mismatches = runqueries (qt->selections, 1, &matches);
+
+  return NULL;
+} /* End of runthread() */
+
+/***************************************************************************
+ * print_stdout():
+ * Print messsage to stdout.
+ ***************************************************************************/
+static void
+print_stdout (char *message)
+{
+  fprintf (stdout, "%s", message);
+} /* End of print_stdout() */
@@ -0,0 +1,239 @@
+/***************************************************************************
+ * lmteststeim.c
+ *
+ * A program for libmseed Steim encoding tests with pseudo-random input.
+ *
+ * Sample series are generated with a fixed seed such that successive
+ * differences cover all Steim difference widths including the limits
+ * of each width.  Each series is packed with Steim1 and Steim2 in both
+ * byte orders, a hash of the records is printed and the records are
+ * unpacked and compared to the input.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#define VERSION "[libmseed " LIBMSEED_VERSION " example]"
+#define PACKAGE "lmteststeim"
+
+#define SERIESCOUNT 32
+#define MAXSAMPLES 3000
+
+/* Limits of Steim difference widths, a zero limit is a full range value */
+static int32_t limits[] = {8, 16, 32, 128, 512, 16384, 32768, 536870912, 0};
+
+static uint32_t seed = 2463534242u;
+
+static int32_t samples[MAXSAMPLES];
+
+/* State for record handler */
+struct packresult {
+  uint32_t hash;
+  int records;
+  int samples;
+  int errors;
+};
+
+static uint32_t xorshift (void);
+static int32_t randomdiff (int series);
+static void packseries (int series, int numsamples, int encoding, int byteorder);
+static void record_handler (char *record, int reclen, void *handlerdata);
+static void print_stdout (char *message);
+
+int
+main (int argc, char **argv)
+{
+  int32_t diff;
+  int numsamples;
+  int series;
+  int idx;
+
+  /* Redirect libmseed logging facility to stdout for comparison */
+  ms_loginit (print_stdout, NULL, print_stdout, NULL);
+
+  for (series = 0; series < SERIESCOUNT; series++)
+  {
+    numsamples = 1 + (xorshift () % MAXSAMPLES);
+
+    samples[0] = (int32_t)xorshift () % 1000;
+
+    for (idx = 1; idx < numsamples; idx++)
+    {
+      diff = randomdiff (series);
+
+      /* Avoid overflow of the sample values by reversing the difference,
+       * the one's complement stays within the same width */
+      if ((diff > 0 && samples[idx - 1] > INT32_MAX - diff) ||
+          (diff < 0 && samples[idx - 1] < INT32_MIN - diff))
+        diff = ~diff;
+
+      samples[idx] = samples[idx - 1] + diff;
+    }
+
+    packseries (series, numsamples, DE_STEIM1, 1);
+    packseries (series, numsamples, DE_STEIM1, 0);
+    packseries (series, numsamples, DE_STEIM2, 1);
+    packseries (series, numsamples, DE_STEIM2, 0);
+  }
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * xorshift:
+ *
+ * Returns the next value of a 32-bit xorshift generator.
+ ***************************************************************************/
+static uint32_t
+xorshift (void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  return seed;
+} /* End of xorshift() */
+
+/***************************************************************************
+ * randomdiff:
+ *
+ * Generate a random difference.  Lower numbered series are limited to
+ * 30-bit differences that can be encoded with Steim2, higher numbered
+ * series include full range differences.  Values at the limits of
+ * each difference width are favored.
+ *
+ * Returns the difference.
+ ***************************************************************************/
+static int32_t
+randomdiff (int series)
+{
+  uint32_t rand = xorshift ();
+  int32_t limit;
+  int width;
+
+  /* Select a width, weighted toward the width of the series */
+  if (rand & 0x1)
+    width = series % 8;
+  else
+    width = (rand >> 1) % ((series < 24) ? 8 : 9);
+
+  limit = limits[width];
+  rand  = xorshift ();
+
+  if (limit == 0)
+    return (int32_t)rand;
+
+  switch (rand & 0x7)
+  {
+  case 0:
+    return limit - 1;
+  case 1:
+    return -limit;
+  case 2:
+    return (width > 0) ? limits[width - 1] : 0;
+  case 3:
+    return (width > 0) ? -limits[width - 1] - 1 : -1;
+  default:
+    return (int32_t)((rand >> 3) % (2 * (uint32_t)limit)) - limit;
+  }
+} /* End of randomdiff() */
+
+/***************************************************************************
+ * packseries:
+ *
+ * Pack a series of samples, print a summary and verify that unpacked
+ * samples match the input.
+ ***************************************************************************/
+static void
+packseries (int series, int numsamples, int encoding, int byteorder)
+{
+  struct packresult result;
+  MSRecord *msr = NULL;
+  int64_t packedsamples = 0;
+  int rv;
+
+  if (!(msr = msr_init (msr)))
+  {
+    fprintf (stderr, "Could not allocate MSRecord, out of memory?\n");
+    exit (1);
+  }
+
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "TEST");
+  strcpy (msr->channel, "LHZ");
+  msr->dataquality = 'R';
+  msr->starttime   = ms_timestr2hptime ("2012-01-01T00:00:00");
+  msr->samprate    = 1.0;
+  msr->reclen      = 256;
+  msr->encoding    = encoding;
+  msr->byteorder   = byteorder;
+  msr->numsamples  = numsamples;
+  msr->samplecnt   = numsamples;
+  msr->datasamples = samples;
+  msr->sampletype  = 'i';
+
+  memset (&result, 0, sizeof (result));
+  result.hash = 2166136261u;
+
+  rv = msr_pack (msr, record_handler, &result, &packedsamples, 1, 0);
+
+  printf ("Series %2d, %s %s: %d samples, %d records, hash 0x%08x, %s\n",
+          series, (encoding == DE_STEIM1) ? "Steim1" : "Steim2",
+          (byteorder) ? "MSBF" : "LSBF", numsamples, (rv < 0) ? rv : result.records,
+          result.hash, (result.errors) ? "MISMATCH" : (rv < 0) ? "not packed" : "verified");
+
+  msr->datasamples = NULL;
+  msr_free (&msr);
+} /* End of packseries() */
+
+/***************************************************************************
+ * record_handler:
+ *
+ * Update the hash of packed records and compare unpacked samples with
+ * the input samples.
+ ***************************************************************************/
+static void
+record_handler (char *record, int reclen, void *handlerdata)
+{
+  struct packresult *result = (struct packresult *)handlerdata;
+  MSRecord *msr = NULL;
+  int idx;
+
+  for (idx = 0; idx < reclen; idx++)
+  {
+    result->hash ^= (uint8_t)record[idx];
+    result->hash *= 16777619u;
+  }
+
+  result->records++;
+
+  if (msr_unpack (record, reclen, &msr, 1, 0) != MS_NOERROR)
+  {
+    result->errors++;
+    return;
+  }
+
+  if ((result->samples + msr->numsamples) > MAXSAMPLES ||
+      memcmp (msr->datasamples, samples + result->samples,
+              msr->numsamples * sizeof (int32_t)))
+    result->errors++;
+
+  result->samples += msr->numsamples;
+
+  msr_free (&msr);
+} /* End of record_handler() */
+
+/***************************************************************************
+ * print_stdout():
+ * Print messsage to stdout.
+ ***************************************************************************/
+static void
+print_stdout (char *message)
+{
+  fprintf (stdout, "%s", message);
+} /* End of print_stdout() */
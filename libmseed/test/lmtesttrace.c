@@ -0,0 +1,680 @@
+/***************************************************************************
+ * lmtesttrace.c
+ *
+ * A program for libmseed trace assembly tests.
+ *
+ * A pseudo-random sample series is split into records of varying
+ * length that are added to MSTraceGroup and MSTraceList containers in
+ * an order mixing additions at the end and beginning of traces, or in
+ * a random order joining segments.  The assembled samples are compared
+ * to the series before and after shrinking the sample buffers.  Records
+ * with gaps between them are added to MSTraceList containers in
+ * reversed and random order to test the segment index with many
+ * segments added out of time order, also after a segment was removed
+ * directly from the list.  Overlapping traces, traces of
+ * another sample rate and of another quality are healed in a
+ * MSTraceGroup to test that contiguous traces are merged.  Records of
+ * several channels are added to a copy of a MSTraceList structure to
+ * test that the trace ID index follows the list.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#define VERSION "[libmseed " LIBMSEED_VERSION " example]"
+#define PACKAGE "lmtesttrace"
+
+#define MAXSAMPLES 20000
+#define MAXRECORDS 1000
+
+/* Order of adding records */
+#define ORDER_EXTEND 0
+#define ORDER_RANDOM 1
+#define ORDER_REVERSE 2
+
+/* Every GAPRECORDS record is omitted to leave a gap */
+#define GAPRECORDS 4
+
+static uint32_t seed = 2463534242u;
+
+static double series[MAXSAMPLES];
+static char samples[MAXSAMPLES * sizeof (double)];
+static int64_t recstart[MAXRECORDS];
+static int64_t reccount[MAXRECORDS];
+static int order[MAXRECORDS];
+static int numrecords;
+static int64_t numsamples;
+
+static uint32_t xorshift (void);
+static void mkseries (char sampletype);
+static void mkorder (int ordertype);
+static void mkrecord (MSRecord *msr, int record, char sampletype, flag adopt);
+static int verify (void *datasamples, int64_t count, int64_t start, char sampletype);
+static void testgroup (char sampletype, int ordertype, flag adopt);
+static void testlist (char sampletype, int ordertype, flag adopt);
+static void testgaps (char sampletype, int ordertype);
+static void testedit (char sampletype);
+static MSTrace *mktrace (int64_t start, int64_t count, double samprate, char quality,
+                         char sampletype);
+static void testoverlap (char sampletype);
+static void testcopy (char sampletype);
+static void print_stdout (char *message);
+
+int
+main (int argc, char **argv)
+{
+  char sampletypes[] = "ifd";
+  int idx;
+
+  /* Redirect libmseed logging facility to stdout for comparison */
+  ms_loginit (print_stdout, NULL, print_stdout, NULL);
+
+  for (idx = 0; sampletypes[idx]; idx++)
+  {
+    mkseries (sampletypes[idx]);
+
+    testgroup (sampletypes[idx], ORDER_EXTEND, 0);
+    testgroup (sampletypes[idx], ORDER_EXTEND, 1);
+    testgroup (sampletypes[idx], ORDER_RANDOM, 0);
+    testlist (sampletypes[idx], ORDER_EXTEND, 0);
+    testlist (sampletypes[idx], ORDER_EXTEND, 1);
+    testlist (sampletypes[idx], ORDER_RANDOM, 0);
+    testlist (sampletypes[idx], ORDER_RANDOM, 1);
+  }
+
+  for (idx = 0; sampletypes[idx]; idx++)
+  {
+    mkseries (sampletypes[idx]);
+
+    testgaps (sampletypes[idx], ORDER_EXTEND);
+    testgaps (sampletypes[idx], ORDER_REVERSE);
+    testgaps (sampletypes[idx], ORDER_RANDOM);
+    testedit (sampletypes[idx]);
+  }
+
+  for (idx = 0; sampletypes[idx]; idx++)
+  {
+    mkseries (sampletypes[idx]);
+
+    testoverlap (sampletypes[idx]);
+  }
+
+  for (idx = 0; sampletypes[idx]; idx++)
+  {
+    mkseries (sampletypes[idx]);
+
+    testcopy (sampletypes[idx]);
+  }
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * xorshift:
+ *
+ * Returns the next value of a 32-bit xorshift generator.
+ ***************************************************************************/
+static uint32_t
+xorshift (void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  return seed;
+} /* End of xorshift() */
+
+/***************************************************************************
+ * mkseries:
+ *
+ * Generate a sample series of the specified type and split it into
+ * records of 1 to 100 samples.
+ ***************************************************************************/
+static void
+mkseries (char sampletype)
+{
+  int64_t idx;
+
+  numsamples = MAXSAMPLES / 2 + (xorshift () % (MAXSAMPLES / 2));
+
+  for (idx = 0; idx < numsamples; idx++)
+  {
+    series[idx] = (int32_t) (xorshift () % 2000000) - 1000000;
+
+    if (sampletype == 'i')
+      ((int32_t *)samples)[idx] = (int32_t)series[idx];
+    else if (sampletype == 'f')
+      ((float *)samples)[idx] = (float)series[idx];
+    else
+      ((double *)samples)[idx] = series[idx];
+  }
+
+  numrecords = 0;
+
+  for (idx = 0; idx < numsamples; idx += reccount[numrecords++])
+  {
+    recstart[numrecords] = idx;
+    reccount[numrecords] = 1 + (xorshift () % 100);
+
+    if (idx + reccount[numrecords] > numsamples)
+      reccount[numrecords] = numsamples - idx;
+  }
+} /* End of mkseries() */
+
+/***************************************************************************
+ * mkorder:
+ *
+ * Determine the order of adding records.  With ORDER_EXTEND each record
+ * is added before or after the records already added, starting in the
+ * middle of the series.  With ORDER_RANDOM the records are shuffled and
+ * with ORDER_REVERSE they are added from the last to the first.
+ ***************************************************************************/
+static void
+mkorder (int ordertype)
+{
+  int first;
+  int last;
+  int swap;
+  int idx;
+
+  if (ordertype == ORDER_EXTEND)
+  {
+    first = last = numrecords / 2;
+    order[0]     = first;
+
+    for (idx = 1; idx < numrecords; idx++)
+    {
+      if (first > 0 && (last == numrecords - 1 || (xorshift () & 0x1)))
+        order[idx] = --first;
+      else
+        order[idx] = ++last;
+    }
+  }
+  else if (ordertype == ORDER_REVERSE)
+  {
+    for (idx = 0; idx < numrecords; idx++)
+      order[idx] = numrecords - 1 - idx;
+  }
+  else
+  {
+    for (idx = 0; idx < numrecords; idx++)
+      order[idx] = idx;
+
+    for (idx = numrecords - 1; idx > 0; idx--)
+    {
+      swap        = xorshift () % (idx + 1);
+      first       = order[idx];
+      order[idx]  = order[swap];
+      order[swap] = first;
+    }
+  }
+} /* End of mkorder() */
+
+/***************************************************************************
+ * mkrecord:
+ *
+ * Populate a MSRecord with the samples of a record of the series, the
+ * samples are copied to an allocated buffer if adopt is true.
+ ***************************************************************************/
+static void
+mkrecord (MSRecord *msr, int record, char sampletype, flag adopt)
+{
+  int samplesize = ms_samplesize (sampletype);
+
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "TEST");
+  strcpy (msr->channel, "LHZ");
+  msr->dataquality = 'D';
+  msr->samprate    = 1.0;
+  msr->starttime   = ms_timestr2hptime ("2012-01-01T00:00:00") +
+                   recstart[record] * HPTMODULUS;
+  msr->numsamples  = reccount[record];
+  msr->samplecnt   = reccount[record];
+  msr->sampletype  = sampletype;
+  msr->datasamples = samples + recstart[record] * samplesize;
+
+  if (adopt)
+  {
+    msr->datasamples = malloc ((size_t) (reccount[record] * samplesize));
+    memcpy (msr->datasamples, samples + recstart[record] * samplesize,
+            (size_t) (reccount[record] * samplesize));
+  }
+} /* End of mkrecord() */
+
+/***************************************************************************
+ * verify:
+ *
+ * Compare samples to the series starting at the specified sample.
+ *
+ * Returns 0 if the samples match and -1 otherwise.
+ ***************************************************************************/
+static int
+verify (void *datasamples, int64_t count, int64_t start, char sampletype)
+{
+  int samplesize = ms_samplesize (sampletype);
+
+  if (start + count > numsamples || (count > 0 && !datasamples))
+    return -1;
+
+  return (memcmp (datasamples, samples + start * samplesize,
+                  (size_t) (count * samplesize)))
+             ? -1
+             : 0;
+} /* End of verify() */
+
+/***************************************************************************
+ * testgroup:
+ *
+ * Assemble a MSTraceGroup from records of the series, heal the group
+ * and verify the trace samples.
+ ***************************************************************************/
+static void
+testgroup (char sampletype, int ordertype, flag adopt)
+{
+  MSTraceGroup *mstg = mst_initgroup (NULL);
+  MSRecord msr;
+  MSTrace *mst;
+  int64_t start;
+  int errors   = 0;
+  int idx;
+
+  mkorder (ordertype);
+
+  for (idx = 0; idx < numrecords; idx++)
+  {
+    memset (&msr, 0, sizeof (MSRecord));
+    mkrecord (&msr, order[idx], sampletype, adopt);
+
+    if (!((adopt) ? mst_adoptsamples (mstg, &msr, 1, -1.0, -1.0) : mst_addmsrtogroup (mstg, &msr, 1, -1.0, -1.0)))
+      errors++;
+  }
+
+  mst_groupheal (mstg, -1.0, -1.0);
+
+  for (mst = mstg->traces; mst; mst = mst->next)
+  {
+    start = (mst->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+
+    if (verify (mst->datasamples, mst->numsamples, start, sampletype))
+      errors++;
+
+    /* The buffer is an allocation the caller may reallocate directly */
+    if (mst->numsamples > 0 &&
+        !(mst->datasamples = realloc (mst->datasamples,
+                                      (size_t) (mst->numsamples * ms_samplesize (sampletype)))))
+      errors++;
+
+    if (mst_shrinksamples (mst) ||
+        verify (mst->datasamples, mst->numsamples, start, sampletype))
+      errors++;
+  }
+
+  printf ("MSTraceGroup %c, %s%s: %d records, %d trace(s), %lld samples, %s\n",
+          sampletype, (ordertype == ORDER_EXTEND) ? "extend" : "random",
+          (adopt) ? " adopt" : "", numrecords, mstg->numtraces,
+          (long long int)((mstg->traces) ? mstg->traces->numsamples : 0),
+          (errors) ? "MISMATCH" : "verified");
+
+  mst_freegroup (&mstg);
+} /* End of testgroup() */
+
+/***************************************************************************
+ * testlist:
+ *
+ * Assemble a MSTraceList from records of the series and verify the
+ * segment samples.
+ ***************************************************************************/
+static void
+testlist (char sampletype, int ordertype, flag adopt)
+{
+  MSTraceList *mstl = mstl_init (NULL);
+  MSTraceSeg *seg;
+  MSRecord msr;
+  int64_t start;
+  int segments = 0;
+  int errors   = 0;
+  int idx;
+
+  mkorder (ordertype);
+
+  for (idx = 0; idx < numrecords; idx++)
+  {
+    memset (&msr, 0, sizeof (MSRecord));
+    mkrecord (&msr, order[idx], sampletype, adopt);
+
+    if (!((adopt) ? mstl_adoptsamples (mstl, &msr, 1, 1, -1.0, -1.0) : mstl_addmsr (mstl, &msr, 1, 1, -1.0, -1.0)))
+      errors++;
+  }
+
+  for (seg = (mstl->traces) ? mstl->traces->first : NULL; seg; seg = seg->next)
+  {
+    start = (seg->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+
+    if (verify (seg->datasamples, seg->numsamples, start, sampletype))
+      errors++;
+
+    segments++;
+  }
+
+  if (mstl_shrinksamples (mstl))
+    errors++;
+
+  for (seg = (mstl->traces) ? mstl->traces->first : NULL; seg; seg = seg->next)
+  {
+    start = (seg->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+
+    if (verify (seg->datasamples, seg->numsamples, start, sampletype))
+      errors++;
+  }
+
+  printf ("MSTraceList  %c, %s%s: %d records, %d segment(s), %lld samples, %s\n",
+          sampletype, (ordertype == ORDER_EXTEND) ? "extend" : "random",
+          (adopt) ? " adopt" : "", numrecords, segments,
+          (long long int)((mstl->traces) ? mstl->traces->first->numsamples : 0),
+          (errors) ? "MISMATCH" : "verified");
+
+  mstl_free (&mstl, 0);
+} /* End of testlist() */
+
+/***************************************************************************
+ * testgaps:
+ *
+ * Assemble a MSTraceList from records of the series omitting every
+ * GAPRECORDS record, verify that each run of records is a segment in
+ * time order and verify the segment samples.
+ ***************************************************************************/
+static void
+testgaps (char sampletype, int ordertype)
+{
+  MSTraceList *mstl = mstl_init (NULL);
+  MSTraceSeg *seg;
+  MSRecord msr;
+  hptime_t lasttime = HPTERROR;
+  int64_t start;
+  int expected = 0;
+  int segments = 0;
+  int errors   = 0;
+  int idx;
+
+  mkorder (ordertype);
+
+  for (idx = 0; idx < numrecords; idx++)
+  {
+    if (order[idx] % GAPRECORDS == GAPRECORDS - 1)
+      continue;
+
+    if (order[idx] % GAPRECORDS == 0)
+      expected++;
+
+    memset (&msr, 0, sizeof (MSRecord));
+    mkrecord (&msr, order[idx], sampletype, 0);
+
+    if (!mstl_addmsr (mstl, &msr, 1, 1, -1.0, -1.0))
+      errors++;
+  }
+
+  for (seg = (mstl->traces) ? mstl->traces->first : NULL; seg; seg = seg->next)
+  {
+    start = (seg->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+
+    if (lasttime != HPTERROR && seg->starttime <= lasttime)
+      errors++;
+
+    if (verify (seg->datasamples, seg->numsamples, start, sampletype))
+      errors++;
+
+    lasttime = seg->endtime;
+    segments++;
+  }
+
+  if (segments != expected)
+    errors++;
+
+  printf ("MSTraceList  %c, gaps %s: %d records, %d segment(s), %s\n",
+          sampletype, (ordertype == ORDER_EXTEND) ? "extend" :
+          (ordertype == ORDER_REVERSE) ? "reverse" : "random",
+          numrecords - numrecords / GAPRECORDS, segments,
+          (errors) ? "MISMATCH" : "verified");
+
+  mstl_free (&mstl, 0);
+} /* End of testgaps() */
+
+/***************************************************************************
+ * testedit:
+ *
+ * Assemble a MSTraceList from records of the series with gaps in
+ * reversed order, remove a segment from the middle of the segment list
+ * directly and add its records again in reversed order.  The segments
+ * must be the same as those of assembling the records once.
+ ***************************************************************************/
+static void
+testedit (char sampletype)
+{
+  MSTraceList *mstl = mstl_init (NULL);
+  MSTraceID *id;
+  MSTraceSeg *seg;
+  MSRecord msr;
+  hptime_t lasttime = HPTERROR;
+  int64_t start;
+  int64_t end;
+  int segments = 0;
+  int errors   = 0;
+  int idx;
+
+  mkorder (ORDER_REVERSE);
+
+  for (idx = 0; idx < numrecords; idx++)
+  {
+    if (order[idx] % GAPRECORDS == GAPRECORDS - 1)
+      continue;
+
+    memset (&msr, 0, sizeof (MSRecord));
+    mkrecord (&msr, order[idx], sampletype, 0);
+
+    if (!mstl_addmsr (mstl, &msr, 1, 1, -1.0, -1.0))
+      errors++;
+  }
+
+  /* Unlink and free a segment from the middle of the list */
+  id  = mstl->traces;
+  seg = id->first;
+  for (idx = 0; idx < id->numsegments / 2; idx++)
+    seg = seg->next;
+
+  start = (seg->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+  end   = start + seg->numsamples;
+
+  seg->prev->next = seg->next;
+  seg->next->prev = seg->prev;
+  id->numsegments--;
+  free (seg->datasamples);
+  free (seg);
+
+  for (idx = 0; idx < numrecords; idx++)
+  {
+    if (order[idx] % GAPRECORDS == GAPRECORDS - 1 ||
+        recstart[order[idx]] < start || recstart[order[idx]] >= end)
+      continue;
+
+    memset (&msr, 0, sizeof (MSRecord));
+    mkrecord (&msr, order[idx], sampletype, 0);
+
+    if (!mstl_addmsr (mstl, &msr, 1, 1, -1.0, -1.0))
+      errors++;
+  }
+
+  for (seg = id->first; seg; seg = seg->next)
+  {
+    start = (seg->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+
+    if (lasttime != HPTERROR && seg->starttime <= lasttime)
+      errors++;
+
+    if (verify (seg->datasamples, seg->numsamples, start, sampletype))
+      errors++;
+
+    lasttime = seg->endtime;
+    segments++;
+  }
+
+  if (segments != (numrecords + GAPRECORDS - 1) / GAPRECORDS || segments != id->numsegments)
+    errors++;
+
+  printf ("MSTraceList  %c, gaps edited: %d segment(s), %s\n",
+          sampletype, segments, (errors) ? "MISMATCH" : "verified");
+
+  mstl_free (&mstl, 0);
+} /* End of testedit() */
+
+/***************************************************************************
+ * mktrace:
+ *
+ * Create a MSTrace with count samples of the series from the start
+ * sample at the specified sample rate and quality.
+ ***************************************************************************/
+static MSTrace *
+mktrace (int64_t start, int64_t count, double samprate, char quality, char sampletype)
+{
+  int samplesize = ms_samplesize (sampletype);
+  MSTrace *mst   = mst_init (NULL);
+
+  strcpy (mst->network, "XX");
+  strcpy (mst->station, "TEST");
+  strcpy (mst->channel, "LHZ");
+  mst->dataquality = quality;
+  mst->samprate    = samprate;
+  mst->starttime   = ms_timestr2hptime ("2012-01-01T00:00:00") + start * HPTMODULUS;
+  mst->endtime     = mst->starttime + (hptime_t) ((count - 1) / samprate * HPTMODULUS);
+  mst->numsamples  = count;
+  mst->samplecnt   = count;
+  mst->sampletype  = sampletype;
+  mst->datasamples = malloc ((size_t) (count * samplesize));
+  memcpy (mst->datasamples, samples + start * samplesize, (size_t) (count * samplesize));
+
+  return mst;
+} /* End of mktrace() */
+
+/***************************************************************************
+ * testoverlap:
+ *
+ * Heal a MSTraceGroup of traces A (0-59 s), B (30-89 s) overlapping
+ * both A and C (60-119 s), R (120 s) with another sample rate and D
+ * (120-179 s) of another quality.  A, C and D are contiguous and must
+ * be merged into one trace of unknown quality, B and R must remain.
+ ***************************************************************************/
+static void
+testoverlap (char sampletype)
+{
+  MSTraceGroup *mstg = mst_initgroup (NULL);
+  MSTrace *mst;
+  int64_t start;
+  int mergings;
+  int errors = 0;
+
+  mst_addtracetogroup (mstg, mktrace (60, 60, 1.0, 'D', sampletype));
+  mst_addtracetogroup (mstg, mktrace (120, 20, 2.0, 'D', sampletype));
+  mst_addtracetogroup (mstg, mktrace (30, 60, 1.0, 'D', sampletype));
+  mst_addtracetogroup (mstg, mktrace (120, 60, 1.0, 'R', sampletype));
+  mst_addtracetogroup (mstg, mktrace (0, 60, 1.0, 'D', sampletype));
+
+  mergings = mst_groupheal (mstg, -1.0, -1.0);
+
+  for (mst = mstg->traces; mst; mst = mst->next)
+  {
+    start = (mst->starttime - ms_timestr2hptime ("2012-01-01T00:00:00")) / HPTMODULUS;
+
+    if (verify (mst->datasamples, mst->numsamples, start, sampletype))
+      errors++;
+
+    if (start == 0 && (mst->numsamples != 180 || mst->dataquality != 0))
+      errors++;
+    else if (start == 30 && (mst->numsamples != 60 || mst->dataquality != 'D'))
+      errors++;
+    else if (start == 120 && mst->samprate != 2.0)
+      errors++;
+  }
+
+  if (mergings != 2 || mstg->numtraces != 3)
+    errors++;
+
+  printf ("MSTraceGroup %c, overlap: %d merging(s), %d trace(s), %s\n",
+          sampletype, mergings, mstg->numtraces, (errors) ? "MISMATCH" : "verified");
+
+  mst_freegroup (&mstg);
+} /* End of testoverlap() */
+
+/***************************************************************************
+ * testcopy:
+ *
+ * Assemble a MSTraceList of three channels from the first half of the
+ * records, then copy the list structure, clear and free the original
+ * and add the remaining records to the copy.  Each channel must be a
+ * single trace ID with one segment of all samples.
+ ***************************************************************************/
+static void
+testcopy (char sampletype)
+{
+  static const char *channels[] = {"LHE", "LHN", "LHZ"};
+  MSTraceList *mstl = mstl_init (NULL);
+  MSTraceList *copy;
+  MSTraceID *id;
+  MSRecord msr;
+  int traces = 0;
+  int errors = 0;
+  int chan;
+  int idx;
+
+  for (idx = 0; idx < numrecords; idx++)
+  {
+    if (idx == numrecords / 2)
+    {
+      copy  = mstl_init (NULL);
+      *copy = *mstl;
+      memset (mstl, 0, sizeof (MSTraceList));
+      mstl_free (&mstl, 0);
+      mstl = copy;
+    }
+
+    for (chan = 0; chan < 3; chan++)
+    {
+      memset (&msr, 0, sizeof (MSRecord));
+      mkrecord (&msr, idx, sampletype, 0);
+      strcpy (msr.channel, channels[chan]);
+
+      if (!mstl_addmsr (mstl, &msr, 1, 1, -1.0, -1.0))
+        errors++;
+    }
+  }
+
+  for (id = mstl->traces; id; id = id->next)
+  {
+    if (id->numsegments != 1 || id->first->numsamples != numsamples ||
+        verify (id->first->datasamples, id->first->numsamples, 0, sampletype))
+      errors++;
+
+    traces++;
+  }
+
+  if (traces != 3 || mstl->numtraces != 3)
+    errors++;
+
+  printf ("MSTraceList  %c, copy: %d records, %d trace(s), %s\n",
+          sampletype, numrecords * 3, traces, (errors) ? "MISMATCH" : "verified");
+
+  mstl_free (&mstl, 0);
+} /* End of testcopy() */
+
+/***************************************************************************
+ * print_stdout():
+ * Print messsage to stdout.
+ ***************************************************************************/
+static void
+print_stdout (char *message)
+{
+  fprintf (stdout, "%s", message);
+} /* End of print_stdout() */
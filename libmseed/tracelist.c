@@ -5,9 +5,10 @@
  *
  * Written by Chad Trabant, IRIS Data Management Center
  *
- * modified: 2015.108
+ * modified: 2026.291
  ***************************************************************************/
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,10 +16,102 @@
 
 #include "libmseed.h"
 
+/* The table of trace ID indexes is shared by all lists and is locked
+ * when threads are available */
+#if !defined(LMP_WIN) && !defined(LMP_NOTHREADS)
+  #define LMP_THREADS 1
+  #include <pthread.h>
+static pthread_mutex_t indexlock = PTHREAD_MUTEX_INITIALIZER;
+  #define INDEX_LOCK() pthread_mutex_lock (&indexlock)
+  #define INDEX_UNLOCK() pthread_mutex_unlock (&indexlock)
+#else
+  #define INDEX_LOCK()
+  #define INDEX_UNLOCK()
+#endif
+
 MSTraceSeg *mstl_msr2seg (MSRecord *msr, hptime_t endtime);
 MSTraceSeg *mstl_addmsrtoseg (MSTraceSeg *seg, MSRecord *msr, hptime_t endtime, flag whence);
 MSTraceSeg *mstl_addsegtoseg (MSTraceSeg *seg1, MSTraceSeg *seg2);
 
+static MSTraceSeg *mstl_addmsr_int (MSTraceList *mstl, MSRecord *msr, flag dataquality,
+                                    flag autoheal, double timetol, double sampratetol,
+                                    flag adopt);
+static MSTraceSeg *mstl_msr2seg_int (MSRecord *msr, hptime_t endtime, flag adopt);
+static MSTraceSeg *mstl_addmsrtoseg_int (MSTraceSeg *seg, MSRecord *msr, hptime_t endtime,
+                                         flag whence, flag adopt);
+
+/* Hash index of MSTraceIDs by source name, open addressing with
+ * linear probing in a power of 2 sized table.  The index of a list is
+ * kept in a private table keyed by the MSTraceList address instead of
+ * in the public structure.  The list head and trace count are recorded
+ * when the index is updated, if they no longer match the list, e.g.
+ * after traces were added or removed directly, the index is rebuilt
+ * from the list.  The segment index of each MSTraceID, if any, is kept
+ * in the slot of the ID. */
+typedef struct MSTraceIDIndex_s {
+  const MSTraceList *mstl;   /* Indexed list, key in the table of indexes */
+  MSTraceID  *traces;        /* List head when the index was updated */
+  int32_t     numtraces;     /* Number of traces when the index was updated */
+  uint32_t    size;          /* Number of slots, a power of 2, 0 if none */
+  uint32_t    count;         /* Number of occupied slots */
+  uint32_t    lastslot;      /* Slot of the last MSTraceID searched by address */
+  uint32_t   *hashes;        /* Source name hash for each slot */
+  MSTraceID **ids;           /* MSTraceID for each slot, NULL if empty */
+  struct MSTraceSegIndex_s **segs; /* Segment index for each slot, NULL if none */
+} MSTraceIDIndex;
+
+#define IDINDEX_MINSIZE 64
+
+/* Table of the indexes of all lists by list address, open addressing
+ * with linear probing in a table of 2^indexbits slots. */
+static MSTraceIDIndex **indextable = NULL;
+static int indexbits               = 0;
+static uint32_t indexcount         = 0;
+
+static uint32_t mstl_srcnamehash (const char *srcname);
+static MSTraceIDIndex *mstl_getindex (MSTraceList *mstl);
+static int mstl_rebuildindex (MSTraceIDIndex *index, MSTraceList *mstl);
+static MSTraceID *mstl_findid (MSTraceIDIndex *index, const char *srcname, uint32_t hash);
+static int mstl_indexid (MSTraceIDIndex *index, MSTraceID *id, uint32_t hash);
+static void mstl_freeindex (MSTraceList *mstl);
+static uint32_t mstl_indexslot (const MSTraceList *mstl);
+static int mstl_indexput (MSTraceIDIndex *index);
+static void mstl_indexdel (uint32_t slot);
+
+/* Index of the segments of a MSTraceID, sorted arrays of segments
+ * in list order (by start time) and by end time.  Searches are
+ * O(log n) but an insert or removal moves the following entries, the
+ * index pays off for records added mostly in time order, where new
+ * and modified segments are near the end of the arrays.  Records in
+ * random order cost O(n) per segment change, O(n^2) overall, though
+ * with a small constant compared to walking the segment list.  The
+ * first and last segments and the segment count are recorded when the
+ * index is updated, if they no longer match the MSTraceID, e.g. after
+ * segments were added or removed directly, the index is discarded. */
+typedef struct MSTraceSegIndex_s {
+  int32_t      size;         /* Allocated entries in each array */
+  int32_t      count;        /* Number of segments in index */
+  MSTraceSeg **bystart;      /* Segments in list order, sorted by start time */
+  MSTraceSeg **byend;        /* Segments sorted by end time */
+  MSTraceSeg  *first;        /* First segment when the index was updated */
+  MSTraceSeg  *last;         /* Last segment when the index was updated */
+  int32_t      numsegments;  /* Number of segments when the index was updated */
+} MSTraceSegIndex;
+
+/* Minimum number of segments before a segment index is used */
+#define SEGINDEX_MINSEGMENTS 16
+
+static MSTraceSegIndex **mstl_segindex_slot (MSTraceIDIndex *index, MSTraceID *id);
+static MSTraceSegIndex *mstl_segindex_build (MSTraceID *id);
+static void mstl_segindex_update (MSTraceSegIndex *segindex, MSTraceID *id);
+static int mstl_segindex_search (MSTraceSegIndex *segindex, MSRecord *msr, hptime_t endtime,
+                                 hptime_t hpdelta, hptime_t hptimetol, double sampratetol,
+                                 flag autoheal, MSTraceSeg **segbefore,
+                                 MSTraceSeg **segafter, MSTraceSeg **followseg);
+static int mstl_segindex_insert (MSTraceSegIndex *segindex, MSTraceSeg *seg);
+static void mstl_segindex_remove (MSTraceSegIndex **psegindex, MSTraceSeg *seg);
+static void mstl_segindex_free (MSTraceSegIndex **psegindex);
+
 /***************************************************************************
  * mstl_init:
  *
@@ -103,6 +196,8 @@ mstl_free (MSTraceList **ppmstl, flag freeprvtptr)
       id = nextid;
     }
 
+    mstl_freeindex (*ppmstl);
+
     free (*ppmstl);
 
     *ppmstl = NULL;
@@ -135,6 +230,58 @@ mstl_free (MSTraceList **ppmstl, flag freeprvtptr)
 MSTraceSeg *
 mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
              flag autoheal, double timetol, double sampratetol)
+{
+  return mstl_addmsr_int (mstl, msr, dataquality, autoheal, timetol, sampratetol, 0);
+} /* End of mstl_addmsr() */
+
+/***************************************************************************
+ * mstl_adoptsamples:
+ *
+ * Add data coverage from an MSRecord to a MSTraceList like
+ * mstl_addmsr() but transfer ownership of the MSRecord data sample
+ * buffer, which must have been allocated with malloc(), to the
+ * MSTraceList.
+ *
+ * When the MSRecord starts a new MSTraceSeg the sample buffer becomes
+ * the segment sample buffer without copying.  When added to an
+ * existing segment the samples are copied and the buffer is freed.
+ *
+ * On success MSRecord->datasamples is set to NULL.  On error the
+ * caller retains ownership of the buffer if MSRecord->datasamples is
+ * not NULL.
+ *
+ * Return a pointer to the MSTraceSeg updated or 0 on error.
+ ***************************************************************************/
+MSTraceSeg *
+mstl_adoptsamples (MSTraceList *mstl, MSRecord *msr, flag dataquality,
+                   flag autoheal, double timetol, double sampratetol)
+{
+  MSTraceSeg *seg;
+
+  seg = mstl_addmsr_int (mstl, msr, dataquality, autoheal, timetol, sampratetol, 1);
+
+  /* Release a buffer that did not contribute to the segment */
+  if (seg && msr->datasamples)
+  {
+    free (msr->datasamples);
+    msr->datasamples = 0;
+  }
+
+  return seg;
+} /* End of mstl_adoptsamples() */
+
+/***************************************************************************
+ * mstl_addmsr_int:
+ *
+ * Add data coverage from an MSRecord to a MSTraceList, see
+ * mstl_addmsr().  If adopt is true ownership of the data samples is
+ * transferred, see mstl_adoptsamples().
+ *
+ * Return a pointer to the MSTraceSeg updated or 0 on error.
+ ***************************************************************************/
+static MSTraceSeg *
+mstl_addmsr_int (MSTraceList *mstl, MSRecord *msr, flag dataquality,
+                 flag autoheal, double timetol, double sampratetol, flag adopt)
 {
   MSTraceID *id       = 0;
   MSTraceID *searchid = 0;
@@ -155,8 +302,12 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
   hptime_t hptimetol  = 0;
   hptime_t nhptimetol = 0;
 
+  MSTraceIDIndex *index;
+  MSTraceSegIndex *noindex    = 0;
+  MSTraceSegIndex **psegindex = &noindex;
   char srcname[45];
   char *s1, *s2;
+  uint32_t hash = 0;
   flag whence;
   flag lastratecheck;
   flag firstratecheck;
@@ -182,8 +333,12 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     return 0;
   }
 
-  /* Search for matching trace ID starting with last accessed ID and
-     then looping through the trace ID list. */
+  if (!(index = mstl_getindex (mstl)))
+    return 0;
+
+  /* Search for matching trace ID starting with last accessed ID, then
+     the trace ID index and finally looping through the trace ID list
+     to find the insertion point of a new ID. */
   if (mstl->last)
   {
     s1 = mstl->last->srcname;
@@ -199,6 +354,10 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     {
       id = mstl->last;
     }
+    else if ((id = mstl_findid (index, srcname, (hash = mstl_srcnamehash (srcname)))))
+    {
+      /* Found in trace ID index */
+    }
     else
     {
       /* Loop through trace ID list searching for a match, simultaneously
@@ -249,6 +408,10 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
         id = searchid;
         break;
       }
+
+      /* Add a trace ID missing from the index */
+      if (id && mstl_indexid (index, id, hash))
+        return 0;
     }
   } /* Done searching for match in trace ID list */
 
@@ -273,12 +436,25 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     id->latest      = endtime;
     id->numsegments = 1;
 
-    if (!(seg = mstl_msr2seg (msr, endtime)))
+    if (!(seg = mstl_msr2seg_int (msr, endtime, adopt)))
     {
+      free (id);
       return 0;
     }
     id->first = id->last = seg;
 
+    if (!hash)
+      hash = mstl_srcnamehash (srcname);
+
+    if (mstl_indexid (index, id, hash))
+    {
+      if (seg->datasamples)
+        free (seg->datasamples);
+      free (seg);
+      free (id);
+      return 0;
+    }
+
     /* Add new MSTraceID to MSTraceList */
     if (!mstl->traces || !ltid)
     {
@@ -292,10 +468,17 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     }
 
     mstl->numtraces++;
+
+    index->traces    = mstl->traces;
+    index->numtraces = mstl->numtraces;
   }
   /* Add data coverage to the matching MSTraceID */
   else
   {
+    /* Segment index of the ID, if any */
+    if (!(psegindex = mstl_segindex_slot (index, id)))
+      psegindex = &noindex;
+
     /* Calculate high-precision sample period */
     hpdelta = (hptime_t) ((msr->samprate) ? (HPTMODULUS / msr->samprate) : 0.0);
 
@@ -340,8 +523,13 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     /* Record coverage fits at end of last segment */
     if (lastgap <= hptimetol && lastgap >= nhptimetol && lastratecheck)
     {
-      if (!mstl_addmsrtoseg (id->last, msr, endtime, 1))
+      mstl_segindex_remove (psegindex, id->last);
+
+      if (!mstl_addmsrtoseg_int (id->last, msr, endtime, 1, adopt))
+      {
+        mstl_segindex_free (psegindex);
         return 0;
+      }
 
       seg = id->last;
 
@@ -351,7 +539,7 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     /* Record coverage is after all other coverage */
     else if ((msr->starttime - hpdelta - hptimetol) > id->latest)
     {
-      if (!(seg = mstl_msr2seg (msr, endtime)))
+      if (!(seg = mstl_msr2seg_int (msr, endtime, adopt)))
         return 0;
 
       /* Add to end of list */
@@ -366,7 +554,7 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     /* Record coverage is before all other coverage */
     else if ((endtime + hpdelta + hptimetol) < id->earliest)
     {
-      if (!(seg = mstl_msr2seg (msr, endtime)))
+      if (!(seg = mstl_msr2seg_int (msr, endtime, adopt)))
         return 0;
 
       /* Add to beginning of list */
@@ -381,8 +569,13 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     /* Record coverage fits at beginning of first segment */
     else if (firstgap <= hptimetol && firstgap >= nhptimetol && firstratecheck)
     {
-      if (!mstl_addmsrtoseg (id->first, msr, endtime, 2))
+      mstl_segindex_remove (psegindex, id->first);
+
+      if (!mstl_addmsrtoseg_int (id->first, msr, endtime, 2, adopt))
+      {
+        mstl_segindex_free (psegindex);
         return 0;
+      }
 
       seg = id->first;
 
@@ -392,10 +585,21 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
     /* Search complete segment list for matches */
     else
     {
-      searchseg = id->first;
       segbefore = 0; /* Find segment that record fits before */
       segafter  = 0; /* Find segment that record fits after */
       followseg = 0; /* Track segment that record follows in time order */
+
+      /* Use a segment index for traces with many segments */
+      if (!*psegindex && id->numsegments >= SEGINDEX_MINSEGMENTS)
+        *psegindex = mstl_segindex_build (id);
+
+      if (*psegindex && mstl_segindex_search (*psegindex, msr, endtime, hpdelta, hptimetol,
+                                              sampratetol, autoheal, &segbefore, &segafter,
+                                              &followseg))
+        return 0;
+
+      /* Otherwise search the segment list */
+      searchseg = (*psegindex) ? 0 : id->first;
       while (searchseg)
       {
         if (msr->starttime > searchseg->starttime)
@@ -453,8 +657,11 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
       /* Add MSRecord coverage to end of segment before */
       if (segbefore)
       {
-        if (!mstl_addmsrtoseg (segbefore, msr, endtime, 1))
+        mstl_segindex_remove (psegindex, segbefore);
+
+        if (!mstl_addmsrtoseg_int (segbefore, msr, endtime, 1, adopt))
         {
+          mstl_segindex_free (psegindex);
           return 0;
         }
 
@@ -464,9 +671,12 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
           /* Add segafter coverage to segbefore */
           if (!mstl_addsegtoseg (segbefore, segafter))
           {
+            mstl_segindex_free (psegindex);
             return 0;
           }
 
+          mstl_segindex_remove (psegindex, segafter);
+
           /* Shift last segment pointer if it's going to be removed */
           if (segafter == id->last)
             id->last = id->last->prev;
@@ -492,8 +702,11 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
       /* Add MSRecord coverage to beginning of segment after */
       else if (segafter)
       {
-        if (!mstl_addmsrtoseg (segafter, msr, endtime, 2))
+        mstl_segindex_remove (psegindex, segafter);
+
+        if (!mstl_addmsrtoseg_int (segafter, msr, endtime, 2, adopt))
         {
+          mstl_segindex_free (psegindex);
           return 0;
         }
 
@@ -503,7 +716,7 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
       else
       {
         /* Create new segment */
-        if (!(seg = mstl_msr2seg (msr, endtime)))
+        if (!(seg = mstl_msr2seg_int (msr, endtime, adopt)))
         {
           return 0;
         }
@@ -592,11 +805,801 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
       id->last = segbefore;
   }
 
+  /* Add the modified or new segment to the segment index */
+  if (*psegindex && mstl_segindex_insert (*psegindex, seg))
+    mstl_segindex_free (psegindex);
+
+  if (*psegindex)
+    mstl_segindex_update (*psegindex, id);
+
   /* Set MSTraceID as last accessed */
   mstl->last = id;
 
   return seg;
-} /* End of mstl_addmsr() */
+} /* End of mstl_addmsr_int() */
+
+/***************************************************************************
+ * mstl_srcnamehash:
+ *
+ * Calculate the FNV-1a hash of a source name.  The hash is never 0 so
+ * that 0 can be used to indicate that it has not been calculated.
+ *
+ * Return the hash value.
+ ***************************************************************************/
+static uint32_t
+mstl_srcnamehash (const char *srcname)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*srcname)
+  {
+    hash ^= (uint8_t)*srcname++;
+    hash *= 16777619u;
+  }
+
+  return (hash) ? hash : 1;
+} /* End of mstl_srcnamehash() */
+
+/***************************************************************************
+ * mstl_getindex:
+ *
+ * Find the trace ID index of a MSTraceList in the table of indexes,
+ * creating an empty index if the list has none.  If the list head or
+ * trace count no longer match the index, the list was changed without
+ * updating the index and the index is rebuilt.
+ *
+ * Return a pointer to the MSTraceIDIndex on success or 0 on error.
+ ***************************************************************************/
+static MSTraceIDIndex *
+mstl_getindex (MSTraceList *mstl)
+{
+  MSTraceIDIndex *index = 0;
+  uint32_t slot;
+
+  INDEX_LOCK ();
+
+  if (indexcount)
+  {
+    for (slot = mstl_indexslot (mstl); indextable[slot];
+         slot = (slot + 1) & ((1u << indexbits) - 1))
+    {
+      if (indextable[slot]->mstl == mstl)
+      {
+        index = indextable[slot];
+        break;
+      }
+    }
+  }
+
+  if (!index && (index = (MSTraceIDIndex *)calloc (1, sizeof (MSTraceIDIndex))))
+  {
+    index->mstl = mstl;
+
+    if (mstl_indexput (index))
+    {
+      free (index);
+      index = 0;
+    }
+  }
+
+  INDEX_UNLOCK ();
+
+  if (!index)
+  {
+    ms_log (2, "mstl_addmsr(): Error allocating memory for trace ID index\n");
+    return 0;
+  }
+
+  if ((index->traces != mstl->traces || index->numtraces != mstl->numtraces) &&
+      mstl_rebuildindex (index, mstl))
+    return 0;
+
+  return index;
+} /* End of mstl_getindex() */
+
+/***************************************************************************
+ * mstl_rebuildindex:
+ *
+ * Rebuild the trace ID index of a MSTraceList from the trace ID list,
+ * segment indexes are discarded and built again when needed.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+mstl_rebuildindex (MSTraceIDIndex *index, MSTraceList *mstl)
+{
+  MSTraceID *id;
+
+  uint32_t idx;
+
+  for (idx = 0; idx < index->size; idx++)
+  {
+    if (index->segs[idx])
+      mstl_segindex_free (&index->segs[idx]);
+  }
+
+  if (index->size)
+  {
+    memset (index->hashes, 0, index->size * sizeof (uint32_t));
+    memset (index->ids, 0, index->size * sizeof (MSTraceID *));
+  }
+
+  index->count = 0;
+
+  for (id = mstl->traces; id; id = id->next)
+  {
+    if (mstl_indexid (index, id, mstl_srcnamehash (id->srcname)))
+      return -1;
+  }
+
+  index->traces    = mstl->traces;
+  index->numtraces = mstl->numtraces;
+
+  return 0;
+} /* End of mstl_rebuildindex() */
+
+/***************************************************************************
+ * mstl_findid:
+ *
+ * Search a trace ID index for the specified source name with the
+ * given hash.
+ *
+ * Return a pointer to the MSTraceID if found otherwise 0.
+ ***************************************************************************/
+static MSTraceID *
+mstl_findid (MSTraceIDIndex *index, const char *srcname, uint32_t hash)
+{
+  uint32_t slot;
+
+  if (!index->size)
+    return 0;
+
+  for (slot = hash & (index->size - 1); index->ids[slot];
+       slot = (slot + 1) & (index->size - 1))
+  {
+    if (index->hashes[slot] == hash && !strcmp (index->ids[slot]->srcname, srcname))
+      return index->ids[slot];
+  }
+
+  return 0;
+} /* End of mstl_findid() */
+
+/***************************************************************************
+ * mstl_indexid:
+ *
+ * Add a MSTraceID to a trace ID index, growing the index as needed to
+ * keep it no more than half full.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+mstl_indexid (MSTraceIDIndex *index, MSTraceID *id, uint32_t hash)
+{
+  uint32_t *newhashes;
+  MSTraceID **newids;
+  MSTraceSegIndex **newsegs;
+  uint32_t newsize;
+  uint32_t slot;
+  uint32_t idx;
+
+  /* Create or grow index, re-inserting existing entries */
+  if ((index->count + 1) * 2 > index->size)
+  {
+    newsize = (index->size) ? index->size * 2 : IDINDEX_MINSIZE;
+
+    newhashes = (uint32_t *)calloc (newsize, sizeof (uint32_t));
+    newids    = (MSTraceID **)calloc (newsize, sizeof (MSTraceID *));
+    newsegs   = (MSTraceSegIndex **)calloc (newsize, sizeof (MSTraceSegIndex *));
+
+    if (!newhashes || !newids || !newsegs)
+    {
+      ms_log (2, "mstl_addmsr(): Error allocating memory for trace ID index\n");
+      free (newhashes);
+      free (newids);
+      free (newsegs);
+      return -1;
+    }
+
+    for (idx = 0; idx < index->size; idx++)
+    {
+      if (!index->ids[idx])
+        continue;
+
+      for (slot = index->hashes[idx] & (newsize - 1); newids[slot];
+           slot = (slot + 1) & (newsize - 1))
+        ;
+
+      newhashes[slot] = index->hashes[idx];
+      newids[slot]    = index->ids[idx];
+      newsegs[slot]   = index->segs[idx];
+    }
+
+    free (index->hashes);
+    free (index->ids);
+    free (index->segs);
+
+    index->hashes   = newhashes;
+    index->ids      = newids;
+    index->segs     = newsegs;
+    index->size     = newsize;
+    index->lastslot = 0;
+  }
+
+  for (slot = hash & (index->size - 1); index->ids[slot];
+       slot = (slot + 1) & (index->size - 1))
+    ;
+
+  index->hashes[slot] = hash;
+  index->ids[slot]    = id;
+  index->count++;
+
+  return 0;
+} /* End of mstl_indexid() */
+
+/***************************************************************************
+ * mstl_freeindex:
+ *
+ * Remove the trace ID index of a MSTraceList from the table of indexes
+ * and free it including the segment indexes.
+ ***************************************************************************/
+static void
+mstl_freeindex (MSTraceList *mstl)
+{
+  MSTraceIDIndex *index = 0;
+  uint32_t slot;
+  uint32_t idx;
+
+  INDEX_LOCK ();
+
+  if (indexcount)
+  {
+    for (slot = mstl_indexslot (mstl); indextable[slot];
+         slot = (slot + 1) & ((1u << indexbits) - 1))
+    {
+      if (indextable[slot]->mstl == mstl)
+      {
+        index = indextable[slot];
+        mstl_indexdel (slot);
+        break;
+      }
+    }
+  }
+
+  INDEX_UNLOCK ();
+
+  if (!index)
+    return;
+
+  for (idx = 0; idx < index->size; idx++)
+  {
+    if (index->segs[idx])
+      mstl_segindex_free (&index->segs[idx]);
+  }
+
+  free (index->hashes);
+  free (index->ids);
+  free (index->segs);
+  free (index);
+} /* End of mstl_freeindex() */
+
+/***************************************************************************
+ * mstl_indexslot:
+ *
+ * Calculate the home slot of a list address in the table of indexes
+ * with Fibonacci hashing.
+ *
+ * Return the slot.
+ ***************************************************************************/
+static uint32_t
+mstl_indexslot (const MSTraceList *mstl)
+{
+  return (uint32_t) (((uint64_t) (uintptr_t)mstl * UINT64_C (0x9E3779B97F4A7C15)) >> (64 - indexbits));
+} /* End of mstl_indexslot() */
+
+/***************************************************************************
+ * mstl_indexput:
+ *
+ * Add a trace ID index to the table of indexes, the table is doubled
+ * in size when more than half full.  The table must be locked.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+mstl_indexput (MSTraceIDIndex *index)
+{
+  MSTraceIDIndex **oldtable = indextable;
+  uint32_t oldsize          = (indextable) ? (1u << indexbits) : 0;
+  uint32_t slot;
+  uint32_t idx;
+
+  if (!indextable || (indexcount + 1) * 2 > oldsize)
+  {
+    if (!(indextable = (MSTraceIDIndex **)calloc ((size_t)1 << ((indexbits) ? indexbits + 1 : 6),
+                                                  sizeof (MSTraceIDIndex *))))
+    {
+      indextable = oldtable;
+      return -1;
+    }
+
+    indexbits  = (indexbits) ? indexbits + 1 : 6;
+    indexcount = 0;
+
+    for (idx = 0; idx < oldsize; idx++)
+    {
+      if (oldtable[idx])
+        mstl_indexput (oldtable[idx]);
+    }
+
+    free (oldtable);
+  }
+
+  for (slot = mstl_indexslot (index->mstl); indextable[slot];
+       slot = (slot + 1) & ((1u << indexbits) - 1))
+    ;
+
+  indextable[slot] = index;
+  indexcount++;
+
+  return 0;
+} /* End of mstl_indexput() */
+
+/***************************************************************************
+ * mstl_indexdel:
+ *
+ * Remove the trace ID index in a slot of the table of indexes,
+ * following entries of the probe sequence are shifted back so that no
+ * tombstones are needed.  The table must be locked.
+ ***************************************************************************/
+static void
+mstl_indexdel (uint32_t slot)
+{
+  uint32_t mask = (1u << indexbits) - 1;
+  uint32_t hole = slot;
+  uint32_t home;
+  uint32_t idx;
+
+  indextable[hole] = NULL;
+  indexcount--;
+
+  for (idx = (hole + 1) & mask; indextable[idx]; idx = (idx + 1) & mask)
+  {
+    home = mstl_indexslot (indextable[idx]->mstl);
+
+    /* Move the entry into the hole if the hole is on its probe path */
+    if (((idx - home) & mask) >= ((idx - hole) & mask))
+    {
+      indextable[hole] = indextable[idx];
+      indextable[idx]  = NULL;
+      hole             = idx;
+    }
+  }
+} /* End of mstl_indexdel() */
+
+/***************************************************************************
+ * mstl_segindex_lower:
+ *
+ * Find the first entry in a sorted array of segments with a start
+ * time, or end time if endtimes is true, not before the specified
+ * time.
+ *
+ * Return the array index of the entry, count if none.
+ ***************************************************************************/
+static int32_t
+mstl_segindex_lower (MSTraceSeg **array, int32_t count, hptime_t time, flag endtimes)
+{
+  int32_t low  = 0;
+  int32_t high = count;
+  int32_t mid;
+
+  while (low < high)
+  {
+    mid = low + (high - low) / 2;
+
+    if (((endtimes) ? array[mid]->endtime : array[mid]->starttime) < time)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+} /* End of mstl_segindex_lower() */
+
+/***************************************************************************
+ * mstl_segindex_find:
+ *
+ * Find a segment in a sorted array of segments using the current
+ * start time, or end time if endtimes is true, of the segment.
+ *
+ * Return the array index of the segment, -1 if not found.
+ ***************************************************************************/
+static int32_t
+mstl_segindex_find (MSTraceSeg **array, int32_t count, MSTraceSeg *seg, flag endtimes)
+{
+  hptime_t time = (endtimes) ? seg->endtime : seg->starttime;
+  int32_t idx;
+
+  for (idx = mstl_segindex_lower (array, count, time, endtimes);
+       idx < count && ((endtimes) ? array[idx]->endtime : array[idx]->starttime) == time;
+       idx++)
+  {
+    if (array[idx] == seg)
+      return idx;
+  }
+
+  return -1;
+} /* End of mstl_segindex_find() */
+
+/***************************************************************************
+ * mstl_segindex_endcmp:
+ *
+ * Compare the end times of two segments for qsort().
+ ***************************************************************************/
+static int
+mstl_segindex_endcmp (const void *a, const void *b)
+{
+  const MSTraceSeg *seg1 = *(MSTraceSeg *const *)a;
+  const MSTraceSeg *seg2 = *(MSTraceSeg *const *)b;
+
+  return (seg1->endtime > seg2->endtime) - (seg1->endtime < seg2->endtime);
+} /* End of mstl_segindex_endcmp() */
+
+/***************************************************************************
+ * mstl_segindex_poscmp:
+ *
+ * Compare two segment positions for qsort().
+ ***************************************************************************/
+static int
+mstl_segindex_poscmp (const void *a, const void *b)
+{
+  int32_t pos1 = *(const int32_t *)a;
+  int32_t pos2 = *(const int32_t *)b;
+
+  return (pos1 > pos2) - (pos1 < pos2);
+} /* End of mstl_segindex_poscmp() */
+
+/***************************************************************************
+ * mstl_segindex_slot:
+ *
+ * Find the slot of a MSTraceID in a trace ID index, holding the
+ * segment index of the ID.  A segment index that no longer matches the
+ * segments of the ID is freed.
+ *
+ * Return a pointer to the segment index in the slot or 0 if the ID is
+ * not in the trace ID index.
+ ***************************************************************************/
+static MSTraceSegIndex **
+mstl_segindex_slot (MSTraceIDIndex *index, MSTraceID *id)
+{
+  MSTraceSegIndex *segindex;
+  uint32_t slot;
+
+  if (!index->size)
+    return 0;
+
+  if (index->ids[index->lastslot] != id)
+  {
+    for (slot = mstl_srcnamehash (id->srcname) & (index->size - 1); index->ids[slot];
+         slot = (slot + 1) & (index->size - 1))
+    {
+      if (index->ids[slot] == id)
+        break;
+    }
+
+    if (!index->ids[slot])
+      return 0;
+
+    index->lastslot = slot;
+  }
+
+  segindex = index->segs[index->lastslot];
+
+  if (segindex && (segindex->first != id->first || segindex->last != id->last ||
+                   segindex->numsegments != id->numsegments))
+    mstl_segindex_free (&index->segs[index->lastslot]);
+
+  return &index->segs[index->lastslot];
+} /* End of mstl_segindex_slot() */
+
+/***************************************************************************
+ * mstl_segindex_build:
+ *
+ * Build an index of the segments of a MSTraceID.  The segment list is
+ * maintained in start time order, the index contains the segments in
+ * list order and in end time order.
+ *
+ * Return a pointer to the MSTraceSegIndex on success or 0 on error.
+ ***************************************************************************/
+static MSTraceSegIndex *
+mstl_segindex_build (MSTraceID *id)
+{
+  MSTraceSegIndex *index;
+  MSTraceSeg *seg;
+  int32_t count = 0;
+
+  for (seg = id->first; seg; seg = seg->next)
+    count++;
+
+  if (!(index = (MSTraceSegIndex *)malloc (sizeof (MSTraceSegIndex))))
+    return 0;
+
+  index->size    = (count < 32) ? 64 : count * 2;
+  index->count   = 0;
+  index->bystart = (MSTraceSeg **)malloc (index->size * sizeof (MSTraceSeg *));
+  index->byend   = (MSTraceSeg **)malloc (index->size * sizeof (MSTraceSeg *));
+
+  if (!index->bystart || !index->byend)
+  {
+    free (index->bystart);
+    free (index->byend);
+    free (index);
+    return 0;
+  }
+
+  for (seg = id->first; seg; seg = seg->next)
+    index->bystart[index->count++] = seg;
+
+  memcpy (index->byend, index->bystart, count * sizeof (MSTraceSeg *));
+  qsort (index->byend, count, sizeof (MSTraceSeg *), mstl_segindex_endcmp);
+
+  mstl_segindex_update (index, id);
+
+  return index;
+} /* End of mstl_segindex_build() */
+
+/***************************************************************************
+ * mstl_segindex_update:
+ *
+ * Record the first and last segments and the segment count of a
+ * MSTraceID in its segment index after the library changed the
+ * segments.
+ ***************************************************************************/
+static void
+mstl_segindex_update (MSTraceSegIndex *segindex, MSTraceID *id)
+{
+  segindex->first       = id->first;
+  segindex->last        = id->last;
+  segindex->numsegments = id->numsegments;
+} /* End of mstl_segindex_update() */
+
+/***************************************************************************
+ * mstl_segindex_search:
+ *
+ * Search a segment index for the segments that a record fits after
+ * (segbefore) and before (segafter) and the segment that the record
+ * follows in time order (followseg).
+ *
+ * The results are identical to searching the segment list in order:
+ * the candidate segments that end or start within the time tolerance
+ * of the record are found with binary searches and evaluated in list
+ * order.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+mstl_segindex_search (MSTraceSegIndex *index, MSRecord *msr, hptime_t endtime,
+                      hptime_t hpdelta, hptime_t hptimetol, double sampratetol,
+                      flag autoheal, MSTraceSeg **segbefore,
+                      MSTraceSeg **segafter, MSTraceSeg **followseg)
+{
+  MSTraceSeg *searchseg;
+  hptime_t nhptimetol = (hptimetol) ? -hptimetol : 0;
+  hptime_t postgap;
+  hptime_t pregap;
+  int32_t *candidates;
+  int32_t ncandidates = 0;
+  int32_t first1, last1;
+  int32_t first2, last2;
+  int32_t idx;
+  flag whence;
+
+  *segbefore = 0;
+  *segafter  = 0;
+
+  /* Segment the record follows in time order */
+  idx        = mstl_segindex_lower (index->bystart, index->count, msr->starttime, 0);
+  *followseg = (idx > 0) ? index->bystart[idx - 1] : 0;
+
+  /* Segments ending within the tolerance of the record start */
+  first1 = mstl_segindex_lower (index->byend, index->count,
+                                msr->starttime - hpdelta - hptimetol, 1);
+  for (last1 = first1; last1 < index->count; last1++)
+    if (index->byend[last1]->endtime > msr->starttime - hpdelta + hptimetol)
+      break;
+
+  /* Segments starting within the tolerance of the record end */
+  first2 = mstl_segindex_lower (index->bystart, index->count,
+                                endtime + hpdelta - hptimetol, 0);
+  for (last2 = first2; last2 < index->count; last2++)
+    if (index->bystart[last2]->starttime > endtime + hpdelta + hptimetol)
+      break;
+
+  if (last1 == first1 && last2 == first2)
+    return 0;
+
+  /* Collect list positions of candidate segments and sort */
+  if (!(candidates = (int32_t *)malloc ((last1 - first1 + last2 - first2) * sizeof (int32_t))))
+  {
+    ms_log (2, "mstl_addmsr(): Error allocating memory\n");
+    return -1;
+  }
+
+  for (idx = first1; idx < last1; idx++)
+  {
+    if ((candidates[ncandidates] = mstl_segindex_find (index->bystart, index->count,
+                                                       index->byend[idx], 0)) < 0)
+    {
+      ms_log (2, "mstl_addmsr(): Segment index is inconsistent\n");
+      free (candidates);
+      return -1;
+    }
+    ncandidates++;
+  }
+
+  for (idx = first2; idx < last2; idx++)
+    candidates[ncandidates++] = idx;
+
+  qsort (candidates, ncandidates, sizeof (int32_t), mstl_segindex_poscmp);
+
+  /* Evaluate candidates in list order, same logic as a list search */
+  for (idx = 0; idx < ncandidates; idx++)
+  {
+    if (idx > 0 && candidates[idx] == candidates[idx - 1])
+      continue;
+
+    searchseg = index->bystart[candidates[idx]];
+
+    whence = 0;
+
+    postgap = msr->starttime - searchseg->endtime - hpdelta;
+    if (!*segbefore && postgap <= hptimetol && postgap >= nhptimetol)
+      whence = 1;
+
+    pregap = searchseg->starttime - endtime - hpdelta;
+    if (!*segafter && pregap <= hptimetol && pregap >= nhptimetol)
+      whence = 2;
+
+    if (!whence)
+      continue;
+
+    if (sampratetol == -1.0)
+    {
+      if (!MS_ISRATETOLERABLE (msr->samprate, searchseg->samprate))
+        continue;
+    }
+    else
+    {
+      if (ms_dabs (msr->samprate - searchseg->samprate) > sampratetol)
+        continue;
+    }
+
+    if (whence == 1)
+      *segbefore = searchseg;
+    else
+      *segafter = searchseg;
+
+    /* Done searching if not autohealing */
+    if (!autoheal)
+      break;
+
+    /* Done searching if both before and after segments are found */
+    if (*segbefore && *segafter)
+      break;
+  }
+
+  free (candidates);
+
+  return 0;
+} /* End of mstl_segindex_search() */
+
+/***************************************************************************
+ * mstl_segindex_insert:
+ *
+ * Insert a segment into a segment index, the segment must already be
+ * linked into the segment list.  The entries following the segment in
+ * each array are moved, see MSTraceSegIndex.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+mstl_segindex_insert (MSTraceSegIndex *index, MSTraceSeg *seg)
+{
+  MSTraceSeg **newarray;
+  int32_t idx;
+
+  if (index->count >= index->size)
+  {
+    if (!(newarray = (MSTraceSeg **)realloc (index->bystart, index->size * 2 * sizeof (MSTraceSeg *))))
+      return -1;
+    index->bystart = newarray;
+
+    if (!(newarray = (MSTraceSeg **)realloc (index->byend, index->size * 2 * sizeof (MSTraceSeg *))))
+      return -1;
+    index->byend = newarray;
+
+    index->size *= 2;
+  }
+
+  /* Insert in list order after the previous segment */
+  if (seg->prev)
+  {
+    if ((idx = mstl_segindex_find (index->bystart, index->count, seg->prev, 0)) < 0)
+      return -1;
+    idx++;
+  }
+  else
+  {
+    idx = 0;
+  }
+
+  memmove (index->bystart + idx + 1, index->bystart + idx,
+           (index->count - idx) * sizeof (MSTraceSeg *));
+  index->bystart[idx] = seg;
+
+  /* Insert in end time order */
+  idx = mstl_segindex_lower (index->byend, index->count, seg->endtime, 1);
+
+  memmove (index->byend + idx + 1, index->byend + idx,
+           (index->count - idx) * sizeof (MSTraceSeg *));
+  index->byend[idx] = seg;
+
+  index->count++;
+
+  return 0;
+} /* End of mstl_segindex_insert() */
+
+/***************************************************************************
+ * mstl_segindex_remove:
+ *
+ * Remove a segment from a segment index, if any, must be called
+ * before the segment times are changed.  If the segment is not found
+ * the index is freed.
+ ***************************************************************************/
+static void
+mstl_segindex_remove (MSTraceSegIndex **psegindex, MSTraceSeg *seg)
+{
+  MSTraceSegIndex *index = *psegindex;
+  int32_t startidx;
+  int32_t endidx;
+
+  if (!index)
+    return;
+
+  startidx = mstl_segindex_find (index->bystart, index->count, seg, 0);
+  endidx   = mstl_segindex_find (index->byend, index->count, seg, 1);
+
+  if (startidx < 0 || endidx < 0)
+  {
+    mstl_segindex_free (psegindex);
+    return;
+  }
+
+  memmove (index->bystart + startidx, index->bystart + startidx + 1,
+           (index->count - startidx - 1) * sizeof (MSTraceSeg *));
+  memmove (index->byend + endidx, index->byend + endidx + 1,
+           (index->count - endidx - 1) * sizeof (MSTraceSeg *));
+
+  index->count--;
+} /* End of mstl_segindex_remove() */
+
+/***************************************************************************
+ * mstl_segindex_free:
+ *
+ * Free a segment index and clear the pointer to it.
+ ***************************************************************************/
+static void
+mstl_segindex_free (MSTraceSegIndex **psegindex)
+{
+  MSTraceSegIndex *index = *psegindex;
+
+  if (!index)
+    return;
+
+  free (index->bystart);
+  free (index->byend);
+  free (index);
+
+  *psegindex = 0;
+} /* End of mstl_segindex_free() */
 
 /***************************************************************************
  * mstl_msr2seg:
@@ -607,6 +1610,21 @@ mstl_addmsr (MSTraceList *mstl, MSRecord *msr, flag dataquality,
  ***************************************************************************/
 MSTraceSeg *
 mstl_msr2seg (MSRecord *msr, hptime_t endtime)
+{
+  return mstl_msr2seg_int (msr, endtime, 0);
+} /* End of mstl_msr2seg() */
+
+/***************************************************************************
+ * mstl_msr2seg_int:
+ *
+ * Create an MSTraceSeg structure from an MSRecord structure.  If
+ * adopt is true the MSRecord data sample buffer becomes the segment
+ * sample buffer and MSRecord->datasamples is set to NULL.
+ *
+ * Return a pointer to a MSTraceSeg otherwise 0 on error.
+ ***************************************************************************/
+static MSTraceSeg *
+mstl_msr2seg_int (MSRecord *msr, hptime_t endtime, flag adopt)
 {
   MSTraceSeg *seg = 0;
   int samplesize;
@@ -625,8 +1643,14 @@ mstl_msr2seg (MSRecord *msr, hptime_t endtime)
   seg->sampletype = msr->sampletype;
   seg->numsamples = msr->numsamples;
 
+  /* Adopt datasamples buffer */
+  if (adopt && msr->datasamples && msr->numsamples)
+  {
+    seg->datasamples = msr->datasamples;
+    msr->datasamples = 0;
+  }
   /* Allocate space for and copy datasamples */
-  if (msr->datasamples && msr->numsamples)
+  else if (msr->datasamples && msr->numsamples)
   {
     samplesize = ms_samplesize (msr->sampletype);
 
@@ -641,7 +1665,7 @@ mstl_msr2seg (MSRecord *msr, hptime_t endtime)
   }
 
   return seg;
-} /* End of mstl_msr2seg() */
+} /* End of mstl_msr2seg_int() */
 
 /***************************************************************************
  * mstl_addmsrtoseg:
@@ -657,14 +1681,64 @@ mstl_msr2seg (MSRecord *msr, hptime_t endtime)
  ***************************************************************************/
 MSTraceSeg *
 mstl_addmsrtoseg (MSTraceSeg *seg, MSRecord *msr, hptime_t endtime, flag whence)
+{
+  return mstl_addmsrtoseg_int (seg, msr, endtime, whence, 0);
+} /* End of mstl_addmsrtoseg() */
+
+/***************************************************************************
+ * mstl_addmsrtoseg_int:
+ *
+ * Add data coverage from a MSRecord structure to a MSTraceSeg
+ * structure, see mstl_addmsrtoseg().
+ *
+ * The sample buffer is grown geometrically, see ms_growsamples().
+ *
+ * If adopt is true and the segment contains no samples the MSRecord
+ * data sample buffer becomes the segment sample buffer.  Otherwise the
+ * samples are copied and the MSRecord buffer is freed.  In both cases
+ * MSRecord->datasamples is set to NULL.
+ *
+ * Return a pointer to a MSTraceSeg otherwise 0 on error.
+ ***************************************************************************/
+static MSTraceSeg *
+mstl_addmsrtoseg_int (MSTraceSeg *seg, MSRecord *msr, hptime_t endtime,
+                      flag whence, flag adopt)
 {
   int samplesize = 0;
-  void *newdatasamples;
+  void *samples  = 0;
 
   if (!seg || !msr)
     return 0;
 
-  /* Allocate more memory for data samples if included */
+  if (whence != 1 && whence != 2)
+  {
+    ms_log (2, "mstl_addmsrtoseg(): unrecognized whence value: %d\n", whence);
+    return 0;
+  }
+
+  /* Adopt the record buffer for a segment without samples */
+  if (adopt && msr->datasamples && msr->numsamples > 0 && seg->numsamples <= 0 &&
+      msr->sampletype == seg->sampletype &&
+      ms_samplesize (msr->sampletype))
+  {
+    if (seg->datasamples)
+      free (seg->datasamples);
+
+    seg->datasamples = msr->datasamples;
+    msr->datasamples = 0;
+
+    if (whence == 1)
+      seg->endtime = endtime;
+    else
+      seg->starttime = msr->starttime;
+
+    seg->samplecnt += msr->samplecnt;
+    seg->numsamples = msr->numsamples;
+
+    return seg;
+  }
+
+  /* Make room for data samples if included */
   if (msr->datasamples && msr->numsamples > 0)
   {
     if (msr->sampletype != seg->sampletype)
@@ -680,13 +1754,16 @@ mstl_addmsrtoseg (MSTraceSeg *seg, MSRecord *msr, hptime_t endtime, flag whence)
       return 0;
     }
 
-    if (!(newdatasamples = realloc (seg->datasamples, (size_t) ((seg->numsamples + msr->numsamples) * samplesize))))
+    if (!(samples = ms_growsamples (&seg->datasamples, seg->numsamples, msr->numsamples,
+                                    samplesize, whence)))
     {
       ms_log (2, "mstl_addmsrtoseg(): Error allocating memory\n");
       return 0;
     }
 
-    seg->datasamples = newdatasamples;
+    memcpy (samples, msr->datasamples, (size_t) (msr->numsamples * samplesize));
+
+    seg->numsamples += msr->numsamples;
   }
 
   /* Add coverage to end of segment */
@@ -694,43 +1771,23 @@ mstl_addmsrtoseg (MSTraceSeg *seg, MSRecord *msr, hptime_t endtime, flag whence)
   {
     seg->endtime = endtime;
     seg->samplecnt += msr->samplecnt;
-
-    if (msr->datasamples && msr->numsamples > 0)
-    {
-      memcpy ((char *)seg->datasamples + (seg->numsamples * samplesize),
-              msr->datasamples,
-              (size_t) (msr->numsamples * samplesize));
-
-      seg->numsamples += msr->numsamples;
-    }
   }
   /* Add coverage to beginning of segment */
-  else if (whence == 2)
+  else
   {
     seg->starttime = msr->starttime;
     seg->samplecnt += msr->samplecnt;
-
-    if (msr->datasamples && msr->numsamples > 0)
-    {
-      memmove ((char *)seg->datasamples + (msr->numsamples * samplesize),
-               seg->datasamples,
-               (size_t) (seg->numsamples * samplesize));
-
-      memcpy (seg->datasamples,
-              msr->datasamples,
-              (size_t) (msr->numsamples * samplesize));
-
-      seg->numsamples += msr->numsamples;
-    }
   }
-  else
+
+  /* Release the record buffer, the samples were copied */
+  if (adopt && msr->datasamples)
   {
-    ms_log (2, "mstl_addmsrtoseg(): unrecognized whence value: %d\n", whence);
-    return 0;
+    free (msr->datasamples);
+    msr->datasamples = 0;
   }
 
   return seg;
-} /* End of mstl_addmsrtoseg() */
+} /* End of mstl_addmsrtoseg_int() */
 
 /***************************************************************************
  * mstl_addsegtoseg:
@@ -743,7 +1800,7 @@ MSTraceSeg *
 mstl_addsegtoseg (MSTraceSeg *seg1, MSTraceSeg *seg2)
 {
   int samplesize = 0;
-  void *newdatasamples;
+  void *samples  = 0;
 
   if (!seg1 || !seg2)
     return 0;
@@ -764,13 +1821,12 @@ mstl_addsegtoseg (MSTraceSeg *seg1, MSTraceSeg *seg2)
       return 0;
     }
 
-    if (!(newdatasamples = realloc (seg1->datasamples, (size_t) ((seg1->numsamples + seg2->numsamples) * samplesize))))
+    if (!(samples = ms_growsamples (&seg1->datasamples, seg1->numsamples, seg2->numsamples,
+                                    samplesize, 1)))
     {
       ms_log (2, "mstl_addsegtoseg(): Error allocating memory\n");
       return 0;
     }
-
-    seg1->datasamples = newdatasamples;
   }
 
   /* Add seg2 coverage to end of seg1 */
@@ -779,9 +1835,7 @@ mstl_addsegtoseg (MSTraceSeg *seg1, MSTraceSeg *seg2)
 
   if (seg2->datasamples && seg2->numsamples > 0)
   {
-    memcpy ((char *)seg1->datasamples + (seg1->numsamples * samplesize),
-            seg2->datasamples,
-            (size_t) (seg2->numsamples * samplesize));
+    memcpy (samples, seg2->datasamples, (size_t) (seg2->numsamples * samplesize));
 
     seg1->numsamples += seg2->numsamples;
   }
@@ -828,6 +1882,14 @@ mstl_convertsamples (MSTraceSeg *seg, char type, flag truncate)
     return -1;
   }
 
+  /* Release any spare capacity, the buffer is reallocated in place */
+  if (seg->datasamples &&
+      ms_shrinksamples (&seg->datasamples, seg->numsamples, ms_samplesize (seg->sampletype)))
+  {
+    ms_log (2, "mstl_convertsamples: cannot re-allocate buffer for sample conversion\n");
+    return -1;
+  }
+
   idata = (int32_t *)seg->datasamples;
   fdata = (float *)seg->datasamples;
   ddata = (double *)seg->datasamples;
@@ -931,6 +1993,51 @@ mstl_convertsamples (MSTraceSeg *seg, char type, flag truncate)
   return 0;
 } /* End of mstl_convertsamples() */
 
+/***************************************************************************
+ * mstl_shrinksamples:
+ *
+ * Release spare capacity of the data sample buffers of all segments in
+ * a MSTraceList grown by adding samples, see ms_shrinksamples().
+ * Afterwards the buffer of each segment holds exactly
+ * MSTraceSeg->numsamples samples.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mstl_shrinksamples (MSTraceList *mstl)
+{
+  MSTraceID *id;
+  MSTraceSeg *seg;
+  int samplesize;
+
+  if (!mstl)
+    return -1;
+
+  for (id = mstl->traces; id; id = id->next)
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      if (!seg->datasamples)
+        continue;
+
+      if ((samplesize = ms_samplesize (seg->sampletype)) == 0)
+      {
+        ms_log (2, "mstl_shrinksamples(): Unrecognized sample type: '%c'\n",
+                seg->sampletype);
+        return -1;
+      }
+
+      if (ms_shrinksamples (&seg->datasamples, seg->numsamples, samplesize))
+      {
+        ms_log (2, "mstl_shrinksamples(): Cannot reallocate memory\n");
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+} /* End of mstl_shrinksamples() */
+
 /***************************************************************************
  * mstl_printtracelist:
  *
@@ -5,7 +5,7 @@
  *
  * Written by Chad Trabant, IRIS Data Management Center
  *
- * modified: 2015.108
+ * modified: 2026.291
  ***************************************************************************/
 
 #include <stdio.h>
@@ -14,14 +14,20 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "packdata.h"
 
 static int mst_groupsort_cmp (MSTrace *mst1, MSTrace *mst2, flag quality);
+static int mst_adoptmsr (MSTrace *mst, MSRecord *msr, flag whence);
+static int mst_healtrace (MSTrace *mst, MSTrace *next);
+static MSTrace *mst_addmsrtogroup_int (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
+                                       double timetol, double sampratetol, flag adopt);
 
 /***************************************************************************
  * mst_init:
  *
  * Initialize and return a MSTrace struct, allocating memory if needed.
  * If the specified MSTrace includes data samples they will be freed.
+ * A trace allocated from an arena remains owned by the arena.
  *
  * Returns a pointer to a MSTrace struct on success or NULL on error.
  ***************************************************************************/
@@ -35,7 +41,7 @@ mst_init (MSTrace *mst)
       free (mst->datasamples);
 
     if (mst->prvtptr)
-      free (mst->prvtptr);
+      ms_arena_release (mst->prvtptr);
 
     if (mst->ststate)
       free (mst->ststate);
@@ -56,6 +62,34 @@ mst_init (MSTrace *mst)
   return mst;
 } /* End of mst_init() */
 
+/***************************************************************************
+ * mst_init_arena:
+ *
+ * Allocate and initialize a MSTrace struct from an arena.  Data
+ * samples and stream state are always allocated on the heap and are
+ * freed by mst_free(), the MSTrace itself is released in bulk when the
+ * arena is reset or freed.  Private memory is released in bulk if it
+ * was allocated from an arena and freed by mst_free() otherwise.  If
+ * the arena is NULL this is equivalent to mst_init(NULL).
+ *
+ * Returns a pointer to a MSTrace struct on success or NULL on error.
+ ***************************************************************************/
+MSTrace *
+mst_init_arena (MSArena *arena)
+{
+  MSTrace *mst;
+
+  if (!(mst = (MSTrace *)ms_arena_alloc (arena, sizeof (MSTrace))))
+  {
+    ms_log (2, "mst_init_arena(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  memset (mst, 0, sizeof (MSTrace));
+
+  return mst;
+} /* End of mst_init_arena() */
+
 /***************************************************************************
  * mst_free:
  *
@@ -73,13 +107,13 @@ mst_free (MSTrace **ppmst)
 
     /* Free private memory if present */
     if ((*ppmst)->prvtptr)
-      free ((*ppmst)->prvtptr);
+      ms_arena_release ((*ppmst)->prvtptr);
 
     /* Free stream processing state if present */
     if ((*ppmst)->ststate)
       free ((*ppmst)->ststate);
 
-    free (*ppmst);
+    ms_arena_release (*ppmst);
 
     *ppmst = 0;
   }
@@ -92,17 +126,24 @@ mst_free (MSTrace **ppmst)
  * needed.  If the supplied MSTraceGroup is not NULL any associated
  * memory it will be freed.
  *
+ * If an arena is bound to the MSTraceGroup with mst_initgroup_arena()
+ * the binding is retained and the arena is reset, releasing all memory
+ * allocated from it in bulk, the arena itself is owned and freed by
+ * the caller.
+ *
  * Returns a pointer to a MSTraceGroup struct on success or NULL on error.
  ***************************************************************************/
 MSTraceGroup *
 mst_initgroup (MSTraceGroup *mstg)
 {
-  MSTrace *mst  = 0;
-  MSTrace *next = 0;
+  MSTrace *mst   = 0;
+  MSTrace *next  = 0;
+  MSArena *arena = 0;
 
   if (mstg)
   {
-    mst = mstg->traces;
+    mst   = mstg->traces;
+    arena = ms_arena_bound (mstg);
 
     while (mst)
     {
@@ -110,6 +151,9 @@ mst_initgroup (MSTraceGroup *mstg)
       mst_free (&mst);
       mst = next;
     }
+
+    if (arena)
+      ms_arena_init (arena, arena->blocksize);
   }
   else
   {
@@ -127,11 +171,40 @@ mst_initgroup (MSTraceGroup *mstg)
   return mstg;
 } /* End of mst_initgroup() */
 
+/***************************************************************************
+ * mst_initgroup_arena:
+ *
+ * Initialize and return a MSTraceGroup struct like mst_initgroup() and
+ * bind an arena to the group, new traces added to the group are then
+ * allocated from the arena.  The binding is kept outside of the
+ * MSTraceGroup and is removed by mst_freegroup(), ms_arena_free() or
+ * by calling this routine with a NULL arena.
+ *
+ * Returns a pointer to a MSTraceGroup struct on success or NULL on error.
+ ***************************************************************************/
+MSTraceGroup *
+mst_initgroup_arena (MSTraceGroup *mstg, MSArena *arena)
+{
+  MSTraceGroup *group;
+
+  if (!(group = mst_initgroup (mstg)))
+    return NULL;
+
+  if (ms_arena_bind (group, arena))
+  {
+    if (!mstg)
+      free (group);
+    return NULL;
+  }
+
+  return group;
+} /* End of mst_initgroup_arena() */
+
 /***************************************************************************
  * mst_freegroup:
  *
  * Free all memory associated with a MSTraceGroup struct and set the
- * pointer to 0.
+ * pointer to 0.  An arena bound to the MSTraceGroup is not freed.
  ***************************************************************************/
 void
 mst_freegroup (MSTraceGroup **ppmstg)
@@ -150,6 +223,8 @@ mst_freegroup (MSTraceGroup **ppmstg)
       mst = next;
     }
 
+    ms_arena_bind (*ppmstg, NULL);
+
     free (*ppmstg);
 
     *ppmstg = 0;
@@ -429,7 +504,8 @@ mst_findadjacent (MSTraceGroup *mstg, flag *whence, char dataquality,
  *
  * If whence is 1 the coverage will be added at the end of the trace,
  * whereas if whence is 2 the coverage will be added at the beginning
- * of the trace.
+ * of the trace.  The sample buffer is grown geometrically, see
+ * ms_growsamples().
  *
  * Return 0 on success and -1 on error.
  ***************************************************************************/
@@ -437,11 +513,12 @@ int
 mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence)
 {
   int samplesize = 0;
+  void *samples;
 
   if (!mst || !msr)
     return -1;
 
-  /* Reallocate data sample buffer if samples are present */
+  /* Check data samples if present */
   if (msr->datasamples && msr->numsamples >= 0)
   {
     /* Check that the entire record was decompressed */
@@ -464,25 +541,21 @@ mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence)
               msr->sampletype, mst->sampletype);
       return -1;
     }
-
-    mst->datasamples = realloc (mst->datasamples,
-                                (size_t) (mst->numsamples * samplesize + msr->numsamples * samplesize));
-
-    if (mst->datasamples == NULL)
-    {
-      ms_log (2, "mst_addmsr(): Cannot allocate memory\n");
-      return -1;
-    }
   }
 
   /* Add samples at end of trace */
   if (whence == 1)
   {
-    if (msr->datasamples && msr->numsamples >= 0)
+    if (msr->datasamples && msr->numsamples > 0)
     {
-      memcpy ((char *)mst->datasamples + (mst->numsamples * samplesize),
-              msr->datasamples,
-              (size_t) (msr->numsamples * samplesize));
+      if (!(samples = ms_growsamples (&mst->datasamples, mst->numsamples, msr->numsamples,
+                                      samplesize, 1)))
+      {
+        ms_log (2, "mst_addmsr(): Cannot allocate memory\n");
+        return -1;
+      }
+
+      memcpy (samples, msr->datasamples, (size_t) (msr->numsamples * samplesize));
 
       mst->numsamples += msr->numsamples;
     }
@@ -499,19 +572,16 @@ mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence)
   /* Add samples at the beginning of trace */
   else if (whence == 2)
   {
-    if (msr->datasamples && msr->numsamples >= 0)
+    if (msr->datasamples && msr->numsamples > 0)
     {
-      /* Move any samples to end of buffer */
-      if (mst->numsamples > 0)
+      if (!(samples = ms_growsamples (&mst->datasamples, mst->numsamples, msr->numsamples,
+                                      samplesize, 2)))
       {
-        memmove ((char *)mst->datasamples + (msr->numsamples * samplesize),
-                 mst->datasamples,
-                 (size_t) (mst->numsamples * samplesize));
+        ms_log (2, "mst_addmsr(): Cannot allocate memory\n");
+        return -1;
       }
 
-      memcpy (mst->datasamples,
-              msr->datasamples,
-              (size_t) (msr->numsamples * samplesize));
+      memcpy (samples, msr->datasamples, (size_t) (msr->numsamples * samplesize));
 
       mst->numsamples += msr->numsamples;
     }
@@ -529,6 +599,63 @@ mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence)
   return 0;
 } /* End of mst_addmsr() */
 
+/***************************************************************************
+ * mst_adoptmsr:
+ *
+ * Add MSRecord time coverage to a MSTrace like mst_addmsr() taking
+ * ownership of the MSRecord data sample buffer, see
+ * mst_adoptsamples().
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+mst_adoptmsr (MSTrace *mst, MSRecord *msr, flag whence)
+{
+  void *datasamples;
+
+  if (!mst || !msr)
+    return -1;
+
+  /* Copy samples unless the trace contains no samples */
+  if (!msr->datasamples || msr->numsamples <= 0 || mst->numsamples > 0 ||
+      msr->sampletype != mst->sampletype ||
+      ms_samplesize (msr->sampletype) == 0)
+  {
+    if (mst_addmsr (mst, msr, whence))
+      return -1;
+
+    if (msr->datasamples)
+      free (msr->datasamples);
+    msr->datasamples = 0;
+
+    return 0;
+  }
+
+  if (msr->samplecnt != msr->numsamples)
+  {
+    ms_log (2, "mst_addmsr(): Sample counts do not match, record not fully decompressed?\n");
+    ms_log (2, "  The sample buffer will likely contain a discontinuity.\n");
+  }
+
+  /* Update times and counts without samples, then install the buffer */
+  datasamples      = msr->datasamples;
+  msr->datasamples = 0;
+
+  if (mst_addmsr (mst, msr, whence))
+  {
+    msr->datasamples = datasamples;
+    return -1;
+  }
+
+  if (mst->datasamples)
+    free (mst->datasamples);
+
+  mst->datasamples = datasamples;
+  mst->numsamples  = msr->numsamples;
+
+  return 0;
+} /* End of mst_adoptmsr() */
+
 /***************************************************************************
  * mst_addspan:
  *
@@ -548,6 +675,7 @@ mst_addspan (MSTrace *mst, hptime_t starttime, hptime_t endtime,
              flag whence)
 {
   int samplesize = 0;
+  void *samples;
 
   if (!mst)
     return -1;
@@ -568,14 +696,6 @@ mst_addspan (MSTrace *mst, hptime_t starttime, hptime_t endtime,
       return -1;
     }
 
-    mst->datasamples = realloc (mst->datasamples,
-                                (size_t) (mst->numsamples * samplesize + numsamples * samplesize));
-
-    if (mst->datasamples == NULL)
-    {
-      ms_log (2, "mst_addspan(): Cannot allocate memory\n");
-      return -1;
-    }
   }
 
   /* Add samples at end of trace */
@@ -583,9 +703,14 @@ mst_addspan (MSTrace *mst, hptime_t starttime, hptime_t endtime,
   {
     if (datasamples && numsamples > 0)
     {
-      memcpy ((char *)mst->datasamples + (mst->numsamples * samplesize),
-              datasamples,
-              (size_t) (numsamples * samplesize));
+      if (!(samples = ms_growsamples (&mst->datasamples, mst->numsamples, numsamples,
+                                      samplesize, 1)))
+      {
+        ms_log (2, "mst_addspan(): Cannot allocate memory\n");
+        return -1;
+      }
+
+      memcpy (samples, datasamples, (size_t) (numsamples * samplesize));
 
       mst->numsamples += numsamples;
     }
@@ -598,17 +723,14 @@ mst_addspan (MSTrace *mst, hptime_t starttime, hptime_t endtime,
   {
     if (datasamples && numsamples > 0)
     {
-      /* Move any samples to end of buffer */
-      if (mst->numsamples > 0)
+      if (!(samples = ms_growsamples (&mst->datasamples, mst->numsamples, numsamples,
+                                      samplesize, 2)))
       {
-        memmove ((char *)mst->datasamples + (numsamples * samplesize),
-                 mst->datasamples,
-                 (size_t) (mst->numsamples * samplesize));
+        ms_log (2, "mst_addspan(): Cannot allocate memory\n");
+        return -1;
       }
 
-      memcpy (mst->datasamples,
-              datasamples,
-              (size_t) (numsamples * samplesize));
+      memcpy (samples, datasamples, (size_t) (numsamples * samplesize));
 
       mst->numsamples += numsamples;
     }
@@ -639,6 +761,57 @@ mst_addspan (MSTrace *mst, hptime_t starttime, hptime_t endtime,
 MSTrace *
 mst_addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
                    double timetol, double sampratetol)
+{
+  return mst_addmsrtogroup_int (mstg, msr, dataquality, timetol, sampratetol, 0);
+} /* End of mst_addmsrtogroup() */
+
+/***************************************************************************
+ * mst_adoptsamples:
+ *
+ * Add a MSRecord to a MSTraceGroup like mst_addmsrtogroup() but
+ * transfer ownership of the MSRecord data sample buffer, which must
+ * have been allocated with malloc(), to the MSTraceGroup.
+ *
+ * When the MSRecord starts a new MSTrace the sample buffer becomes
+ * the MSTrace sample buffer without copying.  When added to an
+ * existing MSTrace the samples are copied and the buffer is freed.
+ *
+ * On success MSRecord->datasamples is set to NULL.  On error the
+ * caller retains ownership of the buffer if MSRecord->datasamples is
+ * not NULL.
+ *
+ * Return a pointer to the MSTrace updated or 0 on error.
+ ***************************************************************************/
+MSTrace *
+mst_adoptsamples (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
+                  double timetol, double sampratetol)
+{
+  MSTrace *mst;
+
+  mst = mst_addmsrtogroup_int (mstg, msr, dataquality, timetol, sampratetol, 1);
+
+  /* Release a buffer that did not contribute to the trace */
+  if (mst && msr->datasamples)
+  {
+    free (msr->datasamples);
+    msr->datasamples = 0;
+  }
+
+  return mst;
+} /* End of mst_adoptsamples() */
+
+/***************************************************************************
+ * mst_addmsrtogroup_int:
+ *
+ * Add a MSRecord to a MSTraceGroup, see mst_addmsrtogroup().  If
+ * adopt is true ownership of the data samples is transferred, see
+ * mst_adoptsamples().
+ *
+ * Return a pointer to the MSTrace updated or 0 on error.
+ ***************************************************************************/
+static MSTrace *
+mst_addmsrtogroup_int (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
+                       double timetol, double sampratetol, flag adopt)
 {
   MSTrace *mst = 0;
   hptime_t endtime;
@@ -672,14 +845,15 @@ mst_addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
     if (msr->samplecnt <= 0 || msr->samprate <= 0.0)
       return mst;
 
-    if (mst_addmsr (mst, msr, whence))
+    if ((adopt) ? mst_adoptmsr (mst, msr, whence) : mst_addmsr (mst, msr, whence))
     {
       return 0;
     }
   }
   else
   {
-    mst = mst_init (NULL);
+    if (!(mst = mst_init_arena (ms_arena_bound (mstg))))
+      return 0;
 
     mst->dataquality = dq;
 
@@ -692,7 +866,7 @@ mst_addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
     mst->samprate   = msr->samprate;
     mst->sampletype = msr->sampletype;
 
-    if (mst_addmsr (mst, msr, 1))
+    if ((adopt) ? mst_adoptmsr (mst, msr, 1) : mst_addmsr (mst, msr, 1))
     {
       mst_free (&mst);
       return 0;
@@ -717,7 +891,7 @@ mst_addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
   }
 
   return mst;
-} /* End of mst_addmsrtogroup() */
+} /* End of mst_addmsrtogroup_int() */
 
 /***************************************************************************
  * mst_addtracetogroup:
@@ -765,6 +939,16 @@ mst_addtracetogroup (MSTraceGroup *mstg, MSTrace *mst)
  * contiguous time coverage.  The MSTraceGroup will be sorted using
  * mst_groupsort() before healing.
  *
+ * The traces are sorted by source name without quality and start
+ * time for healing.  Each trace is then compared to the following
+ * traces with the same network, station, location and channel until
+ * one starts beyond the end of the trace, so overlapping traces and
+ * traces with a different sample rate do not hide contiguous ones.
+ * Traces of different quality are merged and the quality indicator
+ * of the merged trace is reset to 0.  Sample buffers are moved rather
+ * than copied where possible, see mst_healtrace().  The group is
+ * sorted with quality afterwards.
+ *
  * The time tolerance and sample rate tolerance are used to determine
  * if the traces are indeed the same.  If timetol is -1.0 the default
  * tolerance of 1/2 the sample period will be used.  If samprratetol
@@ -778,141 +962,156 @@ mst_groupheal (MSTraceGroup *mstg, double timetol, double sampratetol)
 {
   int mergings         = 0;
   MSTrace *curtrace    = 0;
-  MSTrace *nexttrace   = 0;
   MSTrace *searchtrace = 0;
   MSTrace *prevtrace   = 0;
-  int8_t merged        = 0;
-  double postgap, pregap, delta;
+  double postgap, delta, tolerance;
 
   if (!mstg)
     return -1;
 
-  /* Sort MSTraceGroup before any healing */
-  if (mst_groupsort (mstg, 1))
+  /* Sort MSTraceGroup by source name and time before any healing */
+  if (mst_groupsort (mstg, 0))
     return -1;
 
-  curtrace = mstg->traces;
-
-  while (curtrace)
+  for (curtrace = mstg->traces; curtrace; curtrace = curtrace->next)
   {
-    nexttrace = mstg->traces;
-    prevtrace = mstg->traces;
+    delta = (curtrace->samprate) ? (1.0 / curtrace->samprate) : 0.0;
 
-    while (nexttrace)
-    {
-      searchtrace = nexttrace;
-      nexttrace   = searchtrace->next;
+    /* Calculate default time tolerance (1/2 sample period) if needed */
+    tolerance = (timetol == -1.0) ? 0.5 * delta : timetol;
 
-      /* Do not process the same MSTrace we are trying to match */
-      if (searchtrace == curtrace)
-      {
-        prevtrace = searchtrace;
-        continue;
-      }
+    prevtrace   = curtrace;
+    searchtrace = curtrace->next;
 
-      /* Check if this trace matches the curtrace */
+    while (searchtrace)
+    {
+      /* Following traces with the same ID are adjacent */
       if (strcmp (searchtrace->network, curtrace->network) ||
           strcmp (searchtrace->station, curtrace->station) ||
           strcmp (searchtrace->location, curtrace->location) ||
           strcmp (searchtrace->channel, curtrace->channel))
-      {
-        prevtrace = searchtrace;
-        continue;
-      }
+        break;
 
-      /* Perform default samprate tolerance check if requested */
-      if (sampratetol == -1.0)
-      {
-        if (!MS_ISRATETOLERABLE (searchtrace->samprate, curtrace->samprate))
-        {
-          prevtrace = searchtrace;
-          continue;
-        }
-      }
-      /* Otherwise check against the specified sample rates tolerance */
-      else if (ms_dabs (searchtrace->samprate - curtrace->samprate) > sampratetol)
+      /* postgap is negative when searchtrace overlaps curtrace and
+         positive when there is a time gap, later traces start later */
+      postgap = ((double)(searchtrace->starttime - curtrace->endtime) / HPTMODULUS) - delta;
+
+      if (postgap > tolerance)
+        break;
+
+      /* Merge if searchtrace fits right at the end of curtrace and the
+       * sample rate is tolerable, otherwise continue searching */
+      if (ms_dabs (postgap) > tolerance ||
+          (sampratetol == -1.0 && !MS_ISRATETOLERABLE (searchtrace->samprate, curtrace->samprate)) ||
+          (sampratetol != -1.0 && ms_dabs (searchtrace->samprate - curtrace->samprate) > sampratetol) ||
+          mst_healtrace (curtrace, searchtrace))
       {
-        prevtrace = searchtrace;
+        prevtrace   = searchtrace;
+        searchtrace = searchtrace->next;
         continue;
       }
 
-      merged = 0;
+      /* If qualities do not match reset the indicator */
+      if (curtrace->dataquality != searchtrace->dataquality)
+        curtrace->dataquality = 0;
 
-      /* post/pregap are negative when searchtrace overlaps curtrace
-         segment and positive when there is a time gap. */
-      delta = (curtrace->samprate) ? (1.0 / curtrace->samprate) : 0.0;
+      /* Re-link trace chain and free searchtrace */
+      prevtrace->next = searchtrace->next;
 
-      postgap = ((double)(searchtrace->starttime - curtrace->endtime) / HPTMODULUS) - delta;
+      mst_free (&searchtrace);
 
-      pregap = ((double)(curtrace->starttime - searchtrace->endtime) / HPTMODULUS) - delta;
+      searchtrace = prevtrace->next;
 
-      /* Calculate default time tolerance (1/2 sample period) if needed */
-      if (timetol == -1.0)
-        timetol = 0.5 * delta;
+      mstg->numtraces--;
+      mergings++;
+    }
+  }
 
-      /* Fits right at the end of curtrace */
-      if (ms_dabs (postgap) <= timetol)
-      {
-        /* Merge searchtrace with curtrace */
-        mst_addspan (curtrace, searchtrace->starttime, searchtrace->endtime,
-                     searchtrace->datasamples, searchtrace->numsamples,
-                     searchtrace->sampletype, 1);
+  /* Sort MSTraceGroup by source name including quality */
+  if (mst_groupsort (mstg, 1))
+    return -1;
 
-        /* If no data is present, make sure sample count is updated */
-        if (searchtrace->numsamples <= 0)
-          curtrace->samplecnt += searchtrace->samplecnt;
+  return mergings;
+} /* End of mst_groupheal() */
 
-        /* If qualities do not match reset the indicator */
-        if (curtrace->dataquality != searchtrace->dataquality)
-          curtrace->dataquality = 0;
+/***************************************************************************
+ * mst_healtrace:
+ *
+ * Add the coverage of a following MSTrace to the end of a MSTrace,
+ * the samples are moved to whichever sample buffer already contains
+ * more samples such that only the smaller set is copied.  An empty
+ * trace takes over the sample buffer of the other trace.  The
+ * following trace retains either buffer and is expected to be freed.
+ *
+ * Return 0 on success and -1 if the traces cannot be merged.
+ ***************************************************************************/
+static int
+mst_healtrace (MSTrace *mst, MSTrace *next)
+{
+  MSTrace swap;
+  int64_t addsamples = next->numsamples;
+  int samplesize;
+  void *samples;
 
-        merged = 1;
-      }
+  if (next->datasamples && next->numsamples > 0)
+  {
+    if (next->sampletype != mst->sampletype ||
+        (samplesize = ms_samplesize (next->sampletype)) == 0)
+      return -1;
 
-      /* Fits right at the beginning of curtrace */
-      else if (ms_dabs (pregap) <= timetol)
+    /* Append following samples to the larger buffer */
+    if (mst->datasamples && mst->numsamples > 0 && mst->numsamples > next->numsamples)
+    {
+      if (!(samples = ms_growsamples (&mst->datasamples, mst->numsamples, next->numsamples,
+                                      samplesize, 1)))
       {
-        /* Merge searchtrace with curtrace */
-        mst_addspan (curtrace, searchtrace->starttime, searchtrace->endtime,
-                     searchtrace->datasamples, searchtrace->numsamples,
-                     searchtrace->sampletype, 2);
+        ms_log (2, "mst_groupheal(): Cannot allocate memory\n");
+        return -1;
+      }
 
-        /* If no data is present, make sure sample count is updated */
-        if (searchtrace->numsamples <= 0)
-          curtrace->samplecnt += searchtrace->samplecnt;
+      memcpy (samples, next->datasamples, (size_t) (next->numsamples * samplesize));
+
+      mst->numsamples += next->numsamples;
+    }
+    /* Otherwise prepend samples to the following buffer and swap buffers */
+    else
+    {
+      if (mst->datasamples && mst->numsamples > 0)
+      {
+        if (!(samples = ms_growsamples (&next->datasamples, next->numsamples, mst->numsamples,
+                                        samplesize, 2)))
+        {
+          ms_log (2, "mst_groupheal(): Cannot allocate memory\n");
+          return -1;
+        }
 
-        /* If qualities do not match reset the indicator */
-        if (curtrace->dataquality != searchtrace->dataquality)
-          curtrace->dataquality = 0;
+        memcpy (samples, mst->datasamples, (size_t) (mst->numsamples * samplesize));
 
-        merged = 1;
+        next->numsamples += mst->numsamples;
       }
 
-      /* If searchtrace was merged with curtrace remove it from the chain */
-      if (merged)
-      {
-        /* Re-link trace chain and free searchtrace */
-        if (searchtrace == mstg->traces)
-          mstg->traces = nexttrace;
-        else
-          prevtrace->next = nexttrace;
+      swap.datasamples = mst->datasamples;
+      swap.numsamples  = mst->numsamples;
 
-        mst_free (&searchtrace);
+      mst->datasamples = next->datasamples;
+      mst->numsamples  = next->numsamples;
 
-        mstg->numtraces--;
-        mergings++;
-      }
-      else
-      {
-        prevtrace = searchtrace;
-      }
+      next->datasamples = swap.datasamples;
+      next->numsamples  = swap.numsamples;
     }
 
-    curtrace = curtrace->next;
+    mst->samplecnt += addsamples;
+  }
+  /* If no data is present, make sure sample count is updated */
+  else
+  {
+    mst->samplecnt += next->samplecnt;
   }
 
-  return mergings;
-} /* End of mst_groupheal() */
+  mst->endtime = next->endtime;
+
+  return 0;
+} /* End of mst_healtrace() */
 
 /***************************************************************************
  * mst_groupsort:
@@ -1122,6 +1321,10 @@ mst_convertsamples (MSTrace *mst, char type, flag truncate)
     return -1;
   }
 
+  /* Release any spare capacity, the buffer is reallocated in place */
+  if (mst_shrinksamples (mst))
+    return -1;
+
   idata = (int32_t *)mst->datasamples;
   fdata = (float *)mst->datasamples;
   ddata = (double *)mst->datasamples;
@@ -1225,6 +1428,42 @@ mst_convertsamples (MSTrace *mst, char type, flag truncate)
   return 0;
 } /* End of mst_convertsamples() */
 
+/***************************************************************************
+ * mst_shrinksamples:
+ *
+ * Release spare capacity of the data sample buffer of a MSTrace grown
+ * by adding samples, see ms_shrinksamples().  Afterwards the buffer
+ * holds exactly MSTrace->numsamples samples.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mst_shrinksamples (MSTrace *mst)
+{
+  int samplesize;
+
+  if (!mst)
+    return -1;
+
+  if (!mst->datasamples)
+    return 0;
+
+  if ((samplesize = ms_samplesize (mst->sampletype)) == 0)
+  {
+    ms_log (2, "mst_shrinksamples(): Unrecognized sample type: '%c'\n",
+            mst->sampletype);
+    return -1;
+  }
+
+  if (ms_shrinksamples (&mst->datasamples, mst->numsamples, samplesize))
+  {
+    ms_log (2, "mst_shrinksamples(): Cannot reallocate memory\n");
+    return -1;
+  }
+
+  return 0;
+} /* End of mst_shrinksamples() */
+
 /***************************************************************************
  * mst_srcname:
  *
@@ -1653,6 +1892,49 @@ mst_pack (MSTrace *mst, void (*record_handler) (char *, int, void *),
           void *handlerdata, int reclen, flag encoding, flag byteorder,
           int64_t *packedsamples, flag flush, flag verbose,
           MSRecord *mstemplate)
+{
+  return mst_pack_parallel (mst, record_handler, handlerdata, reclen, encoding,
+                            byteorder, packedsamples, flush, 1, verbose,
+                            mstemplate);
+} /* End of mst_pack() */
+
+/***************************************************************************
+ * mst_pack_parallel:
+ *
+ * Pack MSTrace data into Mini-SEED records like mst_pack() using up to
+ * workers threads to encode Steim1/2 records of long traces, see
+ * msr_pack_parallel().  The records are identical to those packed by
+ * mst_pack().
+ *
+ * Returns the number of records created on success and -1 on error.
+ ***************************************************************************/
+int
+mst_pack_parallel (MSTrace *mst, void (*record_handler) (char *, int, void *),
+                   void *handlerdata, int reclen, flag encoding, flag byteorder,
+                   int64_t *packedsamples, flag flush, int workers, flag verbose,
+                   MSRecord *mstemplate)
+{
+  return mst_pack_reclens (mst, record_handler, handlerdata, &reclen, 1, encoding,
+                           byteorder, packedsamples, flush, workers, verbose,
+                           mstemplate);
+} /* End of mst_pack_parallel() */
+
+/***************************************************************************
+ * mst_pack_reclens:
+ *
+ * Pack MSTrace data into Mini-SEED records like mst_pack_parallel()
+ * with the record lengths chosen from the reclencount lengths in
+ * reclens such that the total length of the records is minimal, see
+ * msr_pack_reclens().  The first length takes the place of the reclen
+ * argument of mst_pack().
+ *
+ * Returns the number of records created on success and -1 on error.
+ ***************************************************************************/
+int
+mst_pack_reclens (MSTrace *mst, void (*record_handler) (char *, int, void *),
+                  void *handlerdata, const int *reclens, int reclencount,
+                  flag encoding, flag byteorder, int64_t *packedsamples,
+                  flag flush, int workers, flag verbose, MSRecord *mstemplate)
 {
   MSRecord *msr;
   char srcname[50];
@@ -1712,7 +1994,7 @@ mst_pack (MSTrace *mst, void (*record_handler) (char *, int, void *),
   }
 
   /* Setup MSRecord template for packing */
-  msr->reclen    = reclen;
+  msr->reclen    = (reclens && reclencount > 0) ? reclens[0] : -1;
   msr->encoding  = encoding;
   msr->byteorder = byteorder;
 
@@ -1731,7 +2013,8 @@ mst_pack (MSTrace *mst, void (*record_handler) (char *, int, void *),
   }
 
   /* Pack data */
-  trpackedrecords = msr_pack (msr, record_handler, handlerdata, &trpackedsamples, flush, verbose);
+  trpackedrecords = msr_pack_reclens (msr, record_handler, handlerdata, &trpackedsamples,
+                                      flush, reclens, reclencount, workers, verbose);
 
   if (verbose > 1)
   {
@@ -1747,19 +2030,13 @@ mst_pack (MSTrace *mst, void (*record_handler) (char *, int, void *),
     samplesize = ms_samplesize (mst->sampletype);
     bufsize    = (mst->numsamples - trpackedsamples) * samplesize;
 
+    /* Move remaining samples to the start of the buffer, the buffer
+     * keeps its size for samples added later */
     if (bufsize)
     {
       memmove (mst->datasamples,
                (char *)mst->datasamples + (trpackedsamples * samplesize),
                (size_t)bufsize);
-
-      mst->datasamples = realloc (mst->datasamples, (size_t)bufsize);
-
-      if (mst->datasamples == NULL)
-      {
-        ms_log (2, "mst_pack(): Cannot (re)allocate datasamples buffer\n");
-        return -1;
-      }
     }
     else
     {
@@ -1793,7 +2070,7 @@ mst_pack (MSTrace *mst, void (*record_handler) (char *, int, void *),
     *packedsamples = trpackedsamples;
 
   return trpackedrecords;
-} /* End of mst_pack() */
+} /* End of mst_pack_reclens() */
 
 /***************************************************************************
  * mst_packgroup:
@@ -13,7 +13,7 @@
  *   ORFEUS/EC-Project MEREDIAN
  *   IRIS Data Management Center
  *
- * modified: 2016.273
+ * modified: 2026.291
  ***************************************************************************/
 #include <ctype.h>
 #include <stdio.h>
@@ -22,9 +22,14 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "packdata.h"
 #include "unpackdata.h"
 
 /* Function(s) internal to this file */
+static int msr_unpack_int (char *record, int reclen, MSRecord **ppmsr,
+                           flag dataflag, void *buffer, size_t buffersize, flag verbose);
+static int msr_decode_data (MSRecord *msr, int swapflag, void *output,
+                            size_t outputsize, flag verbose);
 static int check_environment (int verbose);
 
 /* Header and data byte order flags controlled by environment variables */
@@ -68,6 +73,54 @@ int unpackencodingfallback = -2;
 int
 msr_unpack (char *record, int reclen, MSRecord **ppmsr,
             flag dataflag, flag verbose)
+{
+  return msr_unpack_int (record, reclen, ppmsr, dataflag, NULL, 0, verbose);
+} /* End of msr_unpack() */
+
+/***************************************************************************
+ * msr_unpack_buffer:
+ *
+ * Unpack a SEED data record the same as msr_unpack() with the dataflag
+ * set, but decode the data samples into a buffer supplied by the
+ * caller instead of MSRecord->datasamples.  This allows samples of
+ * many records to be decoded directly into their final location, for
+ * example at consecutive positions of a preallocated trace buffer.
+ *
+ * The buffer must be large enough for MSRecord->samplecnt samples of
+ * the sample type of the encoding.  MSRecord->datasamples is set to
+ * NULL and MSRecord->numsamples and MSRecord->sampletype are set to
+ * the number and type of the decoded samples.
+ *
+ * Returns MS_NOERROR and populates the MSRecord struct at *ppmsr on
+ * success, otherwise returns a libmseed error code (listed in
+ * libmseed.h).
+ ***************************************************************************/
+int
+msr_unpack_buffer (char *record, int reclen, MSRecord **ppmsr,
+                   void *buffer, size_t buffersize, flag verbose)
+{
+  if (!buffer)
+  {
+    ms_log (2, "msr_unpack_buffer(): buffer argument cannot be NULL\n");
+    return MS_GENERROR;
+  }
+
+  return msr_unpack_int (record, reclen, ppmsr, 1, buffer, buffersize, verbose);
+} /* End of msr_unpack_buffer() */
+
+/***************************************************************************
+ * msr_unpack_int:
+ *
+ * Unpack a SEED data record, see msr_unpack() for details.  If buffer
+ * is not NULL data samples are decoded into the buffer instead of
+ * MSRecord->datasamples, see msr_unpack_buffer().
+ *
+ * Returns MS_NOERROR on success, otherwise returns a libmseed error
+ * code (listed in libmseed.h).
+ ***************************************************************************/
+static int
+msr_unpack_int (char *record, int reclen, MSRecord **ppmsr,
+                flag dataflag, void *buffer, size_t buffersize, flag verbose)
 {
   flag headerswapflag = 0;
   flag dataswapflag   = 0;
@@ -129,7 +182,8 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
       return MS_GENERROR;
 
   /* Allocate and copy fixed section of data header */
-  msr->fsdh = realloc (msr->fsdh, sizeof (struct fsdh_s));
+  if (!msr->fsdh)
+    msr->fsdh = (struct fsdh_s *)ms_arena_alloc (ms_arena_owner (msr), sizeof (struct fsdh_s));
 
   if (msr->fsdh == NULL)
   {
@@ -687,7 +741,19 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
     else if (verbose > 2)
       ms_log (1, "%s: Byte swapping NOT needed for unpacking of data samples\n", srcname);
 
-    retval = msr_unpack_data (msr, dswapflag, verbose);
+    if (buffer)
+    {
+      if (msr->datasamples)
+        free (msr->datasamples);
+
+      msr->datasamples = 0;
+
+      retval = msr_decode_data (msr, dswapflag, buffer, buffersize, verbose);
+    }
+    else
+    {
+      retval = msr_unpack_data (msr, dswapflag, verbose);
+    }
 
     if (retval < 0)
       return retval;
@@ -704,7 +770,242 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
   }
 
   return MS_NOERROR;
-} /* End of msr_unpack() */
+} /* End of msr_unpack_int() */
+
+/***************************************************************************
+ * msr_unpack_header:
+ *
+ * Unpack the common header fields of a SEED data record into a
+ * MSRecord struct without parsing the blockette chain into blockette
+ * links or unpacking data samples.  The fixed section of the header
+ * is copied to MSRecord->fsdh and byte swapped as needed, the
+ * blockettes are scanned in place for the values of Blockettes 100,
+ * 1000 and 1001.
+ *
+ * The source name, data quality, sequence number, start time, sample
+ * rate, sample count, encoding, byte order and record length are set
+ * to the same values as msr_unpack() would set.  The record length is
+ * from Blockette 1000 if present, otherwise the specified reclen.
+ * The Blkt100, Blkt1000 and Blkt1001 pointers are not set and no
+ * samples are unpacked.
+ *
+ * The MSRecord->fsdh may point to storage supplied by the caller,
+ * otherwise it is allocated and reused by subsequent calls.  This
+ * routine is intended for fast scanning of many records with a single
+ * MSRecord, no other memory is allocated.
+ *
+ * Returns MS_NOERROR on success, otherwise returns a libmseed error
+ * code (listed in libmseed.h).
+ ***************************************************************************/
+int
+msr_unpack_header (char *record, int reclen, MSRecord *msr, flag verbose)
+{
+  flag headerswapflag = 0;
+  char sequence_number[7];
+  uint16_t blkt_type;
+  uint16_t next_blkt;
+  uint32_t blkt_offset;
+  uint32_t blkt_length;
+  struct blkt_100_s blkt_100;
+  struct blkt_1000_s blkt_1000;
+  uint32_t blkt_end = 0;
+  int blkt_count    = 0;
+  int8_t usec       = 0;
+  flag b100         = 0;
+  char srcname[50];
+
+  if (!record || !msr)
+  {
+    ms_log (2, "msr_unpack_header(): Required argument not defined: 'record' or 'msr'\n");
+    return MS_GENERROR;
+  }
+
+  /* Verify that record includes a valid header */
+  if (!MS_ISVALIDHEADER (record))
+  {
+    ms_recsrcname (record, srcname, 1);
+    ms_log (2, "msr_unpack_header(%s) Record header & quality indicator unrecognized\n", srcname);
+    return MS_NOTSEED;
+  }
+
+  /* Verify that passed record length is within supported range */
+  if (reclen < MINRECLEN || reclen > MAXRECLEN)
+  {
+    ms_recsrcname (record, srcname, 1);
+    ms_log (2, "msr_unpack_header(%s): Record length is out of range: %d\n", srcname, reclen);
+    return MS_OUTOFRANGE;
+  }
+
+  /* Check environment variables if necessary */
+  if (unpackheaderbyteorder == -2 ||
+      unpackdatabyteorder == -2 ||
+      unpackencodingformat == -2 ||
+      unpackencodingfallback == -2)
+    if (check_environment (verbose))
+      return MS_GENERROR;
+
+  if (!msr->fsdh && !(msr->fsdh = ms_arena_alloc (ms_arena_owner (msr), sizeof (struct fsdh_s))))
+  {
+    ms_log (2, "msr_unpack_header(): Cannot allocate memory\n");
+    return MS_GENERROR;
+  }
+
+  memcpy (msr->fsdh, record, sizeof (struct fsdh_s));
+
+  /* Check to see if byte swapping is needed by testing the year and day */
+  if (!MS_ISVALIDYEARDAY (msr->fsdh->start_time.year, msr->fsdh->start_time.day))
+    headerswapflag = 1;
+
+  /* Check if byte order is forced */
+  if (unpackheaderbyteorder >= 0)
+    headerswapflag = (ms_bigendianhost () != unpackheaderbyteorder) ? 1 : 0;
+
+  if (headerswapflag)
+  {
+    MS_SWAPBTIME (&msr->fsdh->start_time);
+    ms_gswap2a (&msr->fsdh->numsamples);
+    ms_gswap2a (&msr->fsdh->samprate_fact);
+    ms_gswap2a (&msr->fsdh->samprate_mult);
+    ms_gswap4a (&msr->fsdh->time_correct);
+    ms_gswap2a (&msr->fsdh->data_offset);
+    ms_gswap2a (&msr->fsdh->blockette_offset);
+  }
+
+  /* Populate the common header fields */
+  strncpy (sequence_number, msr->fsdh->sequence_number, 6);
+  sequence_number[6]   = '\0';
+  msr->sequence_number = (int32_t)strtol (sequence_number, NULL, 10);
+  msr->dataquality     = msr->fsdh->dataquality;
+  ms_strncpcleantail (msr->network, msr->fsdh->network, 2);
+  ms_strncpcleantail (msr->station, msr->fsdh->station, 5);
+  ms_strncpcleantail (msr->location, msr->fsdh->location, 2);
+  ms_strncpcleantail (msr->channel, msr->fsdh->channel, 3);
+  msr->samplecnt  = msr->fsdh->numsamples;
+  msr->numsamples = 0;
+  msr->record     = record;
+  msr->reclen     = reclen;
+  msr->encoding   = -1;
+  msr->byteorder  = -1;
+  msr->Blkt100    = 0;
+  msr->Blkt1000   = 0;
+  msr->Blkt1001   = 0;
+
+  /* Scan the blockettes following the same chain as msr_unpack(),
+   * reporting the same header problems */
+  blkt_offset = msr->fsdh->blockette_offset;
+
+  while ((blkt_offset != 0) &&
+         ((int)blkt_offset < reclen) &&
+         (blkt_offset < MAXRECLEN))
+  {
+    memcpy (&blkt_type, record + blkt_offset, 2);
+    memcpy (&next_blkt, record + blkt_offset + 2, 2);
+    blkt_offset += 4;
+
+    if (headerswapflag)
+    {
+      ms_gswap2 (&blkt_type);
+      ms_gswap2 (&next_blkt);
+    }
+
+    blkt_length = ms_blktlen (blkt_type, record + blkt_offset - 4, headerswapflag);
+
+    if (blkt_length == 0)
+    {
+      ms_log (2, "msr_unpack_header(%s): Unknown blockette length for type %d\n",
+              msr_srcname (msr, srcname, 1), blkt_type);
+      break;
+    }
+
+    if ((int)(blkt_offset - 4 + blkt_length) > reclen)
+    {
+      ms_log (2, "msr_unpack_header(%s): Blockette %d extends beyond record size, truncated?\n",
+              msr_srcname (msr, srcname, 1), blkt_type);
+      break;
+    }
+
+    if (blkt_type == 100)
+    {
+      memcpy (&blkt_100, record + blkt_offset, sizeof (struct blkt_100_s));
+
+      if (headerswapflag)
+        ms_gswap4 (&blkt_100.samprate);
+
+      b100 = 1;
+    }
+    else if (blkt_type == 1000)
+    {
+      memcpy (&blkt_1000, record + blkt_offset, sizeof (struct blkt_1000_s));
+
+      msr->reclen    = (uint32_t)1 << blkt_1000.reclen;
+      msr->encoding  = blkt_1000.encoding;
+      msr->byteorder = blkt_1000.byteorder;
+
+      if (msr->reclen != reclen && verbose)
+      {
+        ms_log (2, "msr_unpack_header(%s): Record length in Blockette 1000 (%d) != specified length (%d)\n",
+                msr_srcname (msr, srcname, 1), msr->reclen, reclen);
+      }
+    }
+    else if (blkt_type == 1001)
+    {
+      usec = ((struct blkt_1001_s *)(record + blkt_offset))->usec;
+    }
+
+    blkt_end = blkt_offset - 4 + blkt_length;
+    blkt_count++;
+
+    if (next_blkt && next_blkt < (blkt_offset + blkt_length - 4))
+    {
+      ms_log (2, "msr_unpack_header(%s): Offset to next blockette (%d) is within current blockette ending at byte %d\n",
+              msr_srcname (msr, srcname, 1), next_blkt, (blkt_offset + blkt_length - 4));
+      break;
+    }
+    else if (next_blkt && next_blkt > reclen)
+    {
+      ms_log (2, "msr_unpack_header(%s): Offset to next blockette (%d) from type %d is beyond record length\n",
+              msr_srcname (msr, srcname, 1), next_blkt, blkt_type);
+      break;
+    }
+
+    blkt_offset = next_blkt;
+  }
+
+  if (blkt_end && msr->fsdh->numsamples && msr->fsdh->data_offset < blkt_end)
+  {
+    ms_log (1, "%s: Warning: Data offset in fixed header (%d) is within the blockette chain ending at %d\n",
+            msr_srcname (msr, srcname, 1), msr->fsdh->data_offset, blkt_end);
+  }
+
+  if (msr->fsdh->numblockettes != blkt_count)
+  {
+    ms_log (1, "%s: Warning: Number of blockettes in fixed header (%d) does not match the number parsed (%d)\n",
+            msr_srcname (msr, srcname, 1), msr->fsdh->numblockettes, blkt_count);
+  }
+
+  msr->starttime = msr_starttime (msr);
+  if (msr->starttime != HPTERROR)
+    msr->starttime += (hptime_t)usec * (HPTMODULUS / 1000000);
+
+  msr->samprate = (b100) ? (double)blkt_100.samprate : msr_nomsamprate (msr);
+
+  /* Apply forced byte order and encoding as msr_unpack() does */
+  if (unpackdatabyteorder >= 0)
+    msr->byteorder = unpackdatabyteorder;
+
+  if (unpackencodingformat >= 0)
+    msr->encoding = unpackencodingformat;
+
+  if (unpackencodingfallback >= 0 && msr->encoding == -1)
+  {
+    msr->encoding = unpackencodingfallback;
+
+    if (msr->byteorder == -1)
+      msr->byteorder = 1;
+  }
+
+  return MS_NOERROR;
+} /* End of msr_unpack_header() */
 
 /************************************************************************
  *  msr_unpack_data:
@@ -719,11 +1020,56 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
  ************************************************************************/
 int
 msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
+{
+  int unpacksize; /* byte size of unpacked samples */
+  char srcname[50];
+
+  if (!msr)
+    return MS_GENERROR;
+
+  /* Calculate buffer size needed for unpacked samples */
+  unpacksize = (int)msr->samplecnt * ms_samplesize (ms_encodingsampletype (msr->encoding));
+
+  /* (Re)Allocate space for the unpacked data */
+  if (unpacksize > 0)
+  {
+    msr->datasamples = realloc (msr->datasamples, unpacksize);
+
+    if (msr->datasamples == NULL)
+    {
+      ms_log (2, "msr_unpack_data(%s): Cannot (re)allocate memory\n",
+              msr_srcname (msr, srcname, 1));
+      return MS_GENERROR;
+    }
+  }
+  else
+  {
+    if (msr->datasamples)
+      free (msr->datasamples);
+    msr->datasamples = 0;
+    msr->numsamples  = 0;
+  }
+
+  return msr_decode_data (msr, swapflag, msr->datasamples, unpacksize, verbose);
+} /* End of msr_unpack_data() */
+
+/************************************************************************
+ *  msr_decode_data:
+ *
+ *  Decode Mini-SEED data samples for a given MSRecord from the record
+ *  indicated by MSRecord->record into the output buffer, which must
+ *  hold at least outputsize bytes.  MSRecord->sampletype is set to
+ *  the type of the decoded samples.
+ *
+ *  Return number of samples decoded or negative libmseed error code.
+ ************************************************************************/
+static int
+msr_decode_data (MSRecord *msr, int swapflag, void *output,
+                 size_t outputsize, flag verbose)
 {
   int datasize;       /* byte size of data samples in record */
   int nsamples;       /* number of samples unpacked	     */
   int unpacksize;     /* byte size of unpacked samples	     */
-  int samplesize = 0; /* size of the data samples in bytes   */
   char srcname[50];
   const char *dbuf;
 
@@ -765,52 +1111,13 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
   datasize = msr->reclen - msr->fsdh->data_offset;
   dbuf     = msr->record + msr->fsdh->data_offset;
 
-  switch (msr->encoding)
-  {
-  case DE_ASCII:
-    samplesize = 1;
-    break;
-  case DE_INT16:
-  case DE_INT32:
-  case DE_FLOAT32:
-  case DE_STEIM1:
-  case DE_STEIM2:
-  case DE_GEOSCOPE24:
-  case DE_GEOSCOPE163:
-  case DE_GEOSCOPE164:
-  case DE_CDSN:
-  case DE_SRO:
-  case DE_DWWSSN:
-    samplesize = 4;
-    break;
-  case DE_FLOAT64:
-    samplesize = 8;
-    break;
-  default:
-    samplesize = 0;
-    break;
-  }
-
-  /* Calculate buffer size needed for unpacked samples */
-  unpacksize = (int)msr->samplecnt * samplesize;
-
-  /* (Re)Allocate space for the unpacked data */
-  if (unpacksize > 0)
-  {
-    msr->datasamples = realloc (msr->datasamples, unpacksize);
+  unpacksize = (int)msr->samplecnt * ms_samplesize (ms_encodingsampletype (msr->encoding));
 
-    if (msr->datasamples == NULL)
-    {
-      ms_log (2, "msr_unpack_data(%s): Cannot (re)allocate memory\n", srcname);
-      return MS_GENERROR;
-    }
-  }
-  else
+  if (unpacksize > 0 && (size_t)unpacksize > outputsize)
   {
-    if (msr->datasamples)
-      free (msr->datasamples);
-    msr->datasamples = 0;
-    msr->numsamples  = 0;
+    ms_log (2, "msr_unpack_data(%s): Output buffer too small for %" PRId64 " samples\n",
+            srcname, msr->samplecnt);
+    return MS_GENERROR;
   }
 
   if (verbose > 2)
@@ -824,7 +1131,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Found ASCII data\n", srcname);
 
     nsamples = (int)msr->samplecnt;
-    memcpy (msr->datasamples, dbuf, nsamples);
+    memcpy (output, dbuf, nsamples);
     msr->sampletype = 'a';
     break;
 
@@ -833,7 +1140,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking INT16 data samples\n", srcname);
 
     nsamples = msr_decode_int16 ((int16_t *)dbuf, (int)msr->samplecnt,
-                                 msr->datasamples, unpacksize, swapflag);
+                                 output, unpacksize, swapflag);
 
     msr->sampletype = 'i';
     break;
@@ -843,7 +1150,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking INT32 data samples\n", srcname);
 
     nsamples = msr_decode_int32 ((int32_t *)dbuf, (int)msr->samplecnt,
-                                 msr->datasamples, unpacksize, swapflag);
+                                 output, unpacksize, swapflag);
 
     msr->sampletype = 'i';
     break;
@@ -853,7 +1160,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking FLOAT32 data samples\n", srcname);
 
     nsamples = msr_decode_float32 ((float *)dbuf, (int)msr->samplecnt,
-                                   msr->datasamples, unpacksize, swapflag);
+                                   output, unpacksize, swapflag);
 
     msr->sampletype = 'f';
     break;
@@ -863,7 +1170,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking FLOAT64 data samples\n", srcname);
 
     nsamples = msr_decode_float64 ((double *)dbuf, (int)msr->samplecnt,
-                                   msr->datasamples, unpacksize, swapflag);
+                                   output, unpacksize, swapflag);
 
     msr->sampletype = 'd';
     break;
@@ -873,7 +1180,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking Steim1 data frames\n", srcname);
 
     nsamples = msr_decode_steim1 ((int32_t *)dbuf, datasize, (int)msr->samplecnt,
-                                  msr->datasamples, unpacksize, srcname, swapflag);
+                                  output, unpacksize, srcname, swapflag);
 
     if (nsamples < 0)
       return MS_GENERROR;
@@ -886,7 +1193,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking Steim2 data frames\n", srcname);
 
     nsamples = msr_decode_steim2 ((int32_t *)dbuf, datasize, (int)msr->samplecnt,
-                                  msr->datasamples, unpacksize, srcname, swapflag);
+                                  output, unpacksize, srcname, swapflag);
 
     if (nsamples < 0)
       return MS_GENERROR;
@@ -910,7 +1217,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
                 srcname);
     }
 
-    nsamples = msr_decode_geoscope ((char *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_geoscope ((char *)dbuf, (int)msr->samplecnt, output,
                                     unpacksize, msr->encoding, srcname, swapflag);
 
     msr->sampletype = 'f';
@@ -920,7 +1227,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     if (verbose > 1)
       ms_log (1, "%s: Unpacking CDSN encoded data samples\n", srcname);
 
-    nsamples = msr_decode_cdsn ((int16_t *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_cdsn ((int16_t *)dbuf, (int)msr->samplecnt, output,
                                 unpacksize, swapflag);
 
     msr->sampletype = 'i';
@@ -930,7 +1237,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     if (verbose > 1)
       ms_log (1, "%s: Unpacking SRO encoded data samples\n", srcname);
 
-    nsamples = msr_decode_sro ((int16_t *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_sro ((int16_t *)dbuf, (int)msr->samplecnt, output,
                                unpacksize, srcname, swapflag);
 
     msr->sampletype = 'i';
@@ -940,7 +1247,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     if (verbose > 1)
       ms_log (1, "%s: Unpacking DWWSSN encoded data samples\n", srcname);
 
-    nsamples = msr_decode_dwwssn ((int16_t *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_dwwssn ((int16_t *)dbuf, (int)msr->samplecnt, output,
                                   unpacksize, swapflag);
 
     msr->sampletype = 'i';
@@ -961,7 +1268,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
   }
 
   return nsamples;
-} /* End of msr_unpack_data() */
+} /* End of msr_decode_data() */
 
 /************************************************************************
  *  check_environment:
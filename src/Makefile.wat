@@ -19,11 +19,14 @@ INCS = -I..\libmseed
 
 all: $(BIN)
 
-$(BIN):	seisan2mseed.obj
-	wlink $(lflags) name $(BIN) file {seisan2mseed.obj}
+$(BIN):	seisan2mseed.obj pipeline.obj fileio.obj logqueue.obj
+	wlink $(lflags) name $(BIN) file {seisan2mseed.obj pipeline.obj fileio.obj logqueue.obj}
 
 # Source dependencies:
-seisan2mseed.obj:	seisan2mseed.c
+seisan2mseed.obj:	seisan2mseed.c fileio.h logqueue.h pipeline.h
+fileio.obj:	fileio.c fileio.h
+logqueue.obj:	logqueue.c logqueue.h
+pipeline.obj:	pipeline.c pipeline.h
 
 # How to compile sources:
 .c.obj:
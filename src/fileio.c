@@ -0,0 +1,2387 @@
+/***************************************************************************
+ * fileio.c
+ *
+ * Input and output file access for the conversion pipeline.
+ *
+ * On Linux an io_uring backend is used when available: input files
+ * are read through a bounded read ahead window of concurrent range
+ * reads, the first of which can be started (prefetched) while the
+ * previous file is processed, and output buffers are written with
+ * asynchronous writes that are tracked until completion.  Otherwise
+ * stdio streams are used.
+ *
+ * Input files compressed with gzip or zstd are decoded while reading
+ * and tar archives are read member by member, all input is read
+ * sequentially without seeking.
+ *
+ * Output may be sent to a Unix domain or TCP stream socket: buffers
+ * are queued and sent in batches with blocking sends, a slow receiver
+ * blocks the writer instead of growing the queue.
+ *
+ * Input routines must only be called from a single thread, output
+ * routines must also only be called from a single thread.  Each
+ * direction uses its own ring.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "fileio.h"
+
+#if defined(FILEIO_URING)
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/* Number of submission queue entries for each ring */
+#define INRINGDEPTH  32
+#define OUTRINGDEPTH 16
+
+/* Size of range reads for input files */
+#define READCHUNK (1024 * 1024)
+
+/* Number of range reads in the read ahead window of an input file, the
+ * windows of the current and a prefetched file fit in the input ring
+ * so that submitting reads never waits for completions */
+#define READAHEAD 8
+
+/* A submission and completion ring pair mapped from the kernel */
+typedef struct IORing_s {
+  int       fd;               /* Ring file descriptor, -1 if not available */
+  unsigned  entries;          /* Number of submission queue entries */
+  unsigned  inflight;         /* Submitted requests not yet completed */
+  unsigned  unsubmitted;      /* Queued requests not yet submitted */
+  unsigned *sqhead;
+  unsigned *sqtail;
+  unsigned *sqmask;
+  unsigned *sqarray;
+  unsigned *cqhead;
+  unsigned *cqtail;
+  unsigned *cqmask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void     *sqring;
+  size_t    sqringlen;
+  void     *cqring;
+  size_t    cqringlen;
+  size_t    sqeslen;
+} IORing;
+
+/* An asynchronous read or write request */
+typedef struct IORequest_s {
+  InputFile  *inf;            /* Input file for reads */
+  OutputFile *of;             /* Output file for writes */
+  struct iovec iov;           /* Remaining buffer of request */
+  int64_t     offset;         /* File offset of remaining buffer */
+  char       *release;        /* Buffer to free on completion */
+  int         slot;           /* Read ahead window slot of reads */
+} IORequest;
+
+/* Ring state: 0 = not initialized, 1 = available, -1 = not available */
+static int inringstate  = 0;
+static int outringstate = 0;
+static IORing inring;
+static IORing outring;
+
+/* Input file with reads started by in_prefetch() */
+static InputFile *prefetched = 0;
+
+static int   ring_init (IORing *ring, unsigned entries);
+static void  ring_free (IORing *ring);
+static int   ring_queue (IORing *ring, int opcode, int fd, IORequest *req);
+static int   ring_submit (IORing *ring, unsigned waitnr);
+static int   ring_reap (IORing *ring, int wait);
+static void  ring_complete (IORing *ring, IORequest *req, int result);
+static IORing *in_ring (void);
+static IORing *out_ring (void);
+static InputFile *in_startread (char *name);
+static void  in_readahead (InputFile *inf);
+static size_t in_window (InputFile *inf, char **window);
+static void  in_wait (InputFile *inf);
+#endif
+
+#if defined(FILEIO_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(FILEIO_ZSTD)
+#include <zstd.h>
+#endif
+
+/* Size of the compressed input buffer for stdio streams */
+#define DECBUFSIZE (256 * 1024)
+
+/* Maximum input or output length of a single decoder call */
+#define DECMAXINPUT ((size_t)1 << 30)
+
+/* Maximum size of a tar long name or extended header */
+#define MAXLONGNAME (1024 * 1024)
+
+/* Decompression state of an input file */
+typedef struct Decoder_s {
+  char     *inbuf;            /* Compressed input for stdio streams */
+  int       end;              /* End of decoded contents reached */
+#if defined(FILEIO_ZLIB)
+  z_stream  zs;
+  int       zsinit;           /* The z_stream is initialized */
+  int       midstream;        /* Decoding within a gzip member */
+#endif
+#if defined(FILEIO_ZSTD)
+  ZSTD_DStream *zds;
+  ZSTD_inBuffer zin;
+  size_t    hint;             /* Last decoder return, 0 at the end of a frame */
+  int       inputend;         /* All compressed input read */
+#endif
+} Decoder;
+
+#if defined(FILEIO_SOCKETS)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+/* Maximum number of buffers and bytes queued for a batched send */
+#define SENDBUFFERS 64
+#define SENDBATCH (256 * 1024)
+
+/* Do not raise SIGPIPE when the receiver has closed the connection */
+#if defined(MSG_NOSIGNAL)
+  #define SENDFLAGS MSG_NOSIGNAL
+#else
+  #define SENDFLAGS 0
+#endif
+
+/* Buffers queued for sending to a socket, released when sent */
+typedef struct SendQueue_s {
+  char     *buffers[SENDBUFFERS];
+  size_t    lengths[SENDBUFFERS];
+  int       count;            /* Number of queued buffers */
+  size_t    bytes;            /* Unsent bytes of queued buffers */
+  size_t    sent;             /* Bytes of the first buffer already sent */
+} SendQueue;
+
+static OutputFile *out_connect (char *name);
+static int   sock_connect (char *name);
+static int   sock_write (OutputFile *of, char *buffer, size_t length);
+static int   sock_flush (OutputFile *of);
+#endif
+
+static InputFile *in_stdio (char *name);
+static int     in_detect (InputFile *inf);
+static size_t  in_rawread (InputFile *inf, char *ptr, size_t length);
+static size_t  in_decread (InputFile *inf, char *ptr, size_t length);
+static size_t  in_streamread (InputFile *inf, char *ptr, size_t length);
+static size_t  in_fill (InputFile *inf, size_t length);
+static int     in_skip (InputFile *inf, int64_t count);
+static int     dec_init (InputFile *inf, char *leading, size_t length);
+static void    dec_free (InputFile *inf);
+#if defined(FILEIO_ZLIB) || defined(FILEIO_ZSTD)
+static size_t  dec_input (InputFile *inf, char **input);
+#endif
+#if defined(FILEIO_ZLIB)
+static size_t  dec_gzip (InputFile *inf, char *ptr, size_t length);
+#endif
+#if defined(FILEIO_ZSTD)
+static size_t  dec_zstd (InputFile *inf, char *ptr, size_t length);
+#endif
+static int     tar_checksum (char *header);
+static int64_t tar_number (char *field, int length);
+static char   *tar_name (char *header);
+static int     tar_longname (InputFile *inf, char type, int64_t size, char **longname);
+
+
+/***************************************************************************
+ * in_open:
+ *
+ * Open an input file.  If reads were started for the file with
+ * in_prefetch() they are continued, otherwise the file is read
+ * asynchronously if possible or opened as a stdio stream.
+ *
+ * Compressed contents are detected and decoded while reading, tar
+ * archives are detected and read member by member with
+ * in_nextmember().  Contents are only read sequentially, no seeking
+ * is done.
+ *
+ * Returns a pointer to an InputFile on success and NULL on failure
+ * with errno set.
+ ***************************************************************************/
+InputFile *
+in_open (char *name)
+{
+  InputFile *inf = 0;
+  int errsave;
+
+  if ( ! name )
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+#if defined(FILEIO_URING)
+  if ( prefetched && ! strcmp (prefetched->name, name) )
+  {
+    inf = prefetched;
+    prefetched = 0;
+  }
+  else if ( in_ring () )
+  {
+    errno = 0;
+    inf = in_startread (name);
+
+    /* A failure other than an unsuitable file is reported */
+    if ( ! inf && errno )
+      return NULL;
+  }
+
+  if ( inf )
+  {
+    if ( inf->error )
+    {
+      errno = inf->error;
+      in_close (inf);
+      return NULL;
+    }
+  }
+#endif
+
+  if ( ! inf && ! (inf = in_stdio (name)) )
+    return NULL;
+
+  if ( in_detect (inf) )
+  {
+    errsave = ( inf->error ) ? inf->error : errno;
+    in_close (inf);
+    errno = errsave;
+    return NULL;
+  }
+
+  return inf;
+}  /* End of in_open() */
+
+
+/***************************************************************************
+ * in_prefetch:
+ *
+ * Start reading a file that will be opened next with in_open(), the
+ * reads of the first read ahead window are submitted.  Only a single
+ * file is prefetched, a previously prefetched file that was not opened
+ * is released.  Without asynchronous I/O this is a no-op.
+ ***************************************************************************/
+void
+in_prefetch (char *name)
+{
+#if defined(FILEIO_URING)
+  if ( ! name || ! in_ring () )
+    return;
+
+  if ( prefetched )
+  {
+    if ( ! strcmp (prefetched->name, name) )
+      return;
+
+    in_close (prefetched);
+    prefetched = 0;
+  }
+
+  prefetched = in_startread (name);
+#else
+  (void) name;
+#endif
+}  /* End of in_prefetch() */
+
+
+/***************************************************************************
+ * in_nextmember:
+ *
+ * Advance to the next member of an input file.  For a tar archive the
+ * remainder of the current member is skipped and the next regular
+ * file member is started, the name of the member is returned in
+ * membername and is valid until the next call.  Any other input file
+ * has a single member, the file itself, with a NULL membername.
+ *
+ * Returns 1 when a member is started, 0 when there are no more
+ * members and -1 on error with errno set.
+ ***************************************************************************/
+int
+in_nextmember (InputFile *inf, char **membername)
+{
+  char header[IN_BLOCKSIZE];
+  char *longname = 0;
+  int64_t size;
+  int rv;
+
+  *membername = 0;
+
+  if ( ! inf->archive )
+    return ( inf->members++ == 0 ) ? 1 : 0;
+
+  /* Skip the remainder and padding of the current member */
+  if ( in_skip (inf, inf->memberleft + inf->memberpad) )
+    return -1;
+
+  inf->memberleft = 0;
+  inf->memberpad = 0;
+
+  for (;;)
+  {
+    if ( (rv = in_streamread (inf, header, IN_BLOCKSIZE)) < IN_BLOCKSIZE )
+    {
+      free (longname);
+
+      if ( inf->error )
+      {
+        errno = inf->error;
+        return -1;
+      }
+
+      /* Archives normally end with zero blocks, tolerate a missing end */
+      if ( rv == 0 )
+        return 0;
+
+      errno = EIO;
+      return -1;
+    }
+
+    /* A zero block marks the end of the archive */
+    if ( (rv = tar_checksum (header)) < 0 )
+    {
+      free (longname);
+      return 0;
+    }
+
+    if ( rv == 0 || (size = tar_number (header + 124, 12)) < 0 )
+    {
+      free (longname);
+      errno = EIO;
+      return -1;
+    }
+
+    /* GNU long name or POSIX extended header naming the next member */
+    if ( header[156] == 'L' || header[156] == 'x' )
+    {
+      free (longname);
+      longname = 0;
+
+      if ( tar_longname (inf, header[156], size, &longname) )
+        return -1;
+
+      continue;
+    }
+
+    /* Regular file member */
+    if ( header[156] == '0' || header[156] == '\0' || header[156] == '7' )
+    {
+      free (inf->membername);
+
+      if ( longname )
+        inf->membername = longname;
+      else if ( ! (inf->membername = tar_name (header)) )
+        return -1;
+
+      inf->members++;
+      inf->memberleft = size;
+      inf->memberpad = (IN_BLOCKSIZE - size % IN_BLOCKSIZE) % IN_BLOCKSIZE;
+      inf->position = 0;
+      inf->eof = 0;
+
+      *membername = inf->membername;
+      return 1;
+    }
+
+    /* Skip directories, links and other member types */
+    free (longname);
+    longname = 0;
+
+    if ( in_skip (inf, size + (IN_BLOCKSIZE - size % IN_BLOCKSIZE) % IN_BLOCKSIZE) )
+      return -1;
+  }
+}  /* End of in_nextmember() */
+
+
+/***************************************************************************
+ * in_read:
+ *
+ * Read up to nmemb items of size bytes from an input file, or the
+ * current member of an archive, following the semantics of fread().
+ *
+ * Returns the number of complete items read.
+ ***************************************************************************/
+size_t
+in_read (void *ptr, size_t size, size_t nmemb, InputFile *inf)
+{
+  size_t want;
+  size_t got;
+
+  if ( size == 0 || nmemb == 0 )
+    return 0;
+
+  want = size * nmemb;
+
+  if ( inf->archive && (int64_t)want > inf->memberleft )
+    want = (size_t) inf->memberleft;
+
+  got = in_streamread (inf, ptr, want);
+
+  if ( got < size * nmemb )
+    inf->eof = 1;
+
+  if ( inf->archive )
+    inf->memberleft -= got;
+
+  inf->position += got;
+
+  return got / size;
+}  /* End of in_read() */
+
+
+/***************************************************************************
+ * in_peek:
+ *
+ * Copy up to length bytes, at most IN_BLOCKSIZE, from the read position
+ * of an input file without consuming them.
+ *
+ * Returns the number of bytes copied.
+ ***************************************************************************/
+size_t
+in_peek (void *ptr, size_t length, InputFile *inf)
+{
+  size_t avail;
+
+  if ( length > IN_BLOCKSIZE )
+    length = IN_BLOCKSIZE;
+
+  if ( inf->archive && (int64_t)length > inf->memberleft )
+    length = (size_t) inf->memberleft;
+
+  avail = in_fill (inf, length);
+
+  if ( length > avail )
+    length = avail;
+
+  memcpy (ptr, inf->lookahead + inf->lookaheadoff, length);
+
+  return length;
+}  /* End of in_peek() */
+
+
+/***************************************************************************
+ * in_tell:
+ *
+ * Returns the current read position of an input file, or of the
+ * current member of an archive, in decoded bytes.
+ ***************************************************************************/
+int64_t
+in_tell (InputFile *inf)
+{
+  return inf->position;
+}  /* End of in_tell() */
+
+
+/***************************************************************************
+ * in_eof:
+ *
+ * Returns non-zero if the end of an input file, or of the current
+ * member of an archive, has been reached.
+ ***************************************************************************/
+int
+in_eof (InputFile *inf)
+{
+  return inf->eof;
+}  /* End of in_eof() */
+
+
+/***************************************************************************
+ * in_error:
+ *
+ * Returns non-zero if an error occurred reading or decoding an input
+ * file.
+ ***************************************************************************/
+int
+in_error (InputFile *inf)
+{
+  if ( inf->fp && ferror (inf->fp) )
+    return 1;
+
+  return inf->error;
+}  /* End of in_error() */
+
+
+/***************************************************************************
+ * in_close:
+ *
+ * Close an input file and free all associated memory, waiting for any
+ * outstanding reads.
+ ***************************************************************************/
+void
+in_close (InputFile *inf)
+{
+  if ( ! inf )
+    return;
+
+  if ( inf->fp )
+    fclose (inf->fp);
+
+#if defined(FILEIO_URING)
+  if ( inf->pending )
+    in_wait (inf);
+
+  if ( inf->fd >= 0 )
+    close (inf->fd);
+#endif
+
+  if ( inf->decoder )
+    dec_free (inf);
+
+  if ( inf->buffer )
+    free (inf->buffer);
+
+  if ( inf->membername )
+    free (inf->membername);
+
+  if ( inf->name )
+    free (inf->name);
+
+  free (inf);
+}  /* End of in_close() */
+
+
+/***************************************************************************
+ * in_stdio:
+ *
+ * Open an input file as a stdio stream.
+ *
+ * Returns a pointer to an InputFile on success and NULL on failure
+ * with errno set.
+ ***************************************************************************/
+static InputFile *
+in_stdio (char *name)
+{
+  InputFile *inf;
+  struct stat sbuf;
+  int errsave;
+
+  if ( (inf = (InputFile *) calloc (1, sizeof(InputFile))) == NULL )
+    return NULL;
+
+  inf->fd = -1;
+
+  if ( (inf->name = strdup (name)) == NULL ||
+       (inf->fp = fopen (name, "rb")) == NULL ||
+       fstat (fileno (inf->fp), &sbuf) )
+  {
+    errsave = errno;
+    in_close (inf);
+    errno = errsave;
+    return NULL;
+  }
+
+  inf->size = sbuf.st_size;
+
+  return inf;
+}  /* End of in_stdio() */
+
+
+/***************************************************************************
+ * in_detect:
+ *
+ * Detect compression of an input file from the leading magic bytes and
+ * set up decoding, then detect a tar archive from the first block of
+ * decoded contents.  The bytes read for detection are retained for
+ * reading.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+in_detect (InputFile *inf)
+{
+  unsigned char magic[4];
+  size_t length;
+
+  length = in_rawread (inf, (char *) magic, sizeof(magic));
+
+  if ( inf->error )
+  {
+    errno = inf->error;
+    return -1;
+  }
+
+  if ( length == 4 && magic[0] == 0x1F && magic[1] == 0x8B )
+    inf->compression = IN_GZIP;
+  else if ( length == 4 && magic[0] == 0x28 && magic[1] == 0xB5 &&
+            magic[2] == 0x2F && magic[3] == 0xFD )
+    inf->compression = IN_ZSTD;
+
+  if ( inf->compression != IN_PLAIN )
+  {
+    if ( dec_init (inf, (char *) magic, length) )
+      return -1;
+  }
+  else
+  {
+    memcpy (inf->lookahead, magic, length);
+    inf->lookaheadlen = (int) length;
+  }
+
+  /* A tar archive starts with a valid ustar header block */
+  if ( in_fill (inf, IN_BLOCKSIZE) == IN_BLOCKSIZE &&
+       tar_checksum (inf->lookahead) > 0 &&
+       ! memcmp (inf->lookahead + 257, "ustar", 5) )
+    inf->archive = 1;
+
+  if ( inf->error )
+  {
+    errno = inf->error;
+    return -1;
+  }
+
+  return 0;
+}  /* End of in_detect() */
+
+
+/***************************************************************************
+ * in_rawread:
+ *
+ * Read up to length bytes of the undecoded file contents from a stdio
+ * stream or the asynchronously read window.
+ *
+ * Returns the number of bytes read.
+ ***************************************************************************/
+static size_t
+in_rawread (InputFile *inf, char *ptr, size_t length)
+{
+  size_t got = 0;
+#if defined(FILEIO_URING)
+  char *window;
+  size_t avail;
+#endif
+
+  if ( inf->fp )
+  {
+    got = fread (ptr, 1, length, inf->fp);
+
+    if ( got < length && ferror (inf->fp) && ! inf->error )
+      inf->error = ( errno ) ? errno : EIO;
+
+    return got;
+  }
+
+#if defined(FILEIO_URING)
+  while ( got < length && (avail = in_window (inf, &window)) > 0 )
+  {
+    if ( avail > length - got )
+      avail = length - got;
+
+    memcpy (ptr + got, window, avail);
+
+    inf->offset += avail;
+    got += avail;
+  }
+#endif
+
+  return got;
+}  /* End of in_rawread() */
+
+
+/***************************************************************************
+ * in_decread:
+ *
+ * Read up to length bytes of decoded file contents.
+ *
+ * Returns the number of bytes read.
+ ***************************************************************************/
+static size_t
+in_decread (InputFile *inf, char *ptr, size_t length)
+{
+#if defined(FILEIO_ZLIB)
+  if ( inf->compression == IN_GZIP )
+    return dec_gzip (inf, ptr, length);
+#endif
+#if defined(FILEIO_ZSTD)
+  if ( inf->compression == IN_ZSTD )
+    return dec_zstd (inf, ptr, length);
+#endif
+
+  return in_rawread (inf, ptr, length);
+}  /* End of in_decread() */
+
+
+/***************************************************************************
+ * in_streamread:
+ *
+ * Read up to length bytes of decoded file contents, starting with any
+ * bytes in the look ahead buffer.  Archive member limits are not
+ * applied.
+ *
+ * Returns the number of bytes read.
+ ***************************************************************************/
+static size_t
+in_streamread (InputFile *inf, char *ptr, size_t length)
+{
+  size_t got = 0;
+
+  if ( inf->lookaheadoff < inf->lookaheadlen )
+  {
+    got = (size_t) (inf->lookaheadlen - inf->lookaheadoff);
+
+    if ( got > length )
+      got = length;
+
+    memcpy (ptr, inf->lookahead + inf->lookaheadoff, got);
+    inf->lookaheadoff += (int) got;
+
+    if ( inf->lookaheadoff == inf->lookaheadlen )
+      inf->lookaheadoff = inf->lookaheadlen = 0;
+  }
+
+  if ( got < length )
+    got += in_decread (inf, ptr + got, length - got);
+
+  return got;
+}  /* End of in_streamread() */
+
+
+/***************************************************************************
+ * in_fill:
+ *
+ * Read decoded file contents into the look ahead buffer until it
+ * contains at least length bytes, at most IN_BLOCKSIZE, or the end of
+ * the file is reached.
+ *
+ * Returns the number of bytes in the look ahead buffer.
+ ***************************************************************************/
+static size_t
+in_fill (InputFile *inf, size_t length)
+{
+  size_t avail = (size_t) (inf->lookaheadlen - inf->lookaheadoff);
+  size_t got;
+
+  if ( avail >= length )
+    return avail;
+
+  memmove (inf->lookahead, inf->lookahead + inf->lookaheadoff, avail);
+  inf->lookaheadoff = 0;
+  inf->lookaheadlen = (int) avail;
+
+  while ( (size_t)inf->lookaheadlen < length )
+  {
+    got = in_decread (inf, inf->lookahead + inf->lookaheadlen,
+                      length - inf->lookaheadlen);
+
+    if ( got == 0 )
+      break;
+
+    inf->lookaheadlen += (int) got;
+  }
+
+  return (size_t) inf->lookaheadlen;
+}  /* End of in_fill() */
+
+
+/***************************************************************************
+ * in_skip:
+ *
+ * Read and discard count bytes of decoded file contents.
+ *
+ * Returns 0 on success and -1 on failure or end of file with errno set.
+ ***************************************************************************/
+static int
+in_skip (InputFile *inf, int64_t count)
+{
+  char discard[IN_BLOCKSIZE * 16];
+  size_t length;
+
+  while ( count > 0 )
+  {
+    length = ( count < (int64_t)sizeof(discard) ) ? (size_t) count : sizeof(discard);
+
+    if ( in_streamread (inf, discard, length) < length )
+    {
+      errno = ( inf->error ) ? inf->error : EIO;
+      return -1;
+    }
+
+    count -= length;
+  }
+
+  return 0;
+}  /* End of in_skip() */
+
+
+/***************************************************************************
+ * dec_init:
+ *
+ * Initialize decoding of compressed file contents, the leading bytes
+ * already read for detection are the first input.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+dec_init (InputFile *inf, char *leading, size_t length)
+{
+  Decoder *dec;
+
+#if !defined(FILEIO_ZLIB)
+  if ( inf->compression == IN_GZIP )
+  {
+    errno = ENOTSUP;
+    return -1;
+  }
+#endif
+#if !defined(FILEIO_ZSTD)
+  if ( inf->compression == IN_ZSTD )
+  {
+    errno = ENOTSUP;
+    return -1;
+  }
+#endif
+
+  if ( (dec = (Decoder *) calloc (1, sizeof(Decoder))) == NULL )
+    return -1;
+
+  inf->decoder = dec;
+
+  /* Stream input is read through a buffer, buffered contents are
+   * decoded in place starting with the leading bytes */
+  if ( inf->fp )
+  {
+    if ( (dec->inbuf = (char *) malloc (DECBUFSIZE)) == NULL )
+      return -1;
+
+    memcpy (dec->inbuf, leading, length);
+  }
+  else
+  {
+    inf->offset -= length;
+    length = 0;
+  }
+
+#if defined(FILEIO_ZLIB)
+  if ( inf->compression == IN_GZIP )
+  {
+    /* Decode gzip format only, concatenated members are supported */
+    if ( inflateInit2 (&dec->zs, 16 + MAX_WBITS) != Z_OK )
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    dec->zsinit = 1;
+    dec->zs.next_in = (Bytef *) dec->inbuf;
+    dec->zs.avail_in = (uInt) length;
+    dec->midstream = 1;
+  }
+#endif
+#if defined(FILEIO_ZSTD)
+  if ( inf->compression == IN_ZSTD )
+  {
+    if ( (dec->zds = ZSTD_createDStream ()) == NULL ||
+         ZSTD_isError (ZSTD_initDStream (dec->zds)) )
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+    dec->zin.src = dec->inbuf;
+    dec->zin.size = length;
+    dec->zin.pos = 0;
+    dec->hint = 1;
+  }
+#endif
+
+  return 0;
+}  /* End of dec_init() */
+
+
+/***************************************************************************
+ * dec_free:
+ *
+ * Release the decompression state of an input file.
+ ***************************************************************************/
+static void
+dec_free (InputFile *inf)
+{
+  Decoder *dec = (Decoder *) inf->decoder;
+
+#if defined(FILEIO_ZLIB)
+  if ( dec->zsinit )
+    inflateEnd (&dec->zs);
+#endif
+#if defined(FILEIO_ZSTD)
+  if ( dec->zds )
+    ZSTD_freeDStream (dec->zds);
+#endif
+
+  if ( dec->inbuf )
+    free (dec->inbuf);
+
+  free (dec);
+  inf->decoder = 0;
+}  /* End of dec_free() */
+
+
+#if defined(FILEIO_ZLIB) || defined(FILEIO_ZSTD)
+/***************************************************************************
+ * dec_input:
+ *
+ * Get the next compressed input, either read from the stdio stream
+ * into the input buffer or the next range of the asynchronously read
+ * window, which remains valid until the following call.
+ *
+ * Returns the number of bytes of input, 0 at the end of the file.
+ ***************************************************************************/
+static size_t
+dec_input (InputFile *inf, char **input)
+{
+  Decoder *dec = (Decoder *) inf->decoder;
+  size_t length = 0;
+
+  if ( inf->fp )
+  {
+    *input = dec->inbuf;
+    return in_rawread (inf, dec->inbuf, DECBUFSIZE);
+  }
+
+#if defined(FILEIO_URING)
+  length = in_window (inf, input);
+
+  inf->offset += length;
+#endif
+
+  return length;
+}  /* End of dec_input() */
+#endif
+
+
+#if defined(FILEIO_ZLIB)
+/***************************************************************************
+ * dec_gzip:
+ *
+ * Decode up to length bytes of gzip compressed contents.  A truncated
+ * or corrupt stream sets the input file error.
+ *
+ * Returns the number of bytes decoded.
+ ***************************************************************************/
+static size_t
+dec_gzip (InputFile *inf, char *ptr, size_t length)
+{
+  Decoder *dec = (Decoder *) inf->decoder;
+  char *input;
+  size_t inputlen;
+  int rv;
+
+  if ( length > DECMAXINPUT )
+    length = DECMAXINPUT;
+
+  dec->zs.next_out = (Bytef *) ptr;
+  dec->zs.avail_out = (uInt) length;
+
+  while ( dec->zs.avail_out > 0 && ! dec->end )
+  {
+    if ( dec->zs.avail_in == 0 )
+    {
+      if ( (inputlen = dec_input (inf, &input)) == 0 )
+      {
+        /* End of input within a member is a truncated stream */
+        if ( dec->midstream && ! inf->error )
+          inf->error = EIO;
+
+        dec->end = 1;
+        break;
+      }
+
+      dec->zs.next_in = (Bytef *) input;
+      dec->zs.avail_in = (uInt) inputlen;
+    }
+
+    /* Start the next of concatenated members */
+    if ( ! dec->midstream )
+    {
+      inflateReset (&dec->zs);
+      dec->midstream = 1;
+    }
+
+    rv = inflate (&dec->zs, Z_NO_FLUSH);
+
+    if ( rv == Z_STREAM_END )
+    {
+      dec->midstream = 0;
+    }
+    else if ( rv != Z_OK )
+    {
+      inf->error = EIO;
+      dec->end = 1;
+    }
+  }
+
+  return length - dec->zs.avail_out;
+}  /* End of dec_gzip() */
+#endif
+
+
+#if defined(FILEIO_ZSTD)
+/***************************************************************************
+ * dec_zstd:
+ *
+ * Decode up to length bytes of zstd compressed contents.  A truncated
+ * or corrupt stream sets the input file error.
+ *
+ * Returns the number of bytes decoded.
+ ***************************************************************************/
+static size_t
+dec_zstd (InputFile *inf, char *ptr, size_t length)
+{
+  Decoder *dec = (Decoder *) inf->decoder;
+  ZSTD_outBuffer out;
+  char *input;
+  size_t inputlen;
+  size_t before;
+
+  out.dst = ptr;
+  out.size = length;
+  out.pos = 0;
+
+  while ( out.pos < out.size && ! dec->end )
+  {
+    if ( dec->zin.pos == dec->zin.size && ! dec->inputend )
+    {
+      if ( (inputlen = dec_input (inf, &input)) == 0 )
+      {
+        dec->inputend = 1;
+      }
+      else
+      {
+        dec->zin.src = input;
+        dec->zin.size = inputlen;
+        dec->zin.pos = 0;
+      }
+    }
+
+    /* All input decoded and the last frame complete */
+    if ( dec->inputend && dec->hint == 0 )
+    {
+      dec->end = 1;
+      break;
+    }
+
+    before = out.pos;
+    dec->hint = ZSTD_decompressStream (dec->zds, &out, &dec->zin);
+
+    if ( ZSTD_isError (dec->hint) ||
+         (dec->inputend && out.pos == before) )
+    {
+      /* Corrupt stream or end of input within a frame */
+      if ( ! inf->error )
+        inf->error = EIO;
+
+      dec->end = 1;
+    }
+  }
+
+  return out.pos;
+}  /* End of dec_zstd() */
+#endif
+
+
+/***************************************************************************
+ * tar_checksum:
+ *
+ * Verify the checksum of a tar header block, the checksum is the sum
+ * of the header bytes with the checksum field taken as spaces.  Sums
+ * of unsigned and, for old archives, signed bytes are accepted.
+ *
+ * Returns 1 if the checksum is valid, 0 if it is not and -1 if the
+ * block contains only zeros.
+ ***************************************************************************/
+static int
+tar_checksum (char *header)
+{
+  int64_t unsignedsum = 0;
+  int64_t signedsum = 0;
+  int64_t checksum;
+  int zero = 1;
+  int idx;
+
+  for (idx = 0; idx < IN_BLOCKSIZE; idx++)
+  {
+    if ( header[idx] )
+      zero = 0;
+
+    if ( idx >= 148 && idx < 156 )
+    {
+      unsignedsum += ' ';
+      signedsum += ' ';
+    }
+    else
+    {
+      unsignedsum += (unsigned char) header[idx];
+      signedsum += (signed char) header[idx];
+    }
+  }
+
+  if ( zero )
+    return -1;
+
+  checksum = tar_number (header + 148, 8);
+
+  return ( checksum == unsignedsum || checksum == signedsum ) ? 1 : 0;
+}  /* End of tar_checksum() */
+
+
+/***************************************************************************
+ * tar_number:
+ *
+ * Parse a numeric tar header field, either octal digits terminated by
+ * a space or NUL or a base-256 value if the high bit of the first byte
+ * is set.
+ *
+ * Returns the value on success and -1 if the field is not valid.
+ ***************************************************************************/
+static int64_t
+tar_number (char *field, int length)
+{
+  int64_t value = 0;
+  int idx = 0;
+
+  if ( (unsigned char) field[0] & 0x80 )
+  {
+    /* Only positive base-256 values, large enough for any size */
+    if ( (unsigned char) field[0] != 0x80 )
+      return -1;
+
+    for (idx = 1; idx < length; idx++)
+    {
+      if ( value > (INT64_MAX >> 8) )
+        return -1;
+
+      value = (value << 8) | (unsigned char) field[idx];
+    }
+
+    return value;
+  }
+
+  while ( idx < length && field[idx] == ' ' )
+    idx++;
+
+  for (; idx < length && field[idx] != ' ' && field[idx] != '\0'; idx++)
+  {
+    if ( field[idx] < '0' || field[idx] > '7' )
+      return -1;
+
+    value = (value << 3) | (field[idx] - '0');
+  }
+
+  return value;
+}  /* End of tar_number() */
+
+
+/***************************************************************************
+ * tar_name:
+ *
+ * Build the member name of a tar header, joining the ustar prefix and
+ * name fields.
+ *
+ * Returns an allocated name on success and NULL on failure.
+ ***************************************************************************/
+static char *
+tar_name (char *header)
+{
+  char *name;
+  char *end;
+  size_t namelen;
+  size_t prefixlen = 0;
+
+  namelen = ( (end = memchr (header, '\0', 100)) ) ? (size_t) (end - header) : 100;
+
+  if ( ! memcmp (header + 257, "ustar", 5) )
+    prefixlen = ( (end = memchr (header + 345, '\0', 155)) ) ? (size_t) (end - (header + 345)) : 155;
+
+  if ( (name = (char *) malloc (prefixlen + namelen + 2)) == NULL )
+    return NULL;
+
+  if ( prefixlen )
+  {
+    memcpy (name, header + 345, prefixlen);
+    name[prefixlen++] = '/';
+  }
+
+  memcpy (name + prefixlen, header, namelen);
+  name[prefixlen + namelen] = '\0';
+
+  return name;
+}  /* End of tar_name() */
+
+
+/***************************************************************************
+ * tar_longname:
+ *
+ * Read the contents of a GNU long name (type L) or POSIX extended
+ * header (type x) member and extract the name of the next member.  An
+ * extended header without a path leaves the long name unset.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+tar_longname (InputFile *inf, char type, int64_t size, char **longname)
+{
+  char *content;
+  char *record;
+  char *end;
+  char *key;
+  long length;
+
+  *longname = 0;
+
+  if ( size < 0 || size > MAXLONGNAME )
+  {
+    errno = EIO;
+    return -1;
+  }
+
+  if ( (content = (char *) malloc ((size_t) size + 1)) == NULL )
+    return -1;
+
+  if ( in_streamread (inf, content, (size_t) size) < (size_t) size ||
+       in_skip (inf, (IN_BLOCKSIZE - size % IN_BLOCKSIZE) % IN_BLOCKSIZE) )
+  {
+    errno = ( inf->error ) ? inf->error : EIO;
+    free (content);
+    return -1;
+  }
+
+  content[size] = '\0';
+
+  if ( type == 'L' )
+  {
+    *longname = content;
+    return 0;
+  }
+
+  /* Extended header records: "<length> <key>=<value>\n" */
+  for (record = content; record < content + size; record += length)
+  {
+    length = strtol (record, &key, 10);
+
+    if ( length <= 0 || record + length > content + size || *key != ' ' )
+      break;
+
+    key++;
+
+    if ( ! strncmp (key, "path=", 5) && record[length - 1] == '\n' )
+    {
+      end = record + length - 1;
+      *end = '\0';
+
+      free (*longname);
+
+      if ( (*longname = strdup (key + 5)) == NULL )
+      {
+        free (content);
+        return -1;
+      }
+    }
+  }
+
+  free (content);
+
+  return 0;
+}  /* End of tar_longname() */
+
+
+/***************************************************************************
+ * out_open:
+ *
+ * Open an output file, truncating any existing file.  Regular files
+ * are written asynchronously if possible.  A name of "unix:<path>" or
+ * "tcp:<host>:<port>" connects to a listening stream socket.
+ *
+ * Returns a pointer to an OutputFile on success and NULL on failure
+ * with errno set.
+ ***************************************************************************/
+OutputFile *
+out_open (char *name)
+{
+  OutputFile *of;
+  int errsave;
+
+#if defined(FILEIO_SOCKETS)
+  if ( ! strncmp (name, "unix:", 5) || ! strncmp (name, "tcp:", 4) )
+    return out_connect (name);
+#endif
+
+  if ( (of = (OutputFile *) calloc (1, sizeof(OutputFile))) == NULL )
+    return NULL;
+
+  of->fd = -1;
+
+#if defined(FILEIO_URING)
+  if ( out_ring () )
+  {
+    struct stat sbuf;
+
+    if ( (of->fd = open (name, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0 )
+    {
+      errsave = errno;
+      free (of);
+      errno = errsave;
+      return NULL;
+    }
+
+    /* Only regular files are written asynchronously, others (e.g. pipes)
+       must be written in order and are used as a stdio stream. */
+    if ( ! fstat (of->fd, &sbuf) && S_ISREG (sbuf.st_mode) )
+      return of;
+
+    if ( (of->fp = fdopen (of->fd, "wb")) == NULL )
+    {
+      errsave = errno;
+      close (of->fd);
+      free (of);
+      errno = errsave;
+      return NULL;
+    }
+
+    of->fd = -1;
+    return of;
+  }
+#endif
+
+  if ( (of->fp = fopen (name, "wb")) == NULL )
+  {
+    errsave = errno;
+    free (of);
+    errno = errsave;
+    return NULL;
+  }
+
+  return of;
+}  /* End of out_open() */
+
+
+/***************************************************************************
+ * out_stdout:
+ *
+ * Returns a pointer to an OutputFile for standard output on success
+ * and NULL on failure.
+ ***************************************************************************/
+OutputFile *
+out_stdout (void)
+{
+  OutputFile *of;
+
+  if ( (of = (OutputFile *) calloc (1, sizeof(OutputFile))) == NULL )
+    return NULL;
+
+  of->fd = -1;
+  of->fp = stdout;
+
+  return of;
+}  /* End of out_stdout() */
+
+
+/***************************************************************************
+ * out_write:
+ *
+ * Write a buffer to an output file.  The buffer must be allocated
+ * with malloc() and ownership is transferred, it is freed when the
+ * write is complete.
+ *
+ * Asynchronous writes are submitted and this routine only waits when
+ * the maximum number of writes are outstanding.  Errors of previously
+ * submitted writes are reported by later calls.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+out_write (OutputFile *of, char *buffer, size_t length)
+{
+  if ( ! of || ! buffer )
+  {
+    if ( buffer )
+      free (buffer);
+    errno = EINVAL;
+    return -1;
+  }
+
+#if defined(FILEIO_SOCKETS)
+  if ( of->sendq )
+    return sock_write (of, buffer, length);
+#endif
+
+  if ( of->fp )
+  {
+    if ( length > 0 && fwrite (buffer, length, 1, of->fp) != 1 )
+    {
+      free (buffer);
+      return -1;
+    }
+
+    free (buffer);
+    return 0;
+  }
+
+#if defined(FILEIO_URING)
+  if ( of->fd >= 0 && ! of->error )
+  {
+    IORing *ring = out_ring ();
+    IORequest *req;
+
+    if ( length == 0 )
+    {
+      free (buffer);
+      return 0;
+    }
+
+    if ( ring && (req = (IORequest *) calloc (1, sizeof(IORequest))) )
+    {
+      req->of = of;
+      req->iov.iov_base = buffer;
+      req->iov.iov_len = length;
+      req->offset = of->offset;
+      req->release = buffer;
+
+      of->offset += length;
+      of->pending++;
+
+      if ( ring_queue (ring, IORING_OP_WRITEV, of->fd, req) || ring_submit (ring, 0) )
+      {
+        of->pending--;
+        of->error = ( errno ) ? errno : EIO;
+        free (req);
+        free (buffer);
+      }
+
+      /* Process any completed writes */
+      ring_reap (ring, 0);
+    }
+    else
+    {
+      of->error = ENOMEM;
+      free (buffer);
+    }
+  }
+  else
+  {
+    free (buffer);
+  }
+
+  if ( of->error )
+  {
+    errno = of->error;
+    return -1;
+  }
+
+  return 0;
+#else
+  free (buffer);
+  errno = EBADF;
+  return -1;
+#endif
+}  /* End of out_write() */
+
+
+/***************************************************************************
+ * out_close:
+ *
+ * Wait for all outstanding writes and close an output file.
+ *
+ * Returns 0 on success and -1 if any write failed with errno set.
+ ***************************************************************************/
+int
+out_close (OutputFile *of)
+{
+  int error = 0;
+
+  if ( ! of )
+    return 0;
+
+  if ( of->fp )
+  {
+    if ( fclose (of->fp) )
+      error = errno;
+  }
+
+#if defined(FILEIO_SOCKETS)
+  if ( of->sendq )
+  {
+    sock_flush (of);
+    free (of->sendq);
+
+    if ( close (of->fd) && ! of->error )
+      of->error = errno;
+
+    of->fd = -1;
+  }
+#endif
+
+#if defined(FILEIO_URING)
+  if ( of->fd >= 0 )
+  {
+    while ( of->pending > 0 )
+      if ( ring_reap (&outring, 1) )
+        break;
+
+    if ( close (of->fd) && ! of->error )
+      of->error = errno;
+  }
+#endif
+
+  if ( of->error )
+    error = of->error;
+
+  free (of);
+
+  if ( error )
+  {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}  /* End of out_close() */
+
+
+#if defined(FILEIO_SOCKETS)
+/***************************************************************************
+ * out_connect:
+ *
+ * Open an output file connected to a listening stream socket.
+ *
+ * Returns a pointer to an OutputFile on success and NULL on failure
+ * with errno set.
+ ***************************************************************************/
+static OutputFile *
+out_connect (char *name)
+{
+  OutputFile *of;
+  int errsave;
+
+  if ( (of = (OutputFile *) calloc (1, sizeof(OutputFile))) == NULL )
+    return NULL;
+
+  if ( (of->sendq = calloc (1, sizeof(SendQueue))) == NULL ||
+       (of->fd = sock_connect (name)) < 0 )
+  {
+    errsave = errno;
+    free (of->sendq);
+    free (of);
+    errno = errsave;
+    return NULL;
+  }
+
+  return of;
+}  /* End of out_connect() */
+
+
+/***************************************************************************
+ * sock_connect:
+ *
+ * Connect a stream socket to "unix:<path>" or "tcp:<host>:<port>", an
+ * IPv6 host address must be enclosed in brackets.
+ *
+ * Returns a socket descriptor on success and -1 on failure with errno
+ * set.
+ ***************************************************************************/
+static int
+sock_connect (char *name)
+{
+  struct sockaddr_un unaddr;
+  struct addrinfo hints;
+  struct addrinfo *addrs;
+  struct addrinfo *addr;
+  char host[256];
+  char *spec;
+  char *port;
+  size_t length;
+  int errsave = ECONNREFUSED;
+  int fd = -1;
+
+  if ( ! strncmp (name, "unix:", 5) )
+  {
+    memset (&unaddr, 0, sizeof(unaddr));
+    unaddr.sun_family = AF_UNIX;
+
+    if ( strlen (name + 5) >= sizeof(unaddr.sun_path) )
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+
+    strcpy (unaddr.sun_path, name + 5);
+
+    if ( (fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0 )
+      return -1;
+
+    if ( connect (fd, (struct sockaddr *) &unaddr, sizeof(unaddr)) )
+    {
+      errsave = errno;
+      close (fd);
+      errno = errsave;
+      return -1;
+    }
+  }
+  else
+  {
+    spec = name + 4;
+
+    if ( *spec == '[' )
+    {
+      spec++;
+      port = strchr (spec, ']');
+
+      if ( port && port[1] != ':' )
+        port = 0;
+    }
+    else
+    {
+      port = strrchr (spec, ':');
+    }
+
+    if ( ! port || (length = (size_t) (port - spec)) >= sizeof(host) )
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    memcpy (host, spec, length);
+    host[length] = '\0';
+    port += ( *port == ']' ) ? 2 : 1;
+
+    memset (&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if ( getaddrinfo (host, port, &hints, &addrs) )
+    {
+      errno = EHOSTUNREACH;
+      return -1;
+    }
+
+    /* Connect to the first address that accepts */
+    for (addr = addrs; addr; addr = addr->ai_next)
+    {
+      if ( (fd = socket (addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0 )
+      {
+        errsave = errno;
+        continue;
+      }
+
+      if ( ! connect (fd, addr->ai_addr, addr->ai_addrlen) )
+        break;
+
+      errsave = errno;
+      close (fd);
+      fd = -1;
+    }
+
+    freeaddrinfo (addrs);
+
+    if ( fd < 0 )
+    {
+      errno = errsave;
+      return -1;
+    }
+  }
+
+#if defined(SO_NOSIGPIPE)
+  {
+    int on = 1;
+    setsockopt (fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+  }
+#endif
+
+  return fd;
+}  /* End of sock_connect() */
+
+
+/***************************************************************************
+ * sock_write:
+ *
+ * Queue a buffer for sending to a socket, taking ownership of it.
+ * Queued buffers are sent when the queue holds SENDBUFFERS buffers or
+ * SENDBATCH bytes.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+sock_write (OutputFile *of, char *buffer, size_t length)
+{
+  SendQueue *sq = (SendQueue *) of->sendq;
+
+  if ( of->error || length == 0 )
+  {
+    free (buffer);
+
+    if ( of->error )
+    {
+      errno = of->error;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  sq->buffers[sq->count] = buffer;
+  sq->lengths[sq->count] = length;
+  sq->count++;
+  sq->bytes += length;
+
+  if ( sq->count == SENDBUFFERS || sq->bytes >= SENDBATCH )
+    return sock_flush (of);
+
+  return 0;
+}  /* End of sock_write() */
+
+
+/***************************************************************************
+ * sock_flush:
+ *
+ * Send all queued buffers to a socket, gathering them into as few
+ * sends as possible.  The sends block while the receiver is not
+ * reading, pausing the writer.  Sent buffers are released, on failure
+ * all queued buffers are released.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+sock_flush (OutputFile *of)
+{
+  SendQueue *sq = (SendQueue *) of->sendq;
+  struct iovec iov[SENDBUFFERS];
+  struct msghdr msg;
+  ssize_t sent;
+  size_t remaining;
+  int idx;
+
+  while ( sq->count > 0 && ! of->error )
+  {
+    for (idx = 0; idx < sq->count; idx++)
+    {
+      iov[idx].iov_base = sq->buffers[idx];
+      iov[idx].iov_len = sq->lengths[idx];
+    }
+
+    iov[0].iov_base = sq->buffers[0] + sq->sent;
+    iov[0].iov_len -= sq->sent;
+
+    memset (&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = sq->count;
+
+    if ( (sent = sendmsg (of->fd, &msg, SENDFLAGS)) < 0 )
+    {
+      if ( errno != EINTR )
+        of->error = errno;
+
+      continue;
+    }
+
+    sq->bytes -= (size_t) sent;
+
+    /* Release completely sent buffers */
+    while ( sent > 0 )
+    {
+      remaining = sq->lengths[0] - sq->sent;
+
+      if ( (size_t) sent < remaining )
+      {
+        sq->sent += (size_t) sent;
+        break;
+      }
+
+      sent -= (ssize_t) remaining;
+      free (sq->buffers[0]);
+      sq->count--;
+      sq->sent = 0;
+
+      memmove (sq->buffers, sq->buffers + 1, sq->count * sizeof(char *));
+      memmove (sq->lengths, sq->lengths + 1, sq->count * sizeof(size_t));
+    }
+  }
+
+  if ( of->error )
+  {
+    for (idx = 0; idx < sq->count; idx++)
+      free (sq->buffers[idx]);
+
+    sq->count = 0;
+    sq->bytes = 0;
+    sq->sent = 0;
+
+    errno = of->error;
+    return -1;
+  }
+
+  return 0;
+}  /* End of sock_flush() */
+#endif
+
+
+/***************************************************************************
+ * fileio_shutdown:
+ *
+ * Release any prefetched input and the asynchronous I/O rings.
+ ***************************************************************************/
+void
+fileio_shutdown (void)
+{
+#if defined(FILEIO_URING)
+  if ( prefetched )
+  {
+    in_close (prefetched);
+    prefetched = 0;
+  }
+
+  if ( inringstate > 0 )
+    ring_free (&inring);
+
+  if ( outringstate > 0 )
+    ring_free (&outring);
+
+  inringstate = outringstate = 0;
+#endif
+}  /* End of fileio_shutdown() */
+
+
+#if defined(FILEIO_URING)
+/***************************************************************************
+ * in_ring:
+ *
+ * Returns the input ring, initializing it on first use, or NULL if
+ * asynchronous I/O is not available.
+ ***************************************************************************/
+static IORing *
+in_ring (void)
+{
+  if ( inringstate == 0 )
+    inringstate = ( ring_init (&inring, INRINGDEPTH) ) ? -1 : 1;
+
+  return ( inringstate > 0 ) ? &inring : NULL;
+}  /* End of in_ring() */
+
+
+/***************************************************************************
+ * out_ring:
+ *
+ * Returns the output ring, initializing it on first use, or NULL if
+ * asynchronous I/O is not available.
+ ***************************************************************************/
+static IORing *
+out_ring (void)
+{
+  if ( outringstate == 0 )
+    outringstate = ( ring_init (&outring, OUTRINGDEPTH) ) ? -1 : 1;
+
+  return ( outringstate > 0 ) ? &outring : NULL;
+}  /* End of out_ring() */
+
+
+/***************************************************************************
+ * in_startread:
+ *
+ * Open a file and submit range reads of the first read ahead window.
+ *
+ * Returns a pointer to an InputFile on success and NULL on failure.
+ * If the file is not suitable for asynchronous reading (not a regular
+ * file) errno is set to 0, otherwise errno is set.
+ ***************************************************************************/
+static InputFile *
+in_startread (char *name)
+{
+  InputFile *inf;
+  struct stat sbuf;
+  int64_t windowsize;
+  int errsave;
+
+  if ( (inf = (InputFile *) calloc (1, sizeof(InputFile))) == NULL )
+    return NULL;
+
+  inf->fd = -1;
+
+  if ( (inf->name = strdup (name)) == NULL ||
+       (inf->fd = open (name, O_RDONLY)) < 0 ||
+       fstat (inf->fd, &sbuf) )
+  {
+    errsave = errno;
+    in_close (inf);
+    errno = errsave;
+    return NULL;
+  }
+
+  if ( ! S_ISREG (sbuf.st_mode) )
+  {
+    in_close (inf);
+    errno = 0;
+    return NULL;
+  }
+
+  inf->size = sbuf.st_size;
+
+  windowsize = (int64_t) READAHEAD * READCHUNK;
+  if ( windowsize > inf->size )
+    windowsize = inf->size;
+
+  if ( (inf->buffer = (char *) malloc ((windowsize > 0) ? (size_t) windowsize : 1)) == NULL )
+  {
+    in_close (inf);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  in_readahead (inf);
+
+  return inf;
+}  /* End of in_startread() */
+
+
+/***************************************************************************
+ * in_readahead:
+ *
+ * Submit range reads for the slots of the read ahead window that are
+ * free, the slots of ranges before the one at the read offset are
+ * reused.  The reads are submitted without waiting for completions.
+ ***************************************************************************/
+static void
+in_readahead (InputFile *inf)
+{
+  IORequest *req;
+  int64_t limit;
+  int queued = 0;
+
+  limit = (inf->offset / READCHUNK + READAHEAD) * READCHUNK;
+  if ( limit > inf->size )
+    limit = inf->size;
+
+  while ( inf->submitted < limit && ! inf->error )
+  {
+    if ( (req = (IORequest *) calloc (1, sizeof(IORequest))) == NULL )
+    {
+      inf->error = ENOMEM;
+      break;
+    }
+
+    req->inf = inf;
+    req->slot = (int) ((inf->submitted / READCHUNK) % READAHEAD);
+    req->iov.iov_base = inf->buffer + (int64_t) req->slot * READCHUNK;
+    req->iov.iov_len = ( (inf->size - inf->submitted) < READCHUNK ) ?
+      (size_t)(inf->size - inf->submitted) : READCHUNK;
+    req->offset = inf->submitted;
+
+    inf->ready &= ~(1u << req->slot);
+    inf->pending++;
+
+    if ( ring_queue (&inring, IORING_OP_READV, inf->fd, req) )
+    {
+      inf->pending--;
+      inf->error = ( errno ) ? errno : EIO;
+      free (req);
+      break;
+    }
+
+    inf->submitted += req->iov.iov_len;
+    queued++;
+  }
+
+  if ( queued && ring_submit (&inring, 0) && ! inf->error )
+    inf->error = errno;
+}  /* End of in_readahead() */
+
+
+/***************************************************************************
+ * in_window:
+ *
+ * Refill the read ahead window and wait for the range read containing
+ * the read offset of an input file to complete.
+ *
+ * Returns the number of bytes available in the window at the read
+ * offset, up to the end of the range, with window set to the first of
+ * them, or 0 at the end of the file or on error.
+ ***************************************************************************/
+static size_t
+in_window (InputFile *inf, char **window)
+{
+  int64_t avail;
+  int slot;
+
+  if ( inf->offset >= inf->size || inf->error )
+    return 0;
+
+  in_readahead (inf);
+
+  slot = (int) ((inf->offset / READCHUNK) % READAHEAD);
+
+  while ( ! (inf->ready & (1u << slot)) )
+  {
+    if ( inf->error )
+      return 0;
+
+    if ( inf->pending == 0 || ring_reap (&inring, 1) )
+    {
+      inf->error = ( errno ) ? errno : EIO;
+      return 0;
+    }
+  }
+
+  avail = READCHUNK - inf->offset % READCHUNK;
+  if ( avail > inf->size - inf->offset )
+    avail = inf->size - inf->offset;
+
+  *window = inf->buffer + (int64_t) slot * READCHUNK + inf->offset % READCHUNK;
+
+  return (size_t) avail;
+}  /* End of in_window() */
+
+
+/***************************************************************************
+ * in_wait:
+ *
+ * Wait for all outstanding reads of an input file to complete.
+ ***************************************************************************/
+static void
+in_wait (InputFile *inf)
+{
+  while ( inf->pending > 0 )
+  {
+    if ( ring_reap (&inring, 1) )
+    {
+      inf->error = ( errno ) ? errno : EIO;
+      break;
+    }
+  }
+}  /* End of in_wait() */
+
+
+/***************************************************************************
+ * ring_init:
+ *
+ * Create an io_uring instance and map the rings.
+ *
+ * Returns 0 on success and -1 on failure.
+ ***************************************************************************/
+static int
+ring_init (IORing *ring, unsigned entries)
+{
+  struct io_uring_params params;
+  char *sq;
+  char *cq;
+
+  memset (ring, 0, sizeof(IORing));
+  memset (&params, 0, sizeof(params));
+
+  if ( (ring->fd = (int) syscall (__NR_io_uring_setup, entries, &params)) < 0 )
+  {
+    ring->fd = -1;
+    return -1;
+  }
+
+  ring->entries = params.sq_entries;
+  ring->sqringlen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqringlen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqeslen = params.sq_entries * sizeof(struct io_uring_sqe);
+
+#if defined(IORING_FEAT_SINGLE_MMAP)
+  if ( params.features & IORING_FEAT_SINGLE_MMAP )
+  {
+    if ( ring->cqringlen > ring->sqringlen )
+      ring->sqringlen = ring->cqringlen;
+    ring->cqringlen = 0;
+  }
+#endif
+
+  ring->sqring = mmap (NULL, ring->sqringlen, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if ( ring->sqring == MAP_FAILED )
+  {
+    ring->sqring = NULL;
+    ring_free (ring);
+    return -1;
+  }
+
+  if ( ring->cqringlen )
+  {
+    ring->cqring = mmap (NULL, ring->cqringlen, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if ( ring->cqring == MAP_FAILED )
+    {
+      ring->cqring = NULL;
+      ring_free (ring);
+      return -1;
+    }
+  }
+
+  ring->sqes = (struct io_uring_sqe *) mmap (NULL, ring->sqeslen, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if ( ring->sqes == MAP_FAILED )
+  {
+    ring->sqes = NULL;
+    ring_free (ring);
+    return -1;
+  }
+
+  sq = (char *) ring->sqring;
+  cq = ( ring->cqring ) ? (char *) ring->cqring : sq;
+
+  ring->sqhead = (unsigned *) (sq + params.sq_off.head);
+  ring->sqtail = (unsigned *) (sq + params.sq_off.tail);
+  ring->sqmask = (unsigned *) (sq + params.sq_off.ring_mask);
+  ring->sqarray = (unsigned *) (sq + params.sq_off.array);
+  ring->cqhead = (unsigned *) (cq + params.cq_off.head);
+  ring->cqtail = (unsigned *) (cq + params.cq_off.tail);
+  ring->cqmask = (unsigned *) (cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+  return 0;
+}  /* End of ring_init() */
+
+
+/***************************************************************************
+ * ring_free:
+ *
+ * Unmap the rings and close an io_uring instance.
+ ***************************************************************************/
+static void
+ring_free (IORing *ring)
+{
+  if ( ring->sqes )
+    munmap (ring->sqes, ring->sqeslen);
+
+  if ( ring->cqring )
+    munmap (ring->cqring, ring->cqringlen);
+
+  if ( ring->sqring )
+    munmap (ring->sqring, ring->sqringlen);
+
+  if ( ring->fd >= 0 )
+    close (ring->fd);
+
+  memset (ring, 0, sizeof(IORing));
+  ring->fd = -1;
+}  /* End of ring_free() */
+
+
+/***************************************************************************
+ * ring_queue:
+ *
+ * Add a vectored read or write request to the submission queue.  When
+ * the maximum number of requests are in flight completions are reaped
+ * until an entry is available.  The request is not submitted until
+ * ring_submit() is called.
+ *
+ * Returns 0 on success and -1 on failure.
+ ***************************************************************************/
+static int
+ring_queue (IORing *ring, int opcode, int fd, IORequest *req)
+{
+  struct io_uring_sqe *sqe;
+  unsigned tail;
+  unsigned index;
+
+  /* Limit requests in flight to the submission queue size, the completion
+     queue is at least as large and cannot overflow. */
+  while ( (ring->inflight + ring->unsubmitted) >= ring->entries )
+  {
+    if ( ring->unsubmitted && ring_submit (ring, 0) )
+      return -1;
+
+    if ( ring->inflight && ring_reap (ring, 1) )
+      return -1;
+  }
+
+  tail = *ring->sqtail;
+  index = tail & *ring->sqmask;
+  sqe = &ring->sqes[index];
+
+  memset (sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = (uint8_t) opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) &req->iov;
+  sqe->len = 1;
+  sqe->off = (uint64_t) req->offset;
+  sqe->user_data = (uint64_t) (uintptr_t) req;
+
+  ring->sqarray[index] = index;
+  __atomic_store_n (ring->sqtail, tail + 1, __ATOMIC_RELEASE);
+
+  ring->unsubmitted++;
+
+  return 0;
+}  /* End of ring_queue() */
+
+
+/***************************************************************************
+ * ring_submit:
+ *
+ * Submit queued requests and optionally wait for completions.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+ring_submit (IORing *ring, unsigned waitnr)
+{
+  long submitted;
+
+  for (;;)
+  {
+    submitted = syscall (__NR_io_uring_enter, ring->fd, ring->unsubmitted, waitnr,
+                         (waitnr) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+    if ( submitted >= 0 )
+      break;
+
+    if ( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+      return -1;
+  }
+
+  ring->unsubmitted -= (unsigned) submitted;
+  ring->inflight += (unsigned) submitted;
+
+  return 0;
+}  /* End of ring_submit() */
+
+
+/***************************************************************************
+ * ring_reap:
+ *
+ * Process all available completions, optionally waiting for at least
+ * one completion if none are available.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+ring_reap (IORing *ring, int wait)
+{
+  struct io_uring_cqe *cqe;
+  IORequest *req;
+  unsigned head;
+  int result;
+  int reaped = 0;
+
+  for (;;)
+  {
+    head = *ring->cqhead;
+
+    if ( head == __atomic_load_n (ring->cqtail, __ATOMIC_ACQUIRE) )
+    {
+      if ( ! wait || reaped || (ring->inflight == 0 && ring->unsubmitted == 0) )
+        break;
+
+      if ( ring_submit (ring, 1) )
+        return -1;
+
+      continue;
+    }
+
+    cqe = &ring->cqes[head & *ring->cqmask];
+    req = (IORequest *) (uintptr_t) cqe->user_data;
+    result = cqe->res;
+
+    __atomic_store_n (ring->cqhead, head + 1, __ATOMIC_RELEASE);
+    ring->inflight--;
+    reaped++;
+
+    ring_complete (ring, req, result);
+  }
+
+  /* Submit any requests queued for short transfers */
+  if ( ring->unsubmitted && ring_submit (ring, 0) )
+    return -1;
+
+  return 0;
+}  /* End of ring_reap() */
+
+
+/***************************************************************************
+ * ring_complete:
+ *
+ * Handle the result of a completed request.  Short transfers are
+ * queued again for the remainder, if the kernel does not support the
+ * operation the transfer is completed synchronously.
+ ***************************************************************************/
+static void
+ring_complete (IORing *ring, IORequest *req, int result)
+{
+  int fd = ( req->inf ) ? req->inf->fd : req->of->fd;
+  ssize_t rv;
+
+  if ( result == -EINTR || result == -EAGAIN )
+  {
+    if ( ! ring_queue (ring, (req->inf) ? IORING_OP_READV : IORING_OP_WRITEV, fd, req) )
+      return;
+
+    result = ( errno ) ? -errno : -EIO;
+  }
+
+  /* Complete the transfer synchronously when the operation is not supported */
+  if ( result == -EINVAL || result == -EOPNOTSUPP )
+  {
+    result = 0;
+
+    while ( req->iov.iov_len > 0 )
+    {
+      if ( req->inf )
+        rv = pread (fd, req->iov.iov_base, req->iov.iov_len, (off_t) req->offset);
+      else
+        rv = pwrite (fd, req->iov.iov_base, req->iov.iov_len, (off_t) req->offset);
+
+      if ( rv < 0 && errno == EINTR )
+        continue;
+
+      if ( rv <= 0 )
+      {
+        result = ( rv < 0 ) ? -errno : -EIO;
+        break;
+      }
+
+      req->iov.iov_base = (char *) req->iov.iov_base + rv;
+      req->iov.iov_len -= rv;
+      req->offset += rv;
+    }
+  }
+  else if ( result == 0 && req->iov.iov_len > 0 )
+  {
+    /* A file truncated while reading or a write of no bytes */
+    result = -EIO;
+  }
+  else if ( result > 0 && (size_t) result < req->iov.iov_len )
+  {
+    req->iov.iov_base = (char *) req->iov.iov_base + result;
+    req->iov.iov_len -= result;
+    req->offset += result;
+
+    if ( ! ring_queue (ring, (req->inf) ? IORING_OP_READV : IORING_OP_WRITEV, fd, req) )
+      return;
+
+    result = ( errno ) ? -errno : -EIO;
+  }
+
+  if ( req->inf )
+  {
+    if ( result < 0 && ! req->inf->error )
+      req->inf->error = -result;
+    else if ( result >= 0 )
+      req->inf->ready |= 1u << req->slot;
+
+    req->inf->pending--;
+  }
+  else
+  {
+    if ( result < 0 && ! req->of->error )
+      req->of->error = -result;
+
+    req->of->pending--;
+  }
+
+  if ( req->release )
+    free (req->release);
+
+  free (req);
+}  /* End of ring_complete() */
+#endif /* FILEIO_URING */
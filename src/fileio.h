@@ -0,0 +1,100 @@
+/***************************************************************************
+ * fileio.h
+ *
+ * Interface declarations for input and output file access with an
+ * optional asynchronous (io_uring) backend, decoding of compressed
+ * and archived input and output to stream sockets.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#ifndef FILEIO_H
+#define FILEIO_H 1
+
+#include <stdio.h>
+#include <libmseed.h>
+
+/* The io_uring backend is used on Linux when the kernel interface
+ * header is available, it can be disabled with -DFILEIO_NOURING.  When
+ * the backend is not compiled in or a ring cannot be created at run
+ * time all access is done with stdio streams. */
+#if defined(LMP_LINUX) && !defined(FILEIO_NOURING) && defined(__has_include)
+  #if __has_include(<linux/io_uring.h>)
+    #define FILEIO_URING 1
+  #endif
+#endif
+
+/* Input files compressed with gzip or zstd are decoded while reading
+ * when compiled with -DFILEIO_ZLIB or -DFILEIO_ZSTD (set by the
+ * Makefile when the libraries are found).  Input files that are tar
+ * archives, compressed or not, are read member by member. */
+
+/* Output to stream sockets, named "unix:<path>" or "tcp:<host>:<port>",
+ * is supported on Unix-like platforms, disable with -DFILEIO_NOSOCKETS. */
+#if !defined(LMP_WIN) && !defined(FILEIO_NOSOCKETS)
+  #define FILEIO_SOCKETS 1
+#endif
+
+/* Input compression types */
+#define IN_PLAIN 0
+#define IN_GZIP  1
+#define IN_ZSTD  2
+
+/* Size of tar archive blocks and the input look ahead buffer */
+#define IN_BLOCKSIZE 512
+
+/* An input file, either a stdio stream or contents read asynchronously
+ * through a read ahead window, possibly compressed and containing a tar
+ * archive */
+typedef struct InputFile_s {
+  char    *name;              /* File name */
+  FILE    *fp;                /* Stream for stdio access */
+  char    *buffer;            /* Read ahead window for asynchronous access */
+  int64_t  size;              /* Size of file in bytes */
+  int64_t  offset;            /* File offset of next unread byte */
+  int64_t  submitted;         /* File offset of next range read to submit */
+  unsigned ready;             /* Completed range reads by window slot */
+  int      fd;                /* File descriptor for asynchronous reads */
+  int      pending;           /* Number of outstanding reads */
+  int      error;             /* Error number of a failed read */
+  int      eof;               /* End of file or archive member reached */
+  int      compression;       /* Compression of file contents, IN_* */
+  void    *decoder;           /* Decompression state */
+  int64_t  position;          /* Read position in decoded file or member */
+  char     lookahead[IN_BLOCKSIZE]; /* Decoded bytes read ahead of position */
+  int      lookaheadoff;      /* Offset of next byte in look ahead buffer */
+  int      lookaheadlen;      /* Length of content in look ahead buffer */
+  int      archive;           /* Contents are a tar archive */
+  int      members;           /* Number of members (or files) started */
+  char    *membername;        /* Name of current archive member */
+  int64_t  memberleft;        /* Unread bytes of current archive member */
+  int64_t  memberpad;         /* Padding following current archive member */
+} InputFile;
+
+/* An output file, either a stdio stream, asynchronously written or a
+ * connected socket */
+typedef struct OutputFile_s {
+  FILE    *fp;                /* Stream for stdio access */
+  int      fd;                /* File descriptor for asynchronous writes or socket */
+  void    *sendq;             /* Buffers queued for sending to a socket */
+  int64_t  offset;            /* File offset of next asynchronous write */
+  int      pending;           /* Number of outstanding writes */
+  int      error;             /* Error number of a failed write */
+} OutputFile;
+
+extern InputFile  *in_open (char *name);
+extern void        in_prefetch (char *name);
+extern int         in_nextmember (InputFile *inf, char **membername);
+extern size_t      in_read (void *ptr, size_t size, size_t nmemb, InputFile *inf);
+extern size_t      in_peek (void *ptr, size_t length, InputFile *inf);
+extern int64_t     in_tell (InputFile *inf);
+extern int         in_eof (InputFile *inf);
+extern int         in_error (InputFile *inf);
+extern void        in_close (InputFile *inf);
+extern OutputFile *out_open (char *name);
+extern OutputFile *out_stdout (void);
+extern int         out_write (OutputFile *of, char *buffer, size_t length);
+extern int         out_close (OutputFile *of);
+extern void        fileio_shutdown (void);
+
+#endif /* FILEIO_H */
@@ -0,0 +1,449 @@
+/***************************************************************************
+ * logqueue.c
+ *
+ * Asynchronous output of libmseed log messages.  Messages are formatted
+ * by ms_log() in the calling thread and added to a bounded ring of
+ * message slots without locking, a writer thread prints the queued
+ * messages.  When the ring is full the calling thread waits for the
+ * writer to release a slot, messages are never dropped.  Error
+ * messages are not queued, the messages queued before them are
+ * written first and the error is then printed directly.
+ *
+ * The ring is a multi-producer, single-consumer queue where each slot
+ * has a sequence number: a slot is free for the producer holding
+ * position N when its sequence is N and holds a message for the
+ * consumer when its sequence is N+1.  When the ring is empty the
+ * writer waits on a condition variable, producers only take the lock
+ * to wake it, or to wait for a free slot or for queued messages to be
+ * written.
+ *
+ * Without thread support messages are printed directly by ms_log().
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logqueue.h"
+
+#if defined(LOGQ_THREADS)
+
+/* Size of the buffer used to write queued messages in batches */
+#define LOGQ_BATCH 8192
+
+/* Prefix of error messages, used to recognize them in logq_diag() */
+#define LOGQ_ERRPREFIX "Error: "
+
+/* A message slot in the ring */
+typedef struct LogSlot_s {
+  uint64_t  sequence;         /* Slot sequence number */
+  int       stream;           /* Output stream: 0 = stdout, 1 = stderr */
+  char     *longmessage;      /* Allocated copy of a message too long for the slot */
+  char      message[MAX_LOG_MSG_LENGTH];
+} LogSlot;
+
+static LogSlot  *ring       = NULL;
+static uint64_t  ringmask   = 0;
+static uint64_t  enqueuepos = 0;
+static uint64_t  flushpos   = 0;  /* Position up to which a flush was requested */
+static uint64_t  writtenpos = 0;  /* Position up to which messages were written */
+static int       running    = 0;
+static int       stopping   = 0;
+static int       sleeping   = 0;
+static int       spacewaits = 0;  /* Producers waiting for a free slot */
+static pthread_t writer;
+static pthread_mutex_t wakelock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  wakecond  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  spacecond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  flushcond = PTHREAD_COND_INITIALIZER;
+
+static void  logq_push (char *message, int stream);
+static void  logq_wake (void);
+static void  logq_flush (void);
+static void  logq_print (char *message);
+static void  logq_diag (char *message);
+static void *writerthread (void *arg);
+#endif
+
+
+/***************************************************************************
+ * logq_start:
+ *
+ * Allocate a ring of at least the specified number of message slots,
+ * rounded up to a power of 2, start the writer thread and direct the
+ * libmseed logging facility to the queue.
+ *
+ * Returns 0 on success and -1 on failure, in which case messages
+ * continue to be printed directly.
+ ***************************************************************************/
+int
+logq_start (int slots)
+{
+#if defined(LOGQ_THREADS)
+  uint64_t size = 1;
+  uint64_t idx;
+
+  if ( running )
+    return 0;
+
+  while ( size < (uint64_t) slots )
+    size <<= 1;
+
+  if ( (ring = (LogSlot *) malloc (sizeof(LogSlot) * size)) == NULL )
+  {
+    fprintf (stderr, "logq_start(): Cannot allocate log queue\n");
+    return -1;
+  }
+
+  for (idx = 0; idx < size; idx++)
+    ring[idx].sequence = idx;
+
+  ringmask   = size - 1;
+  enqueuepos = 0;
+  flushpos   = 0;
+  writtenpos = 0;
+  stopping   = 0;
+
+  if ( pthread_create (&writer, NULL, writerthread, ring) )
+  {
+    fprintf (stderr, "logq_start(): Cannot create log writer thread\n");
+    free (ring);
+    ring = NULL;
+    return -1;
+  }
+
+  __atomic_store_n (&running, 1, __ATOMIC_RELEASE);
+
+  ms_loginit (logq_print, NULL, logq_diag, LOGQ_ERRPREFIX);
+#endif
+
+  return 0;
+}  /* End of logq_start() */
+
+
+/***************************************************************************
+ * logq_stop:
+ *
+ * Wait for the writer thread to print all queued messages and release
+ * the queue, subsequent messages are printed directly.  No messages
+ * may be logged by other threads while stopping.
+ ***************************************************************************/
+void
+logq_stop (void)
+{
+#if defined(LOGQ_THREADS)
+  if ( ! running )
+    return;
+
+  pthread_mutex_lock (&wakelock);
+  __atomic_store_n (&stopping, 1, __ATOMIC_SEQ_CST);
+  pthread_cond_signal (&wakecond);
+  pthread_mutex_unlock (&wakelock);
+
+  pthread_join (writer, NULL);
+
+  __atomic_store_n (&running, 0, __ATOMIC_RELEASE);
+
+  free (ring);
+  ring = NULL;
+#endif
+}  /* End of logq_stop() */
+
+
+#if defined(LOGQ_THREADS)
+/***************************************************************************
+ * logq_push:
+ *
+ * Claim the next free slot in the ring and copy a message into it,
+ * messages longer than a slot are copied to an allocated buffer or
+ * truncated to the slot if a buffer cannot be allocated.  If the ring
+ * is full wait for the writer to release the slot.
+ ***************************************************************************/
+static void
+logq_push (char *message, int stream)
+{
+  LogSlot *slot;
+  uint64_t position;
+  uint64_t sequence;
+  int64_t diff;
+  size_t length;
+
+  if ( ! __atomic_load_n (&running, __ATOMIC_ACQUIRE) )
+  {
+    fputs (message, (stream) ? stderr : stdout);
+    return;
+  }
+
+  position = __atomic_load_n (&enqueuepos, __ATOMIC_RELAXED);
+
+  for (;;)
+  {
+    slot     = &ring[position & ringmask];
+    sequence = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+    diff     = (int64_t) (sequence - position);
+
+    /* Slot is free, claim it by advancing the enqueue position, on
+     * failure the current position is loaded and tried again */
+    if ( diff == 0 )
+    {
+      if ( __atomic_compare_exchange_n (&enqueuepos, &position, position + 1, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+        break;
+    }
+    /* Slot still holds a message from the previous lap, ring is full,
+     * wait for the writer to release it.  The writer checks for waiting
+     * producers after releasing a slot and signals them under the lock */
+    else if ( diff < 0 )
+    {
+      pthread_mutex_lock (&wakelock);
+      __atomic_fetch_add (&spacewaits, 1, __ATOMIC_SEQ_CST);
+
+      while ( (int64_t) (__atomic_load_n (&slot->sequence, __ATOMIC_SEQ_CST) - position) < 0 )
+        pthread_cond_wait (&spacecond, &wakelock);
+
+      __atomic_fetch_sub (&spacewaits, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock (&wakelock);
+
+      position = __atomic_load_n (&enqueuepos, __ATOMIC_RELAXED);
+    }
+    /* Slot was claimed by another thread */
+    else
+    {
+      position = __atomic_load_n (&enqueuepos, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->stream = stream;
+  slot->longmessage = NULL;
+  slot->message[0] = '\0';
+
+  if ( (length = strlen (message)) < MAX_LOG_MSG_LENGTH )
+  {
+    memcpy (slot->message, message, length + 1);
+  }
+  else if ( (slot->longmessage = (char *) malloc (length + 1)) != NULL )
+  {
+    memcpy (slot->longmessage, message, length + 1);
+  }
+  else
+  {
+    memcpy (slot->message, message, MAX_LOG_MSG_LENGTH - 2);
+    slot->message[MAX_LOG_MSG_LENGTH - 2] = '\n';
+    slot->message[MAX_LOG_MSG_LENGTH - 1] = '\0';
+  }
+
+  /* Publish the message to the writer */
+  __atomic_store_n (&slot->sequence, position + 1, __ATOMIC_SEQ_CST);
+
+  if ( __atomic_load_n (&sleeping, __ATOMIC_SEQ_CST) )
+    logq_wake ();
+}  /* End of logq_push() */
+
+
+/***************************************************************************
+ * logq_wake:
+ *
+ * Wake the writer thread waiting for messages.
+ ***************************************************************************/
+static void
+logq_wake (void)
+{
+  pthread_mutex_lock (&wakelock);
+  pthread_cond_signal (&wakecond);
+  pthread_mutex_unlock (&wakelock);
+}  /* End of logq_wake() */
+
+
+/***************************************************************************
+ * logq_flush:
+ *
+ * Wait for the writer thread to write all messages queued before the
+ * call.
+ ***************************************************************************/
+static void
+logq_flush (void)
+{
+  uint64_t target;
+
+  if ( ! __atomic_load_n (&running, __ATOMIC_ACQUIRE) )
+    return;
+
+  target = __atomic_load_n (&enqueuepos, __ATOMIC_SEQ_CST);
+
+  pthread_mutex_lock (&wakelock);
+
+  if ( (int64_t) (target - __atomic_load_n (&flushpos, __ATOMIC_SEQ_CST)) > 0 )
+    __atomic_store_n (&flushpos, target, __ATOMIC_SEQ_CST);
+
+  pthread_cond_signal (&wakecond);
+
+  while ( (int64_t) (target - __atomic_load_n (&writtenpos, __ATOMIC_SEQ_CST)) > 0 )
+    pthread_cond_wait (&flushcond, &wakelock);
+
+  pthread_mutex_unlock (&wakelock);
+}  /* End of logq_flush() */
+
+
+/***************************************************************************
+ * logq_print:
+ *
+ * Log message printing function for ms_loginit(), queue a message for
+ * stdout.
+ ***************************************************************************/
+static void
+logq_print (char *message)
+{
+  logq_push (message, 0);
+}  /* End of logq_print() */
+
+
+/***************************************************************************
+ * logq_diag:
+ *
+ * Diagnostic and error message printing function for ms_loginit(),
+ * queue a diagnostic message for stderr.  Error messages, recognized
+ * by the error prefix, are printed directly after the messages queued
+ * before them have been written.
+ ***************************************************************************/
+static void
+logq_diag (char *message)
+{
+  if ( strncmp (message, LOGQ_ERRPREFIX, sizeof(LOGQ_ERRPREFIX) - 1) == 0 )
+  {
+    logq_flush ();
+    fputs (message, stderr);
+    return;
+  }
+
+  logq_push (message, 1);
+}  /* End of logq_diag() */
+
+
+/***************************************************************************
+ * writerthread:
+ *
+ * Thread routine for the writer, print queued messages in order,
+ * collecting consecutive messages for the same stream into a batch.
+ * When the queue is empty, or the messages up to a flush request have
+ * been collected, the batch is written and flush waiters are woken.
+ * When the queue is empty the thread then waits to be woken by a
+ * producer.  The thread exits when the queue is empty after stopping
+ * was requested.
+ ***************************************************************************/
+static void *
+writerthread (void *arg)
+{
+  LogSlot *slots = (LogSlot *) arg;
+  char batch[LOGQ_BATCH];
+  size_t batchlen = 0;
+  size_t length;
+  int batchstream = 0;
+  uint64_t position = 0;
+  uint64_t sequence;
+  uint64_t flush;
+  LogSlot *slot;
+  char *message;
+
+  for (;;)
+  {
+    slot     = &slots[position & ringmask];
+    sequence = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+
+    if ( sequence == position + 1 )
+    {
+      message = (slot->longmessage) ? slot->longmessage : slot->message;
+      length  = strlen (message);
+
+      if ( batchlen && (batchstream != slot->stream || batchlen + length > sizeof(batch)) )
+      {
+        fwrite (batch, 1, batchlen, (batchstream) ? stderr : stdout);
+        batchlen = 0;
+      }
+
+      /* Write long messages directly */
+      if ( length > sizeof(batch) )
+      {
+        fwrite (message, 1, length, (slot->stream) ? stderr : stdout);
+      }
+      else
+      {
+        memcpy (batch + batchlen, message, length);
+        batchlen   += length;
+        batchstream = slot->stream;
+      }
+
+      if ( slot->longmessage )
+      {
+        free (slot->longmessage);
+        slot->longmessage = NULL;
+      }
+
+      /* Release the slot for the producer on the next lap */
+      __atomic_store_n (&slot->sequence, position + ringmask + 1, __ATOMIC_SEQ_CST);
+      position++;
+
+      /* Wake producers waiting for a free slot */
+      if ( __atomic_load_n (&spacewaits, __ATOMIC_SEQ_CST) )
+      {
+        pthread_mutex_lock (&wakelock);
+        pthread_cond_broadcast (&spacecond);
+        pthread_mutex_unlock (&wakelock);
+      }
+
+      /* Write the batch when all messages up to a flush request have
+       * been collected */
+      flush = __atomic_load_n (&flushpos, __ATOMIC_SEQ_CST);
+
+      if ( (int64_t) (flush - __atomic_load_n (&writtenpos, __ATOMIC_RELAXED)) > 0 &&
+           (int64_t) (position - flush) >= 0 )
+      {
+        if ( batchlen )
+        {
+          fwrite (batch, 1, batchlen, (batchstream) ? stderr : stdout);
+          batchlen = 0;
+        }
+        fflush (stdout);
+
+        pthread_mutex_lock (&wakelock);
+        __atomic_store_n (&writtenpos, position, __ATOMIC_SEQ_CST);
+        pthread_cond_broadcast (&flushcond);
+        pthread_mutex_unlock (&wakelock);
+      }
+
+      continue;
+    }
+
+    /* Queue is empty, write the batch before waiting */
+    if ( batchlen )
+    {
+      fwrite (batch, 1, batchlen, (batchstream) ? stderr : stdout);
+      batchlen = 0;
+    }
+    fflush (stdout);
+
+    /* Announce waiting before checking the queue again, a producer
+     * publishing a message after the check sees the writer waiting and
+     * signals it under the lock.  All messages consumed are written,
+     * wake any flush waiters */
+    pthread_mutex_lock (&wakelock);
+    __atomic_store_n (&writtenpos, position, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast (&flushcond);
+    __atomic_store_n (&sleeping, 1, __ATOMIC_SEQ_CST);
+
+    while ( __atomic_load_n (&slot->sequence, __ATOMIC_SEQ_CST) != position + 1 &&
+            ! __atomic_load_n (&stopping, __ATOMIC_SEQ_CST) )
+      pthread_cond_wait (&wakecond, &wakelock);
+
+    __atomic_store_n (&sleeping, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock (&wakelock);
+
+    if ( __atomic_load_n (&stopping, __ATOMIC_ACQUIRE) &&
+         __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) != position + 1 )
+      break;
+  }
+
+  return NULL;
+}  /* End of writerthread() */
+#endif /* LOGQ_THREADS */
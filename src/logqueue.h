@@ -0,0 +1,26 @@
+/***************************************************************************
+ * logqueue.h
+ *
+ * Interface declarations for asynchronous output of libmseed log
+ * messages.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#ifndef LOGQUEUE_H
+#define LOGQUEUE_H 1
+
+#include <libmseed.h>
+
+/* Thread support is available on all Unix-like platforms, when not
+ * available (or disabled with -DLOGQ_NOTHREADS) messages are printed
+ * by the logging thread. */
+#if !defined(LMP_WIN) && !defined(LOGQ_NOTHREADS)
+  #define LOGQ_THREADS 1
+  #include <pthread.h>
+#endif
+
+extern int  logq_start (int slots);
+extern void logq_stop (void);
+
+#endif /* LOGQUEUE_H */
@@ -0,0 +1,1208 @@
+/***************************************************************************
+ * mseed2seisan.c
+ *
+ * Simple waveform data conversion from Mini-SEED to SeisAn.
+ *
+ * The record headers of each input file are scanned once to build the
+ * trace list, which lays out the event header and channels of the
+ * SeisAn file, and an index of record offsets.  Each continuous
+ * segment becomes a SeisAn channel, segments with more samples than a
+ * channel can hold are split.  Channel data sections are then
+ * streamed: the records of each trace are read from their offsets in
+ * time order, unpacked one at a time and their samples written
+ * directly to the output, the samples of a trace are never held in
+ * memory together.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include <libmseed.h>
+
+#include "fileio.h"
+#include "seisan.h"
+
+#define VERSION "2.0"
+#define PACKAGE "mseed2seisan"
+
+struct listnode {
+  char *key;
+  char *data;
+  struct listnode *next;
+};
+
+/* A SeisAn channel, all or part of a trace segment */
+struct channel {
+  MSTraceID *id;              /* Trace of the channel */
+  hptime_t  starttime;        /* Time of first sample */
+  double    samprate;         /* Sample rate */
+  int64_t   samplecnt;        /* Number of samples */
+  char      station[6];       /* SeisAn station code */
+  char      component[5];     /* SeisAn component */
+};
+
+/* A data record in the input file */
+struct record {
+  MSTraceID *id;              /* Trace of the record */
+  off_t     offset;           /* Offset of the record in the file */
+  hptime_t  starttime;        /* Time of first sample */
+  double    samprate;         /* Sample rate */
+  int       reclen;           /* Record length */
+};
+
+/* Number of samples converted at a time */
+#define CONVERTSAMPLES 1024
+
+static int  mseed2seisan (char *msfile);
+static int  scanrecords (char *msfile, MSTraceList **mstl, MSTraceID ***order,
+                         struct record **records, int64_t *recordcount);
+static int  cmprecords (const void *a, const void *b);
+static int  mkchannels (MSTraceID **order, int tracecount, struct channel **channels, int *count);
+static int  writeeventheader (SeisanWriter *sw, struct channel *channels, int count);
+static int  writechannelheader (SeisanWriter *sw, struct channel *channel, flag uncertain);
+static int  writetrace (SeisanWriter *sw, FILE *ifp, struct channel *channels, int count,
+                        struct record *records, int64_t recordcount);
+static int64_t findrecord (struct record *records, int64_t recordcount, hptime_t expected,
+                           hptime_t tolerance, double samprate);
+static int  writesamples (SeisanWriter *sw, MSRecord *msr, int64_t offset, int64_t count,
+                          struct channel *channel, char *converted);
+static int  writezeros (SeisanWriter *sw, int64_t count);
+static void splittime (hptime_t hptime, int *year, int *doy, int *month, int *mday,
+                       int *hour, int *min, double *sec);
+static void translatecomp (char *channel, char *location, char *component);
+static void mkoutputname (char *outputname, size_t size, char *msfile);
+static int  parameter_proc (int argcount, char **argvec);
+static char *getoptval (int argcount, char **argvec, int argopt);
+static void addnode (struct listnode **listroot, char *key, char *data);
+static void addmapnode (struct listnode **listroot, char *mapping);
+static void usage (void);
+
+static int   verbose     = 0;
+static int   framing     = SEISAN_FRAME4;
+static int   byteorder   = -1;
+static char *outputfile  = 0;
+static flag  swapflag    = 0;
+
+/* A list of input files */
+struct listnode *filelist = 0;
+
+/* A list of component to channel translations */
+struct listnode *chanlist = 0;
+
+int
+main (int argc, char **argv)
+{
+  struct listnode *flp;
+  int retval = 0;
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  /* Files with 1 byte record lengths are always little-endian */
+  if ( framing == SEISAN_FRAME1 )
+    swapflag = ms_bigendianhost ();
+  else if ( byteorder >= 0 )
+    swapflag = ( byteorder != ms_bigendianhost () );
+
+  flp = filelist;
+  while ( flp != 0 )
+  {
+    if ( mseed2seisan (flp->data) )
+      retval = 1;
+
+    flp = flp->next;
+  }
+
+  fileio_shutdown ();
+
+  return retval;
+}  /* End of main() */
+
+
+/***************************************************************************
+ * mseed2seisan:
+ *
+ * Convert a Mini-SEED file to a SeisAn file.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+mseed2seisan (char *msfile)
+{
+  MSTraceList *mstl = 0;
+  MSTraceID **order = 0;
+  struct record *records = 0;
+  struct channel *channels = 0;
+  OutputFile *ofp = 0;
+  FILE *ifp = 0;
+  SeisanWriter sw;
+  char outputname[1024];
+  int64_t recordcount = 0;
+  int64_t ridx = 0;
+  int64_t rlast;
+  int count = 0;
+  int first;
+  int last;
+  int retval = 0;
+
+  /* Scan the record headers for the trace list and record index */
+  if ( scanrecords (msfile, &mstl, &order, &records, &recordcount) ||
+       mkchannels (order, mstl->numtraces, &channels, &count) )
+  {
+    free (order);
+    free (records);
+    mstl_free (&mstl, 0);
+    return -1;
+  }
+
+  free (order);
+
+  if ( count == 0 )
+  {
+    fprintf (stderr, "No data samples in %s, skipping\n", msfile);
+    free (records);
+    mstl_free (&mstl, 0);
+    return 0;
+  }
+
+  if ( count > SEISAN_MAXCHANNELS )
+  {
+    fprintf (stderr, "Too many channels (%d) in %s, maximum is %d\n",
+             count, msfile, SEISAN_MAXCHANNELS);
+    free (channels);
+    free (records);
+    mstl_free (&mstl, 0);
+    return -1;
+  }
+
+  if ( ! (ifp = fopen (msfile, "rb")) )
+  {
+    fprintf (stderr, "Cannot open input file: %s (%s)\n", msfile, strerror(errno));
+    free (channels);
+    free (records);
+    mstl_free (&mstl, 0);
+    return -1;
+  }
+
+  if ( outputfile )
+    snprintf (outputname, sizeof(outputname), "%s", outputfile);
+  else
+    mkoutputname (outputname, sizeof(outputname), msfile);
+
+  if ( strcmp (outputname, "-") == 0 )
+    ofp = out_stdout ();
+  else
+    ofp = out_open (outputname);
+
+  if ( ! ofp || sw_open (&sw, ofp, framing, swapflag) )
+  {
+    fprintf (stderr, "Cannot open output file: %s (%s)\n",
+             outputname, strerror(errno));
+    if ( ofp )
+      out_close (ofp);
+    fclose (ifp);
+    free (channels);
+    free (records);
+    mstl_free (&mstl, 0);
+    return -1;
+  }
+
+  if ( verbose )
+    ms_log (1, "Writing %d channel(s) from %s to %s\n", count, msfile, outputname);
+
+  if ( writeeventheader (&sw, channels, count) )
+    retval = -1;
+
+  /* Write the channels of each trace, the records are in the same trace order */
+  for (first = 0; first < count && ! retval; first = last)
+  {
+    for (last = first + 1; last < count; last++)
+      if ( channels[last].id != channels[first].id )
+        break;
+
+    while ( ridx < recordcount && records[ridx].id != channels[first].id )
+      ridx++;
+
+    for (rlast = ridx; rlast < recordcount; rlast++)
+      if ( records[rlast].id != channels[first].id )
+        break;
+
+    if ( writetrace (&sw, ifp, channels + first, last - first,
+                     records + ridx, rlast - ridx) )
+      retval = -1;
+
+    ridx = rlast;
+  }
+
+  if ( sw_close (&sw) )
+    retval = -1;
+
+  if ( out_close (ofp) )
+    retval = -1;
+
+  if ( retval )
+    fprintf (stderr, "Error writing to output file: %s\n", outputname);
+
+  fclose (ifp);
+  free (channels);
+  free (records);
+  mstl_free (&mstl, 0);
+
+  return retval;
+}  /* End of mseed2seisan() */
+
+
+/***************************************************************************
+ * scanrecords:
+ *
+ * Read the record headers of a file once to build the trace list, the
+ * order of the traces by their first record in the file and an index
+ * of the data records.  The trace list itself is ordered by source
+ * name, the index is sorted by trace order and record start time.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+scanrecords (char *msfile, MSTraceList **mstl, MSTraceID ***order,
+             struct record **records, int64_t *recordcount)
+{
+  MSFileParam *msfp = 0;
+  MSRecord *msr = 0;
+  MSTraceID **neworder;
+  MSTraceID *id;
+  struct record *newrecords;
+  int64_t maxrecords = 0;
+  off_t fpos = 0;
+  int ordered = 0;
+  int retval = 0;
+  int idx;
+  int rv;
+
+  if ( ! (*mstl = mstl_init (NULL)) )
+  {
+    fprintf (stderr, "Error allocating memory for traces\n");
+    return -1;
+  }
+
+  while ( (rv = ms_readmsr_r (&msfp, &msr, msfile, 0, &fpos, NULL, 1, 0, verbose)) == MS_NOERROR )
+  {
+    if ( ! mstl_addmsr (*mstl, msr, 0, 1, -1.0, -1.0) )
+    {
+      fprintf (stderr, "Error adding record to trace list\n");
+      retval = -1;
+      break;
+    }
+
+    id = (*mstl)->last;
+
+    /* Traces are ordered by their first record, marked until sorted */
+    if ( ! id->prvtptr )
+    {
+      if ( ! (neworder = (MSTraceID **) realloc (*order, (ordered + 1) * sizeof(MSTraceID *))) )
+      {
+        fprintf (stderr, "Error allocating memory for traces\n");
+        retval = -1;
+        break;
+      }
+
+      *order = neworder;
+      (*order)[ordered++] = id;
+      id->prvtptr = id;
+    }
+
+    if ( msr->samplecnt <= 0 )
+      continue;
+
+    if ( *recordcount == maxrecords )
+    {
+      maxrecords = ( maxrecords ) ? maxrecords * 2 : 1024;
+
+      if ( ! (newrecords = (struct record *) realloc (*records, maxrecords * sizeof(struct record))) )
+      {
+        fprintf (stderr, "Error allocating memory for record index\n");
+        retval = -1;
+        break;
+      }
+
+      *records = newrecords;
+    }
+
+    (*records)[*recordcount].id = id;
+    (*records)[*recordcount].offset = fpos;
+    (*records)[*recordcount].starttime = msr->starttime;
+    (*records)[*recordcount].samprate = msr->samprate;
+    (*records)[*recordcount].reclen = msr->reclen;
+    (*recordcount)++;
+  }
+
+  if ( ! retval && rv != MS_ENDOFFILE )
+  {
+    fprintf (stderr, "Error reading %s: %s\n", msfile, ms_errorstr (rv));
+    retval = -1;
+  }
+
+  ms_readmsr_r (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, 0);
+
+  if ( retval )
+    return -1;
+
+  /* Sort the index by the position of each trace in the order */
+  for (idx = 0; idx < ordered; idx++)
+    (*order)[idx]->prvtptr = *order + idx;
+
+  if ( *recordcount > 1 )
+    qsort (*records, (size_t) *recordcount, sizeof(struct record), cmprecords);
+
+  for (idx = 0; idx < ordered; idx++)
+    (*order)[idx]->prvtptr = NULL;
+
+  return 0;
+}  /* End of scanrecords() */
+
+
+/***************************************************************************
+ * cmprecords:
+ *
+ * Compare records by trace order, start time and file offset for
+ * qsort().
+ *
+ * Returns -1, 0 or 1 if record a sorts before, with or after record b
+ ***************************************************************************/
+static int
+cmprecords (const void *a, const void *b)
+{
+  const struct record *ra = (const struct record *) a;
+  const struct record *rb = (const struct record *) b;
+  MSTraceID **ta = (MSTraceID **) ra->id->prvtptr;
+  MSTraceID **tb = (MSTraceID **) rb->id->prvtptr;
+
+  if ( ta != tb )
+    return ( ta < tb ) ? -1 : 1;
+
+  if ( ra->starttime != rb->starttime )
+    return ( ra->starttime < rb->starttime ) ? -1 : 1;
+
+  if ( ra->offset != rb->offset )
+    return ( ra->offset < rb->offset ) ? -1 : 1;
+
+  return 0;
+}  /* End of cmprecords() */
+
+
+/***************************************************************************
+ * mkchannels:
+ *
+ * Lay out the SeisAn channels for the segments of ordered traces, in
+ * trace and time order.  Segments without samples or sample rate are
+ * skipped, segments with more than SEISAN_MAXSAMPLES samples are split
+ * into several channels.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+mkchannels (MSTraceID **order, int tracecount, struct channel **channels, int *count)
+{
+  struct channel *channel;
+  MSTraceID *id;
+  MSTraceSeg *seg;
+  int64_t offset;
+  int64_t samplecnt;
+  int maxcount = 0;
+  int tidx;
+
+  *channels = 0;
+  *count = 0;
+
+  for (tidx = 0; tidx < tracecount; tidx++)
+  {
+    id = order[tidx];
+
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      if ( seg->samplecnt <= 0 || seg->samprate <= 0.0 )
+      {
+        if ( verbose )
+          ms_log (1, "Skipping segment of %s without samples or sample rate\n", id->srcname);
+        continue;
+      }
+
+      for (offset = 0; offset < seg->samplecnt; offset += samplecnt)
+      {
+        samplecnt = seg->samplecnt - offset;
+        if ( samplecnt > SEISAN_MAXSAMPLES )
+          samplecnt = SEISAN_MAXSAMPLES;
+
+        if ( *count == maxcount )
+        {
+          maxcount = ( maxcount ) ? maxcount * 2 : 16;
+
+          if ( ! (channel = (struct channel *) realloc (*channels, maxcount * sizeof(struct channel))) )
+          {
+            fprintf (stderr, "Error allocating memory for channels\n");
+            free (*channels);
+            *channels = 0;
+            return -1;
+          }
+
+          *channels = channel;
+        }
+
+        channel = *channels + *count;
+        memset (channel, 0, sizeof(struct channel));
+        channel->id = id;
+        channel->starttime = seg->starttime + (hptime_t) ((double) offset / seg->samprate * HPTMODULUS + 0.5);
+        channel->samprate = seg->samprate;
+        channel->samplecnt = samplecnt;
+
+        snprintf (channel->station, sizeof(channel->station), "%.5s", id->station);
+        translatecomp (id->channel, id->location, channel->component);
+
+        (*count)++;
+      }
+    }
+  }
+
+  return 0;
+}  /* End of mkchannels() */
+
+
+/***************************************************************************
+ * writeeventheader:
+ *
+ * Write the event header: the network name, number of channels and
+ * time window, from the first to the last sample of all channels,
+ * followed by a blank line and the channel list, 3
+ * channels per line and at least SEISAN_MINCHANLINES lines.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+writeeventheader (SeisanWriter *sw, struct channel *channels, int count)
+{
+  char line[SEISAN_LINELEN + 1];
+  char *entry;
+  hptime_t starttime = HPTERROR;
+  hptime_t endtime = HPTERROR;
+  hptime_t chanend;
+  double sec;
+  int year, doy, month, mday, hour, min;
+  int lines;
+  int idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    chanend = channels[idx].starttime +
+              (hptime_t) ((double) (channels[idx].samplecnt - 1) / channels[idx].samprate * HPTMODULUS + 0.5);
+
+    if ( starttime == HPTERROR || channels[idx].starttime < starttime )
+      starttime = channels[idx].starttime;
+    if ( endtime == HPTERROR || chanend > endtime )
+      endtime = chanend;
+  }
+
+  splittime (starttime, &year, &doy, &month, &mday, &hour, &min, &sec);
+
+  /* Network name, number of channels, start time and time window */
+  memset (line, ' ', sizeof(line));
+  snprintf (line, sizeof(line), " %-29.29s%3d%3d %3d %2d %2d %2d %2d %6.3f %9.3f",
+            channels[0].id->network, count, year - 1900, doy, month, mday,
+            hour, min, sec, (double) (endtime - starttime) / HPTMODULUS);
+  line[strlen (line)] = ' ';
+
+  if ( sw_record (sw, line, SEISAN_LINELEN) )
+    return -1;
+
+  memset (line, ' ', sizeof(line));
+
+  if ( sw_record (sw, line, SEISAN_LINELEN) )
+    return -1;
+
+  /* Station, component, start relative to event header and time span */
+  lines = (count + 2) / 3;
+  if ( lines < SEISAN_MINCHANLINES )
+    lines = SEISAN_MINCHANLINES;
+
+  for (idx = 0; idx < lines * 3; idx++)
+  {
+    entry = line + (idx % 3) * 26;
+
+    if ( idx < count )
+    {
+      snprintf (entry, sizeof(line) - (entry - line), " %-4.4s%-4.4s %7.2f %8.2f",
+                channels[idx].station, channels[idx].component,
+                (double) (channels[idx].starttime - starttime) / HPTMODULUS,
+                (channels[idx].samplecnt - 1) / channels[idx].samprate);
+
+      /* The 5th character of a station code follows the component */
+      entry[9] = ( channels[idx].station[4] ) ? channels[idx].station[4] : ' ';
+      entry[26] = ' ';
+    }
+
+    if ( idx % 3 == 2 )
+    {
+      line[SEISAN_LINELEN] = '\0';
+
+      if ( sw_record (sw, line, SEISAN_LINELEN) )
+        return -1;
+
+      memset (line, ' ', sizeof(line));
+    }
+  }
+
+  return 0;
+}  /* End of writeeventheader() */
+
+
+/***************************************************************************
+ * writechannelheader:
+ *
+ * Write the 1040 byte channel header and start the data section of a
+ * channel, 4 byte samples are always written.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+writechannelheader (SeisanWriter *sw, struct channel *channel, flag uncertain)
+{
+  char cheader[SEISAN_CHEADERLEN + 1];
+  char ratestr[16];
+  double sec;
+  int year, doy, month, mday, hour, min;
+  int precision;
+
+  splittime (channel->starttime, &year, &doy, &month, &mday, &hour, &min, &sec);
+
+  /* Sample rate with 2 decimals, more if needed and they fit the field */
+  for (precision = 2; precision < 4; precision++)
+  {
+    snprintf (ratestr, sizeof(ratestr), "%.*f", precision, channel->samprate);
+
+    if ( strtod (ratestr, NULL) == channel->samprate ||
+         snprintf (NULL, 0, "%.*f", precision + 1, channel->samprate) > 7 )
+      break;
+  }
+
+  while ( precision > 0 && snprintf (NULL, 0, "%.*f", precision, channel->samprate) > 7 )
+    precision--;
+
+  snprintf (ratestr, sizeof(ratestr), "%7.*f", precision, channel->samprate);
+
+  memset (cheader, ' ', sizeof(cheader));
+  snprintf (cheader, sizeof(cheader), "%-5.5s%-4.4s%3d %3d %2d %2d %2d %2d%c%6.3f %7.7s%7"PRId64,
+            channel->station, channel->component, year - 1900, doy, month, mday,
+            hour, min, (uncertain) ? 'E' : ' ', sec, ratestr, channel->samplecnt);
+  cheader[strlen (cheader)] = ' ';
+
+  cheader[CH_SAMPLESIZE] = '4';
+
+  if ( verbose > 1 )
+    ms_log (1, "Writing channel %s %s: %"PRId64" samples @ %s Hz\n",
+            channel->station, channel->component, channel->samplecnt, ratestr);
+
+  if ( sw_record (sw, cheader, SEISAN_CHEADERLEN) ||
+       sw_begin (sw, (uint32_t) channel->samplecnt * 4) )
+    return -1;
+
+  return 0;
+}  /* End of writechannelheader() */
+
+
+/***************************************************************************
+ * writetrace:
+ *
+ * Write the channels of a trace, in time order.  For the next sample of
+ * the current channel the record starting at that time is found in
+ * the time sorted index of the trace, read from its offset in the file
+ * and unpacked and its samples are written.  A channel for which no
+ * continuing record is found is completed with zeros.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+writetrace (SeisanWriter *sw, FILE *ifp, struct channel *channels, int count,
+            struct record *records, int64_t recordcount)
+{
+  MSRecord *dmsr = 0;
+  MSTraceID *id = channels[0].id;
+  struct channel *channel;
+  char record[MAXRECLEN];
+  hptime_t expected;
+  hptime_t tolerance;
+  int64_t written = 0;
+  int64_t remaining;
+  int64_t offset;
+  int64_t samples;
+  int64_t ridx;
+  char converted = 0;
+  char started = 0;
+  int cidx = 0;
+  int retval = 0;
+  int rv;
+
+  while ( cidx < count && ! retval )
+  {
+    channel = channels + cidx;
+
+    /* Only a record starting at the next sample of the channel continues it */
+    expected = channel->starttime +
+               (hptime_t) ((double) written / channel->samprate * HPTMODULUS + 0.5);
+    tolerance = (hptime_t) (0.5 / channel->samprate * HPTMODULUS);
+
+    if ( (ridx = findrecord (records, recordcount, expected, tolerance, channel->samprate)) < 0 )
+    {
+      fprintf (stderr, "Missing %"PRId64" samples of %s, filled with zeros\n",
+               channel->samplecnt - written, id->srcname);
+
+      if ( (! started && writechannelheader (sw, channel, 0)) ||
+           writezeros (sw, channel->samplecnt - written) ||
+           sw_end (sw) )
+        retval = -1;
+
+      cidx++;
+      written = 0;
+      started = 0;
+      continue;
+    }
+
+    if ( records[ridx].reclen > MAXRECLEN ||
+         lmp_fseeko (ifp, records[ridx].offset, SEEK_SET) ||
+         fread (record, records[ridx].reclen, 1, ifp) != 1 )
+    {
+      fprintf (stderr, "Error reading record of %s at offset %lld\n",
+               id->srcname, (long long) records[ridx].offset);
+      retval = -1;
+      break;
+    }
+
+    if ( (rv = msr_unpack (record, records[ridx].reclen, &dmsr, 1, verbose)) != MS_NOERROR )
+    {
+      fprintf (stderr, "Error unpacking record of %s: %s\n", id->srcname, ms_errorstr (rv));
+      retval = -1;
+      break;
+    }
+
+    /* Samples of the record may continue into the following channel of a split segment */
+    for (offset = 0; offset < dmsr->numsamples && cidx < count; offset += samples)
+    {
+      channel = channels + cidx;
+
+      /* Remaining samples only continue a channel split from the same segment */
+      if ( offset > 0 && ms_dabs ((double) (channel->starttime - dmsr->starttime) -
+                                  (double) offset / channel->samprate * HPTMODULUS) > tolerance )
+        break;
+
+      if ( ! started )
+      {
+        if ( writechannelheader (sw, channel, (dmsr->fsdh->dq_flags & 0x80) ? 1 : 0) )
+        {
+          retval = -1;
+          break;
+        }
+
+        started = 1;
+      }
+
+      remaining = channel->samplecnt - written;
+      samples = dmsr->numsamples - offset;
+      if ( samples > remaining )
+        samples = remaining;
+
+      if ( writesamples (sw, dmsr, offset, samples, channel, &converted) )
+      {
+        retval = -1;
+        break;
+      }
+
+      written += samples;
+
+      if ( written == channel->samplecnt )
+      {
+        if ( sw_end (sw) )
+        {
+          retval = -1;
+          break;
+        }
+
+        cidx++;
+        written = 0;
+        started = 0;
+      }
+    }
+  }
+
+  if ( dmsr )
+    msr_free (&dmsr);
+
+  return retval;
+}  /* End of writetrace() */
+
+
+/***************************************************************************
+ * findrecord:
+ *
+ * Find the first record of a time sorted index that starts within the
+ * tolerance of the expected time with a tolerable sample rate.
+ *
+ * Returns the index of the record, or -1 if none is found
+ ***************************************************************************/
+static int64_t
+findrecord (struct record *records, int64_t recordcount, hptime_t expected,
+            hptime_t tolerance, double samprate)
+{
+  int64_t low = 0;
+  int64_t high = recordcount;
+  int64_t mid;
+
+  /* Binary search for the first record starting within the tolerance */
+  while ( low < high )
+  {
+    mid = low + (high - low) / 2;
+
+    if ( records[mid].starttime < expected - tolerance )
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  for (; low < recordcount && records[low].starttime <= expected + tolerance; low++)
+    if ( MS_ISRATETOLERABLE (records[low].samprate, samprate) )
+      return low;
+
+  return -1;
+}  /* End of findrecord() */
+
+
+/***************************************************************************
+ * writesamples:
+ *
+ * Write samples of an unpacked record as 32-bit integers in the output
+ * byte order.  Float samples are rounded and clipped and text samples
+ * are written as zeros, either is reported once per trace.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+writesamples (SeisanWriter *sw, MSRecord *msr, int64_t offset, int64_t count,
+              struct channel *channel, char *converted)
+{
+  int32_t buffer[CONVERTSAMPLES];
+  int32_t *samples;
+  double value;
+  int64_t idx;
+  int chunk;
+  int sidx;
+
+  if ( msr->sampletype != 'i' && ! *converted )
+  {
+    fprintf (stderr, "[%s] %s samples written as %s\n", channel->id->srcname,
+             ( msr->sampletype == 'a' ) ? "Text" : "Float",
+             ( msr->sampletype == 'a' ) ? "zeros" : "rounded integers");
+    *converted = 1;
+  }
+
+  for (idx = 0; idx < count; idx += chunk)
+  {
+    chunk = ( (count - idx) > CONVERTSAMPLES ) ? CONVERTSAMPLES : (int) (count - idx);
+
+    if ( msr->sampletype == 'i' && ! swapflag )
+    {
+      samples = (int32_t *) msr->datasamples + offset + idx;
+    }
+    else
+    {
+      samples = buffer;
+
+      for (sidx = 0; sidx < chunk; sidx++)
+      {
+        if ( msr->sampletype == 'i' )
+        {
+          buffer[sidx] = ((int32_t *) msr->datasamples)[offset + idx + sidx];
+        }
+        else if ( msr->sampletype == 'f' || msr->sampletype == 'd' )
+        {
+          value = ( msr->sampletype == 'f' ) ?
+            ((float *) msr->datasamples)[offset + idx + sidx] :
+            ((double *) msr->datasamples)[offset + idx + sidx];
+
+          if ( value >= 2147483647.0 )
+            buffer[sidx] = 2147483647;
+          else if ( value <= -2147483648.0 )
+            buffer[sidx] = -2147483647 - 1;
+          else
+            buffer[sidx] = (int32_t) lrint (value);
+        }
+        else
+        {
+          buffer[sidx] = 0;
+        }
+
+        if ( swapflag )
+          ms_gswap4a (&buffer[sidx]);
+      }
+    }
+
+    if ( sw_write (sw, samples, chunk * sizeof(int32_t)) )
+      return -1;
+  }
+
+  return 0;
+}  /* End of writesamples() */
+
+
+/***************************************************************************
+ * writezeros:
+ *
+ * Write zero value samples.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+writezeros (SeisanWriter *sw, int64_t count)
+{
+  int32_t buffer[CONVERTSAMPLES];
+  int64_t chunk;
+
+  memset (buffer, 0, sizeof(buffer));
+
+  for (; count > 0; count -= chunk)
+  {
+    chunk = ( count > CONVERTSAMPLES ) ? CONVERTSAMPLES : count;
+
+    if ( sw_write (sw, buffer, chunk * sizeof(int32_t)) )
+      return -1;
+  }
+
+  return 0;
+}  /* End of writezeros() */
+
+
+/***************************************************************************
+ * splittime:
+ *
+ * Split a time, rounded to milliseconds as written to SeisAn headers,
+ * into its calendar fields.
+ ***************************************************************************/
+static void
+splittime (hptime_t hptime, int *year, int *doy, int *month, int *mday,
+           int *hour, int *min, double *sec)
+{
+  BTime btime;
+  hptime_t msec = HPTMODULUS / 1000;
+
+  hptime = ( hptime >= 0 ) ? (hptime + msec / 2) / msec * msec :
+                             -((-hptime + msec / 2) / msec * msec);
+
+  ms_hptime2btime (hptime, &btime);
+  ms_doy2md (btime.year, btime.day, month, mday);
+
+  *year = btime.year;
+  *doy = btime.day;
+  *hour = btime.hour;
+  *min = btime.min;
+  *sec = btime.sec + btime.fract / 10000.0;
+}  /* End of splittime() */
+
+
+/***************************************************************************
+ * translatecomp:
+ *
+ * Translate a SEED channel and location to a SeisAn component, the
+ * reverse of the translation done by seisan2mseed:
+ *
+ * Chan  Loc      Component
+ * 'SHZ' '00'  -> 'SH Z'
+ * 'SBZ' 'I0'  -> 'SBIZ'
+ *
+ * User defined component to channel translations are searched by
+ * channel first.
+ ***************************************************************************/
+static void
+translatecomp (char *channel, char *location, char *component)
+{
+  struct listnode *clp;
+
+  /* Check user defined translations */
+  for (clp = chanlist; clp; clp = clp->next)
+  {
+    if ( ! strcmp (channel, clp->data) )
+    {
+      snprintf (component, 5, "%-4.4s", clp->key);
+      return;
+    }
+  }
+
+  snprintf (component, 5, "%-4.4s", channel);
+
+  /* The third channel character becomes the fourth component character */
+  component[3] = ( channel[0] && channel[1] && channel[2] ) ? channel[2] : ' ';
+  component[2] = ' ';
+
+  /* The first location character, unless the default, becomes the third */
+  if ( location[0] && location[0] != '0' && location[0] != ' ' )
+    component[2] = location[0];
+}  /* End of translatecomp() */
+
+
+/***************************************************************************
+ * mkoutputname:
+ *
+ * Build the output file name for a Mini-SEED file.  If the name is a
+ * "standard" SeisAn name as written by seisan2mseed the M is changed
+ * to an S, otherwise _SEISAN is added to the end.
+ ***************************************************************************/
+static void
+mkoutputname (char *outputname, size_t size, char *msfile)
+{
+  char *basename;
+
+  basename = strrchr (msfile, '/');
+  basename = ( basename ) ? basename + 1 : msfile;
+
+  if ( strlen (basename) > 19 &&
+       basename[4] == '-' && basename[7] == '-' && basename[10] == '-' &&
+       basename[15] == '-' && basename[18] == 'M' && basename[19] == '.' )
+  {
+    snprintf (outputname, size, "%s", msfile);
+    outputname[(basename - msfile) + 18] = 'S';
+  }
+  else
+  {
+    snprintf (outputname, size, "%s_SEISAN", msfile);
+  }
+}  /* End of mkoutputname() */
+
+
+/***************************************************************************
+ * parameter_proc:
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure.
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strcmp (argvec[optind], "-F") == 0)
+    {
+      framing = atoi (getoptval(argcount, argvec, optind++));
+    }
+    else if (strcmp (argvec[optind], "-b") == 0)
+    {
+      byteorder = atoi (getoptval(argcount, argvec, optind++));
+    }
+    else if (strcmp (argvec[optind], "-o") == 0)
+    {
+      outputfile = getoptval(argcount, argvec, optind++);
+    }
+    else if (strcmp (argvec[optind], "-T") == 0)
+    {
+      addmapnode (&chanlist, getoptval(argcount, argvec, optind++));
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0 &&
+             strlen (argvec[optind]) > 1 )
+    {
+      fprintf(stderr, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else
+    {
+      addnode (&filelist, NULL, argvec[optind]);
+    }
+  }
+
+  if ( framing != SEISAN_FRAME1 && framing != SEISAN_FRAME4 )
+  {
+    fprintf (stderr, "Unsupported record framing: %d\n", framing);
+    exit (1);
+  }
+
+  if ( framing == SEISAN_FRAME1 && byteorder == 1 )
+  {
+    fprintf (stderr, "Files with 1 byte record lengths are always little-endian\n");
+    exit (1);
+  }
+
+  /* Make sure an input files were specified */
+  if ( filelist == 0 )
+  {
+    fprintf (stderr, "No input files were specified\n\n");
+    fprintf (stderr, "%s version %s\n\n", PACKAGE, VERSION);
+    fprintf (stderr, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  /* Each input file is written to its own SeisAn file */
+  if ( outputfile && filelist->next )
+  {
+    fprintf (stderr, "An output file can only be specified for a single input file\n");
+    exit (1);
+  }
+
+  /* Report the program version */
+  if ( verbose )
+    fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
+
+  return 0;
+}  /* End of parameter_proc() */
+
+
+/***************************************************************************
+ * getoptval:
+ * Return the value to a command line option; checking that the value is
+ * itself not an option (starting with '-') and is not past the end of
+ * the argument list.
+ *
+ * argcount: total arguments in argvec
+ * argvec: argument list
+ * argopt: index of option to process, value is expected to be at argopt+1
+ *
+ * Returns value on success and exits with error message on failure
+ ***************************************************************************/
+static char *
+getoptval (int argcount, char **argvec, int argopt)
+{
+  if ( argvec == NULL || argvec[argopt] == NULL ) {
+    fprintf (stderr, "getoptval(): NULL option requested\n");
+    exit (1);
+    return 0;
+  }
+
+  /* Special case of '-o -' usage */
+  if ( (argopt+1) < argcount && strcmp (argvec[argopt], "-o") == 0 )
+    if ( strcmp (argvec[argopt+1], "-") == 0 )
+      return argvec[argopt+1];
+
+  if ( (argopt+1) < argcount && *argvec[argopt+1] != '-' )
+    return argvec[argopt+1];
+
+  fprintf (stderr, "Option %s requires a value\n", argvec[argopt]);
+  exit (1);
+  return 0;
+}  /* End of getoptval() */
+
+
+/***************************************************************************
+ * addnode:
+ *
+ * Add node to the specified list.
+ ***************************************************************************/
+static void
+addnode (struct listnode **listroot, char *key, char *data)
+{
+  struct listnode *lastlp, *newlp;
+
+  if ( data == NULL )
+  {
+    fprintf (stderr, "addnode(): No file name specified\n");
+    return;
+  }
+
+  lastlp = *listroot;
+  while ( lastlp != 0 )
+  {
+    if ( lastlp->next == 0 )
+      break;
+
+    lastlp = lastlp->next;
+  }
+
+  newlp = (struct listnode *) malloc (sizeof (struct listnode));
+  memset (newlp, 0, sizeof (struct listnode));
+  if ( key ) newlp->key = strdup(key);
+  else newlp->key = key;
+  if ( data) newlp->data = strdup(data);
+  else newlp->data = data;
+  newlp->next = 0;
+
+  if ( lastlp == 0 )
+    *listroot = newlp;
+  else
+    lastlp->next = newlp;
+
+}  /* End of addnode() */
+
+
+/***************************************************************************
+ * addmapnode:
+ *
+ * Add a node to a list deriving the key and data from the supplied
+ * mapping string: 'key=data'.
+ ***************************************************************************/
+static void
+addmapnode (struct listnode **listroot, char *mapping)
+{
+  char *key;
+  char *data;
+
+  key = mapping;
+  data = strchr (mapping, '=');
+
+  if ( ! data )
+  {
+    fprintf (stderr, "addmapmnode(): Cannot find '=' in mapping '%s'\n", mapping);
+    return;
+  }
+
+  *data++ = '\0';
+
+  /* Add to specified list */
+  addnode (listroot, key, data);
+
+}  /* End of addmapnode() */
+
+
+/***************************************************************************
+ * usage:
+ * Print the usage message and exit.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Convert Mini-SEED waveform data to SeisAn.\n\n");
+  fprintf (stderr, "Usage: %s [options] file1 [file2 file3 ...]\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           " -F framing     Specify record framing, default: 4\n"
+           "                  4: Sun/Linux and PC >= 7.0, 1: PC <= 6.0 (little-endian)\n"
+           " -b byteorder   Specify byte order for output, MSBF: 1, LSBF: 0, default: host\n"
+           " -o outfile     Specify the output file for a single input file,\n"
+           "                  default is <inputfile>_SEISAN\n"
+           "\n"
+           " -T comp=chan   Specify component-channel mapping, can be used many times\n"
+           "                  e.g.: \"-T SBIZ=SHZ -T SBIN=SHN -T SBIE=SHE\"\n"
+           "                  spaces must be quoted: \"-T 'S  Z'=SLZ\"\n"
+           "\n"
+           " file(s)        File(s) of Mini-SEED input data\n"
+           "                  Each file is written to a SeisAn file, if the name\n"
+           "                  is a standard SeisAn name with an 'M' as written\n"
+           "                  by seisan2mseed the 'M' is replaced with an 'S'\n"
+           "\n");
+}  /* End of usage() */
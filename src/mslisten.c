@@ -0,0 +1,280 @@
+/***************************************************************************
+ * mslisten.c
+ *
+ * A minimal stream socket listener standing in for a real-time system
+ * that receives Mini-SEED records, used to test socket output.
+ *
+ * A single connection is accepted on a Unix domain or TCP socket and
+ * all data received is written to a file.  Reads can be limited in
+ * size and delayed to simulate a slow receiver, waiting for the
+ * connection can be limited in time so that a sender that fails to
+ * connect does not leave the listener waiting.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+#define VERSION "2.0"
+#define PACKAGE "mslisten"
+
+static int  openlistener (char *address);
+static void usage (void);
+
+static int   readsize = 65536;
+static int   delayms  = 0;
+static int   timeout  = 0;
+static char *address  = 0;
+static char *outfile  = 0;
+
+int
+main (int argc, char **argv)
+{
+  struct timespec delay;
+  struct pollfd pfd;
+  FILE *ofp;
+  char *buffer;
+  long long int received = 0;
+  ssize_t count;
+  int listenfd;
+  int fd;
+  int idx;
+  int rv;
+
+  for (idx = 1; idx < argc; idx++)
+  {
+    if ( strcmp (argv[idx], "-h") == 0 )
+    {
+      usage ();
+      return 0;
+    }
+    else if ( strcmp (argv[idx], "-b") == 0 && idx + 1 < argc )
+    {
+      readsize = atoi (argv[++idx]);
+    }
+    else if ( strcmp (argv[idx], "-d") == 0 && idx + 1 < argc )
+    {
+      delayms = atoi (argv[++idx]);
+    }
+    else if ( strcmp (argv[idx], "-t") == 0 && idx + 1 < argc )
+    {
+      timeout = atoi (argv[++idx]);
+    }
+    else if ( ! address )
+    {
+      address = argv[idx];
+    }
+    else if ( ! outfile )
+    {
+      outfile = argv[idx];
+    }
+    else
+    {
+      fprintf (stderr, "Unknown option: %s\n", argv[idx]);
+      return 1;
+    }
+  }
+
+  if ( ! address || ! outfile || readsize <= 0 )
+  {
+    usage ();
+    return 1;
+  }
+
+  if ( (buffer = (char *) malloc (readsize)) == NULL )
+  {
+    fprintf (stderr, "Error allocating memory for read buffer\n");
+    return 1;
+  }
+
+  if ( strcmp (outfile, "-") == 0 )
+    ofp = stdout;
+  else if ( (ofp = fopen (outfile, "wb")) == NULL )
+  {
+    fprintf (stderr, "Cannot open output file: %s (%s)\n", outfile, strerror(errno));
+    return 1;
+  }
+
+  if ( (listenfd = openlistener (address)) < 0 )
+    return 1;
+
+  /* Wait for a connection for a limited time if requested */
+  if ( timeout > 0 )
+  {
+    pfd.fd = listenfd;
+    pfd.events = POLLIN;
+
+    while ( (rv = poll (&pfd, 1, timeout * 1000)) < 0 && errno == EINTR )
+      ;
+
+    if ( rv <= 0 )
+    {
+      fprintf (stderr, "No connection accepted within %d seconds\n", timeout);
+      return 1;
+    }
+  }
+
+  if ( (fd = accept (listenfd, NULL, NULL)) < 0 )
+  {
+    fprintf (stderr, "Error accepting connection: %s\n", strerror(errno));
+    return 1;
+  }
+
+  delay.tv_sec = delayms / 1000;
+  delay.tv_nsec = (delayms % 1000) * 1000000L;
+
+  /* Read until the sender closes the connection */
+  while ( (count = read (fd, buffer, readsize)) != 0 )
+  {
+    if ( count < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+
+      fprintf (stderr, "Error reading from connection: %s\n", strerror(errno));
+      break;
+    }
+
+    if ( fwrite (buffer, count, 1, ofp) != 1 )
+    {
+      fprintf (stderr, "Error writing to output file: %s\n", strerror(errno));
+      break;
+    }
+
+    received += count;
+
+    if ( delayms > 0 )
+      nanosleep (&delay, NULL);
+  }
+
+  close (fd);
+  close (listenfd);
+
+  if ( strncmp (address, "unix:", 5) == 0 )
+    unlink (address + 5);
+
+  if ( ofp != stdout )
+    fclose (ofp);
+
+  free (buffer);
+
+  fprintf (stderr, "Received %lld bytes\n", received);
+
+  return 0;
+}  /* End of main() */
+
+
+/***************************************************************************
+ * openlistener:
+ *
+ * Open a listening stream socket for "unix:<path>" or
+ * "tcp:<host>:<port>", an existing Unix domain socket file is
+ * replaced.
+ *
+ * Returns a socket descriptor on success and -1 on failure.
+ ***************************************************************************/
+static int
+openlistener (char *address)
+{
+  struct sockaddr_un unaddr;
+  struct addrinfo hints;
+  struct addrinfo *addrs;
+  char host[256];
+  char *port;
+  int on = 1;
+  int fd;
+
+  if ( strncmp (address, "unix:", 5) == 0 )
+  {
+    memset (&unaddr, 0, sizeof(unaddr));
+    unaddr.sun_family = AF_UNIX;
+
+    if ( strlen (address + 5) >= sizeof(unaddr.sun_path) )
+    {
+      fprintf (stderr, "Socket path too long: %s\n", address + 5);
+      return -1;
+    }
+
+    strcpy (unaddr.sun_path, address + 5);
+    unlink (unaddr.sun_path);
+
+    if ( (fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+         bind (fd, (struct sockaddr *) &unaddr, sizeof(unaddr)) ||
+         listen (fd, 1) )
+    {
+      fprintf (stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+      return -1;
+    }
+
+    return fd;
+  }
+
+  if ( strncmp (address, "tcp:", 4) != 0 ||
+       ! (port = strrchr (address + 4, ':')) ||
+       (size_t) (port - (address + 4)) >= sizeof(host) )
+  {
+    fprintf (stderr, "Unrecognized address: %s\n", address);
+    return -1;
+  }
+
+  memcpy (host, address + 4, port - (address + 4));
+  host[port - (address + 4)] = '\0';
+  port++;
+
+  memset (&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  if ( getaddrinfo ((*host) ? host : NULL, port, &hints, &addrs) )
+  {
+    fprintf (stderr, "Cannot resolve address: %s\n", address);
+    return -1;
+  }
+
+  if ( (fd = socket (addrs->ai_family, addrs->ai_socktype, addrs->ai_protocol)) < 0 ||
+       setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) ||
+       bind (fd, addrs->ai_addr, addrs->ai_addrlen) ||
+       listen (fd, 1) )
+  {
+    fprintf (stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+    freeaddrinfo (addrs);
+    return -1;
+  }
+
+  freeaddrinfo (addrs);
+
+  return fd;
+}  /* End of openlistener() */
+
+
+/***************************************************************************
+ * usage:
+ * Print the usage message and exit.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Accept a single connection and write all received data to a file.\n\n");
+  fprintf (stderr, "Usage: %s [options] address outfile\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -h             Show this usage message\n"
+           " -b bytes       Maximum size of each read, default: 65536\n"
+           " -d msec        Delay after each read to simulate a slow receiver\n"
+           " -t sec         Exit if no connection is accepted within sec seconds\n"
+           "\n"
+           " address        Address to listen on, unix:<path> or tcp:<host>:<port>\n"
+           " outfile        File for received data, '-' for stdout\n"
+           "\n");
+}  /* End of usage() */
@@ -0,0 +1,265 @@
+/***************************************************************************
+ * pipeline.c
+ *
+ * A simple staged processing pipeline.  Each stage runs in its own
+ * thread and stages are connected with bounded single-producer,
+ * single-consumer queues, a full queue blocks the producing stage.
+ *
+ * Without thread support items are passed directly to the process()
+ * routine of the next stage, the processing order is identical.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+
+#if defined(PIPE_THREADS)
+static int   pq_init (PipeQueue *pq, int size);
+static void  pq_free (PipeQueue *pq);
+static void  pq_push (PipeQueue *pq, void *item);
+static void *pq_pop (PipeQueue *pq);
+static void *stagethread (void *arg);
+#endif
+
+
+/***************************************************************************
+ * pipe_start:
+ *
+ * Link the stages in the specified order and start a thread for each
+ * stage, each with an input queue of queuedepth items.  A stage that
+ * cannot be started is processed in the thread of the sending stage.
+ *
+ * Returns 0 on success and -1 on failure.
+ ***************************************************************************/
+int
+pipe_start (PipeStage *stages, int stagecount, int queuedepth)
+{
+  int idx;
+
+  if ( ! stages || stagecount <= 0 )
+    return -1;
+
+  for (idx = 0; idx < stagecount; idx++)
+    stages[idx].next = ( idx < (stagecount - 1) ) ? &stages[idx+1] : NULL;
+
+#if defined(PIPE_THREADS)
+  /* Start threads from the last stage to the first so that each stage
+   * is running before any items can be sent to it.  If a thread cannot
+   * be created the stage is run in the thread of the previous stage. */
+  for (idx = stagecount - 1; idx >= 0; idx--)
+  {
+    if ( pq_init (&stages[idx].queue, queuedepth) )
+    {
+      fprintf (stderr, "pipe_start(): Cannot allocate queue for %s stage\n",
+               stages[idx].name);
+      continue;
+    }
+
+    stages[idx].running = 1;
+
+    if ( pthread_create (&stages[idx].thread, NULL, stagethread, &stages[idx]) )
+    {
+      fprintf (stderr, "pipe_start(): Cannot create thread for %s stage\n",
+               stages[idx].name);
+      stages[idx].running = 0;
+      pq_free (&stages[idx].queue);
+    }
+  }
+#endif
+
+  return 0;
+}  /* End of pipe_start() */
+
+
+/***************************************************************************
+ * pipe_send:
+ *
+ * Send an item to a stage.  If the stage runs in a thread the item is
+ * added to the stage input queue, blocking while the queue is full.
+ * Otherwise the item is processed immediately.
+ *
+ * A NULL item marks the end of the stream, it is passed down the
+ * pipeline after being processed by each stage.
+ ***************************************************************************/
+void
+pipe_send (PipeStage *stage, void *item)
+{
+  if ( ! stage )
+    return;
+
+#if defined(PIPE_THREADS)
+  if ( stage->running )
+  {
+    pq_push (&stage->queue, item);
+    return;
+  }
+#endif
+
+  stage->process (stage, item);
+
+  if ( ! item )
+    pipe_send (stage->next, NULL);
+}  /* End of pipe_send() */
+
+
+/***************************************************************************
+ * pipe_finish:
+ *
+ * Send the end of stream marker to the first stage and wait for all
+ * stages to finish processing, releasing associated resources.
+ ***************************************************************************/
+void
+pipe_finish (PipeStage *stages, int stagecount)
+{
+#if defined(PIPE_THREADS)
+  int idx;
+#endif
+
+  if ( ! stages || stagecount <= 0 )
+    return;
+
+  pipe_send (&stages[0], NULL);
+
+#if defined(PIPE_THREADS)
+  for (idx = 0; idx < stagecount; idx++)
+  {
+    if ( stages[idx].running )
+    {
+      pthread_join (stages[idx].thread, NULL);
+      stages[idx].running = 0;
+    }
+
+    pq_free (&stages[idx].queue);
+  }
+#endif
+}  /* End of pipe_finish() */
+
+
+#if defined(PIPE_THREADS)
+/***************************************************************************
+ * stagethread:
+ *
+ * Thread routine for a stage, process items from the input queue until
+ * the end of stream marker is received and pass it on.
+ ***************************************************************************/
+static void *
+stagethread (void *arg)
+{
+  PipeStage *stage = (PipeStage *) arg;
+  void *item;
+
+  for (;;)
+  {
+    item = pq_pop (&stage->queue);
+
+    stage->process (stage, item);
+
+    if ( ! item )
+      break;
+  }
+
+  pipe_send (stage->next, NULL);
+
+  return NULL;
+}  /* End of stagethread() */
+
+
+/***************************************************************************
+ * pq_init:
+ *
+ * Initialize a queue with capacity for size items.
+ *
+ * Returns 0 on success and -1 on failure.
+ ***************************************************************************/
+static int
+pq_init (PipeQueue *pq, int size)
+{
+  memset (pq, 0, sizeof(PipeQueue));
+
+  if ( size <= 0 )
+    size = 1;
+
+  if ( (pq->items = (void **) malloc (sizeof(void *) * size)) == NULL )
+    return -1;
+
+  pq->size = size;
+
+  pthread_mutex_init (&pq->lock, NULL);
+  pthread_cond_init (&pq->notempty, NULL);
+  pthread_cond_init (&pq->notfull, NULL);
+
+  return 0;
+}  /* End of pq_init() */
+
+
+/***************************************************************************
+ * pq_free:
+ *
+ * Release resources associated with a queue.
+ ***************************************************************************/
+static void
+pq_free (PipeQueue *pq)
+{
+  if ( ! pq->items )
+    return;
+
+  free (pq->items);
+  pq->items = NULL;
+
+  pthread_mutex_destroy (&pq->lock);
+  pthread_cond_destroy (&pq->notempty);
+  pthread_cond_destroy (&pq->notfull);
+}  /* End of pq_free() */
+
+
+/***************************************************************************
+ * pq_push:
+ *
+ * Add an item to the tail of a queue, waiting while the queue is full.
+ ***************************************************************************/
+static void
+pq_push (PipeQueue *pq, void *item)
+{
+  pthread_mutex_lock (&pq->lock);
+
+  while ( pq->count >= pq->size )
+    pthread_cond_wait (&pq->notfull, &pq->lock);
+
+  pq->items[(pq->head + pq->count) % pq->size] = item;
+  pq->count++;
+
+  pthread_cond_signal (&pq->notempty);
+  pthread_mutex_unlock (&pq->lock);
+}  /* End of pq_push() */
+
+
+/***************************************************************************
+ * pq_pop:
+ *
+ * Remove and return the item at the head of a queue, waiting while the
+ * queue is empty.
+ ***************************************************************************/
+static void *
+pq_pop (PipeQueue *pq)
+{
+  void *item;
+
+  pthread_mutex_lock (&pq->lock);
+
+  while ( pq->count <= 0 )
+    pthread_cond_wait (&pq->notempty, &pq->lock);
+
+  item = pq->items[pq->head];
+  pq->head = (pq->head + 1) % pq->size;
+  pq->count--;
+
+  pthread_cond_signal (&pq->notfull);
+  pthread_mutex_unlock (&pq->lock);
+
+  return item;
+}  /* End of pq_pop() */
+#endif /* PIPE_THREADS */
@@ -0,0 +1,54 @@
+/***************************************************************************
+ * pipeline.h
+ *
+ * Interface declarations for a simple staged processing pipeline.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H 1
+
+#include <libmseed.h>
+
+/* Thread support is available on all Unix-like platforms, when not
+ * available (or disabled with -DPIPE_NOTHREADS) items are passed
+ * directly to the next stage in the calling thread. */
+#if !defined(LMP_WIN) && !defined(PIPE_NOTHREADS)
+  #define PIPE_THREADS 1
+  #include <pthread.h>
+#endif
+
+/* Bounded single-producer, single-consumer queue of item pointers */
+typedef struct PipeQueue_s {
+  void  **items;              /* Ring buffer of queued items */
+  int     size;               /* Capacity of ring buffer */
+  int     head;               /* Index of next item to pop */
+  int     count;              /* Number of items queued */
+#if defined(PIPE_THREADS)
+  pthread_mutex_t lock;
+  pthread_cond_t  notempty;
+  pthread_cond_t  notfull;
+#endif
+} PipeQueue;
+
+/* A pipeline stage, stages are linked in processing order.  The
+ * process() routine is called for every item sent to the stage and
+ * with a NULL item at the end of the stream. */
+typedef struct PipeStage_s {
+  const char *name;           /* Stage name for diagnostics */
+  void  (*process) (struct PipeStage_s *stage, void *item);
+  void   *data;               /* Private data for the stage */
+  struct PipeStage_s *next;   /* Next stage in the pipeline */
+  PipeQueue queue;            /* Input queue for the stage */
+#if defined(PIPE_THREADS)
+  pthread_t thread;
+  int       running;
+#endif
+} PipeStage;
+
+extern int  pipe_start (PipeStage *stages, int stagecount, int queuedepth);
+extern void pipe_send (PipeStage *stage, void *item);
+extern void pipe_finish (PipeStage *stages, int stagecount);
+
+#endif /* PIPELINE_H */
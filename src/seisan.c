@@ -0,0 +1,294 @@
+/***************************************************************************
+ * seisan.c
+ *
+ * Writing of SeisAn Fortran record framing.
+ *
+ * Records are written in either framing: with 4 byte lengths in the
+ * requested byte order, or with 1 byte lengths where records longer
+ * than SEISAN_MAXFRAME1 bytes are split into consecutive records, as
+ * read back by the channel assembly of seisan2mseed.  The contents of
+ * a record may be written in pieces, so a data section can be
+ * streamed without holding all of it in memory.
+ *
+ * Output is collected in a buffer that is passed to out_write() when
+ * full.
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "seisan.h"
+
+/* Size of the output buffers passed to out_write() */
+#define SW_BUFSIZE 65536
+
+static int sw_put (SeisanWriter *sw, const void *data, size_t length);
+static int sw_flush (SeisanWriter *sw);
+
+
+/***************************************************************************
+ * sw_open:
+ *
+ * Initialize a writer for an output file with the specified framing.
+ * With 1 byte record lengths the signature byte is written, the byte
+ * order of such files is always little-endian.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+sw_open (SeisanWriter *sw, OutputFile *ofp, int framing, flag swapflag)
+{
+  char signature = SEISAN_SIGNATURE;
+
+  if ( ! sw || ! ofp || (framing != SEISAN_FRAME1 && framing != SEISAN_FRAME4) )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset (sw, 0, sizeof(SeisanWriter));
+  sw->ofp = ofp;
+  sw->framing = framing;
+  sw->swapflag = swapflag;
+
+  if ( framing == SEISAN_FRAME1 )
+    return sw_put (sw, &signature, 1);
+
+  return 0;
+}  /* End of sw_open() */
+
+
+/***************************************************************************
+ * sw_begin:
+ *
+ * Start a record of the specified length, the contents must be
+ * written with sw_write() before the record is ended with sw_end().
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+sw_begin (SeisanWriter *sw, uint32_t length)
+{
+  uint32_t reclen = length;
+  uint8_t empty[2] = { 0, 0 };
+
+  if ( sw->recleft )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  sw->reclen = length;
+  sw->recleft = length;
+  sw->frameleft = 0;
+
+  if ( sw->framing == SEISAN_FRAME4 )
+  {
+    if ( sw->swapflag )
+      ms_gswap4 (&reclen);
+
+    return sw_put (sw, &reclen, 4);
+  }
+
+  /* An empty record is complete */
+  if ( length == 0 )
+    return sw_put (sw, empty, 2);
+
+  return 0;
+}  /* End of sw_begin() */
+
+
+/***************************************************************************
+ * sw_write:
+ *
+ * Write contents of the current record, at most the remaining length
+ * of the record.  With 1 byte record lengths the contents are split
+ * into records of at most SEISAN_MAXFRAME1 bytes.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+sw_write (SeisanWriter *sw, const void *data, size_t length)
+{
+  const char *ptr = (const char *) data;
+  size_t count;
+
+  if ( length > sw->recleft )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ( sw->framing == SEISAN_FRAME4 )
+  {
+    sw->recleft -= length;
+    return sw_put (sw, data, length);
+  }
+
+  while ( length > 0 )
+  {
+    /* Start the next record of the split contents */
+    if ( sw->frameleft == 0 )
+    {
+      sw->framelen = ( sw->recleft > SEISAN_MAXFRAME1 ) ? SEISAN_MAXFRAME1 : sw->recleft;
+      sw->frameleft = sw->framelen;
+
+      if ( sw_put (sw, &sw->framelen, 1) )
+        return -1;
+    }
+
+    count = ( length < sw->frameleft ) ? length : sw->frameleft;
+
+    if ( sw_put (sw, ptr, count) )
+      return -1;
+
+    ptr += count;
+    length -= count;
+    sw->recleft -= count;
+    sw->frameleft -= count;
+
+    /* End the record with the mirrored length */
+    if ( sw->frameleft == 0 && sw_put (sw, &sw->framelen, 1) )
+      return -1;
+  }
+
+  return 0;
+}  /* End of sw_write() */
+
+
+/***************************************************************************
+ * sw_end:
+ *
+ * End the current record, all of its contents must have been written.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+sw_end (SeisanWriter *sw)
+{
+  uint32_t reclen = sw->reclen;
+
+  if ( sw->recleft )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ( sw->framing == SEISAN_FRAME4 )
+  {
+    if ( sw->swapflag )
+      ms_gswap4 (&reclen);
+
+    return sw_put (sw, &reclen, 4);
+  }
+
+  return 0;
+}  /* End of sw_end() */
+
+
+/***************************************************************************
+ * sw_record:
+ *
+ * Write a complete record.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+sw_record (SeisanWriter *sw, const void *data, uint32_t length)
+{
+  if ( sw_begin (sw, length) || sw_write (sw, data, length) || sw_end (sw) )
+    return -1;
+
+  return 0;
+}  /* End of sw_record() */
+
+
+/***************************************************************************
+ * sw_close:
+ *
+ * Write any buffered output and release the buffer, the output file
+ * is not closed.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+int
+sw_close (SeisanWriter *sw)
+{
+  int retval = 0;
+
+  if ( sw->recleft )
+  {
+    errno = EINVAL;
+    retval = -1;
+  }
+
+  if ( sw->buflen > 0 && sw_flush (sw) )
+    retval = -1;
+
+  if ( sw->buffer )
+    free (sw->buffer);
+
+  sw->buffer = 0;
+  sw->buflen = 0;
+
+  return retval;
+}  /* End of sw_close() */
+
+
+/***************************************************************************
+ * sw_put:
+ *
+ * Add bytes to the output buffer, passing full buffers to out_write().
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+sw_put (SeisanWriter *sw, const void *data, size_t length)
+{
+  const char *ptr = (const char *) data;
+  size_t count;
+
+  while ( length > 0 )
+  {
+    if ( ! sw->buffer && ! (sw->buffer = (char *) malloc (SW_BUFSIZE)) )
+      return -1;
+
+    count = SW_BUFSIZE - sw->buflen;
+    if ( count > length )
+      count = length;
+
+    memcpy (sw->buffer + sw->buflen, ptr, count);
+    sw->buflen += count;
+    ptr += count;
+    length -= count;
+
+    if ( sw->buflen == SW_BUFSIZE && sw_flush (sw) )
+      return -1;
+  }
+
+  return 0;
+}  /* End of sw_put() */
+
+
+/***************************************************************************
+ * sw_flush:
+ *
+ * Pass the output buffer to out_write(), which takes ownership of it.
+ *
+ * Returns 0 on success and -1 on failure with errno set.
+ ***************************************************************************/
+static int
+sw_flush (SeisanWriter *sw)
+{
+  char *buffer = sw->buffer;
+  size_t length = sw->buflen;
+
+  sw->buffer = 0;
+  sw->buflen = 0;
+
+  return out_write (sw->ofp, buffer, length);
+}  /* End of sw_flush() */
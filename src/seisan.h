@@ -0,0 +1,80 @@
+/***************************************************************************
+ * seisan.h
+ *
+ * Layout of SeisAn waveform files and interface declarations for
+ * writing their Fortran record framing.
+ *
+ * A SeisAn file is a sequence of Fortran unformatted records: an
+ * event header of 80 character lines followed by a 1040 byte header
+ * and a data section for each channel.  Records are framed either by
+ * 4 byte lengths before and after the record (Sun/Linux and PC >= 7.0)
+ * or, following a 'K' signature byte, by 1 byte lengths (PC <= 6.0).
+ *
+ * modified 2026.291
+ ***************************************************************************/
+
+#ifndef SEISAN_H
+#define SEISAN_H 1
+
+#include "fileio.h"
+
+/* Record framing, the size of the record lengths in bytes */
+#define SEISAN_FRAME1 1       /* PC SeisAn <= 6.0, always little-endian */
+#define SEISAN_FRAME4 4       /* Sun/Linux and PC SeisAn >= 7.0 */
+
+/* Signature byte starting a file with 1 byte record lengths */
+#define SEISAN_SIGNATURE 'K'
+
+/* Maximum length of a record with 1 byte record lengths, longer
+ * records are written as consecutive records */
+#define SEISAN_MAXFRAME1 128
+
+/* Length of event header lines and channel headers */
+#define SEISAN_LINELEN   80
+#define SEISAN_CHEADERLEN 1040
+
+/* Minimum number of event header lines listing channels, 3 per line */
+#define SEISAN_MINCHANLINES 10
+
+/* Maximum number of channels and samples per channel */
+#define SEISAN_MAXCHANNELS 999
+#define SEISAN_MAXSAMPLES  9999999
+
+/* Channel header field offsets (columns - 1) and lengths */
+#define CH_STATION     0      /* Station code, 5 */
+#define CH_COMPONENT   5      /* Component, 4 */
+#define CH_YEAR        9      /* Year - 1900, 3 */
+#define CH_DOY        13      /* Day of year, 3 */
+#define CH_MONTH      17      /* Month, 2 */
+#define CH_DAY        20      /* Day of month, 2 */
+#define CH_HOUR       23      /* Hour, 2 */
+#define CH_MINUTE     26      /* Minute, 2 */
+#define CH_TIMEFLAG   28      /* 'E' if the time is uncertain */
+#define CH_SECOND     29      /* Second, 6 */
+#define CH_RATE       36      /* Sample rate, 7 */
+#define CH_SAMPLES    43      /* Number of samples, 7 */
+#define CH_GAINFLAG   75      /* 'G' if a gain factor is given */
+#define CH_SAMPLESIZE 76      /* '4' for 4 byte samples, otherwise 2 */
+#define CH_GAIN      147      /* Gain factor, 12 */
+
+/* Writer of Fortran records to an output file */
+typedef struct SeisanWriter_s {
+  OutputFile *ofp;            /* Output file */
+  int       framing;          /* Record framing, SEISAN_FRAME* */
+  flag      swapflag;         /* Byte swapping needed for output */
+  char     *buffer;           /* Output buffer, passed to out_write() when full */
+  size_t    buflen;           /* Length of content in output buffer */
+  uint32_t  reclen;           /* Length of the current record */
+  uint32_t  recleft;          /* Bytes remaining in the current record */
+  uint8_t   framelen;         /* Length of the current 1 byte framed record */
+  uint8_t   frameleft;        /* Bytes remaining in the current 1 byte framed record */
+} SeisanWriter;
+
+extern int  sw_open (SeisanWriter *sw, OutputFile *ofp, int framing, flag swapflag);
+extern int  sw_begin (SeisanWriter *sw, uint32_t length);
+extern int  sw_write (SeisanWriter *sw, const void *data, size_t length);
+extern int  sw_end (SeisanWriter *sw);
+extern int  sw_record (SeisanWriter *sw, const void *data, uint32_t length);
+extern int  sw_close (SeisanWriter *sw);
+
+#endif /* SEISAN_H */
@@ -5,7 +5,7 @@
  *
  * Written by Chad Trabant, IRIS Data Management Center
  *
- * modified 2017.271
+ * modified 2026.291
  ***************************************************************************/
 
 #include <stdio.h>
@@ -13,11 +13,15 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
-#include <sys/stat.h>
 
 #include <libmseed.h>
 
-#define VERSION "1.8"
+#include "fileio.h"
+#include "logqueue.h"
+#include "pipeline.h"
+#include "seisan.h"
+
+#define VERSION "2.0"
 #define PACKAGE "seisan2mseed"
 
 struct listnode {
@@ -26,22 +30,97 @@ struct listnode {
   struct listnode *next;
 };
 
-static void packtraces (flag flush);
-static int seisan2group (char *seisanfile, MSTraceGroup *mstg);
-static int detectformat (FILE *ifp, flag *formatflag, flag *swapflag, char *seisanfile);
+/* Work item types passed between pipeline stages */
+#define WI_FILEBEGIN  1   /* Start of an input file, output file selected */
+#define WI_FRAMES     2   /* A batch of Fortran records from the input file */
+#define WI_CHANNEL    3   /* A channel header and data section */
+#define WI_RECORDS    4   /* A batch of packed Mini-SEED records */
+#define WI_FILEEND    5   /* End of an input file */
+
+/* A work item, the receiving stage owns the item and buffers */
+struct workitem {
+  int       type;             /* Work item type, WI_* */
+  char     *seisanfile;       /* Input file name */
+  OutputFile *ofp;            /* Output file for WI_FILEBEGIN */
+  flag      swapflag;         /* Byte swapping needed for input samples */
+  int      *framelens;        /* Lengths of the Fortran records of WI_FRAMES */
+  int       framecount;       /* Number of Fortran records of WI_FRAMES */
+  int       framemax;         /* Allocated entries of framelens */
+  char      repaired;         /* Last record length was repaired at end of file */
+  char     *data;             /* Records, data section or packed records buffer */
+  int       datalen;          /* Length of content in data buffer */
+  int       datasize;         /* Allocated size of data buffer */
+  MSRecord *msr;              /* Channel header values and samples */
+  char      uctimeflag;       /* Channel time is uncertain */
+  int       datasamplesize;   /* Channel sample size in bytes */
+  double    gain;             /* Channel gain factor to apply, 0 if none */
+};
+
+/* Channel assembly state, reset for each input file */
+struct assemblystate {
+  char     *seisanfile;
+  flag      swapflag;
+  char      skipfile;
+  char      expectheader;
+  char      cheader[SEISAN_CHEADERLEN];
+  int       cheaderlen;
+  char      expectdata;
+  struct workitem *channel;
+  int       expectdatalen;
+};
+
+/* Channel conversion state, reset for each input file */
+struct conversionstate {
+  char      skipfile;
+};
+
+/* Output state, the output file of the current input file */
+struct outputstate {
+  OutputFile *fileofp;
+};
+
+/* Fortran records are sent to the assembly stage in batches of up to
+ * this many bytes, a longer record is sent alone */
+#define FRAMEBATCH 65536
+
+static void framestage (PipeStage *stage, void *item);
+static void assemblystage (PipeStage *stage, void *item);
+static void assembleframe (PipeStage *stage, struct assemblystate *as,
+                           struct workitem *wi, int offset, unsigned int reclen,
+                           char repaired);
+static void conversionstage (PipeStage *stage, void *item);
+static void encodingstage (PipeStage *stage, void *item);
+static void outputstage (PipeStage *stage, void *item);
+static struct workitem *newitem (int type, char *seisanfile);
+static void freeitem (struct workitem *wi);
+static int parseheader (struct assemblystate *as, struct workitem *channel);
+static void packtraces (flag flush, struct workitem *batch);
+static MSRecord *mktemplate (MSRecord *template, struct workitem *wi);
+static void packchannel (struct workitem *wi, struct workitem *batch);
+static int seisan2group (char *seisanfile, char *nextfile, PipeStage *stage);
+static int readframes (InputFile *ifp, char *seisanfile, char *outputname, PipeStage *stage);
+static void mkoutputname (char *outputname, size_t size, char *seisanfile,
+                          char *membername, int compression);
+static int detectformat (InputFile *ifp, flag *formatflag, flag *swapflag, char *seisanfile);
 static int32_t *mkhostdata (char *data, int datalen, int datasamplesize, flag swapflag);
+static void *mkfloatdata (char *data, int datalen, int datasamplesize, flag swapflag,
+                          double gain, char sampletype);
 static int translatechan (char *component, char *channel, char *location);
 static int parameter_proc (int argcount, char **argvec);
+static int parsereclens (char *reclens);
 static char *getoptval (int argcount, char **argvec, int argopt);
 static int readlistfile (char *listfile);
 static void addnode (struct listnode **listroot, char *key, char *data);
 static void addmapnode (struct listnode **listroot, char *mapping);
 static void record_handler (char *record, int reclen, void *handlerdata);
-static int64_t portable_ftell64 (FILE *stream);
 static void usage (void);
 
+/* Maximum number of record lengths to choose from when packing */
+#define MAXRECLENS 8
+
 static int   verbose     = 0;
-static int   packreclen  = -1;
+static int   packreclens[MAXRECLENS] = { -1 };
+static int   packreclencount = 1;
 static int   encoding    = -1;
 static int   byteorder   = -1;
 static char  srateblkt   = 0;
@@ -50,7 +129,10 @@ static char  retainfutureyear = 0;
 static char *forcenet    = 0;
 static char *forceloc    = 0;
 static char *outputfile  = 0;
-static FILE *ofp         = 0;
+static OutputFile *ofp   = 0;
+static char  rawsamples  = 0;
+static char  applygain   = 0;
+static int   packworkers = 1;
 
 /* A list of input files */
 struct listnode *filelist = 0;
@@ -58,32 +140,66 @@ struct listnode *filelist = 0;
 /* A list of component to channel translations */
 struct listnode *chanlist = 0;
 
+/* A list of archive member and output names, retained until exit */
+struct listnode *memberlist = 0;
+
 static MSTraceGroup *mstg = 0;
+static MSArena *arena = 0;
 
 static int packedtraces  = 0;
 static int packedsamples = 0;
 static int packedrecords = 0;
 
+/* Maximum number of work items queued for each pipeline stage */
+#define PIPEDEPTH 64
+
+/* Number of log messages queued for asynchronous output */
+#define LOGQDEPTH 1024
+
+/* Conversion pipeline stages in processing order */
+static PipeStage stages[] = {
+  { .name = "framing", .process = framestage },
+  { .name = "assembly", .process = assemblystage },
+  { .name = "conversion", .process = conversionstage },
+  { .name = "encoding", .process = encodingstage },
+  { .name = "output", .process = outputstage }
+};
+#define STAGECOUNT (int)(sizeof(stages) / sizeof(stages[0]))
+
 int
 main (int argc, char **argv)
 {
   struct listnode *flp;
+  struct assemblystate as;
+  struct conversionstate cs;
+  struct outputstate os;
 
   /* Process given parameters (command line and parameter file) */
   if (parameter_proc (argc, argv) < 0)
     return -1;
 
-  /* Init MSTraceGroup */
-  mstg = mst_initgroup (mstg);
+  /* Init MSTraceGroup, traces and record templates are allocated from
+   * an arena that is released in bulk when the group is reinitialized */
+  if ( ! (arena = ms_arena_init (NULL, 0)) ||
+       ! (mstg = mst_initgroup_arena (mstg, arena)) )
+  {
+    fprintf (stderr, "Cannot allocate memory for trace group\n");
+    return -1;
+  }
+
+  /* Unless buffering all data, channels to be Steim encoded are packed
+   * directly from the raw SeisAn samples without conversion */
+  if ( ! bufferall && (encoding == -1 || encoding == 10 || encoding == 11) )
+    rawsamples = 1;
 
   /* Open the output file if specified */
   if ( outputfile )
   {
     if ( strcmp (outputfile, "-") == 0 )
     {
-      ofp = stdout;
+      ofp = out_stdout ();
     }
-    else if ( (ofp = fopen (outputfile, "wb")) == NULL )
+    else if ( (ofp = out_open (outputfile)) == NULL )
     {
       fprintf (stderr, "Cannot open output file: %s (%s)\n",
                outputfile, strerror(errno));
@@ -91,28 +207,43 @@ main (int argc, char **argv)
     }
   }
 
-  /* Read input SeisAn files into MSTraceGroup */
+  /* Print diagnostics asynchronously, a failure to start leaves
+   * messages printed directly */
+  logq_start (LOGQDEPTH);
+
+  /* Start conversion pipeline */
+  memset (&as, 0, sizeof(as));
+  memset (&cs, 0, sizeof(cs));
+  memset (&os, 0, sizeof(os));
+  stages[1].data = &as;
+  stages[2].data = &cs;
+  stages[4].data = &os;
+
+  if ( pipe_start (stages, STAGECOUNT, PIPEDEPTH) )
+    return -1;
+
+  /* Send input SeisAn files to the pipeline */
   flp = filelist;
   while ( flp != 0 )
   {
-    if ( verbose )
-      fprintf (stderr, "Reading %s\n", flp->data);
-
-    seisan2group (flp->data, mstg);
+    pipe_send (&stages[0], flp);
 
     flp = flp->next;
   }
 
-  /* Pack any remaining, possibly all data */
-  packtraces (1);
-  packedtraces += mstg->numtraces;
+  /* Wait for all stages to finish, remaining data is packed at the end */
+  pipe_finish (stages, STAGECOUNT);
+
+  logq_stop ();
 
   fprintf (stderr, "Packed %d trace(s) of %d samples into %d records\n",
            packedtraces, packedsamples, packedrecords);
 
   /* Make sure everything is cleaned up */
-  if ( ofp )
-    fclose (ofp);
+  if ( ofp && out_close (ofp) )
+    fprintf (stderr, "Error writing to output file: %s\n", strerror(errno));
+
+  fileio_shutdown ();
 
   return 0;
 }  /* End of main() */
@@ -121,12 +252,11 @@ main (int argc, char **argv)
 /***************************************************************************
  * packtraces:
  *
- * Pack all traces in a group using per-MSTrace templates.
- *
- * Returns 0 on success, and -1 on failure
+ * Pack all traces in a group using per-MSTrace templates, packed
+ * records are added to the specified batch.
  ***************************************************************************/
 static void
-packtraces (flag flush)
+packtraces (flag flush, struct workitem *batch)
 {
   MSTrace *mst;
   int64_t trpackedsamples = 0;
@@ -141,8 +271,11 @@ packtraces (flag flush)
       continue;
     }
 
-    trpackedrecords = mst_pack (mst, &record_handler, 0, packreclen, encoding, byteorder,
-                                &trpackedsamples, flush, verbose-2, (MSRecord *) mst->prvtptr);
+    trpackedrecords = mst_pack_reclens (mst, &record_handler, batch, packreclens, packreclencount,
+                                        (mst->sampletype == 'f') ? DE_FLOAT32 :
+                                        (mst->sampletype == 'd') ? DE_FLOAT64 : encoding,
+                                        byteorder, &trpackedsamples, flush, packworkers,
+                                        verbose-2, (MSRecord *) mst->prvtptr);
     if ( trpackedrecords < 0 )
     {
       fprintf (stderr, "Error packing data\n");
@@ -159,79 +292,329 @@ packtraces (flag flush)
 
 
 /***************************************************************************
- * seian2group:
- * Read a SeisAn file and add data samples to a MSTraceGroup.  As the SeisAn
- * data is read in a MSRecord struct is used as a holder for the input
- * information.
+ * mktemplate:
  *
- * Returns 0 on success, and -1 on failure
+ * Populate a MSRecord template for packing from the channel header
+ * values in the work item holder, allocating the template if needed.
+ * The template, its blockettes and FSDH are allocated from the arena
+ * bound to the MSTraceGroup.
+ *
+ * Returns the template on success and NULL on error.
  ***************************************************************************/
-static int
-seisan2group (char *seisanfile, MSTraceGroup *mstg)
+static MSRecord *
+mktemplate (MSRecord *template, struct workitem *wi)
 {
-  FILE *ifp = 0;
-  MSRecord *msr = 0;
-  MSTrace *mst;
   struct blkt_100_s Blkt100;
+  MSRecord *msr = wi->msr;
+  struct fsdh_s *fsdh;
+  BlktLink *blkt;
 
-  char *record = 0;
-  size_t recordbufsize = 0;
+  if ( ! template )
+  {
+    if ( (template = msr_init_arena (arena)) == NULL )
+      return NULL;
+  }
 
-  flag swapflag = -1;
-  flag formatflag = 0;  /* 1: PC SeisAn <= 6.0, 4: SeisAn >= 7.0 */
-  uint8_t reclen1 = 0;
-  uint8_t reclenmirror1 = 0;
-  uint32_t reclen4 = 0;
-  uint32_t reclenmirror4 = 0;
-  unsigned int reclen = 0;
-  int64_t filepos;
-  struct stat sbuf;
+  /* Retain the FSDH of a reused template, blockettes are replaced */
+  msr_free_blktchain (template);
+  fsdh = template->fsdh;
 
-  size_t readlen;
+  memcpy (template, msr, sizeof(MSRecord));
 
-  char expectheader = 1;
-  char cheader[1040];
-  int cheaderlen = 0;
+  template->fsdh = fsdh;
+  template->blkts = 0;
+  template->Blkt100 = 0;
+  template->Blkt1000 = 0;
+  template->Blkt1001 = 0;
+  template->datasamples = 0;
+  template->ststate = 0;
 
-  char expectdata = 0;
-  char *data = 0;
-  int datalen = 0;
-  int maxdatalen = 0;
-  int datasamplesize = 0;
-  int expectdatalen = 0;
+  /* Copy any blockettes from the holder */
+  for ( blkt = msr->blkts; blkt; blkt = blkt->next )
+  {
+    if ( ! msr_addblockette (template, blkt->blktdata, blkt->blktdatalen,
+                             blkt->blkt_type, 0) )
+      return NULL;
+  }
 
-  char component[5];
-  long year;
-  char timestr[30];
-  char ratestr[10];
-  char sampstr[10];
-  char uctimeflag = 0;
-  char gainstr[15];
-  char gainflag = 0;
-  double gain = 1.0;
+  /* If a blockette 100 is requested add it */
+  if ( srateblkt )
+  {
+    memset (&Blkt100, 0, sizeof(struct blkt_100_s));
+    Blkt100.samprate = (float) msr->samprate;
+    msr_addblockette (template, (char *) &Blkt100,
+                      sizeof(struct blkt_100_s), 100, 0);
+  }
 
-  char *cat, *mouse;
+  /* Create a FSDH for the template */
+  if ( ! template->fsdh &&
+       ! (template->fsdh = ms_arena_alloc (arena, sizeof(struct fsdh_s))) )
+    return NULL;
+
+  if ( msr->fsdh )
+    memcpy (template->fsdh, msr->fsdh, sizeof(struct fsdh_s));
+  else
+    memset (template->fsdh, 0, sizeof(struct fsdh_s));
+
+  /* Set bit 7 (time tag questionable) in the data quality flags appropriately */
+  if ( wi->uctimeflag )
+    template->fsdh->dq_flags |= 0x80;
+  else
+    template->fsdh->dq_flags &= ~(0x80);
+
+  return template;
+}  /* End of mktemplate() */
+
+
+/***************************************************************************
+ * packchannel:
+ *
+ * Pack the raw samples of a channel directly into Steim encoded
+ * records, or the float samples of a channel with a gain applied into
+ * float encoded records, packed records are added to the specified
+ * batch.  The result is identical to adding the channel to an empty
+ * MSTraceGroup and packing it with packtraces().
+ ***************************************************************************/
+static void
+packchannel (struct workitem *wi, struct workitem *batch)
+{
+  MSRecord *template;
+  char srcname[50];
+  int64_t trpackedsamples = 0;
+  int trpackedrecords;
+
+  if ( ! (template = mktemplate (NULL, wi)) )
+  {
+    fprintf (stderr, "[%s] Cannot allocate memory for record template\n", wi->seisanfile);
+    return;
+  }
+
+  packedtraces++;
+
+  template->reclen      = packreclens[0];
+  template->encoding    = encoding;
+  template->byteorder   = byteorder;
+  template->datasamples = wi->data;
+  template->sampletype  = 'i';
+  template->ststate     = NULL;
+
+  /* Samples converted with a gain applied */
+  if ( wi->msr->datasamples )
+  {
+    template->sampletype = wi->msr->sampletype;
+    template->encoding   = (template->sampletype == 'd') ? DE_FLOAT64 : DE_FLOAT32;
+  }
+
+  if ( template->numsamples > 0 )
+  {
+    if ( template->samplecnt != template->numsamples )
+    {
+      ms_log (2, "mst_pack(): Sample counts do not match, abort\n");
+      fprintf (stderr, "Error packing data\n");
+    }
+    else
+    {
+      /* Record lengths are planned from host byte order samples */
+      if ( template->sampletype == 'i' && packreclencount > 1 )
+      {
+        if ( (template->datasamples = mkhostdata (wi->data, wi->datalen, wi->datasamplesize,
+                                                  wi->swapflag)) )
+          trpackedrecords = msr_pack_reclens (template, &record_handler, batch, &trpackedsamples,
+                                              1, packreclens, packreclencount, 1, verbose-2);
+        else
+          trpackedrecords = -1;
+
+        /* 32-bit samples are converted in place */
+        if ( template->datasamples && template->datasamples != wi->data )
+          free (template->datasamples);
+      }
+      else if ( template->sampletype == 'i' )
+        trpackedrecords = msr_pack_rawsamples (template, &record_handler, batch, &trpackedsamples,
+                                               1, wi->datasamplesize, wi->swapflag, verbose-2);
+      else
+        trpackedrecords = msr_pack_reclens (template, &record_handler, batch, &trpackedsamples,
+                                            1, packreclens, packreclencount, 1, verbose-2);
+      if ( trpackedrecords < 0 )
+      {
+        fprintf (stderr, "Error packing data\n");
+      }
+      else
+      {
+        if ( verbose > 3 )
+          ms_log (1, "Packed %d records for %s trace\n", trpackedrecords,
+                  msr_srcname (template, srcname, 0));
+
+        packedrecords += trpackedrecords;
+        packedsamples += trpackedsamples;
+      }
+    }
+  }
+
+  template->datasamples = 0;
+  msr_free (&template);
+
+  /* Release the template in bulk */
+  ms_arena_init (arena, 0);
+}  /* End of packchannel() */
+
+
+/***************************************************************************
+ * framestage:
+ *
+ * Pipeline stage to read SeisAn files, items are input file list
+ * entries.
+ ***************************************************************************/
+static void
+framestage (PipeStage *stage, void *item)
+{
+  struct listnode *flp = (struct listnode *) item;
+
+  if ( ! flp )
+    return;
+
+  if ( verbose )
+    ms_log (1, "Reading %s\n", flp->data);
+
+  seisan2group (flp->data, (flp->next) ? flp->next->data : NULL, stage->next);
+}  /* End of framestage() */
+
+
+/***************************************************************************
+ * seian2group:
+ *
+ * Read a SeisAn file, or each SeisAn file in a tar archive, and send
+ * the Fortran records to the next pipeline stage.  Compressed input is
+ * decoded while reading.  If a next file is specified reading of it is
+ * started while the current file is processed.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+seisan2group (char *seisanfile, char *nextfile, PipeStage *stage)
+{
+  InputFile *ifp = 0;
+  struct listnode *member;
+  char outputname[1024];
+  char *membername;
+  int retval = 0;
+  int rv;
 
   /* Open input file */
-  if ( (ifp = fopen (seisanfile, "rb")) == NULL )
+  if ( (ifp = in_open (seisanfile)) == NULL )
   {
     fprintf (stderr, "Cannot open input file: %s (%s)\n",
              seisanfile, strerror(errno));
     return -1;
   }
 
-  /* Stat file to get size */
-  if ( fstat (fileno(ifp), &sbuf) )
+  /* Start reading the next file */
+  if ( nextfile )
+    in_prefetch (nextfile);
+
+  /* A plain or compressed file has a single member, the file itself */
+  while ( (rv = in_nextmember (ifp, &membername)) > 0 )
   {
-    fprintf (stderr, "Cannot stat input file: %s (%s)\n",
-             seisanfile, strerror(errno));
-    return -1;
+    mkoutputname (outputname, sizeof(outputname), seisanfile,
+                  membername, ifp->compression);
+
+    if ( ! membername )
+    {
+      if ( readframes (ifp, seisanfile, outputname, stage) )
+        retval = -1;
+
+      continue;
+    }
+
+    /* Members of the same name in different directories of an archive
+     * would overwrite each other's output file */
+    if ( ! ofp )
+    {
+      for (member = memberlist; member; member = member->next)
+        if ( ! strcmp (member->key, outputname) )
+          break;
+
+      if ( member )
+      {
+        fprintf (stderr, "Output file %s of %s(%s) already written for %s, skipping member\n",
+                 outputname, seisanfile, membername, member->data);
+        retval = -1;
+        continue;
+      }
+    }
+
+    /* Retain member and output names for the work items of the pipeline */
+    if ( ! (member = (struct listnode *) calloc (1, sizeof(struct listnode))) ||
+         ! (member->key = strdup (outputname)) ||
+         ! (member->data = (char *) malloc (strlen (seisanfile) + strlen (membername) + 3)) )
+    {
+      fprintf (stderr, "Error allocating memory for member name\n");
+      if ( member )
+        free (member->key);
+      free (member);
+      retval = -1;
+      break;
+    }
+
+    sprintf (member->data, "%s(%s)", seisanfile, membername);
+    member->next = memberlist;
+    memberlist = member;
+
+    if ( verbose )
+      ms_log (1, "Reading %s\n", member->data);
+
+    if ( readframes (ifp, member->data, outputname, stage) )
+      retval = -1;
   }
 
+  if ( rv < 0 )
+  {
+    fprintf (stderr, "Error reading archive %s: %s\n", seisanfile, strerror(errno));
+    retval = -1;
+  }
+
+  in_close (ifp);
+
+  return retval;
+}  /* End of seisan2group() */
+
+
+/***************************************************************************
+ * readframes:
+ *
+ * Read the Fortran records of a SeisAn file, or archive member, and
+ * send them to the next pipeline stage in WI_FRAMES batches of up to
+ * FRAMEBATCH bytes, bracketed by WI_FILEBEGIN and WI_FILEEND items.
+ * Records are read sequentially without seeking.  Unless all output
+ * goes to a single file the output file is opened with the specified
+ * name.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+readframes (InputFile *ifp, char *seisanfile, char *outputname, PipeStage *stage)
+{
+  OutputFile *fileofp = 0;
+  struct workitem *wi;
+  struct workitem *batch = 0;
+  int *framelens;
+  char *record;
+  char repaired = 0;
+
+  flag swapflag = -1;
+  flag formatflag = 0;  /* Record framing, SEISAN_FRAME1 or SEISAN_FRAME4 */
+  uint8_t reclen1 = 0;
+  uint8_t reclenmirror1 = 0;
+  uint32_t reclen4 = 0;
+  uint32_t reclenmirror4 = 0;
+  unsigned int reclen = 0;
+  int64_t filepos;
+
+  size_t readlen;
+
   /* Detect format and byte order */
   if ( detectformat (ifp, &formatflag, &swapflag, seisanfile) )
   {
-    if ( ferror(ifp) )
+    if ( in_error (ifp) )
       fprintf (stderr, "Error reading file %s: %s\n",
                seisanfile, strerror(errno));
     else
@@ -240,11 +623,11 @@ seisan2group (char *seisanfile, MSTraceGroup *mstg)
     return -1;
   }
 
-  /* Read the signature character for formatflag == 1, it's not needed. */
-  if ( formatflag == 1 )
-    if ( fread (&reclen1, 1, 1, ifp) < 1 )
+  /* Read the signature character for formatflag == SEISAN_FRAME1, it's not needed. */
+  if ( formatflag == SEISAN_FRAME1 )
+    if ( in_read (&reclen1, 1, 1, ifp) < 1 )
     {
-      if ( ferror(ifp) )
+      if ( in_error (ifp) )
         fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
 
       return -1;
@@ -253,10 +636,10 @@ seisan2group (char *seisanfile, MSTraceGroup *mstg)
   /* Report format and byte order detection results */
   if ( verbose > 1 )
   {
-    if ( formatflag == 1 )
-      fprintf (stderr, "Detected PC <= 6.0 format for %s\n", seisanfile);
-    else if ( formatflag == 4 )
-      fprintf (stderr, "Detected Sun/Linux and PC >= 7.0 format for %s\n", seisanfile);
+    if ( formatflag == SEISAN_FRAME1 )
+      ms_log (1, "Detected PC <= 6.0 format for %s\n", seisanfile);
+    else if ( formatflag == SEISAN_FRAME4 )
+      ms_log (1, "Detected Sun/Linux and PC >= 7.0 format for %s\n", seisanfile);
     else
     {
       fprintf (stderr, "Unknown format for %s\n", seisanfile);
@@ -264,64 +647,56 @@ seisan2group (char *seisanfile, MSTraceGroup *mstg)
     }
 
     if ( swapflag == 0 )
-      fprintf (stderr, "Byte swapping not needed for %s\n", seisanfile);
+      ms_log (1, "Byte swapping not needed for %s\n", seisanfile);
     else
-      fprintf (stderr, "Byte swapping needed for %s\n", seisanfile);
+      ms_log (1, "Byte swapping needed for %s\n", seisanfile);
   }
 
   /* Open output file if needed */
-  if ( ! ofp )
+  if ( ofp )
   {
-    char mseedoutputfile[1024];
-
-    /* If a "standard" name change the S to an M otherwise add _MSEED to the end */
-    if ( seisanfile[4] == '-' && seisanfile[7] == '-' && seisanfile[10] == '-' &&
-         seisanfile[15] == '-' && seisanfile[18] == 'S' && seisanfile[19] == '.' )
-    {
-      strncpy (mseedoutputfile, seisanfile, sizeof(mseedoutputfile));
-      mseedoutputfile[18] = 'M';
-    }
-    else
-    {
-      snprintf (mseedoutputfile, sizeof(mseedoutputfile), "%s_MSEED", seisanfile);
-    }
-
-    if ( (ofp = fopen (mseedoutputfile, "wb")) == NULL )
-    {
-      fprintf (stderr, "Cannot open output file: %s (%s)\n",
-               mseedoutputfile, strerror(errno));
-      return -1;
-    }
+    fileofp = ofp;
+  }
+  else if ( (fileofp = out_open (outputname)) == NULL )
+  {
+    fprintf (stderr, "Cannot open output file: %s (%s)\n",
+             outputname, strerror(errno));
+    return -1;
   }
 
-  if ( ! (msr = msr_init(msr)) )
+  if ( ! (wi = newitem (WI_FILEBEGIN, seisanfile)) )
   {
-    fprintf (stderr, "Cannot initialize MSRecord strcture\n");
+    if ( fileofp != ofp )
+      out_close (fileofp);
     return -1;
   }
 
-  /* Read a record at a time */
+  wi->ofp = fileofp;
+  wi->swapflag = swapflag;
+  pipe_send (stage, wi);
+
+  /* Read a record at a time, collecting records into batches */
   for (;;)
   {
     /* Get current file position */
-    filepos = portable_ftell64 (ifp);
+    filepos = in_tell (ifp);
 
     /* Read next record length */
-    if ( formatflag == 1 )
+    if ( formatflag == SEISAN_FRAME1 )
     {
-      if ( (readlen = fread (&reclen1, 1, 1, ifp)) < 1 )
+      if ( (readlen = in_read (&reclen1, 1, 1, ifp)) < 1 )
       {
-        if ( ferror(ifp) )
+        if ( in_error (ifp) )
           fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
         break;
       }
       reclen = reclen1;
     }
-    if ( formatflag == 4 )
+    if ( formatflag == SEISAN_FRAME4 )
     {
-      if ( (readlen = fread (&reclen4, 4, 1, ifp)) < 1 )
+      if ( (readlen = in_read (&reclen4, 4, 1, ifp)) < 1 )
       {
-        if ( ferror(ifp) )
+        if ( in_error (ifp) )
           fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
         break;
       }
@@ -330,340 +705,811 @@ seisan2group (char *seisanfile, MSTraceGroup *mstg)
       reclen = reclen4;
     }
 
-    /* Check if record is longer then expected */
-    if (expectdatalen && (reclen + datalen) > expectdatalen)
+    if ( verbose > 2 )
+      ms_log (1, "Reading next record of length %d bytes from offset %"PRId64" (0x%"PRIx64") to %"PRId64"\n",
+               reclen, filepos, filepos, filepos+reclen);
+
+    /* Send the batch if the record does not fit */
+    if ( batch && (unsigned int) (batch->datasize - batch->datalen) < reclen )
+    {
+      pipe_send (stage, batch);
+      batch = 0;
+    }
+
+    /* Allocate a work item for the next batch of records */
+    if ( ! batch )
     {
-      /* Check for the observed corrupt data case where the record length is one more
-         than expected and at the end of the file. */
-      if (expectdatalen == (reclen + datalen - 1) &&
-          sbuf.st_size == (filepos + reclen + 1))
+      if ( ! (batch = newitem (WI_FRAMES, seisanfile)) ||
+           ! (batch->data = (char *) malloc ((reclen > FRAMEBATCH) ? reclen : FRAMEBATCH)) )
       {
-        fprintf (stderr, "Warning, bad record length (%d) detected at end of file, setting to %d\n",
-                 reclen, reclen - 1);
-        reclen -= 1;
+        fprintf (stderr, "Error allocating memory for record\n");
+        freeitem (batch);
+        batch = 0;
+        break;
       }
-      else
+
+      batch->datasize = (reclen > FRAMEBATCH) ? reclen : FRAMEBATCH;
+    }
+
+    if ( batch->framecount >= batch->framemax )
+    {
+      framelens = (int *) realloc (batch->framelens, (batch->framemax + 64) * sizeof(int));
+
+      if ( ! framelens )
       {
-        fprintf (stderr, "Error, record length (%d) is longer than expected (%d), ignoring rest of file\n",
-                 reclen, expectdatalen - datalen);
+        fprintf (stderr, "Error allocating memory for record\n");
         break;
       }
+
+      batch->framelens = framelens;
+      batch->framemax += 64;
     }
 
-    if ( verbose > 2 )
-      fprintf (stderr, "Reading next record of length %d bytes from offset %"PRId64" (0x%"PRIx64") to %"PRId64"\n",
-               reclen, filepos, filepos, filepos+reclen);
+    record = batch->data + batch->datalen;
 
-    /* Make sure enough memory is available */
-    if ( reclen > recordbufsize )
+    /* Read the record */
+    if ( (readlen = in_read (record, 1, reclen, ifp)) < reclen )
+    {
+      if ( in_error (ifp) )
+        fprintf (stderr, "Error reading file %s\n", seisanfile);
+      else if ( readlen < reclen )
+        fprintf (stderr, "Short read, only read %d of %d bytes.\n", (int)readlen, reclen);
+
+      break;
+    }
+
+    /* Read record length mirror at the end of the record */
+    if ( formatflag == SEISAN_FRAME1 )
     {
-      if ( (record = realloc (record, reclen)) == NULL )
+      readlen = in_read (&reclenmirror1, 1, 1, ifp);
+
+      /* Check for the observed corrupt data case where the record length is one
+         more than available at the end of the file: the last byte read is the
+         mirror.  The channel assembly verifies that the repaired length matches
+         the expected data length. */
+      if ( readlen < 1 && reclen > 0 && in_eof (ifp) && ! in_error (ifp) )
       {
-        fprintf (stderr, "Error allocating memory for record\n");
+        reclen -= 1;
+        reclenmirror1 = (uint8_t) record[reclen];
+        repaired = 1;
+        readlen = 1;
+
+        if ( verbose > 2 )
+          ms_log (1, "Repaired record length at end of file to %d bytes\n", reclen);
+      }
+
+      if ( readlen < 1 )
+      {
+        if ( in_error (ifp) )
+          fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
+
+        if ( in_eof (ifp) )
+          fprintf (stderr, "Error reading file %s: REACHED END, return: %zu\n", seisanfile, readlen);
+
+        break;
+      }
+
+      if ( reclen1 != reclenmirror1 )
+      {
+        fprintf (stderr, "At byte offset %"PRId64" in %s:\n", filepos, seisanfile);
+        fprintf (stderr, "  Next and previous record length values do not match: %d != %d\n",
+                 reclen1, reclenmirror1);
+        break;
+      }
+    }
+    if ( formatflag == SEISAN_FRAME4 )
+    {
+      if ( (readlen = in_read (&reclenmirror4, 4, 1, ifp)) < 1 )
+      {
+        if ( in_error (ifp) )
+          fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
         break;
       }
+      if ( swapflag ) ms_gswap4 ( &reclenmirror4 );
+      if ( reclen4 != reclenmirror4 )
+      {
+        fprintf (stderr, "At byte offset %"PRId64" in %s:\n", filepos, seisanfile);
+        fprintf (stderr, "  Next and previous record length values do not match: %d != %d\n",
+                 reclen4, reclenmirror4);
+        break;
+      }
+    }
+
+    /* Add the complete record to the batch */
+    batch->framelens[batch->framecount++] = reclen;
+    batch->datalen += reclen;
+    batch->repaired = repaired;
+  }
+
+  /* Send the records read before the end of the file or an error */
+  if ( batch && batch->framecount > 0 )
+    pipe_send (stage, batch);
+  else
+    freeitem (batch);
+
+  if ( (wi = newitem (WI_FILEEND, seisanfile)) )
+    pipe_send (stage, wi);
+
+  return 0;
+}  /* End of readframes() */
+
+
+/***************************************************************************
+ * mkoutputname:
+ *
+ * Build the output file name for a SeisAn file or archive member.  The
+ * output for an archive member is placed in the directory of the
+ * archive and named after the member without its directory, members
+ * of the same name are detected by the caller.  Any compression
+ * suffix is removed from the name of a compressed file.  If the name
+ * is a "standard" SeisAn name the S is changed to an M, otherwise
+ * _MSEED is added to the end.
+ ***************************************************************************/
+static void
+mkoutputname (char *outputname, size_t size, char *seisanfile,
+              char *membername, int compression)
+{
+  char basename[1024];
+  char *cp;
+  size_t length;
+
+  memset (basename, 0, sizeof(basename));
+
+  if ( membername )
+  {
+    length = ( (cp = strrchr (seisanfile, '/')) ) ? (size_t) (cp - seisanfile + 1) : 0;
+    if ( length >= sizeof(basename) )
+      length = sizeof(basename) - 1;
+
+    memcpy (basename, seisanfile, length);
+
+    cp = strrchr (membername, '/');
+    strncat (basename, (cp) ? cp + 1 : membername, sizeof(basename) - length - 1);
+  }
+  else
+  {
+    strncpy (basename, seisanfile, sizeof(basename) - 1);
+
+    if ( compression != IN_PLAIN )
+    {
+      length = strlen (basename);
+
+      if ( length > 3 && ! strcmp (basename + length - 3, ".gz") )
+        basename[length - 3] = '\0';
+      else if ( length > 4 && ! strcmp (basename + length - 4, ".zst") )
+        basename[length - 4] = '\0';
+    }
+  }
+
+  if ( basename[4] == '-' && basename[7] == '-' && basename[10] == '-' &&
+       basename[15] == '-' && basename[18] == 'S' && basename[19] == '.' )
+  {
+    snprintf (outputname, size, "%s", basename);
+    outputname[18] = 'M';
+  }
+  else
+  {
+    snprintf (outputname, size, "%s_MSEED", basename);
+  }
+}  /* End of mkoutputname() */
+
+
+
+/***************************************************************************
+ * assemblystage:
+ *
+ * Pipeline stage to assemble Fortran records into channel headers and
+ * data sections, each complete channel is sent as a WI_CHANNEL item.
+ ***************************************************************************/
+static void
+assemblystage (PipeStage *stage, void *item)
+{
+  struct assemblystate *as = (struct assemblystate *) stage->data;
+  struct workitem *wi = (struct workitem *) item;
+  int offset;
+  int idx;
+
+  if ( ! wi )
+    return;
+
+  if ( wi->type == WI_FILEBEGIN )
+  {
+    freeitem (as->channel);
+    memset (as, 0, sizeof(struct assemblystate));
+    as->seisanfile = wi->seisanfile;
+    as->swapflag = wi->swapflag;
+    as->expectheader = 1;
+    pipe_send (stage->next, wi);
+    return;
+  }
+
+  if ( wi->type == WI_FILEEND )
+  {
+    freeitem (as->channel);
+    as->channel = 0;
+    pipe_send (stage->next, wi);
+    return;
+  }
+
+  if ( wi->type != WI_FRAMES )
+  {
+    freeitem (wi);
+    return;
+  }
+
+  /* Assemble each record of the batch, the repaired flag applies to the last */
+  for ( idx = 0, offset = 0; idx < wi->framecount && ! as->skipfile; idx++ )
+  {
+    assembleframe (stage, as, wi, offset, wi->framelens[idx],
+                   (idx == wi->framecount - 1) ? wi->repaired : 0);
+    offset += wi->framelens[idx];
+  }
+
+  freeitem (wi);
+}  /* End of assemblystage() */
+
+
+/***************************************************************************
+ * assembleframe:
+ *
+ * Add a single Fortran record, at offset in the data buffer of a
+ * WI_FRAMES item, to the channel header or data section being
+ * assembled.  A complete channel is sent to the next stage.  The
+ * caller frees the batch item.
+ ***************************************************************************/
+static void
+assembleframe (PipeStage *stage, struct assemblystate *as, struct workitem *wi,
+               int offset, unsigned int reclen, char repaired)
+{
+  struct workitem *channel;
+  char *record = wi->data + offset;
+  int datalen;
+
+  datalen = ( as->channel ) ? as->channel->datalen : 0;
+
+  /* Check if record is longer then expected */
+  if ( repaired )
+  {
+    /* Only accept the repaired length of the last record in the file if it
+       completes the expected data, otherwise the record is truncated. */
+    if ( as->expectdatalen && as->expectdatalen == (reclen + datalen) )
+    {
+      fprintf (stderr, "Warning, bad record length (%d) detected at end of file, setting to %d\n",
+               reclen + 1, reclen);
+    }
+    else
+    {
+      if ( as->expectdatalen && (reclen + 1 + datalen) > as->expectdatalen )
+        fprintf (stderr, "Error, record length (%d) is longer than expected (%d), ignoring rest of file\n",
+                 reclen + 1, as->expectdatalen - datalen);
       else
-        recordbufsize = reclen;
+        fprintf (stderr, "Short read, only read %d of %d bytes.\n", reclen, reclen + 1);
+
+      as->skipfile = 1;
+      return;
     }
+  }
+  else if ( as->expectdatalen && (reclen + datalen) > as->expectdatalen )
+  {
+    fprintf (stderr, "Error, record length (%d) is longer than expected (%d), ignoring rest of file\n",
+             reclen, as->expectdatalen - datalen);
+    as->skipfile = 1;
+    return;
+  }
+
+  /* Expecting a channel header:
+   * Either the channel header is starting (first char is not space)
+   * Or we are already reading it (cheaderlen != 0) */
+  if ( as->expectheader && (as->cheaderlen != 0 || *record != ' ') )
+  {
+    /* Copy record into channel header buffer */
+    if ( (reclen + as->cheaderlen) <= SEISAN_CHEADERLEN )
+    {
+      memcpy (as->cheader + as->cheaderlen, record, reclen);
+      as->cheaderlen += reclen;
+    }
+    else
+    {
+      fprintf (stderr, "Record is too long for the expected channel header!\n");
+      fprintf (stderr, "  cheaderlen: %d, reclen: %d (channel header should be 1040 bytes)\n",
+               as->cheaderlen, reclen);
+      as->skipfile = 1;
+      return;
+    }
+
+    /* Continue reading records if channel header is not filled */
+    if ( as->cheaderlen < SEISAN_CHEADERLEN )
+      return;
+
+    /* Otherwise parse the header */
+    if ( ! (channel = newitem (WI_CHANNEL, as->seisanfile)) ||
+         ! (channel->msr = msr_init (NULL)) )
+    {
+      fprintf (stderr, "Cannot initialize MSRecord strcture\n");
+      freeitem (channel);
+      as->skipfile = 1;
+      return;
+    }
+
+    parseheader (as, channel);
+
+    as->channel = channel;
+    as->expectdata = 1;
+    as->expectdatalen = channel->msr->samplecnt * channel->datasamplesize;
+    as->expectheader = 0;
+    as->cheaderlen = 0;
+    return;
+  }
+
+  /* Expecting data */
+  if ( as->expectdata )
+  {
+    channel = as->channel;
+
+    /* Copy record into data buffer */
+    if ( (reclen + channel->datalen) <= as->expectdatalen )
+    {
+      /* Use the batch buffer directly if it is a single record
+         containing the complete data */
+      if ( channel->datalen == 0 && reclen == as->expectdatalen &&
+           wi->framecount == 1 )
+      {
+        channel->data = wi->data;
+        channel->datasize = wi->datasize;
+        wi->data = 0;
+      }
+      else
+      {
+        /* Make sure enough memory is available */
+        if ( (reclen + channel->datalen) > channel->datasize )
+        {
+          if ( (channel->data = realloc (channel->data, (reclen + channel->datalen))) == NULL )
+          {
+            fprintf (stderr, "Error allocating memory for record\n");
+            as->skipfile = 1;
+            return;
+          }
+          else
+            channel->datasize = reclen + channel->datalen;
+        }
+
+        memcpy (channel->data + channel->datalen, record, reclen);
+      }
+
+      channel->datalen += reclen;
+    }
+    else
+    {
+      fprintf (stderr, "Record is too long for the expected data!\n");
+      fprintf (stderr, " datalen: %d, reclen: %d, expectdatalen: %d\n",
+               channel->datalen, reclen, as->expectdatalen);
+      as->skipfile = 1;
+      return;
+    }
+
+    /* Continue reading records if enough data has not been read */
+    if ( channel->datalen < as->expectdatalen )
+      return;
+
+    /* Send complete channel to the next stage and reset state */
+    as->channel = 0;
+    pipe_send (stage->next, channel);
+
+    as->expectheader = 1;
+    as->expectdata = 0;
+  }
+}  /* End of assembleframe() */
+
+
+/***************************************************************************
+ * parseheader:
+ *
+ * Parse a 1040 byte SeisAn channel header into the MSRecord and
+ * channel details of a WI_CHANNEL work item.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parseheader (struct assemblystate *as, struct workitem *channel)
+{
+  MSRecord *msr = channel->msr;
+  char *cheader = as->cheader;
+  char *seisanfile = as->seisanfile;
+
+  char component[5];
+  long year;
+  char timestr[30];
+  char ratestr[10];
+  char sampstr[10];
+  char gainstr[15];
+  char gainflag = 0;
+  double gain = 1.0;
+
+  char *cat, *mouse;
+
+  ms_strncpclean (msr->network, forcenet, 2);
+  ms_strncpclean (msr->station, cheader + CH_STATION, 5);
+
+  /* Map component to SEED channel and location */
+  memset (component, 0, sizeof(component));
+  memcpy (component, cheader + CH_COMPONENT, 4);
+
+  translatechan (component, msr->channel, msr->location);
+
+  if ( verbose > 1 )
+  {
+    ms_log (1, "[%s] SeisAn channel: '%s', SEED channel: '%s'\n",
+             seisanfile, component, msr->channel);
+  }
+
+  if ( forceloc )
+    ms_strncpclean (msr->location, forceloc, 2);
+
+  /* Construct time string */
+  memset (timestr, 0, sizeof(timestr));
+  memcpy (timestr, cheader + CH_YEAR, 3);
+  year = strtoul (timestr, NULL, 10);
+  year += 1900;
+
+  /* Optionally shift start times beyond the year 2051 back to the year 2050 */
+  if ( ! retainfutureyear && year > 2050 )
+  {
+    if ( verbose )
+      ms_log (1, "[%s] Shifting start year from %ld to 2050\n", seisanfile, year);
+    year = 2050;
+  }
+
+  sprintf (timestr, "%4ld", year);
+
+  strcat (timestr, ",");
+  strncat (timestr, cheader + CH_DOY, 3);
+  strcat (timestr, ",");
+  strncat (timestr, cheader + CH_HOUR, 2);
+  strcat (timestr, ":");
+  strncat (timestr, cheader + CH_MINUTE, 2);
+  strcat (timestr, ":");
+  strncat (timestr, cheader + CH_SECOND, 6);
+
+  /* Remove spaces */
+  cat = mouse = timestr;
+  while ( *mouse )
+    if ( *mouse++ != ' ' )
+      *cat++ = *(mouse-1);
+  *cat = '\0';
+
+  msr->starttime = ms_seedtimestr2hptime (timestr);
+
+  /* Parse sample rate */
+  memset (ratestr, 0, sizeof(ratestr));
+  memcpy (ratestr, cheader + CH_RATE, 7);
+  msr->samprate = strtod (ratestr, NULL);
+
+  /* Parse sample count */
+  memset (sampstr, 0, sizeof(sampstr));
+  memcpy (sampstr, cheader + CH_SAMPLES, 7);
+  msr->samplecnt = strtoul (sampstr, NULL, 10);
+
+  /* Detect uncertain time */
+  channel->uctimeflag = ( cheader[CH_TIMEFLAG] == 'E' ) ? 1 : 0;
+
+  /* Detect gain */
+  gainflag = ( cheader[CH_GAINFLAG] == 'G' ) ? 1 : 0;
+  if ( gainflag )
+  {
+    memset (gainstr, 0, sizeof(gainstr));
+    memcpy (gainstr, cheader + CH_GAIN, 12);
+    gain = strtod (gainstr, NULL);
+
+    if ( ! applygain )
+    {
+      fprintf (stderr, "[%s] Gain of %f detected, not applied\n", seisanfile, gain);
+    }
+    else if ( gain == 0.0 )
+    {
+      fprintf (stderr, "[%s] Gain of %f cannot be applied\n", seisanfile, gain);
+    }
+    else
+    {
+      if ( verbose > 1 )
+        ms_log (1, "[%s] Applying gain of %f\n", seisanfile, gain);
+
+      channel->gain = gain;
+    }
+  }
+
+  /* Determine data sample size */
+  channel->datasamplesize = ( cheader[CH_SAMPLESIZE] == '4' ) ? 4 : 2;
+  channel->swapflag = as->swapflag;
+
+  if ( verbose )
+    ms_log (1, "[%s] '%s_%s' (%s): %s%s, %lld %d byte samps @ %.4f Hz\n",
+             seisanfile, msr->station, component, msr->channel,
+             timestr, (channel->uctimeflag) ? " [UNCERTAIN]" : "",
+             (long long int)msr->samplecnt, channel->datasamplesize, msr->samprate);
+
+  return 0;
+}  /* End of parseheader() */
+
+
+/***************************************************************************
+ * conversionstage:
+ *
+ * Pipeline stage to convert channel data sections to 32-bit integers
+ * in host byte order, or to floats if a gain is applied or a float
+ * encoding is requested.
+ ***************************************************************************/
+static void
+conversionstage (PipeStage *stage, void *item)
+{
+  struct conversionstate *cs = (struct conversionstate *) stage->data;
+  struct workitem *wi = (struct workitem *) item;
+  MSRecord *msr;
+  int32_t *hostdata;
+  void *floatdata;
+  char sampletype;
+
+  if ( ! wi )
+    return;
+
+  if ( wi->type != WI_CHANNEL )
+  {
+    if ( wi->type == WI_FILEBEGIN )
+      cs->skipfile = 0;
+
+    pipe_send (stage->next, wi);
+    return;
+  }
 
-    /* Read the record */
-    if ( (readlen = fread (record, 1, reclen, ifp)) < reclen )
-    {
-      if ( ferror(ifp) )
-        fprintf (stderr, "Error reading file %s\n", seisanfile);
-      else if ( readlen < reclen )
-        fprintf (stderr, "Short read, only read %d of %d bytes.\n", (int)readlen, reclen);
+  if ( cs->skipfile )
+  {
+    freeitem (wi);
+    return;
+  }
 
-      break;
-    }
+  msr = wi->msr;
 
-    /* Read record length mirror at the end of the record */
-    if ( formatflag == 1 )
-    {
-      if ( (readlen = fread (&reclenmirror1, 1, 1, ifp)) < 1 )
-      {
-        if ( ferror(ifp) )
-          fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
+  /* Number of samples implied by data record length */
+  msr->numsamples = wi->datalen / wi->datasamplesize;
 
-        if ( feof(ifp) )
-          fprintf (stderr, "Error reading file %s: REACHED END, return: %zu\n", seisanfile, readlen);
+  if ( msr->samplecnt != msr->numsamples )
+  {
+    fprintf (stderr, "[%s] Number of samples in channel header != data section\n", wi->seisanfile);
+    fprintf (stderr, "  Header: %lld, Data section: %lld\n",
+             (long long int)msr->samplecnt, (long long int)msr->numsamples);
+  }
 
-        break;
-      }
+  /* Convert to floats with any gain applied */
+  if ( wi->gain != 0.0 || encoding == DE_FLOAT32 || encoding == DE_FLOAT64 )
+  {
+    sampletype = ( encoding == DE_FLOAT64 ) ? 'd' : 'f';
 
-      if ( reclen1 != reclenmirror1 )
-      {
-        fprintf (stderr, "At byte offset %"PRId64" in %s:\n", filepos, seisanfile);
-        fprintf (stderr, "  Next and previous record length values do not match: %d != %d\n",
-                 reclen1, reclenmirror1);
-        break;
-      }
-    }
-    if ( formatflag == 4 )
+    if ( ! (floatdata = mkfloatdata (wi->data, wi->datalen, wi->datasamplesize,
+                                     wi->swapflag, wi->gain, sampletype)) )
     {
-      if ( (readlen = fread (&reclenmirror4, 4, 1, ifp)) < 1 )
-      {
-        if ( ferror(ifp) )
-          fprintf (stderr, "Error reading file %s: %s\n", seisanfile, strerror(errno));
-        break;
-      }
-      if ( swapflag ) ms_gswap4 ( &reclenmirror4 );
-      if ( reclen4 != reclenmirror4 )
-      {
-        fprintf (stderr, "At byte offset %"PRId64" in %s:\n", filepos, seisanfile);
-        fprintf (stderr, "  Next and previous record length values do not match: %d != %d\n",
-                 reclen4, reclenmirror4);
-        break;
-      }
+      cs->skipfile = 1;
+      freeitem (wi);
+      return;
     }
 
-    /* Expecting a channel header:
-     * Either the channel header is starting (first char is not space)
-     * Or we are already reading it (cheaderlen != 0) */
-    if ( expectheader && (cheaderlen != 0 || *record != ' ') )
-    {
-      /* Copy record into channel header buffer */
-      if ( (reclen + cheaderlen) <= 1040 )
-      {
-        memcpy (cheader + cheaderlen, record, reclen);
-        cheaderlen += reclen;
-      }
-      else
-      {
-        fprintf (stderr, "Record is too long for the expected channel header!\n");
-        fprintf (stderr, "  cheaderlen: %d, reclen: %d (channel header should be 1040 bytes)\n",
-                 cheaderlen, reclen);
-        break;
-      }
+    free (wi->data);
+    wi->data = (char *) floatdata;
+    wi->datasize = msr->numsamples * ms_samplesize (sampletype);
 
-      /* Continue reading records if channel header is not filled */
-      if ( cheaderlen < 1040 )
-        continue;
+    msr->datasamples = floatdata;
+    msr->sampletype = sampletype;
 
-      /* Otherwise parse the header */
-      ms_strncpclean (msr->network, forcenet, 2);
-      ms_strncpclean (msr->station, cheader, 5);
+    pipe_send (stage->next, wi);
+    return;
+  }
 
-      /* Map component to SEED channel and location */
-      memset (component, 0, sizeof(component));
-      memcpy (component, cheader + 5, 4);
+  /* Raw samples are packed directly by the encoding stage */
+  if ( rawsamples )
+  {
+    pipe_send (stage->next, wi);
+    return;
+  }
 
-      translatechan (component, msr->channel, msr->location);
+  /* Make sure we have 32-bit integers in host byte order */
+  if ( ! (hostdata = mkhostdata (wi->data, wi->datalen, wi->datasamplesize, wi->swapflag)) )
+  {
+    cs->skipfile = 1;
+    freeitem (wi);
+    return;
+  }
 
-      if ( verbose > 1 )
-      {
-        fprintf (stderr, "[%s] SeisAn channel: '%s', SEED channel: '%s'\n",
-                 seisanfile, component, msr->channel);
-      }
+  /* Replace raw data with converted samples */
+  if ( (char *) hostdata != wi->data )
+  {
+    free (wi->data);
+    wi->data = (char *) hostdata;
+    wi->datasize = msr->numsamples * sizeof(int32_t);
+  }
 
-      if ( forceloc )
-        ms_strncpclean (msr->location, forceloc, 2);
+  msr->datasamples = hostdata;
+  msr->sampletype = 'i';
 
-      /* Construct time string */
-      memset (timestr, 0, sizeof(timestr));
-      memcpy (timestr, cheader + 9, 3);
-      year = strtoul (timestr, NULL, 10);
-      year += 1900;
+  pipe_send (stage->next, wi);
+}  /* End of conversionstage() */
 
-      /* Optionally shift start times beyond the year 2051 back to the year 2050 */
-      if ( ! retainfutureyear && year > 2050 )
-      {
-        if ( verbose )
-          fprintf (stderr, "[%s] Shifting start year from %ld to 2050\n", seisanfile, year);
-        year = 2050;
-      }
 
-      sprintf (timestr, "%4ld", year);
-
-      strcat (timestr, ",");
-      strncat (timestr, cheader + 13, 3);
-      strcat (timestr, ",");
-      strncat (timestr, cheader + 23, 2);
-      strcat (timestr, ":");
-      strncat (timestr, cheader + 26, 2);
-      strcat (timestr, ":");
-      strncat (timestr, cheader + 29, 6);
-
-      /* Remove spaces */
-      cat = mouse = timestr;
-      while ( *mouse )
-        if ( *mouse++ != ' ' )
-          *cat++ = *(mouse-1);
-      *cat = '\0';
-
-      msr->starttime = ms_seedtimestr2hptime (timestr);
-
-      /* Parse sample rate */
-      memset (ratestr, 0, sizeof(ratestr));
-      memcpy (ratestr, cheader + 36, 7);
-      msr->samprate = strtod (ratestr, NULL);
-
-      /* Parse sample count */
-      memset (sampstr, 0, sizeof(sampstr));
-      memcpy (sampstr, cheader + 43, 7);
-      msr->samplecnt = strtoul (sampstr, NULL, 10);
-
-      /* Detect uncertain time */
-      uctimeflag = ( *(cheader+28) == 'E' ) ? 1 : 0;
-
-      /* Detect gain */
-      gainflag = ( *(cheader+75) == 'G' ) ? 1 : 0;
-      if ( gainflag )
-      {
-        memset (gainstr, 0, sizeof(gainstr));
-        memcpy (gainstr, cheader + 147, 12);
-        gain = strtod (gainstr, NULL);
+/***************************************************************************
+ * encodingstage:
+ *
+ * Pipeline stage to add channel samples to the MSTraceGroup and pack
+ * Mini-SEED records, records are sent to the output stage in batches.
+ ***************************************************************************/
+static void
+encodingstage (PipeStage *stage, void *item)
+{
+  struct workitem *wi = (struct workitem *) item;
+  struct workitem *batch;
+  MSRecord *msr;
+  MSTrace *mst;
 
-        fprintf (stderr, "Gain of %f detected\n", gain);
-        fprintf (stderr, "Gain NOT applied, no support for that yet!\n");
-      }
+  /* At the end of the stream pack any remaining, possibly all data */
+  if ( ! wi )
+  {
+    if ( (batch = newitem (WI_RECORDS, NULL)) )
+    {
+      packtraces (1, batch);
+      packedtraces += mstg->numtraces;
+      pipe_send (stage->next, batch);
+    }
+
+    return;
+  }
 
-      /* Determine data sample size */
-      datasamplesize = ( *(cheader+76) == '4' ) ? 4 : 2;
+  if ( wi->type != WI_CHANNEL )
+  {
+    pipe_send (stage->next, wi);
+    return;
+  }
 
-      if ( verbose )
-        fprintf (stderr, "[%s] '%s_%s' (%s): %s%s, %lld %d byte samps @ %.4f Hz\n",
-                 seisanfile, msr->station, component, msr->channel,
-                 timestr, (uctimeflag) ? " [UNCERTAIN]" : "",
-                 (long long int)msr->samplecnt, datasamplesize, msr->samprate);
+  msr = wi->msr;
 
-      expectdata = 1;
-      expectdatalen = msr->samplecnt * datasamplesize;
-      expectheader = 0;
-      cheaderlen = 0;
-      continue;
-    }
+  if ( verbose > 1 )
+  {
+    ms_log (1, "[%s] %lld samps @ %.6f Hz for N: '%s', S: '%s', L: '%s', C: '%s'\n",
+             wi->seisanfile, (long long int)msr->numsamples, msr->samprate,
+             msr->network, msr->station,  msr->location, msr->channel);
+  }
 
-    /* Expecting data */
-    if ( expectdata )
+  /* Pack raw samples directly */
+  if ( rawsamples )
+  {
+    if ( (batch = newitem (WI_RECORDS, wi->seisanfile)) )
     {
-      /* Copy record into data buffer */
-      if ( (reclen + datalen) <= expectdatalen )
-      {
-        /* Make sure enough memory is available */
-        if ( (reclen + datalen) > maxdatalen )
-        {
-          if ( (data = realloc (data, (reclen+datalen))) == NULL )
-          {
-            fprintf (stderr, "Error allocating memory for record\n");
-            break;
-          }
-          else
-            maxdatalen = reclen + datalen;
-        }
+      packchannel (wi, batch);
+      pipe_send (stage->next, batch);
+    }
 
-        memcpy (data + datalen, record, reclen);
-        datalen += reclen;
-      }
-      else
-      {
-        fprintf (stderr, "Record is too long for the expected data!\n");
-        fprintf (stderr, " datalen: %d, reclen: %d, expectdatalen: %d\n",
-                 datalen, reclen, expectdatalen);
-        break;
-      }
+    freeitem (wi);
+    return;
+  }
 
-      /* Continue reading records if enough data has not been read */
-      if ( datalen < expectdatalen )
-        continue;
+  /* Add data to MSTraceGroup, transferring the sample buffer */
+  if ( ! (mst = mst_adoptsamples (mstg, msr, 0, -1.0, -1.0)) )
+  {
+    fprintf (stderr, "[%s] Error adding samples to MSTraceGroup\n", wi->seisanfile);
+    freeitem (wi);
+    return;
+  }
 
-      /* Number of samples implied by data record length */
-      msr->numsamples = datalen / datasamplesize;
+  /* The sample buffer is now owned by the MSTraceGroup */
+  if ( ! msr->datasamples )
+    wi->data = 0;
 
-      if ( msr->samplecnt != msr->numsamples )
-      {
-        fprintf (stderr, "[%s] Number of samples in channel header != data section\n", seisanfile);
-        fprintf (stderr, "  Header: %lld, Data section: %lld\n",
-                 (long long int)msr->samplecnt, (long long int)msr->numsamples);
-      }
+  /* Create an MSRecord template for the MSTrace by copying the current holder */
+  mst->prvtptr = mktemplate ((MSRecord *) mst->prvtptr, wi);
 
-      /* Make sure we have 32-bit integers in host byte order */
-      if ( ! (msr->datasamples = mkhostdata (data, datalen, datasamplesize, swapflag)) )
-        break;
+  /* Unless buffering all files in memory pack any MSTraces now */
+  if ( ! bufferall )
+  {
+    if ( (batch = newitem (WI_RECORDS, wi->seisanfile)) )
+    {
+      packtraces (1, batch);
+      pipe_send (stage->next, batch);
+    }
 
-      /* Add data to MSTraceGroup */
-      msr->sampletype = 'i';
+    packedtraces += mstg->numtraces;
+    mst_initgroup (mstg);
+  }
 
-      if ( verbose > 1 )
-      {
-        fprintf (stderr, "[%s] %lld samps @ %.6f Hz for N: '%s', S: '%s', L: '%s', C: '%s'\n",
-                 seisanfile, (long long int)msr->numsamples, msr->samprate,
-                 msr->network, msr->station,  msr->location, msr->channel);
-      }
+  freeitem (wi);
+}  /* End of encodingstage() */
 
-      if ( ! (mst = mst_addmsrtogroup (mstg, msr, 0, -1.0, -1.0)) )
-      {
-        fprintf (stderr, "[%s] Error adding samples to MSTraceGroup\n", seisanfile);
-      }
 
-      /* Create an MSRecord template for the MSTrace by copying the current holder */
-      if ( ! mst->prvtptr )
-      {
-        mst->prvtptr = malloc (sizeof(MSRecord));
-      }
+/***************************************************************************
+ * outputstage:
+ *
+ * Pipeline stage to write packed records to the output file selected
+ * at the beginning of each input file.
+ ***************************************************************************/
+static void
+outputstage (PipeStage *stage, void *item)
+{
+  struct outputstate *os = (struct outputstate *) stage->data;
+  struct workitem *wi = (struct workitem *) item;
 
-      memcpy (mst->prvtptr, msr, sizeof(MSRecord));
+  if ( ! wi )
+    return;
 
-      /* If a blockette 100 is requested add it */
-      if ( srateblkt )
-      {
-        memset (&Blkt100, 0, sizeof(struct blkt_100_s));
-        Blkt100.samprate = (float) msr->samprate;
-        msr_addblockette ((MSRecord *) mst->prvtptr, (char *) &Blkt100,
-                          sizeof(struct blkt_100_s), 100, 0);
-      }
+  if ( wi->type == WI_FILEBEGIN )
+  {
+    os->fileofp = wi->ofp;
+  }
+  else if ( wi->type == WI_RECORDS && wi->datalen > 0 )
+  {
+    /* The records buffer is released by the output routine */
+    if ( out_write (os->fileofp, wi->data, wi->datalen) )
+    {
+      fprintf (stderr, "Error writing to output file\n");
+    }
 
-      /* Create a FSDH for the template */
-      if ( ! ((MSRecord *)mst->prvtptr)->fsdh )
-      {
-        ((MSRecord *)mst->prvtptr)->fsdh = malloc (sizeof(struct fsdh_s));
-        memset (((MSRecord *)mst->prvtptr)->fsdh, 0, sizeof(struct fsdh_s));
-      }
+    wi->data = 0;
+  }
+  else if ( wi->type == WI_FILEEND )
+  {
+    if ( os->fileofp && os->fileofp != ofp && out_close (os->fileofp) )
+      fprintf (stderr, "Error writing to output file: %s\n", strerror(errno));
 
-      /* Set bit 7 (time tag questionable) in the data quality flags appropriately */
-      if ( uctimeflag )
-        ((MSRecord *)mst->prvtptr)->fsdh->dq_flags |= 0x80;
-      else
-        ((MSRecord *)mst->prvtptr)->fsdh->dq_flags &= ~(0x80);
+    os->fileofp = ofp;
+  }
 
-      /* Unless buffering all files in memory pack any MSTraces now */
-      if ( ! bufferall )
-      {
-        packtraces (1);
-        packedtraces += mstg->numtraces;
-        mst_initgroup (mstg);
-      }
+  freeitem (wi);
+}  /* End of outputstage() */
 
-      /* Cleanup and reset state */
-      msr->datasamples = 0;
-      msr = msr_init (msr);
 
-      expectheader = 1;
-      expectdata = 0;
-      datalen = 0;
-      continue;
-    }
+/***************************************************************************
+ * newitem:
+ *
+ * Allocate and initialize a work item.
+ *
+ * Returns a pointer to a new work item on success and 0 on failure.
+ ***************************************************************************/
+static struct workitem *
+newitem (int type, char *seisanfile)
+{
+  struct workitem *wi;
+
+  if ( (wi = (struct workitem *) calloc (1, sizeof(struct workitem))) == NULL )
+  {
+    fprintf (stderr, "Error allocating memory for work item\n");
+    return 0;
   }
 
-  fclose (ifp);
+  wi->type = type;
+  wi->seisanfile = seisanfile;
+
+  return wi;
+}  /* End of newitem() */
+
+
+/***************************************************************************
+ * freeitem:
+ *
+ * Free a work item and associated buffers.
+ ***************************************************************************/
+static void
+freeitem (struct workitem *wi)
+{
+  if ( ! wi )
+    return;
 
-  if ( ofp  && ! outputfile )
+  if ( wi->msr )
   {
-    fclose (ofp);
-    ofp = 0;
+    wi->msr->datasamples = 0;
+    msr_free (&wi->msr);
   }
 
-  if ( data )
-    free (data);
-
-  if ( record )
-    free (record);
+  if ( wi->data )
+    free (wi->data);
 
-  if ( msr )
-    msr_free (&msr);
+  if ( wi->framelens )
+    free (wi->framelens);
 
-  return 0;
-}  /* End of seisan2group() */
+  free (wi);
+}  /* End of freeitem() */
 
 
 /***************************************************************************
@@ -674,26 +1520,23 @@ seisan2group (char *seisanfile, MSTraceGroup *mstg)
  * Returns 0 on sucess and -1 on failure.
  ***************************************************************************/
 static int
-detectformat (FILE *ifp, flag *formatflag, flag *swapflag, char *seisanfile)
+detectformat (InputFile *ifp, flag *formatflag, flag *swapflag, char *seisanfile)
 {
   int32_t ident;
 
-  /* Read the first four bytes into ident */
-  if ( fread (&ident, 4, 1, ifp) < 1 )
+  /* Peek at the first four bytes without consuming them */
+  if ( in_peek (&ident, 4, ifp) < 4 )
   {
     return -1;
   }
 
-  /* Rewind the file position pointer to the beginning */
-  rewind (ifp);
-
   /* If the first character is a 'K' assume the PC version <= 6.0
    * format, otherwise test if the ident is (80) with either byte
    * order which indicates the Sun/Linux and later PC versions
    * format. */
-  if ( *(char*)&ident == 'K' )
+  if ( *(char*)&ident == SEISAN_SIGNATURE )
   {
-    *formatflag = 1;
+    *formatflag = SEISAN_FRAME1;
 
     /* The PC <= 6.0 format should always be little-endian data */
     *swapflag = (ms_bigendianhost()) ? 1 : 0;
@@ -702,9 +1545,9 @@ detectformat (FILE *ifp, flag *formatflag, flag *swapflag, char *seisanfile)
   }
 
   /* Test if the ident is 80 */
-  if ( ident == 80 )
+  if ( ident == SEISAN_LINELEN )
   {
-    *formatflag = 4;
+    *formatflag = SEISAN_FRAME4;
     *swapflag = 0;
 
     return 0;
@@ -712,9 +1555,9 @@ detectformat (FILE *ifp, flag *formatflag, flag *swapflag, char *seisanfile)
 
   /* Swap and test if the ident is 80 */
   ms_gswap4 ( &ident );
-  if ( ident == 80 )
+  if ( ident == SEISAN_LINELEN )
   {
-    *formatflag = 4;
+    *formatflag = SEISAN_FRAME4;
     *swapflag = 1;
 
     return 0;
@@ -731,48 +1574,33 @@ detectformat (FILE *ifp, flag *formatflag, flag *swapflag, char *seisanfile)
  * byte order.  The routine may modify the contents of the supplied
  * data sample buffer.
  *
- * A buffer used for 16->32 bit conversions is statically maintained
- * for re-use.  If 'data' is specified as 0 this internal buffer will
- * be released.
+ * For 32-bit samples the supplied buffer is converted in place and
+ * returned, for 16-bit samples a new buffer is allocated that must be
+ * freed by the caller.
  *
- * Returns a pointer on success and 0 on failure or reset.
+ * Returns a pointer on success and 0 on failure.
  ***************************************************************************/
 static int32_t *
 mkhostdata (char *data, int datalen, int datasamplesize, flag swapflag)
 {
-  static int32_t *samplebuffer = 0;
-  static int maxsamplebufferlen = 0;
-
   int32_t *hostdata = 0;
   int32_t *sampleptr4;
   int16_t *sampleptr2;
   int numsamples;
 
   if ( ! data )
-  {
-    if ( samplebuffer )
-      free (samplebuffer);
-    samplebuffer = 0;
-    maxsamplebufferlen = 0;
-
     return 0;
-  }
 
   if ( datasamplesize == 2 )
   {
-    if ( (datalen * 2) > maxsamplebufferlen )
+    if ( (hostdata = (int32_t *) malloc ((datalen > 0) ? (datalen*2) : 1)) == NULL )
     {
-      if ( (samplebuffer = realloc (samplebuffer, (datalen*2))) == NULL )
-      {
-        fprintf (stderr, "Error allocating memory for sample buffer\n");
-        return 0;
-      }
-      else
-        maxsamplebufferlen = datalen * 2;
+      fprintf (stderr, "Error allocating memory for sample buffer\n");
+      return 0;
     }
 
     sampleptr2 = (int16_t *) data;
-    sampleptr4 = samplebuffer;
+    sampleptr4 = hostdata;
     numsamples = datalen / datasamplesize;
 
     /* Convert to 32-bit and swap data samples if needed */
@@ -783,8 +1611,6 @@ mkhostdata (char *data, int datalen, int datasamplesize, flag swapflag)
 
       *(sampleptr4++) = *(sampleptr2++);
     }
-
-    hostdata = samplebuffer;
   }
   else if ( datasamplesize == 4 )
   {
@@ -799,7 +1625,7 @@ mkhostdata (char *data, int datalen, int datasamplesize, flag swapflag)
     }
 
     if ( verbose > 1 && encoding == 1 )
-      fprintf (stderr, "WARNING: attempting to pack 32-bit integers into 16-bit encoding\n");
+      ms_log (1, "WARNING: attempting to pack 32-bit integers into 16-bit encoding\n");
 
     hostdata = (int32_t *) data;
   }
@@ -813,6 +1639,88 @@ mkhostdata (char *data, int datalen, int datasamplesize, flag swapflag)
 }  /* End of mkhostdata() */
 
 
+/* Reverse the byte order of 16 and 32-bit unsigned integers */
+#define SWAP16(X) ((uint16_t) (((X) << 8) | ((X) >> 8)))
+#define SWAP32(X) (((X) << 24) | (((X) << 8) & 0x00FF0000u) | \
+                   (((X) >> 8) & 0x0000FF00u) | ((X) >> 24))
+
+/* Convert samples to floats in a single pass, written without calls
+ * or branches so compilers can vectorize the loop */
+#define CONVERTLOOP(INTYPE, SAMPLE, OUTTYPE)                   \
+  {                                                            \
+    const INTYPE *in = (const INTYPE *) data;                  \
+    OUTTYPE *out = (OUTTYPE *) floatdata;                      \
+    for ( idx = 0; idx < numsamples; idx++ )                   \
+      out[idx] = (OUTTYPE) (SAMPLE * scale);                   \
+  }
+
+/***************************************************************************
+ * mkfloatdata:
+ *
+ * Given the raw input data return a new buffer of 32-bit (sampletype
+ * 'f') or 64-bit (sampletype 'd') floats in host byte order.  Byte
+ * swapping, conversion and division by the gain factor are done in a
+ * single pass over the samples.  A gain of 0 leaves the sample values
+ * unchanged.
+ *
+ * The returned buffer must be freed by the caller.
+ *
+ * Returns a pointer on success and 0 on failure.
+ ***************************************************************************/
+static void *
+mkfloatdata (char *data, int datalen, int datasamplesize, flag swapflag,
+             double gain, char sampletype)
+{
+  void *floatdata;
+  double scale;
+  int numsamples;
+  int idx;
+
+  if ( ! data )
+    return 0;
+
+  if ( datasamplesize != 2 && datasamplesize != 4 )
+  {
+    fprintf (stderr, "Error, unknown data sample size: %d\n", datasamplesize);
+    return 0;
+  }
+
+  numsamples = datalen / datasamplesize;
+  scale = ( gain != 0.0 ) ? 1.0 / gain : 1.0;
+
+  if ( (floatdata = malloc ((numsamples > 0) ? (numsamples * ms_samplesize (sampletype)) : 1)) == NULL )
+  {
+    fprintf (stderr, "Error allocating memory for sample buffer\n");
+    return 0;
+  }
+
+  if ( sampletype == 'f' )
+  {
+    if ( datasamplesize == 2 && swapflag )
+      CONVERTLOOP (uint16_t, (int16_t) SWAP16 (in[idx]), float)
+    else if ( datasamplesize == 2 )
+      CONVERTLOOP (int16_t, in[idx], float)
+    else if ( swapflag )
+      CONVERTLOOP (uint32_t, (int32_t) SWAP32 (in[idx]), float)
+    else
+      CONVERTLOOP (int32_t, in[idx], float)
+  }
+  else
+  {
+    if ( datasamplesize == 2 && swapflag )
+      CONVERTLOOP (uint16_t, (int16_t) SWAP16 (in[idx]), double)
+    else if ( datasamplesize == 2 )
+      CONVERTLOOP (int16_t, in[idx], double)
+    else if ( swapflag )
+      CONVERTLOOP (uint32_t, (int32_t) SWAP32 (in[idx]), double)
+    else
+      CONVERTLOOP (int32_t, in[idx], double)
+  }
+
+  return floatdata;
+}  /* End of mkfloatdata() */
+
+
 /***************************************************************************
  * translatechan:
  *
@@ -911,6 +1819,10 @@ parameter_proc (int argcount, char **argvec)
     {
       bufferall = 1;
     }
+    else if (strcmp (argvec[optind], "-g") == 0)
+    {
+      applygain = 1;
+    }
     else if (strcmp (argvec[optind], "-n") == 0)
     {
       forcenet = getoptval(argcount, argvec, optind++);
@@ -921,7 +1833,8 @@ parameter_proc (int argcount, char **argvec)
     }
     else if (strcmp (argvec[optind], "-r") == 0)
     {
-      packreclen = atoi (getoptval(argcount, argvec, optind++));
+      if ( parsereclens (getoptval(argcount, argvec, optind++)) )
+        exit (1);
     }
     else if (strcmp (argvec[optind], "-e") == 0)
     {
@@ -931,6 +1844,10 @@ parameter_proc (int argcount, char **argvec)
     {
       byteorder = atoi (getoptval(argcount, argvec, optind++));
     }
+    else if (strcmp (argvec[optind], "-j") == 0)
+    {
+      packworkers = atoi (getoptval(argcount, argvec, optind++));
+    }
     else if (strcmp (argvec[optind], "-rfy") == 0)
     {
       retainfutureyear = 1;
@@ -955,6 +1872,12 @@ parameter_proc (int argcount, char **argvec)
     }
   }
 
+  if ( packworkers < 1 )
+  {
+    fprintf (stderr, "Number of packing workers must be at least 1\n");
+    exit(1);
+  }
+
   /* Make sure an output file is specified if buffering all */
   if ( bufferall && ! outputfile )
   {
@@ -1199,6 +2122,57 @@ addnode (struct listnode **listroot, char *key, char *data)
 }  /* End of addnode() */
 
 
+/***************************************************************************
+ * parsereclens:
+ *
+ * Parse a record length or a comma separated list of record lengths
+ * to choose from when packing, the first is used when data is not
+ * flushed.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+parsereclens (char *reclens)
+{
+  char *list = reclens;
+  char *endptr;
+  long int reclen;
+
+  packreclencount = 0;
+
+  while ( *reclens )
+  {
+    reclen = strtol (reclens, &endptr, 10);
+
+    if ( endptr == reclens || (*endptr && *endptr != ',') ||
+         reclen < MINRECLEN || reclen > MAXRECLEN || (reclen & (reclen - 1)) )
+    {
+      fprintf (stderr, "Record length must be a power of 2 from %d to %d: %s\n",
+               MINRECLEN, MAXRECLEN, list);
+      return -1;
+    }
+
+    if ( packreclencount >= MAXRECLENS )
+    {
+      fprintf (stderr, "Too many record lengths, maximum is %d\n", MAXRECLENS);
+      return -1;
+    }
+
+    packreclens[packreclencount++] = (int) reclen;
+
+    reclens = ( *endptr ) ? endptr + 1 : endptr;
+  }
+
+  if ( packreclencount == 0 )
+  {
+    fprintf (stderr, "No record length specified\n");
+    return -1;
+  }
+
+  return 0;
+}  /* End of parsereclens() */
+
+
 /***************************************************************************
  * addmapnode:
  *
@@ -1230,33 +2204,33 @@ addmapnode (struct listnode **listroot, char *mapping)
 
 /***************************************************************************
  * record_handler:
- * Saves passed records to the output file.
+ * Add passed records to the batch of records for the output stage.
  ***************************************************************************/
 static void
 record_handler (char *record, int reclen, void *handlerdata)
 {
-  if ( fwrite(record, reclen, 1, ofp) != 1 )
+  struct workitem *batch = (struct workitem *) handlerdata;
+  int newsize;
+
+  if ( (batch->datalen + reclen) > batch->datasize )
   {
-    fprintf (stderr, "Error writing to output file\n");
-  }
-}  /* End of record_handler() */
+    newsize = (batch->datasize > 0) ? batch->datasize : reclen;
+    while ( newsize < (batch->datalen + reclen) )
+      newsize *= 2;
+
+    if ( (batch->data = realloc (batch->data, newsize)) == NULL )
+    {
+      fprintf (stderr, "Error allocating memory for output records\n");
+      batch->datalen = batch->datasize = 0;
+      return;
+    }
 
+    batch->datasize = newsize;
+  }
 
-/***************************************************************************
- * portable_ftell64:
- * A portable file position function.
- *
- * Returns current position in file.
- ***************************************************************************/
-static int64_t
-portable_ftell64 (FILE *stream)
-{
-#if defined(LMP_WIN)
-  return (int64_t) _ftelli64(stream);
-#else
-  return (int64_t) ftello (stream);
-#endif
-}  /* End of portable_ftell64() */
+  memcpy (batch->data + batch->datalen, record, reclen);
+  batch->datalen += reclen;
+}  /* End of record_handler() */
 
 
 /***************************************************************************
@@ -1276,13 +2250,18 @@ usage (void)
            " -v             Be more verbose, multiple flags can be used\n"
            " -S             Include SEED blockette 100 for very irrational sample rates\n"
            " -B             Buffer data before packing, default packs at end of each block\n"
+           " -g             Apply SeisAn gain factors, channels with a gain are packed as floats\n"
+           " -j workers     Encode Steim records of long buffered traces with workers, default: 1\n"
            " -rfy           Retain far future years, default is to shift years > 2050 to 2050\n"
            " -n netcode     Specify the SEED network code, default is blank\n"
            " -l loccode     Specify the SEED location code, default is blank\n"
            " -r bytes       Specify record length in bytes for packing, default: 4096\n"
+           "                  a list, e.g. 4096,1024,512, chooses the lengths packing\n"
+           "                  each channel with the fewest bytes\n"
            " -e encoding    Specify SEED encoding format for packing, default: 11 (Steim2)\n"
            " -b byteorder   Specify byte order for packing, MSBF: 1 (default), LSBF: 0\n"
            " -o outfile     Specify the output file, default is <inputfile>_MSEED\n"
+           "                  unix:<path> or tcp:<host>:<port> sends to a socket\n"
            "\n"
            " -T comp=chan   Specify component-channel mapping, can be used many times\n"
            "                  e.g.: \"-T SBIZ=SHZ -T SBIN=SHN -T SBIE=SHE\"\n"
@@ -1293,10 +2272,14 @@ usage (void)
            "                  'filenr.lis' it is assumed to contain a list of data files\n"
            "                  to be read.  This list can either be a simple text list\n"
            "                  or in the 'dirf' (filenr.lis) format.\n"
+           "                  Files may be gzip or zstd compressed and tar archives\n"
+           "                  of SeisAn files.\n"
            "\n"
            "Supported Mini-SEED encoding formats:\n"
            " 1  : 16-bit integers (only works if samples can be represented in 16-bits)\n"
            " 3  : 32-bit integers\n"
+           " 4  : 32-bit floats, also used for channels with a gain applied\n"
+           " 5  : 64-bit floats, channels with a gain applied are packed as 64-bit floats\n"
            " 10 : Steim 1 compression\n"
            " 11 : Steim 2 compression\n"
            "\n");